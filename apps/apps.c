@@ -145,6 +145,11 @@
 #include "apps.h"
 #undef NON_MAIN
 
+#if defined(OPENSSL_THREADS) && defined(OPENSSL_SYS_UNIX)
+# include <pthread.h>
+# define APPS_THREADS
+#endif
+
 #ifdef _WIN32
 static int WIN32_rename(const char *from, const char *to);
 # define rename(from,to) WIN32_rename((from),(to))
@@ -545,6 +550,68 @@ void destroy_ui_method(void)
     }
 }
 
+#ifdef APPS_THREADS
+static pthread_mutex_t *thread_locks = NULL;
+
+static void thread_locking_cb(int mode, int type, const char *file, int line)
+{
+    if (mode & CRYPTO_LOCK)
+        pthread_mutex_lock(&thread_locks[type]);
+    else
+        pthread_mutex_unlock(&thread_locks[type]);
+}
+#endif
+
+/*
+ * Commands that run several threads need the library locks. Returns 1 if
+ * they have been set up, 0 if threads are not supported or another locking
+ * callback is already installed.
+ */
+int setup_thread_locking(void)
+{
+#ifdef APPS_THREADS
+    int i;
+
+    if (thread_locks != NULL)
+        return 1;
+    if (CRYPTO_get_locking_callback() != NULL)
+        return 0;
+    thread_locks = OPENSSL_malloc(CRYPTO_num_locks() * sizeof(*thread_locks));
+    if (thread_locks == NULL)
+        return 0;
+    for (i = 0; i < CRYPTO_num_locks(); i++)
+        pthread_mutex_init(&thread_locks[i], NULL);
+    CRYPTO_set_locking_callback(thread_locking_cb);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int thread_locking_enabled(void)
+{
+#ifdef APPS_THREADS
+    return thread_locks != NULL;
+#else
+    return 0;
+#endif
+}
+
+void destroy_thread_locking(void)
+{
+#ifdef APPS_THREADS
+    int i;
+
+    if (thread_locks == NULL)
+        return;
+    CRYPTO_set_locking_callback(NULL);
+    for (i = 0; i < CRYPTO_num_locks(); i++)
+        pthread_mutex_destroy(&thread_locks[i]);
+    OPENSSL_free(thread_locks);
+    thread_locks = NULL;
+#endif
+}
+
 int password_callback(char *buf, int bufsiz, int verify, PW_CB_DATA *cb_tmp)
 {
     UI *ui = NULL;
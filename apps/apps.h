@@ -226,6 +226,9 @@ int password_callback(char *buf, int bufsiz, int verify, PW_CB_DATA *cb_data);
 
 int setup_ui_method(void);
 void destroy_ui_method(void);
+int setup_thread_locking(void);
+int thread_locking_enabled(void);
+void destroy_thread_locking(void);
 
 int should_retry(int i);
 int args_from_file(char *file, int *argc, char **argv[]);
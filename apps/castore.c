@@ -0,0 +1,188 @@
+/* apps/castore.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "apps.h"
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#undef PROG
+#define PROG castore_main
+
+static int add_certs(STACK_OF(X509) *certs, const char *file);
+
+int MAIN(int, char **);
+
+int MAIN(int argc, char **argv)
+{
+    STACK_OF(OPENSSL_STRING) *infiles = NULL;
+    STACK_OF(X509) *certs = NULL;
+    char **args, *outfile = NULL;
+    BIO *out = NULL;
+    int i, ret = 1, badarg = 0, verbose = 0;
+
+    apps_startup();
+
+    if (bio_err == NULL)
+        bio_err = BIO_new_fp(stderr, BIO_NOCLOSE);
+    if (!load_config(bio_err, NULL))
+        goto end;
+    ERR_load_crypto_strings();
+
+    infiles = sk_OPENSSL_STRING_new_null();
+    certs = sk_X509_new_null();
+    if (infiles == NULL || certs == NULL)
+        goto end;
+
+    args = argv + 1;
+    while (!badarg && *args && *args[0] == '-') {
+        if (!strcmp(*args, "-in")) {
+            if (args[1]) {
+                args++;
+                sk_OPENSSL_STRING_push(infiles, *args);
+            } else
+                badarg = 1;
+        } else if (!strcmp(*args, "-out")) {
+            if (args[1]) {
+                args++;
+                outfile = *args;
+            } else
+                badarg = 1;
+        } else if (!strcmp(*args, "-verbose"))
+            verbose = 1;
+        else
+            badarg = 1;
+        args++;
+    }
+
+    if (badarg || outfile == NULL || sk_OPENSSL_STRING_num(infiles) == 0) {
+        BIO_printf(bio_err, "Compile certificates into a precompiled store\n");
+        BIO_printf(bio_err, "Usage castore [options]\n");
+        BIO_printf(bio_err, "where options are\n");
+        BIO_printf(bio_err,
+                   "-in file   PEM certificate file, may be repeated\n");
+        BIO_printf(bio_err, "-out file  store file to write\n");
+        BIO_printf(bio_err, "-verbose   report the number of certificates\n");
+        goto end;
+    }
+
+    for (i = 0; i < sk_OPENSSL_STRING_num(infiles); i++) {
+        if (!add_certs(certs, sk_OPENSSL_STRING_value(infiles, i)))
+            goto end;
+    }
+
+    if ((out = BIO_new_file(outfile, "wb")) == NULL) {
+        BIO_printf(bio_err, "Can't open output file %s\n", outfile);
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+    if (!X509_mmap_store_write(out, certs) || BIO_flush(out) <= 0) {
+        BIO_printf(bio_err, "Error writing store file %s\n", outfile);
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+    if (verbose)
+        BIO_printf(bio_err, "%d certificates written to %s\n",
+                   sk_X509_num(certs), outfile);
+    ret = 0;
+ end:
+    BIO_free(out);
+    sk_X509_pop_free(certs, X509_free);
+    sk_OPENSSL_STRING_free(infiles);
+    apps_shutdown();
+    OPENSSL_EXIT(ret);
+}
+
+/*
+ * Read every certificate in a PEM file, keeping trust settings of
+ * "TRUSTED CERTIFICATE" blocks. CRLs and keys are ignored.
+ */
+static int add_certs(STACK_OF(X509) *certs, const char *file)
+{
+    STACK_OF(X509_INFO) *sk = NULL;
+    X509_INFO *xi;
+    BIO *in;
+    int n = 0;
+
+    if ((in = BIO_new_file(file, "r")) == NULL) {
+        BIO_printf(bio_err, "Can't open input file %s\n", file);
+        ERR_print_errors(bio_err);
+        return 0;
+    }
+    sk = PEM_X509_INFO_read_bio(in, NULL, NULL, NULL);
+    BIO_free(in);
+    if (sk == NULL) {
+        BIO_printf(bio_err, "Error reading certificates from %s\n", file);
+        ERR_print_errors(bio_err);
+        return 0;
+    }
+    while ((xi = sk_X509_INFO_shift(sk)) != NULL) {
+        if (xi->x509 != NULL) {
+            if (!sk_X509_push(certs, xi->x509)) {
+                X509_INFO_free(xi);
+                n = -1;
+                break;
+            }
+            xi->x509 = NULL;
+            n++;
+        }
+        X509_INFO_free(xi);
+    }
+    sk_X509_INFO_pop_free(sk, X509_INFO_free);
+    if (n <= 0) {
+        BIO_printf(bio_err, "No certificates read from %s\n", file);
+        return 0;
+    }
+    return 1;
+}
@@ -71,6 +71,7 @@
 # include <openssl/comp.h>
 #endif
 #include <ctype.h>
+#include <limits.h>
 
 int set_hex(char *in, unsigned char *out, int size);
 #undef SIZE
@@ -81,6 +82,557 @@ int set_hex(char *in, unsigned char *out, int size);
 #define BSIZE   (8*1024)
 #define PROG    enc_main
 
+/*
+ * Chunked AEAD container used when enc is given a GCM or OCB cipher.  The
+ * stream is a fixed header followed by independently sealed chunks:
+ *
+ *   header: "AEADchk1" | cipher NID (2) | tag length (1) |
+ *           chunk size (4) | nonce base (12)
+ *   chunk:  ciphertext (chunk size, the last one may be shorter) | tag
+ *
+ * The nonce of chunk i is the nonce base with i XORed into its last eight
+ * bytes. The AAD of every chunk is the header, the chunk index and a flag
+ * marking the final chunk, so the header is authenticated and truncation or
+ * reordering is detected.  All integers are big-endian.  Since every chunk
+ * but the last has the same size, any chunk can be located and decrypted on
+ * its own.
+ */
+#define AEAD_TAG_LEN            16
+#define AEAD_NONCE_LEN          12
+#define AEAD_HDR_LEN            (8 + 2 + 1 + 4 + AEAD_NONCE_LEN)
+#define AEAD_AAD_LEN            (AEAD_HDR_LEN + 8 + 1)
+#define AEAD_CHUNK              (64*1024)
+#define AEAD_MAX_CHUNK          (64*1024*1024)
+#define AEAD_MAX_THREADS        64
+/* Upper bound on the input buffered for one batch of chunks */
+#define AEAD_MAX_BATCH          (256*1024*1024)
+/* Chunks handed out per thread in each batch */
+#define AEAD_JOBS_PER_THREAD    4
+
+#if defined(OPENSSL_THREADS) && defined(OPENSSL_SYS_UNIX)
+# include <pthread.h>
+# define AEAD_THREADS
+#endif
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# ifdef _POSIX_MAPPED_FILES
+#  include <sys/mman.h>
+#  define AEAD_MMAP
+# endif
+#endif
+
+static const char aead_magic[] = "AEADchk1";
+
+typedef struct {
+    const EVP_CIPHER *cipher;
+    const unsigned char *key;
+    unsigned char hdr[AEAD_HDR_LEN];
+    size_t chunk;
+    int enc;
+} AEAD_PARAMS;
+
+typedef struct {
+    const unsigned char *in;
+    size_t inl;
+    unsigned char *out;
+    size_t outl;
+    unsigned long idx;
+    int final;
+    int ok;
+} AEAD_JOB;
+
+static int enc_aead_cipher(const EVP_CIPHER *c)
+{
+    int mode = EVP_CIPHER_mode(c);
+
+    return (EVP_CIPHER_flags(c) & EVP_CIPH_FLAG_AEAD_CIPHER) != 0 &&
+        (mode == EVP_CIPH_GCM_MODE
+#ifndef OPENSSL_NO_OCB
+         || mode == EVP_CIPH_OCB_MODE
+#endif
+        );
+}
+
+static int aead_ctx_init(EVP_CIPHER_CTX *ctx, const AEAD_PARAMS *p)
+{
+    EVP_CIPHER_CTX_init(ctx);
+    if (!EVP_CipherInit_ex(ctx, p->cipher, NULL, NULL, NULL, p->enc)
+        || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                                AEAD_NONCE_LEN, NULL)
+        || !EVP_CipherInit_ex(ctx, NULL, NULL, p->key, NULL, p->enc))
+        return 0;
+    return 1;
+}
+
+static void aead_do_job(EVP_CIPHER_CTX *ctx, const AEAD_PARAMS *p,
+                        AEAD_JOB *job)
+{
+    unsigned char nonce[AEAD_NONCE_LEN], aad[AEAD_AAD_LEN];
+    unsigned long v = job->idx;
+    size_t len = job->inl;
+    int i, outl = 0, tmpl;
+
+    job->ok = 0;
+    job->outl = 0;
+    memcpy(nonce, p->hdr + AEAD_HDR_LEN - AEAD_NONCE_LEN, AEAD_NONCE_LEN);
+    memcpy(aad, p->hdr, AEAD_HDR_LEN);
+    for (i = 7; i >= 0; i--) {
+        nonce[AEAD_NONCE_LEN - 8 + i] ^= (unsigned char)v;
+        aad[AEAD_HDR_LEN + i] = (unsigned char)v;
+        v >>= 8;
+    }
+    aad[AEAD_AAD_LEN - 1] = job->final ? 1 : 0;
+
+    if (!p->enc) {
+        if (len < AEAD_TAG_LEN)
+            return;
+        len -= AEAD_TAG_LEN;
+    }
+    if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, nonce, p->enc))
+        return;
+    if (!p->enc && !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                        AEAD_TAG_LEN,
+                                        (void *)(job->in + len)))
+        return;
+    if (!EVP_CipherUpdate(ctx, NULL, &tmpl, aad, sizeof(aad)))
+        return;
+    if (len > 0 && !EVP_CipherUpdate(ctx, job->out, &outl, job->in, (int)len))
+        return;
+    if (!EVP_CipherFinal_ex(ctx, job->out + outl, &tmpl))
+        return;
+    outl += tmpl;
+    if (p->enc) {
+        if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_LEN,
+                                 job->out + outl))
+            return;
+        outl += AEAD_TAG_LEN;
+    }
+    job->outl = outl;
+    job->ok = 1;
+}
+
+#ifdef AEAD_THREADS
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    const AEAD_PARAMS *p;
+    AEAD_JOB *jobs;
+    int njobs, next, pending, shutdown;
+    int nthreads, nctx, claimed;
+    pthread_t tid[AEAD_MAX_THREADS];
+    EVP_CIPHER_CTX ctx[AEAD_MAX_THREADS];
+} AEAD_POOL;
+
+/* Called and returns with pool->lock held */
+static void aead_pool_drain(AEAD_POOL *pool, EVP_CIPHER_CTX *ctx)
+{
+    int j;
+
+    while (pool->next < pool->njobs) {
+        j = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        aead_do_job(ctx, pool->p, &pool->jobs[j]);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+}
+
+static void *aead_worker(void *arg)
+{
+    AEAD_POOL *pool = arg;
+    EVP_CIPHER_CTX *ctx;
+
+    pthread_mutex_lock(&pool->lock);
+    ctx = &pool->ctx[pool->claimed++];
+    for (;;) {
+        while (!pool->shutdown && pool->next >= pool->njobs)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->shutdown)
+            break;
+        aead_pool_drain(pool, ctx);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static AEAD_POOL *aead_pool_new(const AEAD_PARAMS *p, int nthreads)
+{
+    AEAD_POOL *pool;
+
+    if ((pool = OPENSSL_malloc(sizeof(*pool))) == NULL)
+        return NULL;
+    memset(pool, 0, sizeof(*pool));
+    pool->p = p;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    /* Without the library locks the calling thread does all the work */
+    if (!thread_locking_enabled())
+        return pool;
+
+    /*
+     * Contexts are set up here rather than in the workers so that engine
+     * and cipher lookups all happen on this thread. The calling thread is
+     * the first worker and uses its own context.
+     */
+    while (pool->nthreads < nthreads - 1) {
+        if (!aead_ctx_init(&pool->ctx[pool->nctx++], p))
+            break;
+        if (pthread_create(&pool->tid[pool->nthreads], NULL, aead_worker,
+                           pool) != 0)
+            break;
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+static void aead_pool_free(AEAD_POOL *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->tid[i], NULL);
+    for (i = 0; i < pool->nctx; i++)
+        EVP_CIPHER_CTX_cleanup(&pool->ctx[i]);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    OPENSSL_free(pool);
+}
+#else
+typedef struct {
+    int nthreads;
+} AEAD_POOL;
+# define aead_pool_new(p, n)     NULL
+# define aead_pool_free(pool)
+#endif
+
+static void aead_run(AEAD_POOL *pool, const AEAD_PARAMS *p,
+                     EVP_CIPHER_CTX *ctx, AEAD_JOB *jobs, int njobs)
+{
+    int j;
+
+#ifdef AEAD_THREADS
+    if (pool != NULL && pool->nthreads > 0 && njobs > 1) {
+        pthread_mutex_lock(&pool->lock);
+        pool->jobs = jobs;
+        pool->njobs = njobs;
+        pool->next = 0;
+        pool->pending = njobs;
+        pthread_cond_broadcast(&pool->work);
+        aead_pool_drain(pool, ctx);
+        while (pool->pending > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pool->jobs = NULL;
+        pool->njobs = pool->next = 0;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+#endif
+    for (j = 0; j < njobs; j++)
+        aead_do_job(ctx, p, &jobs[j]);
+}
+
+static size_t aead_read_full(BIO *b, unsigned char *buf, size_t n)
+{
+    size_t done = 0;
+    int i;
+
+    while (done < n) {
+        i = BIO_read(b, buf + done,
+                     n - done > INT_MAX ? INT_MAX : (int)(n - done));
+        if (i <= 0)
+            break;
+        done += i;
+    }
+    return done;
+}
+
+#ifdef AEAD_MMAP
+/*
+ * Map the remainder of the regular file behind |in|. Returns the mapping
+ * and sets |*len| to its size and |*off| to the current read position.
+ */
+static unsigned char *aead_map(BIO *in, size_t *len, size_t *off)
+{
+    FILE *fp = NULL;
+    struct stat st;
+    long pos;
+    void *m;
+
+    if (BIO_get_fp(in, &fp) <= 0 || fp == NULL)
+        return NULL;
+    if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)
+        || st.st_size <= 0 || (off_t)(size_t)st.st_size != st.st_size)
+        return NULL;
+    if ((pos = BIO_tell(in)) < 0 || pos > st.st_size)
+        return NULL;
+    m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp),
+             0);
+    if (m == MAP_FAILED)
+        return NULL;
+# ifdef MADV_SEQUENTIAL
+    madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+# endif
+    *len = (size_t)st.st_size;
+    *off = (size_t)pos;
+    return m;
+}
+#endif
+
+static int aead_default_threads(void)
+{
+    long n = 1;
+
+#if defined(AEAD_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        n = 1;
+    return n > AEAD_MAX_THREADS ? AEAD_MAX_THREADS : (int)n;
+}
+
+/*
+ * Encrypt or decrypt |rbio| to |wbio| in the chunked AEAD format. |in| is
+ * the underlying input file BIO, which is mapped instead of read when
+ * nothing is stacked on top of it. When decrypting, |first| and |count|
+ * (0 for all) select a range of chunks.
+ */
+static int aead_stream(BIO *rbio, BIO *wbio, BIO *in, AEAD_PARAMS *p,
+                       int nthreads, unsigned long first, unsigned long count)
+{
+    unsigned char *hdr = p->hdr, *ibuf = NULL, *obuf = NULL, *map = NULL;
+    const unsigned char *src = NULL;
+    AEAD_JOB *jobs = NULL;
+    AEAD_POOL *pool = NULL;
+    EVP_CIPHER_CTX ctx;
+    size_t isz = 0, osz = 0, have = 0, take, remain = 0, map_len = 0, skip;
+    unsigned long idx, total = 0;
+    int nid = EVP_CIPHER_nid(p->cipher);
+    int batch = 0, nj, j, eof, ret = 0;
+
+    EVP_CIPHER_CTX_init(&ctx);
+    if (p->enc) {
+        memcpy(hdr, aead_magic, 8);
+        hdr[8] = (unsigned char)(nid >> 8);
+        hdr[9] = (unsigned char)nid;
+        hdr[10] = AEAD_TAG_LEN;
+        hdr[11] = (unsigned char)(p->chunk >> 24);
+        hdr[12] = (unsigned char)(p->chunk >> 16);
+        hdr[13] = (unsigned char)(p->chunk >> 8);
+        hdr[14] = (unsigned char)p->chunk;
+        /*
+         * A fresh nonce base for every file, so that files encrypted under
+         * the same key never share a nonce.
+         */
+        if (RAND_bytes(hdr + 15, AEAD_NONCE_LEN) <= 0)
+            goto err;
+        if (BIO_write(wbio, hdr, AEAD_HDR_LEN) != AEAD_HDR_LEN) {
+            BIO_printf(bio_err, "error writing output file\n");
+            goto err;
+        }
+    } else {
+        if (aead_read_full(rbio, hdr, AEAD_HDR_LEN) != AEAD_HDR_LEN
+            || memcmp(hdr, aead_magic, 8) != 0) {
+            BIO_printf(bio_err, "bad magic number\n");
+            goto err;
+        }
+        if (((hdr[8] << 8) | hdr[9]) != nid || hdr[10] != AEAD_TAG_LEN) {
+            BIO_printf(bio_err, "input was not encrypted with %s\n",
+                       OBJ_nid2sn(nid));
+            goto err;
+        }
+        p->chunk = ((size_t)hdr[11] << 24) | ((size_t)hdr[12] << 16)
+            | ((size_t)hdr[13] << 8) | hdr[14];
+        if (p->chunk == 0 || p->chunk > AEAD_MAX_CHUNK) {
+            BIO_printf(bio_err, "invalid chunk size\n");
+            goto err;
+        }
+    }
+
+    isz = p->enc ? p->chunk : p->chunk + AEAD_TAG_LEN;
+    osz = p->enc ? p->chunk + AEAD_TAG_LEN : p->chunk;
+    if (nthreads <= 0)
+        nthreads = aead_default_threads();
+    batch = nthreads * AEAD_JOBS_PER_THREAD;
+    if ((size_t)batch > AEAD_MAX_BATCH / isz)
+        batch = (int)(AEAD_MAX_BATCH / isz);
+    if (batch < 1)
+        batch = 1;
+
+    if (!aead_ctx_init(&ctx, p)) {
+        BIO_printf(bio_err, "Error setting cipher %s\n",
+                   EVP_CIPHER_name(p->cipher));
+        goto err;
+    }
+
+#ifdef AEAD_MMAP
+    if (rbio == in && (map = aead_map(in, &map_len, &skip)) != NULL) {
+        src = map + skip;
+        remain = map_len - skip;
+    }
+#endif
+    if (first > 0) {
+        if (first > (size_t)-1 / isz) {
+            BIO_printf(bio_err, "chunk index out of range\n");
+            goto err;
+        }
+        skip = first * isz;
+        if (map != NULL) {
+            if (skip > remain)
+                skip = remain;
+            src += skip;
+            remain -= skip;
+        } else {
+            unsigned char tmp[BSIZE];
+            long pos = rbio == in ? BIO_tell(in) : -1;
+
+            /* Seek if we can, otherwise read and discard */
+            if (pos < 0 || skip > (size_t)(LONG_MAX - pos)
+                || BIO_seek(in, pos + (long)skip) != 0) {
+                while (skip > 0) {
+                    j = skip > sizeof(tmp) ? (int)sizeof(tmp) : (int)skip;
+                    if (aead_read_full(rbio, tmp, j) != (size_t)j)
+                        break;
+                    skip -= j;
+                }
+            }
+        }
+    }
+
+    jobs = OPENSSL_malloc(batch * sizeof(*jobs));
+    obuf = OPENSSL_malloc(batch * osz);
+    if (map == NULL)
+        ibuf = OPENSSL_malloc(batch * isz + 1);
+    if (jobs == NULL || obuf == NULL || (map == NULL && ibuf == NULL)) {
+        BIO_printf(bio_err, "out of memory\n");
+        goto err;
+    }
+    /* Without a pool everything simply runs on this thread */
+    if (nthreads > 1)
+        pool = aead_pool_new(p, nthreads);
+
+    for (idx = first;;) {
+        /*
+         * Look one byte past the batch so that we know whether its last
+         * chunk is the final one of the stream.
+         */
+        if (map != NULL) {
+            eof = remain <= batch * isz;
+            take = eof ? remain : batch * isz;
+        } else {
+            have += aead_read_full(rbio, ibuf + have,
+                                   batch * isz + 1 - have);
+            eof = have <= batch * isz;
+            take = eof ? have : batch * isz;
+            src = ibuf;
+        }
+        nj = (int)((take + isz - 1) / isz);
+        if (nj == 0) {
+            if (!p->enc || total > 0) {
+                BIO_printf(bio_err, first > 0 ? "chunk index out of range\n"
+                           : "error reading input file\n");
+                goto err;
+            }
+            /* Empty input still gets a (final) chunk carrying a tag */
+            nj = 1;
+        }
+        if (count > 0 && (unsigned long)nj > count - total)
+            nj = (int)(count - total);
+
+        for (j = 0; j < nj; j++) {
+            jobs[j].in = src + j * isz;
+            jobs[j].inl = (j + 1) * isz <= take ? isz : take - j * isz;
+            jobs[j].out = obuf + j * osz;
+            jobs[j].idx = idx + j;
+            jobs[j].final = eof && (j + 1) * isz >= take;
+        }
+        aead_run(pool, p, &ctx, jobs, nj);
+        for (j = 0; j < nj; j++) {
+            if (!jobs[j].ok) {
+                if (p->enc)
+                    BIO_printf(bio_err, "error encrypting chunk %lu\n",
+                               jobs[j].idx);
+                else
+                    BIO_printf(bio_err, "bad decrypt in chunk %lu\n",
+                               jobs[j].idx);
+                goto err;
+            }
+        }
+        for (j = 0; j < nj; j++) {
+            if (BIO_write(wbio, jobs[j].out, (int)jobs[j].outl)
+                != (int)jobs[j].outl) {
+                BIO_printf(bio_err, "error writing output file\n");
+                goto err;
+            }
+        }
+
+        idx += nj;
+        total += nj;
+        if (jobs[nj - 1].final || (count > 0 && total >= count))
+            break;
+        if (map != NULL) {
+            src += take;
+            remain -= take;
+        } else {
+            memmove(ibuf, ibuf + take, have - take);
+            have -= take;
+        }
+    }
+    ret = 1;
+
+ err:
+    ERR_print_errors(bio_err);
+    aead_pool_free(pool);
+    EVP_CIPHER_CTX_cleanup(&ctx);
+#ifdef AEAD_MMAP
+    if (map != NULL)
+        munmap(map, map_len);
+#endif
+    if (obuf != NULL) {
+        OPENSSL_cleanse(obuf, batch * osz);
+        OPENSSL_free(obuf);
+    }
+    if (ibuf != NULL) {
+        OPENSSL_cleanse(ibuf, batch * isz + 1);
+        OPENSSL_free(ibuf);
+    }
+    if (jobs != NULL)
+        OPENSSL_free(jobs);
+    return ret;
+}
+
+static int aead_getnum(const char *s, unsigned long *n)
+{
+    unsigned long v = 0;
+
+    if (*s == '\0')
+        return 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+        v = v * 10 + *s - '0';
+    if (*s == 'k') {
+        v *= 1024;
+        s++;
+    } else if (*s == 'm') {
+        v *= 1024 * 1024;
+        s++;
+    }
+    *n = v;
+    return *s == '\0';
+}
+
 struct doall_enc_ciphers {
     BIO *bio;
     int n;
@@ -97,7 +649,8 @@ static void show_ciphers(const OBJ_NAME *name, void *arg)
     /* Filter out ciphers that we cannot use */
     cipher = EVP_get_cipherbyname(name->name);
     if (cipher == NULL ||
-            (EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER) != 0 ||
+            ((EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER) != 0 &&
+             !enc_aead_cipher(cipher)) ||
             EVP_CIPHER_mode(cipher) == EVP_CIPH_XTS_MODE)
         return;
 
@@ -143,6 +696,9 @@ int MAIN(int argc, char **argv)
     const EVP_MD *dgst = NULL;
     int non_fips_allow = 0;
     struct doall_enc_ciphers dec;
+    int aead = 0, threads = 0;
+    unsigned long chunk = AEAD_CHUNK, chunk_first = 0, chunk_count = 0;
+    char *hchunk = NULL, *hthreads = NULL, *hfirst = NULL, *hcount = NULL;
 
     apps_startup();
 
@@ -229,6 +785,22 @@ int MAIN(int argc, char **argv)
             if (--argc < 1)
                 goto bad;
             bufsize = (unsigned char *)*(++argv);
+        } else if (strcmp(*argv, "-chunk") == 0) {
+            if (--argc < 1)
+                goto bad;
+            hchunk = *(++argv);
+        } else if (strcmp(*argv, "-threads") == 0) {
+            if (--argc < 1)
+                goto bad;
+            hthreads = *(++argv);
+        } else if (strcmp(*argv, "-chunk_first") == 0) {
+            if (--argc < 1)
+                goto bad;
+            hfirst = *(++argv);
+        } else if (strcmp(*argv, "-chunk_count") == 0) {
+            if (--argc < 1)
+                goto bad;
+            hcount = *(++argv);
         } else if (strcmp(*argv, "-k") == 0) {
             if (--argc < 1)
                 goto bad;
@@ -317,6 +889,17 @@ int MAIN(int argc, char **argv)
             BIO_printf(bio_err, "%-14s buffer size\n", "-bufsize <n>");
             BIO_printf(bio_err, "%-14s disable standard block padding\n",
                        "-nopad");
+            BIO_printf(bio_err,
+                       "%-14s AEAD chunk size when encrypting (default 64k)\n",
+                       "-chunk <n>");
+            BIO_printf(bio_err,
+                       "%-14s AEAD worker threads (default: one per CPU)\n",
+                       "-threads <n>");
+            BIO_printf(bio_err,
+                       "%-14s decrypt AEAD chunks starting at index n\n",
+                       "-chunk_first n");
+            BIO_printf(bio_err, "%-14s decrypt at most n AEAD chunks\n",
+                       "-chunk_count n");
 #ifndef OPENSSL_NO_ENGINE
             BIO_printf(bio_err,
                        "%-14s use engine e, possibly a hardware device.\n",
@@ -339,8 +922,47 @@ int MAIN(int argc, char **argv)
     e = setup_engine(bio_err, engine, 0);
 
     if (cipher && EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER) {
+        if (!enc_aead_cipher(cipher)) {
+            BIO_printf(bio_err,
+                       "AEAD ciphers not supported by the enc utility\n");
+            goto end;
+        }
+        aead = 1;
+    }
+
+    if ((hchunk || hthreads || hfirst || hcount) && !aead) {
+        BIO_printf(bio_err,
+                   "chunk and thread options need a GCM or OCB cipher\n");
+        goto end;
+    }
+    if (hiv != NULL && aead) {
+        BIO_printf(bio_err,
+                   "-iv cannot be used with GCM or OCB ciphers, each file "
+                   "gets a random nonce\n");
+        goto end;
+    }
+    if (hchunk && (!aead_getnum(hchunk, &chunk) || chunk == 0
+                   || chunk > AEAD_MAX_CHUNK)) {
+        BIO_printf(bio_err, "invalid 'chunk' specified.\n");
+        goto end;
+    }
+    if (hthreads) {
+        unsigned long n;
+
+        if (!aead_getnum(hthreads, &n) || n == 0 || n > AEAD_MAX_THREADS) {
+            BIO_printf(bio_err, "invalid 'threads' specified.\n");
+            goto end;
+        }
+        threads = (int)n;
+    }
+    if ((hfirst || hcount) && enc) {
         BIO_printf(bio_err,
-                   "AEAD ciphers not supported by the enc utility\n");
+                   "-chunk_first and -chunk_count only apply when decrypting\n");
+        goto end;
+    }
+    if ((hfirst && !aead_getnum(hfirst, &chunk_first))
+        || (hcount && (!aead_getnum(hcount, &chunk_count) || chunk_count == 0))) {
+        BIO_printf(bio_err, "invalid chunk index specified.\n");
         goto end;
     }
 
@@ -569,7 +1191,7 @@ int MAIN(int argc, char **argv)
                 goto end;
             }
         }
-        if ((hiv == NULL) && (str == NULL)
+        if ((hiv == NULL) && (str == NULL) && !aead
             && EVP_CIPHER_iv_length(cipher) != 0) {
             /*
              * No IV was explicitly set and no IV was generated during
@@ -584,39 +1206,42 @@ int MAIN(int argc, char **argv)
             goto end;
         }
 
-        if ((benc = BIO_new(BIO_f_cipher())) == NULL)
-            goto end;
+        /* The chunked AEAD stream sets up its own contexts */
+        if (!aead) {
+            if ((benc = BIO_new(BIO_f_cipher())) == NULL)
+                goto end;
 
-        /*
-         * Since we may be changing parameters work on the encryption context
-         * rather than calling BIO_set_cipher().
-         */
+            /*
+             * Since we may be changing parameters work on the encryption
+             * context rather than calling BIO_set_cipher().
+             */
 
-        BIO_get_cipher_ctx(benc, &ctx);
+            BIO_get_cipher_ctx(benc, &ctx);
 
-        if (non_fips_allow)
-            EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPH_FLAG_NON_FIPS_ALLOW);
+            if (non_fips_allow)
+                EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPH_FLAG_NON_FIPS_ALLOW);
 
-        if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, enc)) {
-            BIO_printf(bio_err, "Error setting cipher %s\n",
-                       EVP_CIPHER_name(cipher));
-            ERR_print_errors(bio_err);
-            goto end;
-        }
+            if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, enc)) {
+                BIO_printf(bio_err, "Error setting cipher %s\n",
+                           EVP_CIPHER_name(cipher));
+                ERR_print_errors(bio_err);
+                goto end;
+            }
 
-        if (nopad)
-            EVP_CIPHER_CTX_set_padding(ctx, 0);
+            if (nopad)
+                EVP_CIPHER_CTX_set_padding(ctx, 0);
 
-        if (!EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, enc)) {
-            BIO_printf(bio_err, "Error setting cipher %s\n",
-                       EVP_CIPHER_name(cipher));
-            ERR_print_errors(bio_err);
-            goto end;
-        }
+            if (!EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, enc)) {
+                BIO_printf(bio_err, "Error setting cipher %s\n",
+                           EVP_CIPHER_name(cipher));
+                ERR_print_errors(bio_err);
+                goto end;
+            }
 
-        if (debug) {
-            BIO_set_callback(benc, BIO_debug_callback);
-            BIO_set_callback_arg(benc, (char *)bio_err);
+            if (debug) {
+                BIO_set_callback(benc, BIO_debug_callback);
+                BIO_set_callback_arg(benc, (char *)bio_err);
+            }
         }
 
         if (printkey) {
@@ -632,7 +1257,7 @@ int MAIN(int argc, char **argv)
                     printf("%02X", key[i]);
                 printf("\n");
             }
-            if (cipher->iv_len > 0) {
+            if (cipher->iv_len > 0 && !aead) {
                 printf("iv =");
                 for (i = 0; i < cipher->iv_len; i++)
                     printf("%02X", iv[i]);
@@ -649,13 +1274,25 @@ int MAIN(int argc, char **argv)
     if (benc != NULL)
         wbio = BIO_push(benc, wbio);
 
-    for (;;) {
-        inl = BIO_read(rbio, (char *)buff, bsize);
-        if (inl <= 0)
-            break;
-        if (BIO_write(wbio, (char *)buff, inl) != inl) {
-            BIO_printf(bio_err, "error writing output file\n");
+    if (aead) {
+        AEAD_PARAMS ap;
+
+        ap.cipher = cipher;
+        ap.key = key;
+        ap.chunk = chunk;
+        ap.enc = enc;
+        if (!aead_stream(rbio, wbio, in, &ap, threads, chunk_first,
+                         chunk_count))
             goto end;
+    } else {
+        for (;;) {
+            inl = BIO_read(rbio, (char *)buff, bsize);
+            if (inl <= 0)
+                break;
+            if (BIO_write(wbio, (char *)buff, inl) != inl) {
+                BIO_printf(bio_err, "error writing output file\n");
+                goto end;
+            }
         }
     }
     if (!BIO_flush(wbio)) {
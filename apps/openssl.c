@@ -301,12 +301,13 @@ int main(int Argc, char *ARGV[])
     }
     CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_ON);
 
-#if 0
-    if (getenv("OPENSSL_DEBUG_LOCKING") != NULL)
-#endif
-    {
+    /*
+     * Real locks where threads are supported, so that commands may run
+     * several. Otherwise, or on request, check that locks are used
+     * correctly in a single thread.
+     */
+    if (getenv("OPENSSL_DEBUG_LOCKING") != NULL || !setup_thread_locking())
         CRYPTO_set_locking_callback(lock_dbg_cb);
-    }
 
     if (getenv("OPENSSL_FIPS")) {
 #ifdef OPENSSL_FIPS
@@ -435,6 +436,7 @@ int main(int Argc, char *ARGV[])
     }
 #endif
     apps_shutdown();
+    destroy_thread_locking();
     CRYPTO_mem_leaks(bio_err);
     if (bio_err != NULL) {
         BIO_free(bio_err);
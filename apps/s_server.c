@@ -316,6 +316,8 @@ static int s_debug = 0;
 #ifndef OPENSSL_NO_TLSEXT
 static int s_tlsextdebug = 0;
 static int s_tlsextstatus = 0;
+static int s_tlsextstatus_cache = 0;
+static char *s_tlsextstatus_url = NULL;
 static int cert_status_cb(SSL *s, void *arg);
 #endif
 static int no_resume_ephemeral = 0;
@@ -677,6 +679,8 @@ static void sv_usage(void)
     BIO_printf(bio_err,
                " -status_timeout n - status request responder timeout\n");
     BIO_printf(bio_err, " -status_url URL   - status request fallback URL\n");
+    BIO_printf(bio_err,
+               " -status_cache     - staple cached responses fetched in the background\n");
 }
 
 static int local_argc = 0;
@@ -1364,6 +1368,7 @@ int MAIN(int argc, char *argv[])
             s_tlsextstatus = 1;
             if (--argc < 1)
                 goto bad;
+            s_tlsextstatus_url = argv[1];
             if (!OCSP_parse_url(*(++argv),
                                 &tlscstatp.host,
                                 &tlscstatp.port,
@@ -1371,7 +1376,8 @@ int MAIN(int argc, char *argv[])
                 BIO_printf(bio_err, "Error parsing URL\n");
                 goto bad;
             }
-        }
+        } else if (strcmp(*argv, "-status_cache") == 0)
+            s_tlsextstatus_cache = 1;
 #endif
         else if (strcmp(*argv, "-msg") == 0) {
             s_msg = 1;
@@ -1963,6 +1969,17 @@ int MAIN(int argc, char *argv[])
         if (!set_cert_key_stuff(ctx, s_dcert, s_dkey, s_dchain, build_chain))
             goto end;
     }
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+    if (s_tlsextstatus_cache) {
+        /* The library callback is used instead of cert_status_cb */
+        s_tlsextstatus = 0;
+        if (!SSL_CTX_set_ocsp_stapling(ctx, s_tlsextstatus_url, 0)) {
+            BIO_printf(bio_err, "Error setting up OCSP stapling\n");
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+    }
+#endif
 #ifndef OPENSSL_NO_RSA
 # if 1
     if (!no_tmp_rsa) {
@@ -2215,6 +2232,11 @@ static int sv_body(int s, int stype, unsigned char *context)
     if (con == NULL) {
         con = SSL_new(ctx);
 #ifndef OPENSSL_NO_TLSEXT
+# ifndef OPENSSL_NO_OCSP
+        /* Built-in stapling is refreshed here, never by the handshake */
+        if (s_tlsextstatus_cache)
+            SSL_CTX_update_ocsp_stapling(ctx);
+# endif
         if (s_tlsextdebug) {
             SSL_set_tlsext_debug_callback(con, tlsext_cb);
             SSL_set_tlsext_debug_arg(con, bio_s_out);
@@ -2831,6 +2853,10 @@ static int www_body(int s, int stype, unsigned char *context)
     if ((con = SSL_new(ctx)) == NULL)
         goto err;
 #ifndef OPENSSL_NO_TLSEXT
+# ifndef OPENSSL_NO_OCSP
+    if (s_tlsextstatus_cache)
+        SSL_CTX_update_ocsp_stapling(ctx);
+# endif
     if (s_tlsextdebug) {
         SSL_set_tlsext_debug_callback(con, tlsext_cb);
         SSL_set_tlsext_debug_arg(con, bio_s_out);
@@ -3228,6 +3254,10 @@ static int rev_body(int s, int stype, unsigned char *context)
     if ((con = SSL_new(ctx)) == NULL)
         goto err;
 #ifndef OPENSSL_NO_TLSEXT
+# ifndef OPENSSL_NO_OCSP
+    if (s_tlsextstatus_cache)
+        SSL_CTX_update_ocsp_stapling(ctx);
+# endif
     if (s_tlsextdebug) {
         SSL_set_tlsext_debug_callback(con, tlsext_cb);
         SSL_set_tlsext_debug_arg(con, bio_s_out);
@@ -181,6 +181,7 @@
 #  include "./testrsa.h"
 # endif
 # include <openssl/x509.h>
+# include <openssl/pem.h>
 # ifndef OPENSSL_NO_DSA
 #  include <openssl/dsa.h>
 #  include "./testdsa.h"
@@ -367,7 +368,10 @@ static void *KDF1_SHA1(const void *in, size_t inlen, void *out,
 }
 # endif                         /* OPENSSL_NO_ECDH */
 
-static void multiblock_speed(const EVP_CIPHER *evp_cipher);
+static void multiblock_speed(const EVP_CIPHER *evp_cipher, int decrypt);
+static void bio_cipher_speed(const EVP_CIPHER *evp_cipher, int decrypt,
+                             long chunk);
+static void d2i_speed(const char *file);
 
 int MAIN(int, char **);
 
@@ -651,6 +655,9 @@ int MAIN(int argc, char **argv)
     int multi = 0;
 # endif
     int multiblock = 0;
+    int use_bio = 0;
+    long bio_chunk = 0;
+    const char *d2i_file = NULL;
 
 # ifndef TIMES
     usertime = -1;
@@ -783,6 +790,27 @@ int MAIN(int argc, char **argv)
         } else if (argc > 0 && !strcmp(*argv, "-mb")) {
             multiblock = 1;
             j--;
+        } else if (argc > 0 && !strcmp(*argv, "-d2i")) {
+            argc--;
+            argv++;
+            if (argc == 0) {
+                BIO_printf(bio_err, "no certificate file given\n");
+                goto end;
+            }
+            d2i_file = *argv;
+            j--;
+        } else if (argc > 0 && !strcmp(*argv, "-bio")) {
+            use_bio = 1;
+            j--;
+        } else if (argc > 0 && !strcmp(*argv, "-bio_chunk")) {
+            argc--;
+            argv++;
+            if (argc == 0 || (bio_chunk = atol(*argv)) <= 0) {
+                BIO_printf(bio_err, "bad -bio_chunk value\n");
+                goto end;
+            }
+            use_bio = 1;
+            j--;
         } else
 # ifndef OPENSSL_NO_MD2
         if (strcmp(*argv, "md2") == 0)
@@ -1213,6 +1241,15 @@ int MAIN(int argc, char **argv)
             BIO_printf(bio_err,
                        "-decrypt        "
                        "time decryption instead of encryption (only EVP).\n");
+            BIO_printf(bio_err,
+                       "-d2i file       "
+                       "time decoding the certificate in file.\n");
+            BIO_printf(bio_err,
+                       "-bio            "
+                       "time EVP cipher through BIO_f_cipher.\n");
+            BIO_printf(bio_err,
+                       "-bio_chunk n    "
+                       "as -bio, with a BIO_f_cipher chunk size of n.\n");
             BIO_printf(bio_err,
                        "-mr             "
                        "produce machine readable output.\n");
@@ -1546,6 +1583,12 @@ int MAIN(int argc, char **argv)
 #  endif
 # endif                         /* SIGALRM */
 
+    if (d2i_file != NULL) {
+        d2i_speed(d2i_file);
+        mret = 0;
+        goto end;
+    }
+
 # ifndef OPENSSL_NO_MD2
     if (doit[D_MD2]) {
         for (j = 0; j < SIZE_NUM; j++) {
@@ -1957,11 +2000,16 @@ int MAIN(int argc, char **argv)
                         OBJ_nid2ln(evp_cipher->nid));
                 goto end;
             }
-            multiblock_speed(evp_cipher);
+            multiblock_speed(evp_cipher, decrypt);
             mret = 0;
             goto end;
         }
 # endif
+        if (use_bio && evp_cipher) {
+            bio_cipher_speed(evp_cipher, decrypt, bio_chunk);
+            mret = 0;
+            goto end;
+        }
         for (j = 0; j < SIZE_NUM; j++) {
             if (evp_cipher) {
                 EVP_CIPHER_CTX ctx;
@@ -2769,31 +2817,118 @@ static int do_multi(int multi)
 }
 # endif
 
-static void multiblock_speed(const EVP_CIPHER *evp_cipher)
+/*
+ * Times multi-block decryption of records that |ctx| produces out of |len|
+ * bytes, i.e. what TLS receiver does when read-ahead has buffered a burst
+ * of records. Records are decrypted out of place, so that same ciphertext
+ * can be reused.
+ */
+static int multiblock_decrypt_speed(EVP_CIPHER_CTX *ctx,
+                                    EVP_CIPHER_CTX *dctx,
+                                    const char *alg_name,
+                                    unsigned char *inp, unsigned char *out,
+                                    int len, int j)
+{
+    unsigned char aad[EVP_AEAD_TLS1_AAD_LEN], *rec;
+    EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM mb_param;
+    int count, packlen, n;
+    double d;
+
+    memset(aad, 0, 8);
+    aad[8] = 23;                /* SSL3_RT_APPLICATION_DATA */
+    aad[9] = 3;                 /* version */
+    aad[10] = 2;
+    aad[11] = 0;                /* length */
+    aad[12] = 0;
+    mb_param.out = NULL;
+    mb_param.inp = aad;
+    mb_param.len = len;
+    mb_param.interleave = 8;
+    packlen = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_AAD,
+                                  sizeof(mb_param), &mb_param);
+    if (packlen <= 0)
+        return 1;
+    n = mb_param.interleave;
+
+    /* encrypt, records end up in |inp| */
+    rec = OPENSSL_malloc(packlen);
+    if (rec == NULL) {
+        BIO_printf(bio_err, "Out of memory\n");
+        return 0;
+    }
+    mb_param.out = rec;
+    mb_param.inp = inp;
+    mb_param.len = len;
+    packlen = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT,
+                                  sizeof(mb_param), &mb_param);
+    memcpy(inp, rec, packlen);
+    OPENSSL_free(rec);
+
+    print_message(alg_name, 0, len);
+    Time_F(START);
+    for (count = 0, run = 1; run && count < 0x7fffffff; count++) {
+        memset(aad, 0, 8);
+        memcpy(aad + 8, inp, 5);
+        mb_param.out = NULL;
+        mb_param.inp = aad;
+        mb_param.len = packlen;
+        mb_param.interleave = n;
+        EVP_CIPHER_CTX_ctrl(dctx, EVP_CTRL_TLS1_1_MULTIBLOCK_AAD,
+                            sizeof(mb_param), &mb_param);
+
+        mb_param.out = out;
+        mb_param.inp = inp;
+        if (EVP_CIPHER_CTX_ctrl(dctx, EVP_CTRL_TLS1_1_MULTIBLOCK_DECRYPT,
+                                sizeof(mb_param), &mb_param) != n) {
+            BIO_printf(bio_err, "multi-block decrypt failed\n");
+            return 0;
+        }
+    }
+    d = Time_F(STOP);
+    BIO_printf(bio_err,
+               mr ? "+R:%d:%s:%f\n"
+               : "%d %s's in %.2fs\n", count, "evp", d);
+    results[D_EVP][j] = ((double)count) / d * len;
+
+    return 1;
+}
+
+static void multiblock_speed(const EVP_CIPHER *evp_cipher, int decrypt)
 {
     static int mblengths[] =
         { 8 * 1024, 2 * 8 * 1024, 4 * 8 * 1024, 8 * 8 * 1024, 8 * 16 * 1024 };
     int j, count, num = sizeof(lengths) / sizeof(lengths[0]);
     const char *alg_name;
     unsigned char *inp, *out, no_key[32], no_iv[16];
-    EVP_CIPHER_CTX ctx;
+    EVP_CIPHER_CTX ctx, dctx;
     double d = 0.0;
 
-    inp = OPENSSL_malloc(mblengths[num - 1]);
+    inp = OPENSSL_malloc(mblengths[num - 1] + 1024);
     out = OPENSSL_malloc(mblengths[num - 1] + 1024);
     if (!inp || !out) {
         BIO_printf(bio_err,"Out of memory\n");
         goto end;
     }
-
+    memset(no_key, 0, sizeof(no_key));
+    memset(no_iv, 0, sizeof(no_iv));
 
     EVP_CIPHER_CTX_init(&ctx);
     EVP_EncryptInit_ex(&ctx, evp_cipher, NULL, no_key, no_iv);
     EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_SET_MAC_KEY, sizeof(no_key),
                         no_key);
+    EVP_CIPHER_CTX_init(&dctx);
+    EVP_DecryptInit_ex(&dctx, evp_cipher, NULL, no_key, no_iv);
+    EVP_CIPHER_CTX_ctrl(&dctx, EVP_CTRL_AEAD_SET_MAC_KEY, sizeof(no_key),
+                        no_key);
     alg_name = OBJ_nid2ln(evp_cipher->nid);
 
     for (j = 0; j < num; j++) {
+        if (decrypt) {
+            if (!multiblock_decrypt_speed(&ctx, &dctx, alg_name, inp, out,
+                                          mblengths[j], j))
+                goto end;
+            continue;
+        }
         print_message(alg_name, 0, mblengths[j]);
         Time_F(START);
         for (count = 0, run = 1; run && count < 0x7fffffff; count++) {
@@ -2872,6 +3007,180 @@ static void multiblock_speed(const EVP_CIPHER *evp_cipher)
     }
 
 end:
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    EVP_CIPHER_CTX_cleanup(&dctx);
+    if (inp)
+        OPENSSL_free(inp);
+    if (out)
+        OPENSSL_free(out);
+}
+
+/*
+ * Times d2i_X509() of the certificate in |file| followed by X509_free(),
+ * then a borrowing decode with ASN1_item_d2i_borrow().
+ */
+static void d2i_speed(const char *file)
+{
+    BIO *in;
+    X509 *x = NULL;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int len, count, k;
+    double d, rate[2];
+    static const char *names[2] = { "d2i_X509", "d2i_X509 borrow" };
+
+    if ((in = BIO_new_file(file, "r")) == NULL) {
+        BIO_printf(bio_err, "Can't open %s\n", file);
+        ERR_print_errors(bio_err);
+        return;
+    }
+    x = PEM_read_bio_X509(in, NULL, NULL, NULL);
+    if (x == NULL) {
+        (void)BIO_reset(in);
+        x = d2i_X509_bio(in, NULL);
+    }
+    BIO_free(in);
+    if (x == NULL || (len = i2d_X509(x, &der)) <= 0) {
+        BIO_printf(bio_err, "Can't read certificate from %s\n", file);
+        ERR_print_errors(bio_err);
+        X509_free(x);
+        return;
+    }
+    X509_free(x);
+
+    for (k = 0; k < 2; k++) {
+        print_message(names[k], 0, len);
+        Time_F(START);
+        for (count = 0, run = 1; run && count < 0x7fffffff; count++) {
+            p = der;
+            if (k == 0)
+                X509_free(d2i_X509(NULL, &p, len));
+            else
+                X509_free((X509 *)ASN1_item_d2i_borrow(NULL, &p, len,
+                                                       ASN1_ITEM_rptr(X509)));
+        }
+        d = Time_F(STOP);
+        BIO_printf(bio_err, mr ? "+R:%d:%s:%f\n"
+                   : "%d %s's in %.2fs\n", count, "d2i", d);
+        rate[k] = count / d;
+    }
+    fprintf(stdout, "%-24s%12s\n", "", "d2i/s");
+    for (k = 0; k < 2; k++)
+        fprintf(stdout, "%-24s%12.1f\n", names[k], rate[k]);
+    OPENSSL_free(der);
+}
+
+/*
+ * Times |evp_cipher| through a BIO_f_cipher filter: encryption writes to a
+ * null BIO, decryption reads from a fresh read-only memory BIO each time.
+ * Uses larger buffers than the other tests since that is where the BIO chunk
+ * size matters.
+ */
+static void bio_cipher_speed(const EVP_CIPHER *evp_cipher, int decrypt,
+                             long chunk)
+{
+    static int biolengths[] =
+        { 1024, 8 * 1024, 64 * 1024, 256 * 1024, 512 * 1024 };
+    int j, count, num = sizeof(biolengths) / sizeof(biolengths[0]);
+    const char *alg_name;
+    unsigned char *inp = NULL, *out = NULL, no_key[EVP_MAX_KEY_LENGTH];
+    unsigned char no_iv[EVP_MAX_IV_LENGTH];
+    BIO *benc = NULL, *bend = NULL;
+    EVP_CIPHER_CTX *ctx;
+    double d = 0.0;
+
+    inp = OPENSSL_malloc(biolengths[num - 1]);
+    out = OPENSSL_malloc(biolengths[num - 1]);
+    if (!inp || !out) {
+        BIO_printf(bio_err, "Out of memory\n");
+        goto end;
+    }
+    memset(inp, 0, biolengths[num - 1]);
+    memset(no_key, 0, sizeof(no_key));
+    memset(no_iv, 0, sizeof(no_iv));
+    alg_name = OBJ_nid2ln(evp_cipher->nid);
+
+    for (j = 0; j < num; j++) {
+        benc = BIO_new(BIO_f_cipher());
+        if (benc == NULL) {
+            BIO_printf(bio_err, "Out of memory\n");
+            goto end;
+        }
+        BIO_get_cipher_ctx(benc, &ctx);
+        if (!EVP_CipherInit_ex(ctx, evp_cipher, NULL, no_key, no_iv,
+                               !decrypt)) {
+            BIO_printf(bio_err, "%s initialization failed\n", alg_name);
+            goto end;
+        }
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+        if (chunk > 0 && BIO_set_cipher_chunk_size(benc, chunk) <= 0) {
+            BIO_printf(bio_err, "bad chunk size %ld\n", chunk);
+            goto end;
+        }
+
+        print_message(alg_name, 0, biolengths[j]);
+        Time_F(START);
+        if (decrypt) {
+            for (count = 0, run = 1; run && count < 0x7fffffff; count++) {
+                if ((bend = BIO_new_mem_buf(inp, biolengths[j])) == NULL)
+                    break;
+                BIO_set_mem_eof_return(bend, -1);
+                BIO_push(benc, bend);
+                BIO_read(benc, out, biolengths[j]);
+                BIO_pop(benc);
+                BIO_free(bend);
+            }
+            bend = NULL;
+        } else {
+            if ((bend = BIO_new(BIO_s_null())) == NULL)
+                goto end;
+            benc = BIO_push(benc, bend);
+            bend = NULL;
+            for (count = 0, run = 1; run && count < 0x7fffffff; count++)
+                BIO_write(benc, inp, biolengths[j]);
+            (void)BIO_flush(benc);
+        }
+        d = Time_F(STOP);
+        BIO_printf(bio_err,
+                   mr ? "+R:%d:%s:%f\n"
+                   : "%d %s's in %.2fs\n", count, "evp", d);
+        results[D_EVP][j] = ((double)count) / d * biolengths[j];
+        BIO_free_all(benc);
+        benc = NULL;
+    }
+
+    if (mr) {
+        fprintf(stdout, "+H");
+        for (j = 0; j < num; j++)
+            fprintf(stdout, ":%d", biolengths[j]);
+        fprintf(stdout, "\n");
+        fprintf(stdout, "+F:%d:%s", D_EVP, alg_name);
+        for (j = 0; j < num; j++)
+            fprintf(stdout, ":%.2f", results[D_EVP][j]);
+        fprintf(stdout, "\n");
+    } else {
+        fprintf(stdout,
+                "The 'numbers' are in 1000s of bytes per second processed.\n");
+        fprintf(stdout, "type                    ");
+        for (j = 0; j < num; j++)
+            fprintf(stdout, "%7d bytes", biolengths[j]);
+        fprintf(stdout, "\n");
+        fprintf(stdout, "%-24s", alg_name);
+
+        for (j = 0; j < num; j++) {
+            if (results[D_EVP][j] > 10000)
+                fprintf(stdout, " %11.2fk", results[D_EVP][j] / 1e3);
+            else
+                fprintf(stdout, " %11.2f ", results[D_EVP][j]);
+        }
+        fprintf(stdout, "\n");
+    }
+
+ end:
+    if (benc)
+        BIO_free_all(benc);
+    if (bend)
+        BIO_free(bend);
     if (inp)
         OPENSSL_free(inp);
     if (out)
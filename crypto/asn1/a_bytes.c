@@ -115,10 +115,7 @@ ASN1_STRING *d2i_ASN1_type_bytes(ASN1_STRING **a, const unsigned char **pp,
     } else
         s = NULL;
 
-    if (ret->data != NULL)
-        OPENSSL_free(ret->data);
-    ret->length = (int)len;
-    ret->data = s;
+    ASN1_STRING_set0(ret, s, (int)len);
     ret->type = tag;
     if (a != NULL)
         (*a) = ret;
@@ -229,27 +226,24 @@ static ASN1_STRING *int_d2i_ASN1_bytes(ASN1_STRING **a,
         }
     } else {
         if (len != 0) {
-            if ((ret->length < len) || (ret->data == NULL)) {
+            if ((ret->length < len) || (ret->data == NULL)
+                || (ret->flags & ASN1_STRING_FLAG_BORROWED)) {
                 s = OPENSSL_malloc((int)len + 1);
                 if (s == NULL) {
                     *perr = ERR_R_MALLOC_FAILURE;
                     goto err;
                 }
-                if (ret->data != NULL)
-                    OPENSSL_free(ret->data);
             } else
                 s = ret->data;
             memcpy(s, p, (int)len);
             s[len] = '\0';
             p += len;
-        } else {
+        } else
             s = NULL;
-            if (ret->data != NULL)
-                OPENSSL_free(ret->data);
-        }
 
+        if (s != ret->data)
+            ASN1_STRING_set0(ret, s, (int)len);
         ret->length = (int)len;
-        ret->data = s;
         ret->type = Ptag;
     }
 
@@ -318,10 +312,7 @@ static int asn1_collate_primitive(ASN1_STRING *a, ASN1_const_CTX *c,
     if (!asn1_const_Finish(c))
         goto err;
 
-    a->length = num;
-    if (a->data != NULL)
-        OPENSSL_free(a->data);
-    a->data = (unsigned char *)b.data;
+    ASN1_STRING_set0(a, b.data, num);
     if (os != NULL)
         ASN1_STRING_free(os);
     return (1);
@@ -74,6 +74,9 @@ int ASN1_ENUMERATED_set(ASN1_ENUMERATED *a, long v)
     long d;
 
     a->type = V_ASN1_ENUMERATED;
+    /* Borrowed data is read-only: drop it rather than overwrite it */
+    if (a->flags & ASN1_STRING_FLAG_BORROWED)
+        ASN1_STRING_set0(a, NULL, 0);
     if (a->length < (int)(sizeof(long) + 1)) {
         if (a->data != NULL)
             OPENSSL_free(a->data);
@@ -150,6 +153,8 @@ ASN1_ENUMERATED *BN_to_ASN1_ENUMERATED(BIGNUM *bn, ASN1_ENUMERATED *ai)
         ret->type = V_ASN1_NEG_ENUMERATED;
     else
         ret->type = V_ASN1_ENUMERATED;
+    if (ret->flags & ASN1_STRING_FLAG_BORROWED)
+        ASN1_STRING_set0(ret, NULL, 0);
     j = BN_num_bits(bn);
     len = ((j == 0) ? 0 : ((j / 8) + 1));
     if (ret->length < len + 4) {
@@ -235,6 +235,11 @@ struct asn1_object_st {
  * type.
  */
 # define ASN1_STRING_FLAG_MSTRING 0x040
+/*
+ * The data of this ASN1_STRING points into a buffer owned by the caller of
+ * ASN1_item_d2i_borrow(): it must not be freed or written to.
+ */
+# define ASN1_STRING_FLAG_BORROWED 0x080
 /* This is the base type that holds just about everything :-) */
 struct asn1_string_st {
     int length;
@@ -1099,6 +1104,8 @@ ASN1_VALUE *ASN1_item_new(const ASN1_ITEM *it);
 void ASN1_item_free(ASN1_VALUE *val, const ASN1_ITEM *it);
 ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **val, const unsigned char **in,
                           long len, const ASN1_ITEM *it);
+ASN1_VALUE *ASN1_item_d2i_borrow(ASN1_VALUE **val, const unsigned char **in,
+                                 long len, const ASN1_ITEM *it);
 int ASN1_item_i2d(ASN1_VALUE *val, unsigned char **out, const ASN1_ITEM *it);
 int ASN1_item_ndef_i2d(ASN1_VALUE *val, unsigned char **out,
                        const ASN1_ITEM *it);
@@ -1245,6 +1252,7 @@ void ERR_load_ASN1_strings(void);
 # define ASN1_F_C2I_ASN1_INTEGER                          194
 # define ASN1_F_C2I_ASN1_OBJECT                           196
 # define ASN1_F_COLLECT_DATA                              140
+# define ASN1_F_COMPACT_CRL_LOOKUP                        228
 # define ASN1_F_D2I_ASN1_BIT_STRING                       141
 # define ASN1_F_D2I_ASN1_BOOLEAN                          142
 # define ASN1_F_D2I_ASN1_BYTES                            143
@@ -1265,6 +1273,7 @@ void ERR_load_ASN1_strings(void);
 # define ASN1_F_D2I_RSA_NET_2                             201
 # define ASN1_F_D2I_X509                                  156
 # define ASN1_F_D2I_X509_CINF                             157
+# define ASN1_F_D2I_X509_CRL_COMPACT                      227
 # define ASN1_F_D2I_X509_PKEY                             159
 # define ASN1_F_DO_BUF                                    221
 # define ASN1_F_I2D_ASN1_BIO_STREAM                       211
@@ -1289,6 +1298,7 @@ void ERR_load_ASN1_strings(void);
 # define ASN1_F_SMIME_TEXT                                213
 # define ASN1_F_X509_CINF_NEW                             168
 # define ASN1_F_X509_CRL_ADD0_REVOKED                     169
+# define ASN1_F_X509_CRL_UNCOMPACT                        229
 # define ASN1_F_X509_INFO_NEW                             170
 # define ASN1_F_X509_NAME_ENCODE                          203
 # define ASN1_F_X509_NAME_EX_D2I                          158
@@ -340,7 +340,7 @@ int ASN1_STRING_copy(ASN1_STRING *dst, const ASN1_STRING *str)
     dst->type = str->type;
     if (!ASN1_STRING_set(dst, str->data, str->length))
         return 0;
-    dst->flags = str->flags;
+    dst->flags = str->flags & ~ASN1_STRING_FLAG_BORROWED;
     return 1;
 }
 
@@ -370,7 +370,15 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
         else
             len = strlen(data);
     }
-    if ((str->length <= len) || (str->data == NULL)) {
+    if (str->flags & ASN1_STRING_FLAG_BORROWED) {
+        /* Never write to or reallocate borrowed input: take a copy */
+        if ((c = OPENSSL_malloc(len + 1)) == NULL) {
+            ASN1err(ASN1_F_ASN1_STRING_SET, ERR_R_MALLOC_FAILURE);
+            return (0);
+        }
+        str->data = c;
+        str->flags &= ~ASN1_STRING_FLAG_BORROWED;
+    } else if ((str->length <= len) || (str->data == NULL)) {
         c = str->data;
         if (c == NULL)
             str->data = OPENSSL_malloc(len + 1);
@@ -394,8 +402,9 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
 
 void ASN1_STRING_set0(ASN1_STRING *str, void *data, int len)
 {
-    if (str->data)
+    if (str->data && !(str->flags & ASN1_STRING_FLAG_BORROWED))
         OPENSSL_free(str->data);
+    str->flags &= ~ASN1_STRING_FLAG_BORROWED;
     str->data = data;
     str->length = len;
 }
@@ -425,14 +434,18 @@ void ASN1_STRING_free(ASN1_STRING *a)
 {
     if (a == NULL)
         return;
-    if (a->data && !(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (a->data
+        && !(a->flags & (ASN1_STRING_FLAG_NDEF
+                         | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_free(a->data);
     OPENSSL_free(a);
 }
 
 void ASN1_STRING_clear_free(ASN1_STRING *a)
 {
-    if (a && a->data && !(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (a && a->data
+        && !(a->flags & (ASN1_STRING_FLAG_NDEF
+                         | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_cleanse(a->data, a->length);
     ASN1_STRING_free(a);
 }
@@ -133,3 +133,6 @@ struct x509_crl_method_st {
                        ASN1_INTEGER *ser, X509_NAME *issuer);
     int (*crl_verify) (X509_CRL *crl, EVP_PKEY *pk);
 };
+
+/* Turn a CRL from d2i_X509_CRL_compact() into an ordinary one */
+int x509_crl_uncompact(X509_CRL *crl);
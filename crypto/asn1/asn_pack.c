@@ -147,7 +147,7 @@ ASN1_STRING *ASN1_pack_string(void *obj, i2d_of_void *i2d, ASN1_STRING **oct)
         ASN1err(ASN1_F_ASN1_PACK_STRING, ERR_R_MALLOC_FAILURE);
         goto err;
     }
-    octmp->data = p;
+    ASN1_STRING_set0(octmp, p, octmp->length);
     i2d(obj, &p);
     return octmp;
  err:
@@ -177,10 +177,7 @@ ASN1_STRING *ASN1_item_pack(void *obj, const ASN1_ITEM *it, ASN1_STRING **oct)
     } else
         octmp = *oct;
 
-    if (octmp->data) {
-        OPENSSL_free(octmp->data);
-        octmp->data = NULL;
-    }
+    ASN1_STRING_set0(octmp, NULL, 0);
 
     if (!(octmp->length = ASN1_item_i2d(obj, &octmp->data, it))) {
         ASN1err(ASN1_F_ASN1_ITEM_PACK, ASN1_R_ENCODE_ERROR);
@@ -106,6 +106,7 @@ int ASN1_TYPE_set_int_octetstring(ASN1_TYPE *a, long num, unsigned char *data,
                                  * trouble */
     in.data = buf;
     in.length = 32;
+    in.flags = 0;
     os.data = data;
     os.type = V_ASN1_OCTET_STRING;
     os.length = len;
@@ -58,6 +58,7 @@
  */
 
 #include <stddef.h>
+#include <limits.h>
 #include <string.h>
 #include <openssl/asn1.h>
 #include <openssl/asn1t.h>
@@ -73,7 +74,12 @@
  */
 #define ASN1_MAX_CONSTRUCTED_NEST 30
 
+/* Decode flags passed down the recursion */
+#define ASN1_D2I_FLAG_BORROW    0x1
+
 static int asn1_check_eoc(const unsigned char **in, long len);
+static int asn1_ex_c2i_borrow(ASN1_VALUE **pval, const unsigned char *cont,
+                              long len, int utype, const ASN1_ITEM *it);
 static int asn1_find_end(const unsigned char **in, long len, char inf);
 
 static int asn1_collect(BUF_MEM *buf, const unsigned char **in, long len,
@@ -86,19 +92,22 @@ static int asn1_check_tlen(long *olen, int *otag, unsigned char *oclass,
                            const unsigned char **in, long len,
                            int exptag, int expclass, char opt, ASN1_TLC *ctx);
 
+static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
+                            long len, const ASN1_ITEM *it, int tag, int aclass,
+                            char opt, ASN1_TLC *ctx, int depth, int dflags);
 static int asn1_template_ex_d2i(ASN1_VALUE **pval,
                                 const unsigned char **in, long len,
                                 const ASN1_TEMPLATE *tt, char opt,
-                                ASN1_TLC *ctx, int depth);
+                                ASN1_TLC *ctx, int depth, int dflags);
 static int asn1_template_noexp_d2i(ASN1_VALUE **val,
                                    const unsigned char **in, long len,
                                    const ASN1_TEMPLATE *tt, char opt,
-                                   ASN1_TLC *ctx, int depth);
+                                   ASN1_TLC *ctx, int depth, int dflags);
 static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
                                  const unsigned char **in, long len,
                                  const ASN1_ITEM *it,
                                  int tag, int aclass, char opt,
-                                 ASN1_TLC *ctx);
+                                 ASN1_TLC *ctx, int dflags);
 
 /* Table to convert tags to bit values, used for MSTRING type */
 static const unsigned long tag2bit[32] = {
@@ -156,13 +165,35 @@ ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **pval,
     return NULL;
 }
 
+/*
+ * As ASN1_item_d2i() but OCTET STRING, BIT STRING and non-negative INTEGER
+ * and ENUMERATED content is not copied: the ASN1_STRING data points into
+ * the input buffer, which must stay valid and unmodified until the decoded
+ * structure is freed.
+ */
+
+ASN1_VALUE *ASN1_item_d2i_borrow(ASN1_VALUE **pval,
+                                 const unsigned char **in, long len,
+                                 const ASN1_ITEM *it)
+{
+    ASN1_TLC c;
+    ASN1_VALUE *ptmpval = NULL;
+    if (!pval)
+        pval = &ptmpval;
+    asn1_tlc_clear_nc(&c);
+    if (asn1_item_ex_d2i(pval, in, len, it, -1, 0, 0, &c, 0,
+                         ASN1_D2I_FLAG_BORROW) > 0)
+        return *pval;
+    return NULL;
+}
+
 int ASN1_template_d2i(ASN1_VALUE **pval,
                       const unsigned char **in, long len,
                       const ASN1_TEMPLATE *tt)
 {
     ASN1_TLC c;
     asn1_tlc_clear_nc(&c);
-    return asn1_template_ex_d2i(pval, in, len, tt, 0, &c, 0);
+    return asn1_template_ex_d2i(pval, in, len, tt, 0, &c, 0, 0);
 }
 
 /*
@@ -171,7 +202,8 @@ int ASN1_template_d2i(ASN1_VALUE **pval,
  */
 static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
                             long len, const ASN1_ITEM *it, int tag, int aclass,
-                            char opt, ASN1_TLC *ctx, int depth)
+                            char opt, ASN1_TLC *ctx, int depth,
+                            int dflags)
 {
     const ASN1_TEMPLATE *tt, *errtt = NULL;
     const ASN1_COMPAT_FUNCS *cf;
@@ -216,10 +248,11 @@ static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
                 goto err;
             }
             return asn1_template_ex_d2i(pval, in, len,
-                                        it->templates, opt, ctx, depth);
+                                        it->templates, opt, ctx, depth,
+                                        dflags);
         }
         return asn1_d2i_ex_primitive(pval, in, len, it,
-                                     tag, aclass, opt, ctx);
+                                     tag, aclass, opt, ctx, dflags);
         break;
 
     case ASN1_ITYPE_MSTRING:
@@ -258,7 +291,8 @@ static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
             ASN1err(ASN1_F_ASN1_ITEM_EX_D2I, ASN1_R_MSTRING_WRONG_TAG);
             goto err;
         }
-        return asn1_d2i_ex_primitive(pval, in, len, it, otag, 0, 0, ctx);
+        return asn1_d2i_ex_primitive(pval, in, len, it, otag, 0, 0, ctx,
+                                     dflags);
 
     case ASN1_ITYPE_EXTERN:
         /* Use new style d2i */
@@ -357,7 +391,8 @@ static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
             /*
              * We mark field as OPTIONAL so its absence can be recognised.
              */
-            ret = asn1_template_ex_d2i(pchptr, &p, len, tt, 1, ctx, depth);
+            ret = asn1_template_ex_d2i(pchptr, &p, len, tt, 1, ctx, depth,
+                                       dflags);
             /* If field not present, try the next one */
             if (ret == -1)
                 continue;
@@ -476,7 +511,7 @@ static int asn1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in,
              */
 
             ret = asn1_template_ex_d2i(pseqval, &p, len, seqtt, isopt, ctx,
-                                       depth);
+                                       depth, dflags);
             if (!ret) {
                 errtt = seqtt;
                 goto err;
@@ -550,7 +585,7 @@ int ASN1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in, long len,
                      const ASN1_ITEM *it,
                      int tag, int aclass, char opt, ASN1_TLC *ctx)
 {
-    return asn1_item_ex_d2i(pval, in, len, it, tag, aclass, opt, ctx, 0);
+    return asn1_item_ex_d2i(pval, in, len, it, tag, aclass, opt, ctx, 0, 0);
 }
 
 /*
@@ -561,7 +596,7 @@ int ASN1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in, long len,
 static int asn1_template_ex_d2i(ASN1_VALUE **val,
                                 const unsigned char **in, long inlen,
                                 const ASN1_TEMPLATE *tt, char opt,
-                                ASN1_TLC *ctx, int depth)
+                                ASN1_TLC *ctx, int depth, int dflags)
 {
     int flags, aclass;
     int ret;
@@ -596,7 +631,8 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
             return 0;
         }
         /* We've found the field so it can't be OPTIONAL now */
-        ret = asn1_template_noexp_d2i(val, &p, len, tt, 0, ctx, depth);
+        ret = asn1_template_noexp_d2i(val, &p, len, tt, 0, ctx, depth,
+                                      dflags);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_EX_D2I, ERR_R_NESTED_ASN1_ERROR);
             return 0;
@@ -620,7 +656,8 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
             }
         }
     } else
-        return asn1_template_noexp_d2i(val, in, inlen, tt, opt, ctx, depth);
+        return asn1_template_noexp_d2i(val, in, inlen, tt, opt, ctx, depth,
+                                       dflags);
 
     *in = p;
     return 1;
@@ -633,7 +670,7 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
 static int asn1_template_noexp_d2i(ASN1_VALUE **val,
                                    const unsigned char **in, long len,
                                    const ASN1_TEMPLATE *tt, char opt,
-                                   ASN1_TLC *ctx, int depth)
+                                   ASN1_TLC *ctx, int depth, int dflags)
 {
     int flags, aclass;
     int ret;
@@ -705,7 +742,7 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
             }
             skfield = NULL;
             if (!asn1_item_ex_d2i(&skfield, &p, len, ASN1_ITEM_ptr(tt->item),
-                                  -1, 0, 0, ctx, depth)) {
+                                  -1, 0, 0, ctx, depth, dflags)) {
                 ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I,
                         ERR_R_NESTED_ASN1_ERROR);
                 goto err;
@@ -724,7 +761,7 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
     } else if (flags & ASN1_TFLG_IMPTAG) {
         /* IMPLICIT tagging */
         ret = asn1_item_ex_d2i(val, &p, len, ASN1_ITEM_ptr(tt->item), tt->tag,
-                               aclass, opt, ctx, depth);
+                               aclass, opt, ctx, depth, dflags);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
@@ -734,7 +771,7 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
         /* Nothing special */
         ret = asn1_item_ex_d2i(val, &p, len, ASN1_ITEM_ptr(tt->item),
                                -1, tt->flags & ASN1_TFLG_COMBINE, opt, ctx,
-                               depth);
+                               depth, dflags);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
@@ -753,7 +790,8 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
 static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
                                  const unsigned char **in, long inlen,
                                  const ASN1_ITEM *it,
-                                 int tag, int aclass, char opt, ASN1_TLC *ctx)
+                                 int tag, int aclass, char opt, ASN1_TLC *ctx,
+                                 int dflags)
 {
     int ret = 0, utype;
     long plen;
@@ -870,9 +908,17 @@ static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
     }
 
     /* We now have content length and type: translate into a structure */
+    if ((dflags & ASN1_D2I_FLAG_BORROW) && !free_cont)
+        ret = asn1_ex_c2i_borrow(pval, cont, len, utype, it);
+    else
+        ret = -1;
+    if (ret == 0)
+        goto err;
     /* asn1_ex_c2i may reuse allocated buffer, and so sets free_cont to 0 */
-    if (!asn1_ex_c2i(pval, cont, len, utype, &free_cont, it))
+    if (ret == -1 && !asn1_ex_c2i(pval, cont, len, utype, &free_cont, it)) {
+        ret = 0;
         goto err;
+    }
 
     *in = p;
     ret = 1;
@@ -992,10 +1038,7 @@ int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
         }
         /* If we've already allocated a buffer use it */
         if (*free_cont) {
-            if (stmp->data)
-                OPENSSL_free(stmp->data);
-            stmp->data = (unsigned char *)cont; /* UGLY CAST! RL */
-            stmp->length = len;
+            ASN1_STRING_set0(stmp, (unsigned char *)cont, len);
             *free_cont = 0;
         } else {
             if (!ASN1_STRING_set(stmp, cont, len)) {
@@ -1021,6 +1064,70 @@ int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
     return ret;
 }
 
+/*
+ * Set up an ASN1_STRING whose data points straight at the content octets.
+ * This is only possible where the stored form is a contiguous part of the
+ * content: returns -1 if the value has to be decoded normally.
+ */
+
+static int asn1_ex_c2i_borrow(ASN1_VALUE **pval, const unsigned char *cont,
+                              long len, int utype, const ASN1_ITEM *it)
+{
+    ASN1_STRING *stmp;
+    int bits = 0;
+
+    if (it->itype != ASN1_ITYPE_PRIMITIVE || it->funcs
+        || it->utype == V_ASN1_ANY || len <= 0 || len > INT_MAX)
+        return -1;
+
+    switch (utype) {
+    case V_ASN1_OCTET_STRING:
+        break;
+
+    case V_ASN1_BIT_STRING:
+        /* The unused bits must already be zero, as DER requires */
+        bits = cont[0];
+        if (len < 2 || bits > 7 || (cont[len - 1] & ~(0xff << bits)))
+            return -1;
+        cont++;
+        len--;
+        break;
+
+    case V_ASN1_INTEGER:
+    case V_ASN1_ENUMERATED:
+        /* Negative values are stored as their magnitude */
+        if (cont[0] & 0x80)
+            return -1;
+        if (cont[0] == 0 && len > 1) {
+            cont++;
+            len--;
+        }
+        break;
+
+    default:
+        return -1;
+    }
+
+    if (!*pval) {
+        stmp = ASN1_STRING_type_new(utype);
+        if (!stmp) {
+            ASN1err(ASN1_F_ASN1_EX_C2I, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        *pval = (ASN1_VALUE *)stmp;
+    } else {
+        stmp = (ASN1_STRING *)*pval;
+        stmp->type = utype;
+    }
+    ASN1_STRING_set0(stmp, (unsigned char *)cont, (int)len);
+    stmp->flags |= ASN1_STRING_FLAG_BORROWED;
+    if (utype == V_ASN1_BIT_STRING) {
+        stmp->flags &= ~(ASN1_STRING_FLAG_BITS_LEFT | 0x07);
+        stmp->flags |= ASN1_STRING_FLAG_BITS_LEFT | bits;
+    }
+    return 1;
+}
+
 /*
  * This function finds the end of an ASN1 structure when passed its maximum
  * length, whether it is indefinite length and a pointer to the content. This
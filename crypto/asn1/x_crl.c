@@ -57,6 +57,7 @@
  */
 
 #include <stdio.h>
+#include <limits.h>
 #include "cryptlib.h"
 #include <openssl/asn1t.h>
 #include "asn1_locl.h"
@@ -291,6 +292,12 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         }
         break;
 
+    case ASN1_OP_I2D_PRE:
+        /* A modified compact CRL is encoded from its fields */
+        if (crl->crl->enc.modified && !x509_crl_uncompact(crl))
+            return 0;
+        break;
+
     case ASN1_OP_FREE_POST:
         if (crl->meth->crl_free) {
             if (!crl->meth->crl_free(crl))
@@ -372,6 +379,8 @@ static int X509_REVOKED_cmp(const X509_REVOKED *const *a,
 int X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev)
 {
     X509_CRL_INFO *inf;
+    if (!x509_crl_uncompact(crl))
+        return 0;
     inf = crl->crl;
     if (!inf->revoked)
         inf->revoked = sk_X509_REVOKED_new(X509_REVOKED_cmp);
@@ -475,6 +484,502 @@ static int def_crl_lookup(X509_CRL *crl,
     return 0;
 }
 
+/*
+ * Compact CRLs. d2i_X509_CRL_compact() decodes a CRL without its list of
+ * revoked certificates, which stays in DER form inside the cached encoding
+ * of the CRL information. An open addressing hash table of serial numbers
+ * pointing into that encoding takes the place of the sorted
+ * STACK_OF(X509_REVOKED) and an entry is only decoded when a lookup finds
+ * it. For a large CRL this keeps little more than the encoding itself in
+ * memory and makes loading a single pass over the DER.
+ *
+ * A compact CRL uses its own X509_CRL_METHOD, so X509_CRL_get_REVOKED()
+ * returns NULL for it while X509_CRL_get0_by_serial() and
+ * X509_CRL_get0_by_cert() work as usual. Functions that change the list or
+ * re-encode the CRL turn it into an ordinary one first. Indirect CRLs, whose entries
+ * depend on the certificate issuer extensions of those before them, and
+ * CRLs with serial numbers that are not DER encoded are decoded in full.
+ */
+
+typedef struct {
+    /* Revoked certificate list, points into crl->crl->enc.enc */
+    const unsigned char *der;
+    long der_len;
+    /* Offset of each entry in der */
+    unsigned int *off;
+    unsigned int num;
+    /* Entry number plus one for each serial number hash, zero if free */
+    unsigned int *table;
+    unsigned int mask;
+    /* Each entry once decoded, NULL before */
+    X509_REVOKED **rev;
+} CRL_INDEX;
+
+static int compact_crl_free(X509_CRL *crl);
+static int compact_crl_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                              ASN1_INTEGER *serial, X509_NAME *issuer);
+
+static const X509_CRL_METHOD compact_crl_meth = {
+    0,
+    0, compact_crl_free,
+    compact_crl_lookup,
+    def_crl_verify
+};
+
+static unsigned int crl_serial_hash(const unsigned char *p, long len)
+{
+    unsigned int h = 2166136261U;
+
+    while (len-- > 0)
+        h = (h ^ *p++) * 16777619U;
+    return h;
+}
+
+static void crl_index_free(CRL_INDEX *idx)
+{
+    unsigned int i;
+
+    if (idx == NULL)
+        return;
+    if (idx->rev != NULL) {
+        for (i = 0; i < idx->num; i++)
+            X509_REVOKED_free(idx->rev[i]);
+        OPENSSL_free(idx->rev);
+    }
+    if (idx->off != NULL)
+        OPENSSL_free(idx->off);
+    if (idx->table != NULL)
+        OPENSSL_free(idx->table);
+    OPENSSL_free(idx);
+}
+
+static int compact_crl_free(X509_CRL *crl)
+{
+    crl_index_free(crl->meth_data);
+    crl->meth_data = NULL;
+    return 1;
+}
+
+/*
+ * Read a definite length DER header, returning 0 on error. Tags outside the
+ * universal class are returned as -1.
+ */
+static int crl_der_hdr(const unsigned char **pp, const unsigned char *end,
+                       long *plen, int *ptag, int *pcons)
+{
+    int ret, xclass;
+
+    if (*pp >= end)
+        return 0;
+    ret = ASN1_get_object(pp, plen, ptag, &xclass, end - *pp);
+    if (ret & 0x81)
+        return 0;
+    if (xclass != V_ASN1_UNIVERSAL)
+        *ptag = -1;
+    *pcons = ret & V_ASN1_CONSTRUCTED;
+    return 1;
+}
+
+static int crl_der_oid_is(const unsigned char *p, long len, int nid)
+{
+    ASN1_OBJECT *obj = OBJ_nid2obj(nid);
+
+    return obj != NULL && obj->length == len && !memcmp(obj->data, p, len);
+}
+
+/*
+ * Check the extensions of one entry the way crl_set_issuers() would,
+ * without decoding them. Returns 0 if the CRL cannot be made compact.
+ */
+static int crl_scan_entry_exts(const unsigned char *p,
+                               const unsigned char *end, int *pflags)
+{
+    const unsigned char *ext_end, *q;
+    const unsigned char *oid;
+    long len, oid_len, vlen;
+    int tag, cons, critical, nreason = 0;
+
+    while (p < end) {
+        if (!crl_der_hdr(&p, end, &len, &tag, &cons)
+            || tag != V_ASN1_SEQUENCE || !cons)
+            return 0;
+        ext_end = p + len;
+        if (!crl_der_hdr(&p, ext_end, &oid_len, &tag, &cons)
+            || tag != V_ASN1_OBJECT)
+            return 0;
+        oid = p;
+        p += oid_len;
+        critical = 0;
+        if (!crl_der_hdr(&p, ext_end, &len, &tag, &cons))
+            return 0;
+        if (tag == V_ASN1_BOOLEAN) {
+            critical = len == 1 && p[0] != 0;
+            p += len;
+            if (!crl_der_hdr(&p, ext_end, &len, &tag, &cons))
+                return 0;
+        }
+        if (tag != V_ASN1_OCTET_STRING || p + len != ext_end)
+            return 0;
+        if (crl_der_oid_is(oid, oid_len, NID_certificate_issuer))
+            return 0;
+        if (crl_der_oid_is(oid, oid_len, NID_crl_reason)) {
+            q = p;
+            /* Like X509_REVOKED_get_ext_d2i(), reject duplicates */
+            if (++nreason > 1
+                || !crl_der_hdr(&q, ext_end, &vlen, &tag, &cons)
+                || tag != V_ASN1_ENUMERATED || cons || q + vlen != ext_end)
+                *pflags |= EXFLAG_INVALID;
+        }
+        if (critical)
+            *pflags |= EXFLAG_CRITICAL;
+        p = ext_end;
+    }
+    return 1;
+}
+
+/*
+ * Index the revoked certificate list |der|. Returns NULL if it cannot be
+ * indexed, in which case the CRL is decoded in full.
+ */
+static CRL_INDEX *crl_index_new(const unsigned char *der, long der_len,
+                                int *pflags)
+{
+    CRL_INDEX *idx;
+    const unsigned char *p = der, *end = der + der_len, *ent_end, *ser;
+    unsigned int *tmp, max = 0, size, i, h;
+    long len, ser_len;
+    int tag, cons;
+
+    if ((idx = OPENSSL_malloc(sizeof(*idx))) == NULL)
+        return NULL;
+    memset(idx, 0, sizeof(*idx));
+    idx->der = der;
+    idx->der_len = der_len;
+
+    while (p < end) {
+        if (idx->num == max) {
+            max = max ? max * 2 : 64;
+            tmp = OPENSSL_realloc(idx->off, max * sizeof(*idx->off));
+            if (tmp == NULL)
+                goto err;
+            idx->off = tmp;
+        }
+        idx->off[idx->num++] = p - der;
+        if (!crl_der_hdr(&p, end, &len, &tag, &cons)
+            || tag != V_ASN1_SEQUENCE || !cons)
+            goto err;
+        ent_end = p + len;
+        if (!crl_der_hdr(&p, ent_end, &ser_len, &tag, &cons)
+            || tag != V_ASN1_INTEGER || cons || ser_len == 0)
+            goto err;
+        ser = p;
+        /* Lookups compare encodings, so they must be minimal */
+        if (ser_len > 1 && ((ser[0] == 0 && !(ser[1] & 0x80))
+                            || (ser[0] == 0xff && (ser[1] & 0x80))))
+            goto err;
+        p += ser_len;
+        if (!crl_der_hdr(&p, ent_end, &len, &tag, &cons))
+            goto err;
+        p += len;
+        if (p < ent_end) {
+            if (!crl_der_hdr(&p, ent_end, &len, &tag, &cons)
+                || tag != V_ASN1_SEQUENCE || p + len != ent_end
+                || !crl_scan_entry_exts(p, ent_end, pflags))
+                goto err;
+        }
+        p = ent_end;
+    }
+
+    for (size = 16; size < 2 * idx->num; size <<= 1) ;
+    if ((idx->table = OPENSSL_malloc(size * sizeof(*idx->table))) == NULL)
+        goto err;
+    memset(idx->table, 0, size * sizeof(*idx->table));
+    idx->mask = size - 1;
+    for (i = 0; i < idx->num; i++) {
+        p = der + idx->off[i];
+        crl_der_hdr(&p, end, &len, &tag, &cons);
+        crl_der_hdr(&p, end, &ser_len, &tag, &cons);
+        for (h = crl_serial_hash(p, ser_len) & idx->mask; idx->table[h];
+             h = (h + 1) & idx->mask) ;
+        idx->table[h] = i + 1;
+    }
+
+    idx->rev = OPENSSL_malloc(idx->num * sizeof(*idx->rev));
+    if (idx->rev == NULL && idx->num > 0)
+        goto err;
+    for (i = 0; i < idx->num; i++)
+        idx->rev[i] = NULL;
+    return idx;
+
+ err:
+    crl_index_free(idx);
+    return NULL;
+}
+
+/* Decode entry |i| as crl_set_issuers() would */
+static X509_REVOKED *crl_entry_decode(CRL_INDEX *idx, unsigned int i)
+{
+    const unsigned char *p = idx->der + idx->off[i];
+    ASN1_ENUMERATED *reason;
+    X509_REVOKED *rev;
+    int j;
+
+    rev = d2i_X509_REVOKED(NULL, &p, idx->der_len - idx->off[i]);
+    if (rev == NULL)
+        return NULL;
+    reason = X509_REVOKED_get_ext_d2i(rev, NID_crl_reason, &j, NULL);
+    if (reason != NULL) {
+        rev->reason = ASN1_ENUMERATED_get(reason);
+        ASN1_ENUMERATED_free(reason);
+    } else
+        rev->reason = CRL_REASON_NONE;
+    return rev;
+}
+
+/* Decode entry |i|, returning a placeholder if it is malformed */
+static X509_REVOKED *crl_index_decode(CRL_INDEX *idx, unsigned int i,
+                                      ASN1_INTEGER *serial)
+{
+    X509_REVOKED *rev;
+
+    if ((rev = crl_entry_decode(idx, i)) != NULL)
+        return rev;
+    /* The serial number matched, so treat the certificate as revoked */
+    ERR_clear_error();
+    rev = X509_REVOKED_new();
+    if (rev == NULL || !X509_REVOKED_set_serialNumber(rev, serial)) {
+        X509_REVOKED_free(rev);
+        return NULL;
+    }
+    rev->reason = CRL_REASON_UNSPECIFIED;
+    return rev;
+}
+
+static int compact_crl_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                              ASN1_INTEGER *serial, X509_NAME *issuer)
+{
+    CRL_INDEX *idx = crl->meth_data;
+    X509_REVOKED *rev;
+    unsigned char buf[64], *enc = buf, *q;
+    const unsigned char *p, *end = idx->der + idx->der_len;
+    unsigned int h, i = 0;
+    long len, ser_len;
+    int tag, cons, enc_len;
+
+    /* Without certificate issuer extensions every entry has the CRL issuer */
+    if (issuer != NULL && X509_NAME_cmp(issuer, X509_CRL_get_issuer(crl)))
+        return 0;
+
+    /* The DER content octets of |serial|, as stored in the index */
+    enc_len = i2c_ASN1_INTEGER(serial, NULL);
+    if (enc_len <= 0)
+        return 0;
+    if (enc_len > (int)sizeof(buf)
+        && (enc = OPENSSL_malloc(enc_len)) == NULL) {
+        ASN1err(ASN1_F_COMPACT_CRL_LOOKUP, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    q = enc;
+    i2c_ASN1_INTEGER(serial, &q);
+
+    for (h = crl_serial_hash(enc, enc_len) & idx->mask; idx->table[h];
+         h = (h + 1) & idx->mask) {
+        i = idx->table[h] - 1;
+        p = idx->der + idx->off[i];
+        crl_der_hdr(&p, end, &len, &tag, &cons);
+        crl_der_hdr(&p, end, &ser_len, &tag, &cons);
+        if (ser_len == enc_len && !memcmp(p, enc, enc_len))
+            break;
+    }
+    if (enc != buf)
+        OPENSSL_free(enc);
+    if (!idx->table[h])
+        return 0;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_CRL);
+    rev = idx->rev[i];
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_CRL);
+    if (rev == NULL) {
+        CRYPTO_w_lock(CRYPTO_LOCK_X509_CRL);
+        if ((rev = idx->rev[i]) == NULL)
+            rev = idx->rev[i] = crl_index_decode(idx, i, serial);
+        CRYPTO_w_unlock(CRYPTO_LOCK_X509_CRL);
+    }
+
+    /* The serial number matched: do not report it as absent */
+    if (rev == NULL) {
+        ASN1err(ASN1_F_COMPACT_CRL_LOOKUP, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    if (ret)
+        *ret = rev;
+    if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
+        return 2;
+    return 1;
+}
+
+/*
+ * Decode every entry of a compact CRL into an ordinary revoked list and
+ * switch it to the default method. Entries already handed out by lookups
+ * are kept, so pointers to them stay valid. Returns 1 on success or if the
+ * CRL was not compact, 0 if an entry cannot be decoded.
+ */
+int x509_crl_uncompact(X509_CRL *crl)
+{
+    CRL_INDEX *idx;
+    STACK_OF(X509_REVOKED) *revoked;
+    X509_REVOKED *rev;
+    unsigned int i;
+    int j;
+
+    if (crl->meth != &compact_crl_meth)
+        return 1;
+    idx = crl->meth_data;
+    if ((revoked = sk_X509_REVOKED_new(X509_REVOKED_cmp)) == NULL)
+        goto memerr;
+    for (i = 0; i < idx->num; i++) {
+        if ((rev = idx->rev[i]) == NULL
+            && (rev = crl_entry_decode(idx, i)) == NULL) {
+            ASN1err(ASN1_F_X509_CRL_UNCOMPACT, ERR_R_NESTED_ASN1_ERROR);
+            goto err;
+        }
+        if (!sk_X509_REVOKED_push(revoked, rev)) {
+            if (rev != idx->rev[i])
+                X509_REVOKED_free(rev);
+            goto memerr;
+        }
+    }
+
+    /* The entries now belong to the revoked list */
+    for (i = 0; i < idx->num; i++)
+        idx->rev[i] = NULL;
+    crl_index_free(idx);
+    sk_X509_REVOKED_free(crl->crl->revoked);
+    crl->crl->revoked = revoked;
+    crl->meth = &int_crl_meth;
+    crl->meth_data = NULL;
+    return 1;
+
+ memerr:
+    ASN1err(ASN1_F_X509_CRL_UNCOMPACT, ERR_R_MALLOC_FAILURE);
+ err:
+    /* Only free what this call decoded */
+    for (j = 0; j < sk_X509_REVOKED_num(revoked); j++) {
+        rev = sk_X509_REVOKED_value(revoked, j);
+        if (rev != idx->rev[j])
+            X509_REVOKED_free(rev);
+    }
+    sk_X509_REVOKED_free(revoked);
+    return 0;
+}
+
+X509_CRL *d2i_X509_CRL_compact(X509_CRL **a, const unsigned char **pp,
+                               long length)
+{
+    const unsigned char *p = *pp, *end = *pp + length;
+    const unsigned char *tbs, *tbs_body, *tbs_end, *outer_end;
+    const unsigned char *rev = NULL, *rev_body = NULL, *rev_end = NULL, *s;
+    unsigned char *red = NULL, *w, *enc = NULL;
+    const unsigned char *rp;
+    long len, tbs_len, red_tbs_len, red_len;
+    int tag, cons, nseq = 0, flags = 0;
+    CRL_INDEX *idx = NULL;
+    X509_CRL *crl = NULL;
+
+    /* Locate the revoked certificate list inside the CRL information */
+    if (default_crl_method != &int_crl_meth || length > INT_MAX / 2
+        || !crl_der_hdr(&p, end, &len, &tag, &cons)
+        || tag != V_ASN1_SEQUENCE || !cons)
+        goto full;
+    outer_end = p + len;
+    tbs = p;
+    if (!crl_der_hdr(&p, outer_end, &tbs_len, &tag, &cons)
+        || tag != V_ASN1_SEQUENCE || !cons)
+        goto full;
+    tbs_body = p;
+    tbs_end = p + tbs_len;
+    while (p < tbs_end) {
+        s = p;
+        if (!crl_der_hdr(&p, tbs_end, &len, &tag, &cons))
+            goto full;
+        /* After the signature algorithm and the issuer name */
+        if (tag == V_ASN1_SEQUENCE && ++nseq == 3) {
+            rev = s;
+            rev_body = p;
+            rev_end = p + len;
+            break;
+        }
+        p += len;
+    }
+    if (rev == NULL)
+        goto full;
+
+    /*
+     * Decode a copy of the CRL without the revoked list, then put the
+     * original encoding back so that signatures and i2d are unaffected.
+     */
+    red_tbs_len = tbs_len - (rev_end - rev);
+    red_len = ASN1_object_size(1, (int)red_tbs_len, V_ASN1_SEQUENCE)
+        + (outer_end - tbs_end);
+    red = OPENSSL_malloc(ASN1_object_size(1, (int)red_len, V_ASN1_SEQUENCE));
+    enc = OPENSSL_malloc((int)(tbs_end - tbs));
+    if (red == NULL || enc == NULL) {
+        ASN1err(ASN1_F_D2I_X509_CRL_COMPACT, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    w = red;
+    ASN1_put_object(&w, 1, (int)red_len, V_ASN1_SEQUENCE, V_ASN1_UNIVERSAL);
+    ASN1_put_object(&w, 1, (int)red_tbs_len, V_ASN1_SEQUENCE,
+                    V_ASN1_UNIVERSAL);
+    memcpy(w, tbs_body, rev - tbs_body);
+    w += rev - tbs_body;
+    memcpy(w, rev_end, outer_end - rev_end);
+    w += outer_end - rev_end;
+    memcpy(enc, tbs, tbs_end - tbs);
+
+    idx = crl_index_new(enc + (rev_body - tbs), rev_end - rev_body, &flags);
+    if (idx == NULL)
+        goto full;
+
+    rp = red;
+    crl = d2i_X509_CRL(NULL, &rp, w - red);
+    if (crl == NULL)
+        goto full;
+    OPENSSL_free(crl->crl->enc.enc);
+    crl->crl->enc.enc = enc;
+    crl->crl->enc.len = tbs_end - tbs;
+    enc = NULL;
+#ifndef OPENSSL_NO_SHA
+    X509_CRL_digest(crl, EVP_sha1(), crl->sha1_hash, NULL);
+#endif
+    crl->flags |= flags;
+    crl->meth = &compact_crl_meth;
+    crl->meth_data = idx;
+
+    OPENSSL_free(red);
+    *pp = outer_end;
+    if (a != NULL) {
+        X509_CRL_free(*a);
+        *a = crl;
+    }
+    return crl;
+
+ full:
+    crl_index_free(idx);
+    if (red != NULL)
+        OPENSSL_free(red);
+    if (enc != NULL)
+        OPENSSL_free(enc);
+    return d2i_X509_CRL(a, pp, length);
+
+ err:
+    if (red != NULL)
+        OPENSSL_free(red);
+    if (enc != NULL)
+        OPENSSL_free(enc);
+    return NULL;
+}
+
 void X509_CRL_set_default_method(const X509_CRL_METHOD *meth)
 {
     if (meth == NULL)
@@ -241,9 +241,8 @@ static int x509_name_ex_d2i(ASN1_VALUE **val,
             sk_X509_NAME_ENTRY_set(entries, j, NULL);
         }
     }
-    ret = x509_name_canon(nm.x);
-    if (!ret)
-        goto err;
+    /* The canonical encoding is only generated when first needed */
+    nm.x->canon_enclen = -1;
     sk_STACK_OF_X509_NAME_ENTRY_pop_free(intname.s,
                                          local_sk_X509_NAME_ENTRY_free);
     nm.x->modified = 0;
@@ -268,9 +267,26 @@ static int x509_name_ex_i2d(ASN1_VALUE **val, unsigned char **out,
         ret = x509_name_encode(a);
         if (ret < 0)
             return ret;
-        ret = x509_name_canon(a);
-        if (ret < 0)
-            return ret;
+        if (!x509_name_canon(a))
+            return -1;
+    } else {
+        /*
+         * Decoded names are shared between threads, so the pending canonical
+         * encoding is checked and generated under a lock. The X509 lock
+         * is held around name comparisons while caching extensions, so
+         * the otherwise idle X509_REQ lock is borrowed. The encoding is
+         * never changed once set, so callers may read it after this.
+         */
+        CRYPTO_r_lock(CRYPTO_LOCK_X509_REQ);
+        ret = a->canon_enclen >= 0;
+        CRYPTO_r_unlock(CRYPTO_LOCK_X509_REQ);
+        if (!ret) {
+            CRYPTO_w_lock(CRYPTO_LOCK_X509_REQ);
+            ret = a->canon_enclen >= 0 || x509_name_canon(a);
+            CRYPTO_w_unlock(CRYPTO_LOCK_X509_REQ);
+            if (!ret)
+                return -1;
+        }
     }
     ret = a->bytes->length;
     if (out != NULL) {
@@ -355,7 +371,7 @@ static int x509_name_canon(X509_NAME *a)
     STACK_OF(STACK_OF_X509_NAME_ENTRY) *intname = NULL;
     STACK_OF(X509_NAME_ENTRY) *entries = NULL;
     X509_NAME_ENTRY *entry, *tmpentry = NULL;
-    int i, set = -1, ret = 0;
+    int i, len, set = -1, ret = 0;
 
     if (a->canon_enc) {
         OPENSSL_free(a->canon_enc);
@@ -392,11 +408,14 @@ static int x509_name_canon(X509_NAME *a)
         tmpentry = NULL;
     }
 
-    /* Finally generate encoding */
+    /*
+     * Finally generate encoding: the length is set last, as a non-negative
+     * value tells readers the encoding is present.
+     */
 
-    a->canon_enclen = i2d_name_canon(intname, NULL);
+    len = i2d_name_canon(intname, NULL);
 
-    p = OPENSSL_malloc(a->canon_enclen);
+    p = OPENSSL_malloc(len);
 
     if (!p)
         goto err;
@@ -405,9 +424,13 @@ static int x509_name_canon(X509_NAME *a)
 
     i2d_name_canon(intname, &p);
 
+    a->canon_enclen = len;
+
     ret = 1;
 
  err:
+    if (!ret)
+        a->canon_enclen = -1;
 
     if (tmpentry)
         X509_NAME_ENTRY_free(tmpentry);
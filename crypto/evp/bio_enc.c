@@ -75,6 +75,8 @@ static int enc_new(BIO *h);
 static int enc_free(BIO *data);
 static long enc_callback_ctrl(BIO *h, int cmd, bio_info_cb *fps);
 #define ENC_BLOCK_SIZE  (1024*4)
+#define ENC_MIN_CHUNK   (256)
+#define ENC_MAX_CHUNK   (1024*1024)
 #define BUF_OFFSET      (EVP_MAX_BLOCK_LENGTH*2)
 
 typedef struct enc_struct {
@@ -84,11 +86,14 @@ typedef struct enc_struct {
     int finished;
     int ok;                     /* bad decrypt */
     EVP_CIPHER_CTX cipher;
+    int chunk;                  /* bytes passed to EVP_CipherUpdate at once */
     /*
-     * buf is larger than ENC_BLOCK_SIZE because EVP_DecryptUpdate can return
-     * up to a block more data than is presented to it
+     * buf is larger than chunk because EVP_DecryptUpdate can return up to a
+     * block more data than is presented to it. It points either at sbuf or,
+     * for chunk sizes other than ENC_BLOCK_SIZE, at a separate allocation.
      */
-    char buf[ENC_BLOCK_SIZE + BUF_OFFSET + 2];
+    char *buf;
+    char sbuf[ENC_BLOCK_SIZE + BUF_OFFSET + 2];
 } BIO_ENC_CTX;
 
 static BIO_METHOD methods_enc = {
@@ -122,6 +127,8 @@ static int enc_new(BIO *bi)
     ctx->cont = 1;
     ctx->finished = 0;
     ctx->ok = 1;
+    ctx->chunk = ENC_BLOCK_SIZE;
+    ctx->buf = ctx->sbuf;
 
     bi->init = 0;
     bi->ptr = (char *)ctx;
@@ -137,6 +144,10 @@ static int enc_free(BIO *a)
         return (0);
     b = (BIO_ENC_CTX *)a->ptr;
     EVP_CIPHER_CTX_cleanup(&(b->cipher));
+    if (b->buf != b->sbuf) {
+        OPENSSL_cleanse(b->buf, b->chunk + BUF_OFFSET + 2);
+        OPENSSL_free(b->buf);
+    }
     OPENSSL_cleanse(a->ptr, sizeof(BIO_ENC_CTX));
     OPENSSL_free(a->ptr);
     a->ptr = NULL;
@@ -145,10 +156,40 @@ static int enc_free(BIO *a)
     return (1);
 }
 
+static int enc_set_chunk(BIO_ENC_CTX *ctx, long chunk)
+{
+    char *buf;
+
+    if (chunk < ENC_MIN_CHUNK || chunk > ENC_MAX_CHUNK)
+        return 0;
+    /* Refuse while there is output still waiting in the old buffer */
+    if (ctx->buf_len != ctx->buf_off)
+        return 0;
+    if (chunk == ctx->chunk)
+        return 1;
+    if (chunk == ENC_BLOCK_SIZE) {
+        buf = ctx->sbuf;
+    } else {
+        buf = OPENSSL_malloc((int)chunk + BUF_OFFSET + 2);
+        if (buf == NULL)
+            return 0;
+    }
+    if (ctx->buf != ctx->sbuf) {
+        OPENSSL_cleanse(ctx->buf, ctx->chunk + BUF_OFFSET + 2);
+        OPENSSL_free(ctx->buf);
+    }
+    ctx->buf = buf;
+    ctx->chunk = (int)chunk;
+    ctx->buf_len = 0;
+    ctx->buf_off = 0;
+    return 1;
+}
+
 static int enc_read(BIO *b, char *out, int outl)
 {
-    int ret = 0, i;
+    int ret = 0, i, j, n, blocksize;
     BIO_ENC_CTX *ctx;
+    unsigned char *in;
 
     if (out == NULL)
         return (0);
@@ -173,6 +214,10 @@ static int enc_read(BIO *b, char *out, int outl)
         }
     }
 
+    blocksize = EVP_CIPHER_CTX_block_size(&ctx->cipher);
+    if (blocksize == 1)
+        blocksize = 0;
+
     /*
      * At this point, we have room of outl bytes and an empty buffer, so we
      * should read in some more.
@@ -185,7 +230,7 @@ static int enc_read(BIO *b, char *out, int outl)
         /*
          * read in at IV offset, read the EVP_Cipher documentation about why
          */
-        i = BIO_read(b->next_bio, &(ctx->buf[BUF_OFFSET]), ENC_BLOCK_SIZE);
+        i = BIO_read(b->next_bio, &(ctx->buf[BUF_OFFSET]), ctx->chunk);
 
         if (i <= 0) {
             /* Should be continue next time we are called? */
@@ -201,15 +246,39 @@ static int enc_read(BIO *b, char *out, int outl)
                 break;
             }
         } else {
+            in = (unsigned char *)&(ctx->buf[BUF_OFFSET]);
+            ctx->cont = 1;
+            /*
+             * If the caller has room, process straight into their buffer
+             * rather than bouncing the data through ctx->buf. Leave a block
+             * spare since EVP_CipherUpdate can output that much more than
+             * it is given.
+             */
+            if (outl > ENC_MIN_CHUNK) {
+                n = outl - blocksize;
+                if (n > i)
+                    n = i;
+                if (!EVP_CipherUpdate(&ctx->cipher,
+                                      (unsigned char *)out, &j, in, n)) {
+                    BIO_clear_retry_flags(b);
+                    ctx->ok = 0;
+                    return 0;
+                }
+                ret += j;
+                out += j;
+                outl -= j;
+                in += n;
+                i -= n;
+                if (i == 0)
+                    continue;
+            }
             if (!EVP_CipherUpdate(&ctx->cipher,
                                   (unsigned char *)ctx->buf, &ctx->buf_len,
-                                  (unsigned char *)&(ctx->buf[BUF_OFFSET]),
-                                  i)) {
+                                  in, i)) {
                 BIO_clear_retry_flags(b);
                 ctx->ok = 0;
                 return 0;
             }
-            ctx->cont = 1;
             /*
              * Note: it is possible for EVP_CipherUpdate to decrypt zero
              * bytes because this is or looks like the final block: if this
@@ -264,7 +333,7 @@ static int enc_write(BIO *b, const char *in, int inl)
 
     ctx->buf_off = 0;
     while (inl > 0) {
-        n = (inl > ENC_BLOCK_SIZE) ? ENC_BLOCK_SIZE : inl;
+        n = (inl > ctx->chunk) ? ctx->chunk : inl;
         if (!EVP_CipherUpdate(&ctx->cipher,
                               (unsigned char *)ctx->buf, &ctx->buf_len,
                               (unsigned char *)in, n)) {
@@ -368,6 +437,12 @@ static long enc_ctrl(BIO *b, int cmd, long num, void *ptr)
         ret = BIO_ctrl(b->next_bio, cmd, num, ptr);
         BIO_copy_next_retry(b);
         break;
+    case BIO_C_SET_CIPHER_CHUNK_SIZE:
+        ret = enc_set_chunk(ctx, num);
+        break;
+    case BIO_C_GET_CIPHER_CHUNK_SIZE:
+        ret = ctx->chunk;
+        break;
     case BIO_C_GET_CIPHER_CTX:
         c_ctx = (EVP_CIPHER_CTX **)ptr;
         (*c_ctx) = &(ctx->cipher);
@@ -377,7 +452,8 @@ static long enc_ctrl(BIO *b, int cmd, long num, void *ptr)
         dbio = (BIO *)ptr;
         dctx = (BIO_ENC_CTX *)dbio->ptr;
         EVP_CIPHER_CTX_init(&dctx->cipher);
-        ret = EVP_CIPHER_CTX_copy(&dctx->cipher, &ctx->cipher);
+        ret = EVP_CIPHER_CTX_copy(&dctx->cipher, &ctx->cipher)
+            && enc_set_chunk(dctx, ctx->chunk);
         if (ret)
             dbio->init = 1;
         break;
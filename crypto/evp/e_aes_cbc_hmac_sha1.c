@@ -184,6 +184,193 @@ static void sha1_update(SHA_CTX *c, const void *data, size_t len)
 #  endif
 #  define SHA1_Update sha1_update
 
+/*
+ * Finish HMAC over |len| bytes of decrypted payload|HMAC|padding at |out|,
+ * |inp_len| of which are payload, and verify both HMAC and padding in
+ * constant time. |key->md| is expected to have absorbed the TLS AAD and
+ * any payload preceding |out|, and |ret| is the result of the preceding
+ * padding length check.
+ */
+static int tls1_cbc_hmac_sha1_verify(EVP_AES_HMAC_SHA1 *key,
+                                     unsigned char *out, size_t len,
+                                     size_t inp_len, unsigned int pad,
+                                     unsigned int maxpad, int ret)
+{
+    union {
+        unsigned int u[SHA_DIGEST_LENGTH / sizeof(unsigned int)];
+        unsigned char c[32 + SHA_DIGEST_LENGTH];
+    } mac, *pmac;
+    union {
+        unsigned int u[SHA_LBLOCK];
+        unsigned char c[SHA_CBLOCK];
+    } *data = (void *)key->md.data;
+    size_t mask, j, i;
+    unsigned int res, bitlen;
+
+    /* arrange cache line alignment */
+    pmac = (void *)(((size_t)mac.c + 31) & ((size_t)0 - 32));
+
+#  if 1
+    len -= SHA_DIGEST_LENGTH; /* amend mac */
+    if (len >= (256 + SHA_CBLOCK)) {
+        j = (len - (256 + SHA_CBLOCK)) & (0 - SHA_CBLOCK);
+        j += SHA_CBLOCK - key->md.num;
+        SHA1_Update(&key->md, out, j);
+        out += j;
+        len -= j;
+        inp_len -= j;
+    }
+
+    /* but pretend as if we hashed padded payload */
+    bitlen = key->md.Nl + (inp_len << 3); /* at most 18 bits */
+#   ifdef BSWAP4
+    bitlen = BSWAP4(bitlen);
+#   else
+    mac.c[0] = 0;
+    mac.c[1] = (unsigned char)(bitlen >> 16);
+    mac.c[2] = (unsigned char)(bitlen >> 8);
+    mac.c[3] = (unsigned char)bitlen;
+    bitlen = mac.u[0];
+#   endif
+
+    pmac->u[0] = 0;
+    pmac->u[1] = 0;
+    pmac->u[2] = 0;
+    pmac->u[3] = 0;
+    pmac->u[4] = 0;
+
+    for (res = key->md.num, j = 0; j < len; j++) {
+        size_t c = out[j];
+        mask = (j - inp_len) >> (sizeof(j) * 8 - 8);
+        c &= mask;
+        c |= 0x80 & ~mask & ~((inp_len - j) >> (sizeof(j) * 8 - 8));
+        data->c[res++] = (unsigned char)c;
+
+        if (res != SHA_CBLOCK)
+            continue;
+
+        /* j is not incremented yet */
+        mask = 0 - ((inp_len + 7 - j) >> (sizeof(j) * 8 - 1));
+        data->u[SHA_LBLOCK - 1] |= bitlen & mask;
+        sha1_block_data_order(&key->md, data, 1);
+        mask &= 0 - ((j - inp_len - 72) >> (sizeof(j) * 8 - 1));
+        pmac->u[0] |= key->md.h0 & mask;
+        pmac->u[1] |= key->md.h1 & mask;
+        pmac->u[2] |= key->md.h2 & mask;
+        pmac->u[3] |= key->md.h3 & mask;
+        pmac->u[4] |= key->md.h4 & mask;
+        res = 0;
+    }
+
+    for (i = res; i < SHA_CBLOCK; i++, j++)
+        data->c[i] = 0;
+
+    if (res > SHA_CBLOCK - 8) {
+        mask = 0 - ((inp_len + 8 - j) >> (sizeof(j) * 8 - 1));
+        data->u[SHA_LBLOCK - 1] |= bitlen & mask;
+        sha1_block_data_order(&key->md, data, 1);
+        mask &= 0 - ((j - inp_len - 73) >> (sizeof(j) * 8 - 1));
+        pmac->u[0] |= key->md.h0 & mask;
+        pmac->u[1] |= key->md.h1 & mask;
+        pmac->u[2] |= key->md.h2 & mask;
+        pmac->u[3] |= key->md.h3 & mask;
+        pmac->u[4] |= key->md.h4 & mask;
+
+        memset(data, 0, SHA_CBLOCK);
+        j += 64;
+    }
+    data->u[SHA_LBLOCK - 1] = bitlen;
+    sha1_block_data_order(&key->md, data, 1);
+    mask = 0 - ((j - inp_len - 73) >> (sizeof(j) * 8 - 1));
+    pmac->u[0] |= key->md.h0 & mask;
+    pmac->u[1] |= key->md.h1 & mask;
+    pmac->u[2] |= key->md.h2 & mask;
+    pmac->u[3] |= key->md.h3 & mask;
+    pmac->u[4] |= key->md.h4 & mask;
+
+#   ifdef BSWAP4
+    pmac->u[0] = BSWAP4(pmac->u[0]);
+    pmac->u[1] = BSWAP4(pmac->u[1]);
+    pmac->u[2] = BSWAP4(pmac->u[2]);
+    pmac->u[3] = BSWAP4(pmac->u[3]);
+    pmac->u[4] = BSWAP4(pmac->u[4]);
+#   else
+    for (i = 0; i < 5; i++) {
+        res = pmac->u[i];
+        pmac->c[4 * i + 0] = (unsigned char)(res >> 24);
+        pmac->c[4 * i + 1] = (unsigned char)(res >> 16);
+        pmac->c[4 * i + 2] = (unsigned char)(res >> 8);
+        pmac->c[4 * i + 3] = (unsigned char)res;
+    }
+#   endif
+    len += SHA_DIGEST_LENGTH;
+#  else
+    SHA1_Update(&key->md, out, inp_len);
+    res = key->md.num;
+    SHA1_Final(pmac->c, &key->md);
+
+    {
+        unsigned int inp_blocks, pad_blocks;
+
+        /* but pretend as if we hashed padded payload */
+        inp_blocks =
+            1 + ((SHA_CBLOCK - 9 - res) >> (sizeof(res) * 8 - 1));
+        res += (unsigned int)(len - inp_len);
+        pad_blocks = res / SHA_CBLOCK;
+        res %= SHA_CBLOCK;
+        pad_blocks +=
+            1 + ((SHA_CBLOCK - 9 - res) >> (sizeof(res) * 8 - 1));
+        for (; inp_blocks < pad_blocks; inp_blocks++)
+            sha1_block_data_order(&key->md, data, 1);
+    }
+#  endif
+    key->md = key->tail;
+    SHA1_Update(&key->md, pmac->c, SHA_DIGEST_LENGTH);
+    SHA1_Final(pmac->c, &key->md);
+
+    /* verify HMAC */
+    out += inp_len;
+    len -= inp_len;
+#  if 1
+    {
+        unsigned char *p = out + len - 1 - maxpad - SHA_DIGEST_LENGTH;
+        size_t off = out - p;
+        unsigned int c, cmask;
+
+        maxpad += SHA_DIGEST_LENGTH;
+        for (res = 0, i = 0, j = 0; j < maxpad; j++) {
+            c = p[j];
+            cmask =
+                ((int)(j - off - SHA_DIGEST_LENGTH)) >> (sizeof(int) *
+                                                         8 - 1);
+            res |= (c ^ pad) & ~cmask; /* ... and padding */
+            cmask &= ((int)(off - 1 - j)) >> (sizeof(int) * 8 - 1);
+            res |= (c ^ pmac->c[i]) & cmask;
+            i += 1 & cmask;
+        }
+        maxpad -= SHA_DIGEST_LENGTH;
+
+        res = 0 - ((0 - res) >> (sizeof(res) * 8 - 1));
+        ret &= (int)~res;
+    }
+#  else
+    for (res = 0, i = 0; i < SHA_DIGEST_LENGTH; i++)
+        res |= out[i] ^ pmac->c[i];
+    res = 0 - ((0 - res) >> (sizeof(res) * 8 - 1));
+    ret &= (int)~res;
+
+    /* verify padding */
+    pad = (pad & ~res) | (maxpad & res);
+    out = out + len - 1 - pad;
+    for (res = 0, i = 0; i < pad; i++)
+        res |= out[i] ^ pad;
+
+    res = (0 - res) >> (sizeof(res) * 8 - 1);
+    ret &= (int)~res;
+#  endif
+    return ret;
+}
+
 #  if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
 
 typedef struct {
@@ -451,6 +638,164 @@ static size_t tls1_1_multi_block_encrypt(EVP_AES_HMAC_SHA1 *key,
 
     return ret;
 }
+
+void aesni_multi_cbc_decrypt(CIPH_DESC *, void *, int);
+
+/*
+ * Decrypt and verify |num| complete TLS 1.1+ records laid back to back at
+ * |inp|, |inp_len| bytes in total, into same positions at |out|. Records
+ * are decrypted with interleaved AES-NI and public leading part of each
+ * record is hashed with multi-buffer SHA1, tails are processed in constant
+ * time one record at a time. Length field of each output record header is
+ * overwritten with payload length, and payload itself starts past explicit
+ * IV. Returns |num| if all records are verified, 0 if any is not, or -1 if
+ * input is publicly malformed.
+ */
+static int tls1_1_multi_block_decrypt(EVP_AES_HMAC_SHA1 *key,
+                                      unsigned char *out,
+                                      const unsigned char *inp,
+                                      size_t inp_len, int n4x,
+                                      unsigned int num)
+{                               /* n4x is 1 or 2 */
+    HASH_DESC hash_d[8], edges[8];
+    CIPH_DESC ciph_d[8];
+    unsigned char storage[sizeof(SHA1_MB_CTX) + 32];
+    union {
+        u64 q[16];
+        u32 d[32];
+        u8 c[128];
+    } blocks[8];
+    SHA1_MB_CTX *ctx;
+    size_t off[8], len[8], inp_lens[8], o, mask;
+    unsigned int pad[8], maxpad[8], i, x4 = 4 * n4x, carry, j;
+    int ret = 1, ok[8];
+
+    if (num == 0 || num > x4)
+        return -1;
+
+    /* locate records, everything checked here is public */
+    for (o = 0, i = 0; i < num; i++) {
+        if (inp_len - o < 5)
+            return -1;
+        len[i] = inp[o + 3] << 8 | inp[o + 4];
+        if ((inp[o + 1] << 8 | inp[o + 2]) < TLS1_1_VERSION
+            || len[i] % AES_BLOCK_SIZE
+            || len[i] < AES_BLOCK_SIZE + ((SHA_DIGEST_LENGTH + AES_BLOCK_SIZE)
+                                          & -AES_BLOCK_SIZE)
+            || len[i] > inp_len - o - 5)
+            return -1;
+        off[i] = o;
+        o += 5 + len[i];
+    }
+    if (o != inp_len)
+        return -1;
+
+    ctx = (SHA1_MB_CTX *) (storage + 32 - ((size_t)storage % 32)); /* align */
+
+    /* decrypt all records at once, IV is explicit */
+    for (i = 0; i < x4; i++) {
+        if (i < num) {
+            if (out != inp)
+                memcpy(out + off[i], inp + off[i], 5 + AES_BLOCK_SIZE);
+            memcpy(ciph_d[i].iv, inp + off[i] + 5, AES_BLOCK_SIZE);
+            ciph_d[i].inp = inp + off[i] + 5 + AES_BLOCK_SIZE;
+            ciph_d[i].out = out + off[i] + 5 + AES_BLOCK_SIZE;
+            ciph_d[i].blocks = (int)(len[i] / AES_BLOCK_SIZE) - 1;
+        } else {
+            ciph_d[i].inp = inp;
+            ciph_d[i].out = out;
+            ciph_d[i].blocks = 0;
+        }
+    }
+    aesni_multi_cbc_decrypt(ciph_d, &key->ks, n4x);
+
+    for (i = 0; i < x4; i++) {
+        edges[i].ptr = hash_d[i].ptr = blocks[i].c;
+        edges[i].blocks = hash_d[i].blocks = 0;
+
+        ctx->A[i] = key->head.h0;
+        ctx->B[i] = key->head.h1;
+        ctx->C[i] = key->head.h2;
+        ctx->D[i] = key->head.h3;
+        ctx->E[i] = key->head.h4;
+    }
+
+    for (i = 0; i < num; i++) {
+        unsigned char *ptr = out + off[i] + 5 + AES_BLOCK_SIZE;
+        size_t l = len[i] - AES_BLOCK_SIZE;
+
+        /* figure out payload length, see aesni_cbc_hmac_sha1_cipher */
+        pad[i] = ptr[l - 1];
+        maxpad[i] = l - (SHA_DIGEST_LENGTH + 1);
+        maxpad[i] |= (255 - maxpad[i]) >> (sizeof(maxpad[i]) * 8 - 8);
+        maxpad[i] &= 255;
+
+        mask = constant_time_ge(maxpad[i], pad[i]);
+        ok[i] = (int)(1 & mask);
+        pad[i] = constant_time_select(mask, pad[i], maxpad[i]);
+
+        inp_lens[i] = l - (SHA_DIGEST_LENGTH + pad[i] + 1);
+
+        /* sequence number, type, version and payload length */
+        for (carry = i, j = 8; j--;) {
+            blocks[i].c[j] = key->aux.tls_aad[j] + carry;
+            carry = (blocks[i].c[j] - carry) >> (sizeof(carry) * 8 - 1);
+        }
+        blocks[i].c[8] = out[off[i]];
+        blocks[i].c[9] = out[off[i] + 1];
+        blocks[i].c[10] = out[off[i] + 2];
+        blocks[i].c[11] = (u8)(inp_lens[i] >> 8);
+        blocks[i].c[12] = (u8)(inp_lens[i]);
+
+        /*
+         * Hash the part of payload that can't be covered by padding in
+         * parallel, exactly as much as single-record path would...
+         */
+        l -= SHA_DIGEST_LENGTH;
+        if (l >= (256 + SHA_CBLOCK)) {
+            memcpy(blocks[i].c + 13, ptr, SHA_CBLOCK - 13);
+            edges[i].blocks = 1;
+            hash_d[i].ptr = ptr + (SHA_CBLOCK - 13);
+            hash_d[i].blocks = (int)((l - (256 + SHA_CBLOCK)) / SHA_CBLOCK);
+        }
+    }
+
+    sha1_multi_block(ctx, edges, n4x);
+    sha1_multi_block(ctx, hash_d, n4x);
+
+    /* ... and finish each record in constant time */
+    for (i = 0; i < num; i++) {
+        unsigned char *ptr = out + off[i] + 5 + AES_BLOCK_SIZE;
+        size_t l = len[i] - AES_BLOCK_SIZE, done;
+
+        key->md = key->head;
+        if (edges[i].blocks) {
+            done = SHA_CBLOCK - 13 + (size_t)hash_d[i].blocks * SHA_CBLOCK;
+            key->md.h0 = ctx->A[i];
+            key->md.h1 = ctx->B[i];
+            key->md.h2 = ctx->C[i];
+            key->md.h3 = ctx->D[i];
+            key->md.h4 = ctx->E[i];
+            key->md.Nl += (unsigned int)(done + 13) << 3; /* at most 18 bits */
+        } else {
+            done = 0;
+            SHA1_Update(&key->md, blocks[i].c, 13);
+        }
+
+        ok[i] = tls1_cbc_hmac_sha1_verify(key, ptr + done, l - done,
+                                          inp_lens[i] - done, pad[i],
+                                          maxpad[i], ok[i]);
+        ret &= ok[i];
+
+        out[off[i] + 3] = (unsigned char)(inp_lens[i] >> 8);
+        out[off[i] + 4] = (unsigned char)(inp_lens[i]);
+    }
+
+    OPENSSL_cleanse(blocks, sizeof(blocks));
+    OPENSSL_cleanse(ctx, sizeof(*ctx));
+
+    return ret ? (int)num : 0;
+}
 #  endif
 
 static int aesni_cbc_hmac_sha1_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
@@ -525,22 +870,11 @@ static int aesni_cbc_hmac_sha1_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
                               &key->ks, ctx->iv, 1);
         }
     } else {
-        union {
-            unsigned int u[SHA_DIGEST_LENGTH / sizeof(unsigned int)];
-            unsigned char c[32 + SHA_DIGEST_LENGTH];
-        } mac, *pmac;
-
-        /* arrange cache line alignment */
-        pmac = (void *)(((size_t)mac.c + 31) & ((size_t)0 - 32));
 
         if (plen != NO_PAYLOAD_LENGTH) { /* "TLS" mode of operation */
-            size_t inp_len, mask, j, i;
-            unsigned int res, maxpad, pad, bitlen;
+            size_t inp_len, mask;
+            unsigned int maxpad, pad;
             int ret = 1;
-            union {
-                unsigned int u[SHA_LBLOCK];
-                unsigned char c[SHA_CBLOCK];
-            } *data = (void *)key->md.data;
 #  if defined(STITCHED_DECRYPT_CALL)
             unsigned char tail_iv[AES_BLOCK_SIZE];
             int stitch = 0;
@@ -621,165 +955,8 @@ static int aesni_cbc_hmac_sha1_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
             }
 #  endif
 
-#  if 1
-            len -= SHA_DIGEST_LENGTH; /* amend mac */
-            if (len >= (256 + SHA_CBLOCK)) {
-                j = (len - (256 + SHA_CBLOCK)) & (0 - SHA_CBLOCK);
-                j += SHA_CBLOCK - key->md.num;
-                SHA1_Update(&key->md, out, j);
-                out += j;
-                len -= j;
-                inp_len -= j;
-            }
-
-            /* but pretend as if we hashed padded payload */
-            bitlen = key->md.Nl + (inp_len << 3); /* at most 18 bits */
-#   ifdef BSWAP4
-            bitlen = BSWAP4(bitlen);
-#   else
-            mac.c[0] = 0;
-            mac.c[1] = (unsigned char)(bitlen >> 16);
-            mac.c[2] = (unsigned char)(bitlen >> 8);
-            mac.c[3] = (unsigned char)bitlen;
-            bitlen = mac.u[0];
-#   endif
-
-            pmac->u[0] = 0;
-            pmac->u[1] = 0;
-            pmac->u[2] = 0;
-            pmac->u[3] = 0;
-            pmac->u[4] = 0;
-
-            for (res = key->md.num, j = 0; j < len; j++) {
-                size_t c = out[j];
-                mask = (j - inp_len) >> (sizeof(j) * 8 - 8);
-                c &= mask;
-                c |= 0x80 & ~mask & ~((inp_len - j) >> (sizeof(j) * 8 - 8));
-                data->c[res++] = (unsigned char)c;
-
-                if (res != SHA_CBLOCK)
-                    continue;
-
-                /* j is not incremented yet */
-                mask = 0 - ((inp_len + 7 - j) >> (sizeof(j) * 8 - 1));
-                data->u[SHA_LBLOCK - 1] |= bitlen & mask;
-                sha1_block_data_order(&key->md, data, 1);
-                mask &= 0 - ((j - inp_len - 72) >> (sizeof(j) * 8 - 1));
-                pmac->u[0] |= key->md.h0 & mask;
-                pmac->u[1] |= key->md.h1 & mask;
-                pmac->u[2] |= key->md.h2 & mask;
-                pmac->u[3] |= key->md.h3 & mask;
-                pmac->u[4] |= key->md.h4 & mask;
-                res = 0;
-            }
-
-            for (i = res; i < SHA_CBLOCK; i++, j++)
-                data->c[i] = 0;
-
-            if (res > SHA_CBLOCK - 8) {
-                mask = 0 - ((inp_len + 8 - j) >> (sizeof(j) * 8 - 1));
-                data->u[SHA_LBLOCK - 1] |= bitlen & mask;
-                sha1_block_data_order(&key->md, data, 1);
-                mask &= 0 - ((j - inp_len - 73) >> (sizeof(j) * 8 - 1));
-                pmac->u[0] |= key->md.h0 & mask;
-                pmac->u[1] |= key->md.h1 & mask;
-                pmac->u[2] |= key->md.h2 & mask;
-                pmac->u[3] |= key->md.h3 & mask;
-                pmac->u[4] |= key->md.h4 & mask;
-
-                memset(data, 0, SHA_CBLOCK);
-                j += 64;
-            }
-            data->u[SHA_LBLOCK - 1] = bitlen;
-            sha1_block_data_order(&key->md, data, 1);
-            mask = 0 - ((j - inp_len - 73) >> (sizeof(j) * 8 - 1));
-            pmac->u[0] |= key->md.h0 & mask;
-            pmac->u[1] |= key->md.h1 & mask;
-            pmac->u[2] |= key->md.h2 & mask;
-            pmac->u[3] |= key->md.h3 & mask;
-            pmac->u[4] |= key->md.h4 & mask;
-
-#   ifdef BSWAP4
-            pmac->u[0] = BSWAP4(pmac->u[0]);
-            pmac->u[1] = BSWAP4(pmac->u[1]);
-            pmac->u[2] = BSWAP4(pmac->u[2]);
-            pmac->u[3] = BSWAP4(pmac->u[3]);
-            pmac->u[4] = BSWAP4(pmac->u[4]);
-#   else
-            for (i = 0; i < 5; i++) {
-                res = pmac->u[i];
-                pmac->c[4 * i + 0] = (unsigned char)(res >> 24);
-                pmac->c[4 * i + 1] = (unsigned char)(res >> 16);
-                pmac->c[4 * i + 2] = (unsigned char)(res >> 8);
-                pmac->c[4 * i + 3] = (unsigned char)res;
-            }
-#   endif
-            len += SHA_DIGEST_LENGTH;
-#  else
-            SHA1_Update(&key->md, out, inp_len);
-            res = key->md.num;
-            SHA1_Final(pmac->c, &key->md);
-
-            {
-                unsigned int inp_blocks, pad_blocks;
-
-                /* but pretend as if we hashed padded payload */
-                inp_blocks =
-                    1 + ((SHA_CBLOCK - 9 - res) >> (sizeof(res) * 8 - 1));
-                res += (unsigned int)(len - inp_len);
-                pad_blocks = res / SHA_CBLOCK;
-                res %= SHA_CBLOCK;
-                pad_blocks +=
-                    1 + ((SHA_CBLOCK - 9 - res) >> (sizeof(res) * 8 - 1));
-                for (; inp_blocks < pad_blocks; inp_blocks++)
-                    sha1_block_data_order(&key->md, data, 1);
-            }
-#  endif
-            key->md = key->tail;
-            SHA1_Update(&key->md, pmac->c, SHA_DIGEST_LENGTH);
-            SHA1_Final(pmac->c, &key->md);
-
-            /* verify HMAC */
-            out += inp_len;
-            len -= inp_len;
-#  if 1
-            {
-                unsigned char *p = out + len - 1 - maxpad - SHA_DIGEST_LENGTH;
-                size_t off = out - p;
-                unsigned int c, cmask;
-
-                maxpad += SHA_DIGEST_LENGTH;
-                for (res = 0, i = 0, j = 0; j < maxpad; j++) {
-                    c = p[j];
-                    cmask =
-                        ((int)(j - off - SHA_DIGEST_LENGTH)) >> (sizeof(int) *
-                                                                 8 - 1);
-                    res |= (c ^ pad) & ~cmask; /* ... and padding */
-                    cmask &= ((int)(off - 1 - j)) >> (sizeof(int) * 8 - 1);
-                    res |= (c ^ pmac->c[i]) & cmask;
-                    i += 1 & cmask;
-                }
-                maxpad -= SHA_DIGEST_LENGTH;
-
-                res = 0 - ((0 - res) >> (sizeof(res) * 8 - 1));
-                ret &= (int)~res;
-            }
-#  else
-            for (res = 0, i = 0; i < SHA_DIGEST_LENGTH; i++)
-                res |= out[i] ^ pmac->c[i];
-            res = 0 - ((0 - res) >> (sizeof(res) * 8 - 1));
-            ret &= (int)~res;
-
-            /* verify padding */
-            pad = (pad & ~res) | (maxpad & res);
-            out = out + len - 1 - pad;
-            for (res = 0, i = 0; i < pad; i++)
-                res |= out[i] ^ pad;
-
-            res = (0 - res) >> (sizeof(res) * 8 - 1);
-            ret &= (int)~res;
-#  endif
-            return ret;
+            return tls1_cbc_hmac_sha1_verify(key, out, len, inp_len, pad,
+                                             maxpad, ret);
         } else {
 #  if defined(STITCHED_DECRYPT_CALL)
             if (len >= 1024 && ctx->key_len == 32) {
@@ -933,8 +1110,23 @@ static int aesni_cbc_hmac_sha1_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg,
                 param->interleave = x4;
 
                 return (int)packlen;
-            } else
-                return -1;      /* not yet */
+            } else {
+                if ((param->inp[9] << 8 | param->inp[10]) < TLS1_1_VERSION)
+                    return -1;
+
+                if (param->interleave < 4)
+                    return 0;   /* too few records */
+
+                /* remember sequence number of the first record */
+                memcpy(key->aux.tls_aad, param->inp, EVP_AEAD_TLS1_AAD_LEN);
+
+                if (param->interleave >= 8 && OPENSSL_ia32cap_P[2] & (1 << 5))
+                    param->interleave = 8; /* AVX2 */
+                else
+                    param->interleave = 4;
+
+                return (int)param->interleave;
+            }
         }
     case EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT:
         {
@@ -946,6 +1138,18 @@ static int aesni_cbc_hmac_sha1_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg,
                                                    param->interleave / 4);
         }
     case EVP_CTRL_TLS1_1_MULTIBLOCK_DECRYPT:
+        {
+            EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM *param =
+                (EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM *) ptr;
+
+            if (ctx->encrypt)
+                return -1;
+
+            return tls1_1_multi_block_decrypt(key, param->out,
+                                              param->inp, param->len,
+                                              param->interleave > 4 ? 2 : 1,
+                                              param->interleave);
+        }
 #  endif
     default:
         return -1;
@@ -125,6 +125,62 @@ static const unsigned char data_ascii2bin[128] = {
 };
 
 #ifndef CHARSET_EBCDIC
+/*
+ * As data_ascii2bin but with every character that is not a base64 digit,
+ * '=' included, mapped to B64_ERROR. Only used by decode_quads().
+ */
+static const unsigned char data_ascii2bin_strict[128] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B,
+    0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30,
+    0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/*
+ * Decodes |n| characters from |f| into |t|, |n| being a multiple of 4 and
+ * at most 64, if they contain no padding, whitespace or line breaks, which
+ * is the bulk of any PEM body. This is the computation EVP_DecodeBlock()
+ * does without its per-character trimming and classification. Output goes
+ * to |t| only once all of the input has decoded, so on failure |t| is left
+ * untouched. Returns 1 if the input was decoded and 0 otherwise.
+ */
+static int decode_quads(unsigned char *t, const unsigned char *f, int n)
+{
+    unsigned char buf[48], *p = buf;
+    int i;
+    unsigned int a, b, c, d;
+    unsigned long l;
+
+    for (i = 0; i < n; i += 4, f += 4, p += 3) {
+        a = data_ascii2bin_strict[f[0] & 0x7f];
+        b = data_ascii2bin_strict[f[1] & 0x7f];
+        c = data_ascii2bin_strict[f[2] & 0x7f];
+        d = data_ascii2bin_strict[f[3] & 0x7f];
+        /* bit 7 is set by non-ASCII input and by every non-digit entry */
+        if ((f[0] | f[1] | f[2] | f[3] | a | b | c | d) & 0x80)
+            return 0;
+        l = ((unsigned long)a << 18) | ((unsigned long)b << 12) |
+            ((unsigned long)c << 6) | (unsigned long)d;
+        p[0] = (unsigned char)(l >> 16);
+        p[1] = (unsigned char)(l >> 8);
+        p[2] = (unsigned char)l;
+    }
+    memcpy(t, buf, p - buf);
+    return 1;
+}
+
 static unsigned char conv_ascii2bin(unsigned char a)
 {
     if (a & 0x80)
@@ -213,27 +269,30 @@ int EVP_EncodeBlock(unsigned char *t, const unsigned char *f, int dlen)
     int i, ret = 0;
     unsigned long l;
 
-    for (i = dlen; i > 0; i -= 3) {
-        if (i >= 3) {
-            l = (((unsigned long)f[0]) << 16L) |
-                (((unsigned long)f[1]) << 8L) | f[2];
-            *(t++) = conv_bin2ascii(l >> 18L);
-            *(t++) = conv_bin2ascii(l >> 12L);
-            *(t++) = conv_bin2ascii(l >> 6L);
-            *(t++) = conv_bin2ascii(l);
-        } else {
-            l = ((unsigned long)f[0]) << 16L;
-            if (i == 2)
-                l |= ((unsigned long)f[1] << 8L);
-
-            *(t++) = conv_bin2ascii(l >> 18L);
-            *(t++) = conv_bin2ascii(l >> 12L);
-            *(t++) = (i == 1) ? '=' : conv_bin2ascii(l >> 6L);
-            *(t++) = '=';
-        }
-        ret += 4;
+    /* Whole groups first, so that the main loop has no tail handling */
+    for (i = dlen; i >= 3; i -= 3) {
+        l = (((unsigned long)f[0]) << 16L) |
+            (((unsigned long)f[1]) << 8L) | f[2];
+        t[0] = conv_bin2ascii(l >> 18L);
+        t[1] = conv_bin2ascii(l >> 12L);
+        t[2] = conv_bin2ascii(l >> 6L);
+        t[3] = conv_bin2ascii(l);
+        t += 4;
         f += 3;
     }
+    ret = (dlen - i) / 3 * 4;
+
+    if (i > 0) {
+        l = ((unsigned long)f[0]) << 16L;
+        if (i == 2)
+            l |= ((unsigned long)f[1] << 8L);
+
+        *(t++) = conv_bin2ascii(l >> 18L);
+        *(t++) = conv_bin2ascii(l >> 12L);
+        *(t++) = (i == 1) ? '=' : conv_bin2ascii(l >> 6L);
+        *(t++) = '=';
+        ret += 4;
+    }
 
     *t = '\0';
     return (ret);
@@ -290,6 +349,23 @@ int EVP_DecodeUpdate(EVP_ENCODE_CTX *ctx, unsigned char *out, int *outl,
     }
 
     for (i = 0; i < inl; i++) {
+#ifndef CHARSET_EBCDIC
+        /*
+         * With nothing buffered and no padding seen, a run of 64 plain
+         * base64 characters is decoded straight from the input. This is
+         * exactly what collecting them in |d| until n reaches 64 below
+         * would produce. Anything else takes the byte-by-byte path.
+         */
+        while (n == 0 && eof == 0 && inl - i >= 64
+               && decode_quads(out, in, 64)) {
+            ret += 48;
+            out += 48;
+            in += 64;
+            i += 64;
+        }
+        if (i == inl)
+            break;
+#endif
         tmp = *(in++);
         v = conv_ascii2bin(tmp);
         if (v == B64_ERROR) {
@@ -164,7 +164,7 @@ static void test1(const EVP_CIPHER *c, const unsigned char *key, int kn,
     EVP_CIPHER_CTX_init(&ctx);
     EVP_CIPHER_CTX_set_flags(&ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
     if (encdec != 0) {
-        if (mode == EVP_CIPH_GCM_MODE) {
+        if (mode == EVP_CIPH_GCM_MODE || mode == EVP_CIPH_OCB_MODE) {
             if (!EVP_EncryptInit_ex(&ctx, c, NULL, NULL, NULL)) {
                 fprintf(stderr, "EncryptInit failed\n");
                 ERR_print_errors_fp(stderr);
@@ -175,6 +175,13 @@ static void test1(const EVP_CIPHER *c, const unsigned char *key, int kn,
                 ERR_print_errors_fp(stderr);
                 test1_exit(11);
             }
+            if (mode == EVP_CIPH_OCB_MODE
+                && !EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_SET_TAG, tn,
+                                        NULL)) {
+                fprintf(stderr, "Tag length set failed\n");
+                ERR_print_errors_fp(stderr);
+                test1_exit(11);
+            }
             if (!EVP_EncryptInit_ex(&ctx, NULL, NULL, key, iv)) {
                 fprintf(stderr, "Key/IV set failed\n");
                 ERR_print_errors_fp(stderr);
@@ -252,7 +259,8 @@ static void test1(const EVP_CIPHER *c, const unsigned char *key, int kn,
             hexdump(stderr, "Expected", ciphertext, cn);
             test1_exit(9);
         }
-        if (mode == EVP_CIPH_GCM_MODE || mode == EVP_CIPH_CCM_MODE) {
+        if (mode == EVP_CIPH_GCM_MODE || mode == EVP_CIPH_CCM_MODE
+            || mode == EVP_CIPH_OCB_MODE) {
             unsigned char rtag[16];
             /*
              * Note: EVP_CTRL_CCM_GET_TAG has same value as
@@ -273,7 +281,7 @@ static void test1(const EVP_CIPHER *c, const unsigned char *key, int kn,
     }
 
     if (encdec <= 0) {
-        if (mode == EVP_CIPH_GCM_MODE) {
+        if (mode == EVP_CIPH_GCM_MODE || mode == EVP_CIPH_OCB_MODE) {
             if (!EVP_DecryptInit_ex(&ctx, c, NULL, NULL, NULL)) {
                 fprintf(stderr, "EncryptInit failed\n");
                 ERR_print_errors_fp(stderr);
@@ -284,6 +292,13 @@ static void test1(const EVP_CIPHER *c, const unsigned char *key, int kn,
                 ERR_print_errors_fp(stderr);
                 test1_exit(11);
             }
+            if (mode == EVP_CIPH_OCB_MODE
+                && !EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_SET_TAG, tn,
+                                        NULL)) {
+                fprintf(stderr, "Tag length set failed\n");
+                ERR_print_errors_fp(stderr);
+                test1_exit(11);
+            }
             if (!EVP_DecryptInit_ex(&ctx, NULL, NULL, key, iv)) {
                 fprintf(stderr, "Key/IV set failed\n");
                 ERR_print_errors_fp(stderr);
@@ -2649,6 +2649,23 @@ DECLARE_SPECIAL_STACK_OF(OPENSSL_BLOCK, void)
 # define lh_OPENSSL_STRING_stats_bio(lh,out) \
   LHM_lh_stats_bio(OPENSSL_STRING,lh,out)
 # define lh_OPENSSL_STRING_free(lh) LHM_lh_free(OPENSSL_STRING,lh)
+# define lh_SSL_CERT_CACHE_ENTRY_new() LHM_lh_new(SSL_CERT_CACHE_ENTRY,ssl_cert_cache_entry)
+# define lh_SSL_CERT_CACHE_ENTRY_insert(lh,inst) LHM_lh_insert(SSL_CERT_CACHE_ENTRY,lh,inst)
+# define lh_SSL_CERT_CACHE_ENTRY_retrieve(lh,inst) LHM_lh_retrieve(SSL_CERT_CACHE_ENTRY,lh,inst)
+# define lh_SSL_CERT_CACHE_ENTRY_delete(lh,inst) LHM_lh_delete(SSL_CERT_CACHE_ENTRY,lh,inst)
+# define lh_SSL_CERT_CACHE_ENTRY_doall(lh,fn) LHM_lh_doall(SSL_CERT_CACHE_ENTRY,lh,fn)
+# define lh_SSL_CERT_CACHE_ENTRY_doall_arg(lh,fn,arg_type,arg) \
+  LHM_lh_doall_arg(SSL_CERT_CACHE_ENTRY,lh,fn,arg_type,arg)
+# define lh_SSL_CERT_CACHE_ENTRY_error(lh) LHM_lh_error(SSL_CERT_CACHE_ENTRY,lh)
+# define lh_SSL_CERT_CACHE_ENTRY_num_items(lh) LHM_lh_num_items(SSL_CERT_CACHE_ENTRY,lh)
+# define lh_SSL_CERT_CACHE_ENTRY_down_load(lh) LHM_lh_down_load(SSL_CERT_CACHE_ENTRY,lh)
+# define lh_SSL_CERT_CACHE_ENTRY_node_stats_bio(lh,out) \
+  LHM_lh_node_stats_bio(SSL_CERT_CACHE_ENTRY,lh,out)
+# define lh_SSL_CERT_CACHE_ENTRY_node_usage_stats_bio(lh,out) \
+  LHM_lh_node_usage_stats_bio(SSL_CERT_CACHE_ENTRY,lh,out)
+# define lh_SSL_CERT_CACHE_ENTRY_stats_bio(lh,out) \
+  LHM_lh_stats_bio(SSL_CERT_CACHE_ENTRY,lh,out)
+# define lh_SSL_CERT_CACHE_ENTRY_free(lh) LHM_lh_free(SSL_CERT_CACHE_ENTRY,lh)
 # define lh_SSL_SESSION_new() LHM_lh_new(SSL_SESSION,ssl_session)
 # define lh_SSL_SESSION_insert(lh,inst) LHM_lh_insert(SSL_SESSION,lh,inst)
 # define lh_SSL_SESSION_retrieve(lh,inst) LHM_lh_retrieve(SSL_SESSION,lh,inst)
@@ -2666,6 +2683,40 @@ DECLARE_SPECIAL_STACK_OF(OPENSSL_BLOCK, void)
 # define lh_SSL_SESSION_stats_bio(lh,out) \
   LHM_lh_stats_bio(SSL_SESSION,lh,out)
 # define lh_SSL_SESSION_free(lh) LHM_lh_free(SSL_SESSION,lh)
+# define lh_SSL_SNI_ENTRY_new() LHM_lh_new(SSL_SNI_ENTRY,ssl_sni_entry)
+# define lh_SSL_SNI_ENTRY_insert(lh,inst) LHM_lh_insert(SSL_SNI_ENTRY,lh,inst)
+# define lh_SSL_SNI_ENTRY_retrieve(lh,inst) LHM_lh_retrieve(SSL_SNI_ENTRY,lh,inst)
+# define lh_SSL_SNI_ENTRY_delete(lh,inst) LHM_lh_delete(SSL_SNI_ENTRY,lh,inst)
+# define lh_SSL_SNI_ENTRY_doall(lh,fn) LHM_lh_doall(SSL_SNI_ENTRY,lh,fn)
+# define lh_SSL_SNI_ENTRY_doall_arg(lh,fn,arg_type,arg) \
+  LHM_lh_doall_arg(SSL_SNI_ENTRY,lh,fn,arg_type,arg)
+# define lh_SSL_SNI_ENTRY_error(lh) LHM_lh_error(SSL_SNI_ENTRY,lh)
+# define lh_SSL_SNI_ENTRY_num_items(lh) LHM_lh_num_items(SSL_SNI_ENTRY,lh)
+# define lh_SSL_SNI_ENTRY_down_load(lh) LHM_lh_down_load(SSL_SNI_ENTRY,lh)
+# define lh_SSL_SNI_ENTRY_node_stats_bio(lh,out) \
+  LHM_lh_node_stats_bio(SSL_SNI_ENTRY,lh,out)
+# define lh_SSL_SNI_ENTRY_node_usage_stats_bio(lh,out) \
+  LHM_lh_node_usage_stats_bio(SSL_SNI_ENTRY,lh,out)
+# define lh_SSL_SNI_ENTRY_stats_bio(lh,out) \
+  LHM_lh_stats_bio(SSL_SNI_ENTRY,lh,out)
+# define lh_SSL_SNI_ENTRY_free(lh) LHM_lh_free(SSL_SNI_ENTRY,lh)
+# define lh_X509_VERIFY_CACHE_ENTRY_new() LHM_lh_new(X509_VERIFY_CACHE_ENTRY,x509_verify_cache_entry)
+# define lh_X509_VERIFY_CACHE_ENTRY_insert(lh,inst) LHM_lh_insert(X509_VERIFY_CACHE_ENTRY,lh,inst)
+# define lh_X509_VERIFY_CACHE_ENTRY_retrieve(lh,inst) LHM_lh_retrieve(X509_VERIFY_CACHE_ENTRY,lh,inst)
+# define lh_X509_VERIFY_CACHE_ENTRY_delete(lh,inst) LHM_lh_delete(X509_VERIFY_CACHE_ENTRY,lh,inst)
+# define lh_X509_VERIFY_CACHE_ENTRY_doall(lh,fn) LHM_lh_doall(X509_VERIFY_CACHE_ENTRY,lh,fn)
+# define lh_X509_VERIFY_CACHE_ENTRY_doall_arg(lh,fn,arg_type,arg) \
+  LHM_lh_doall_arg(X509_VERIFY_CACHE_ENTRY,lh,fn,arg_type,arg)
+# define lh_X509_VERIFY_CACHE_ENTRY_error(lh) LHM_lh_error(X509_VERIFY_CACHE_ENTRY,lh)
+# define lh_X509_VERIFY_CACHE_ENTRY_num_items(lh) LHM_lh_num_items(X509_VERIFY_CACHE_ENTRY,lh)
+# define lh_X509_VERIFY_CACHE_ENTRY_down_load(lh) LHM_lh_down_load(X509_VERIFY_CACHE_ENTRY,lh)
+# define lh_X509_VERIFY_CACHE_ENTRY_node_stats_bio(lh,out) \
+  LHM_lh_node_stats_bio(X509_VERIFY_CACHE_ENTRY,lh,out)
+# define lh_X509_VERIFY_CACHE_ENTRY_node_usage_stats_bio(lh,out) \
+  LHM_lh_node_usage_stats_bio(X509_VERIFY_CACHE_ENTRY,lh,out)
+# define lh_X509_VERIFY_CACHE_ENTRY_stats_bio(lh,out) \
+  LHM_lh_stats_bio(X509_VERIFY_CACHE_ENTRY,lh,out)
+# define lh_X509_VERIFY_CACHE_ENTRY_free(lh) LHM_lh_free(X509_VERIFY_CACHE_ENTRY,lh)
 #ifdef  __cplusplus
 }
 #endif
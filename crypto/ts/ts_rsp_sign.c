@@ -848,12 +848,9 @@ static ESS_CERT_ID *ESS_CERT_ID_new_init(X509 *cert, int issuer_needed)
     ESS_CERT_ID *cid = NULL;
     GENERAL_NAME *name = NULL;
 
-    /* Recompute SHA1 hash of certificate if necessary (side effect). */
-    X509_check_purpose(cert, -1, 0);
-
     if (!(cid = ESS_CERT_ID_new()))
         goto err;
-    if (!ASN1_OCTET_STRING_set(cid->hash, cert->sha1_hash,
+    if (!ASN1_OCTET_STRING_set(cid->hash, X509_get0_sha1_hash(cert),
                                sizeof(cert->sha1_hash)))
         goto err;
 
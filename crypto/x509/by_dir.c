@@ -72,15 +72,32 @@
 #include <openssl/lhash.h>
 #include <openssl/x509.h>
 
+/*
+ * Lookups are remembered per directory and name hash: for CRLs the next
+ * file suffix to try, and for certificates whether the directory had no
+ * entry at all for the hash when it last changed. Such misses are not looked
+ * for on disk again. Creating a file or link adds a directory entry, which
+ * changes the directory's own modification time, so that is all that needs
+ * checking, at most once every BY_DIR_CHECK_INTERVAL seconds. Files that do
+ * exist are always read again, so certificates and CRLs rewritten in place
+ * are picked up as before.
+ */
+#define BY_DIR_CHECK_INTERVAL   1
+#define BY_DIR_HASH_MAX         4096
+
 typedef struct lookup_dir_hashes_st {
     unsigned long hash;
     int suffix;
+    int cert_missing;
 } BY_DIR_HASH;
 
 typedef struct lookup_dir_entry_st {
     char *dir;
     int dir_type;
     STACK_OF(BY_DIR_HASH) *hashes;
+    time_t mtime;
+    time_t checked;
+    unsigned long flushes;
 } BY_DIR_ENTRY;
 
 typedef struct lookup_dir_st {
@@ -119,8 +136,9 @@ X509_LOOKUP_METHOD *X509_LOOKUP_hash_dir(void)
 static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
                     char **retp)
 {
-    int ret = 0;
-    BY_DIR *ld;
+    int ret = 0, i;
+    BY_DIR *ld, *from;
+    BY_DIR_ENTRY *ent;
     char *dir = NULL;
 
     ld = (BY_DIR *)ctx->method_data;
@@ -140,6 +158,15 @@ static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
         } else
             ret = add_cert_dir(ld, argp, (int)argl);
         break;
+    case X509_L_COPY:
+        /* The directories only, lookups are remembered afresh */
+        from = (BY_DIR *)((X509_LOOKUP *)argp)->method_data;
+        ret = 1;
+        for (i = 0; ret && i < sk_BY_DIR_ENTRY_num(from->dirs); i++) {
+            ent = sk_BY_DIR_ENTRY_value(from->dirs, i);
+            ret = add_cert_dir(ld, ent->dir, ent->dir_type);
+        }
+        break;
     }
     return (ret);
 }
@@ -235,6 +262,9 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
                 return 0;
             ent->dir_type = type;
             ent->hashes = sk_BY_DIR_HASH_new(by_dir_hash_cmp);
+            ent->mtime = 0;
+            ent->checked = 0;
+            ent->flushes = 0;
             ent->dir = OPENSSL_malloc((unsigned int)len + 1);
             if (!ent->dir || !ent->hashes) {
                 by_dir_entry_free(ent);
@@ -242,6 +272,7 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
             }
             strncpy(ent->dir, ss, (unsigned int)len);
             ent->dir[len] = '\0';
+            sk_BY_DIR_HASH_sort(ent->hashes);
             if (!sk_BY_DIR_ENTRY_push(ctx->dirs, ent)) {
                 by_dir_entry_free(ent);
                 return 0;
@@ -251,6 +282,81 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
     return 1;
 }
 
+static void by_dir_flush(BY_DIR_ENTRY *ent)
+{
+    BY_DIR_HASH *hent;
+    int i;
+
+    for (i = 0; i < sk_BY_DIR_HASH_num(ent->hashes); i++) {
+        hent = sk_BY_DIR_HASH_value(ent->hashes, i);
+        hent->cert_missing = 0;
+    }
+    ent->flushes++;
+}
+
+/*
+ * Whether the directory was found unchanged less than BY_DIR_CHECK_INTERVAL
+ * seconds ago. Called with CRYPTO_LOCK_X509_STORE at least read locked.
+ */
+static int by_dir_checked_recently(BY_DIR_ENTRY *ent, time_t now)
+{
+    return ent->checked != 0 && now >= ent->checked
+        && now - ent->checked < BY_DIR_CHECK_INTERVAL;
+}
+
+/*
+ * Check whether the misses recorded for a directory may be used and new
+ * ones recorded, forgetting them if the directory has changed. Called with
+ * CRYPTO_LOCK_X509_STORE write locked.
+ */
+static int by_dir_cache_valid(BY_DIR_ENTRY *ent)
+{
+#ifndef OPENSSL_NO_POSIX_IO
+    struct stat st;
+    time_t now = time(NULL);
+
+    if (by_dir_checked_recently(ent, now))
+        return 1;
+    if (stat(ent->dir, &st) < 0) {
+        by_dir_flush(ent);
+        ent->checked = 0;
+        return 0;
+    }
+    if (st.st_mtime != ent->mtime) {
+        by_dir_flush(ent);
+        ent->mtime = st.st_mtime;
+    }
+    /*
+     * The modification time has a resolution of one second, so a change
+     * made later in the second of the last change would go unnoticed.
+     */
+    if (st.st_mtime >= now) {
+        ent->checked = 0;
+        return 0;
+    }
+    ent->checked = now;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Whether |path| has no directory entry at all. A dangling link fails
+ * stat() but must not be recorded as a miss, as creating its target would
+ * not change the directory.
+ */
+static int by_dir_no_entry(const char *path)
+{
+#if !defined(OPENSSL_NO_POSIX_IO) && defined(S_IFLNK)
+    struct stat st;
+
+    return lstat(path, &st) < 0 && errno == ENOENT;
+#else
+    return 1;
+#endif
+}
+
 static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
                                X509_OBJECT *ret)
 {
@@ -301,7 +407,8 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
     h = X509_NAME_hash(name);
     for (i = 0; i < sk_BY_DIR_ENTRY_num(ctx->dirs); i++) {
         BY_DIR_ENTRY *ent;
-        int idx;
+        int idx, use_cache, missing;
+        unsigned long flushes;
         BY_DIR_HASH htmp, *hent;
         ent = sk_BY_DIR_ENTRY_value(ctx->dirs, i);
         j = strlen(ent->dir) + 1 + 8 + 6 + 1 + 1;
@@ -309,23 +416,31 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
             X509err(X509_F_GET_CERT_BY_SUBJECT, ERR_R_MALLOC_FAILURE);
             goto finish;
         }
-        if (type == X509_LU_CRL && ent->hashes) {
-            htmp.hash = h;
-            CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
-            idx = sk_BY_DIR_HASH_find(ent->hashes, &htmp);
-            if (idx >= 0) {
-                hent = sk_BY_DIR_HASH_value(ent->hashes, idx);
-                k = hent->suffix;
-            } else {
-                hent = NULL;
-                k = 0;
-            }
-            CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
-        } else {
-            k = 0;
-            hent = NULL;
+        htmp.hash = h;
+        k = 0;
+        missing = 0;
+        CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+        use_cache = type == X509_LU_X509
+            && by_dir_checked_recently(ent, time(NULL));
+        flushes = ent->flushes;
+        idx = sk_BY_DIR_HASH_find(ent->hashes, &htmp);
+        hent = idx >= 0 ? sk_BY_DIR_HASH_value(ent->hashes, idx) : NULL;
+        if (hent != NULL && type == X509_LU_CRL)
+            k = hent->suffix;
+        else if (hent != NULL && use_cache)
+            missing = hent->cert_missing;
+        CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+        if (type == X509_LU_X509 && !use_cache) {
+            /* Only a directory check needs the write lock */
+            CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+            use_cache = by_dir_cache_valid(ent);
+            flushes = ent->flushes;
+            if (hent != NULL && use_cache)
+                missing = hent->cert_missing;
+            CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
         }
-        for (;;) {
+
+        while (!missing) {
             char c = '/';
 #ifdef OPENSSL_SYS_VMS
             c = ent->dir[strlen(ent->dir) - 1];
@@ -385,9 +500,13 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
             tmp = NULL;
         CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
-        /* If a CRL, update the last file suffix added for this */
+        /*
+         * If a CRL, update the last file suffix added for this. If a
+         * certificate, record a miss unless the directory changed meanwhile.
+         */
 
-        if (type == X509_LU_CRL) {
+        if (type == X509_LU_CRL
+            || (use_cache && !missing && k == 0 && by_dir_no_entry(b->data))) {
             CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
             /*
              * Look for entry again in case another thread added an entry
@@ -399,6 +518,12 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
                 if (idx >= 0)
                     hent = sk_BY_DIR_HASH_value(ent->hashes, idx);
             }
+            if (!hent && type == X509_LU_X509
+                && sk_BY_DIR_HASH_num(ent->hashes) >= BY_DIR_HASH_MAX) {
+                /* Don't let lookups of unknown names grow this forever */
+                CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+                goto retrieved;
+            }
             if (!hent) {
                 hent = OPENSSL_malloc(sizeof(BY_DIR_HASH));
                 if (hent == NULL) {
@@ -407,19 +532,25 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
                     goto finish;
                 }
                 hent->hash = h;
-                hent->suffix = k;
+                hent->suffix = type == X509_LU_CRL ? k : 0;
+                hent->cert_missing = 0;
                 if (!sk_BY_DIR_HASH_push(ent->hashes, hent)) {
                     CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
                     OPENSSL_free(hent);
                     ok = 0;
                     goto finish;
                 }
-            } else if (hent->suffix < k)
+                /* Keep it sorted so that finds under the read lock don't */
+                sk_BY_DIR_HASH_sort(ent->hashes);
+            } else if (type == X509_LU_CRL && hent->suffix < k)
                 hent->suffix = k;
+            if (type == X509_LU_X509 && flushes == ent->flushes)
+                hent->cert_missing = 1;
 
             CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
         }
+ retrieved:
 
         if (tmp != NULL) {
             ok = 1;
@@ -119,6 +119,10 @@ static int by_file_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp,
                 ok = (X509_load_cert_file(ctx, argp, (int)argl) != 0);
         }
         break;
+    case X509_L_COPY:
+        /* What was loaded is in the store itself */
+        ok = 1;
+        break;
     }
     return (ok);
 }
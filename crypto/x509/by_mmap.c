@@ -0,0 +1,496 @@
+/* crypto/x509/by_mmap.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cryptlib.h"
+#include <openssl/buffer.h>
+#include <openssl/x509.h>
+
+#if defined(OPENSSL_SYS_UNIX) && !defined(OPENSSL_NO_POSIX_IO)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# ifdef _POSIX_MAPPED_FILES
+#  include <sys/mman.h>
+#  define MMAP_STORE_USE_MMAP
+# endif
+#endif
+
+/*
+ * Precompiled certificate store. The file is written by
+ * X509_mmap_store_write() (see "openssl castore") and is laid out as:
+ *
+ *      header  magic "OSSLCST1", then four 32 bit big endian values:
+ *              version, number of certificates, offset and length of
+ *              the certificate data, padded to MMAP_STORE_HDR_LEN bytes
+ *      index   one entry per certificate, sorted by subject name hash:
+ *              hash (X509_NAME_hash()), offset into the data, DER length
+ *      data    the certificates as i2d_X509_AUX() encodings, so any trust
+ *              settings are kept
+ *
+ * The lookup maps the file read-only and answers get_by_subject by binary
+ * searching the index and parsing only the certificates whose subject
+ * matches. These are added to the X509_STORE like the hash directory
+ * lookup does, so each one is parsed at most once. A mapping made before
+ * fork() is shared by all child processes.
+ */
+
+#define MMAP_STORE_MAGIC        "OSSLCST1"
+#define MMAP_STORE_VERSION      1
+#define MMAP_STORE_HDR_LEN      32
+#define MMAP_STORE_ENT_LEN      12
+#define MMAP_STORE_MAX          0xffffffffUL
+
+static unsigned long mmap_store_get32(const unsigned char *p)
+{
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16)
+        | ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+}
+
+static void mmap_store_put32(unsigned char *p, unsigned long v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+#ifndef OPENSSL_NO_STDIO
+
+typedef struct mmap_store_st {
+    unsigned char *base;
+    size_t len;
+    int mapped;
+    const unsigned char *index;
+    unsigned long num;
+    const unsigned char *data;
+    unsigned long data_len;
+    char *file;
+    struct mmap_store_st *next;
+} MMAP_STORE;
+
+static int mmap_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
+                     char **ret);
+static void free_mmap(X509_LOOKUP *lu);
+static int mmap_get_cert_by_subject(X509_LOOKUP *xl, int type,
+                                    X509_NAME *name, X509_OBJECT *ret);
+X509_LOOKUP_METHOD x509_mmap_lookup = {
+    "Load certs from a precompiled store file",
+    NULL,                       /* new */
+    free_mmap,                  /* free */
+    NULL,                       /* init */
+    NULL,                       /* shutdown */
+    mmap_ctrl,                  /* ctrl */
+    mmap_get_cert_by_subject,   /* get_by_subject */
+    NULL,                       /* get_by_issuer_serial */
+    NULL,                       /* get_by_fingerprint */
+    NULL,                       /* get_by_alias */
+};
+
+X509_LOOKUP_METHOD *X509_LOOKUP_mmap(void)
+{
+    return (&x509_mmap_lookup);
+}
+
+static void mmap_store_free(MMAP_STORE *st)
+{
+    if (st->base != NULL) {
+#ifdef MMAP_STORE_USE_MMAP
+        if (st->mapped)
+            munmap(st->base, st->len);
+        else
+#endif
+            OPENSSL_free(st->base);
+    }
+    if (st->file != NULL)
+        OPENSSL_free(st->file);
+    OPENSSL_free(st);
+}
+
+static void free_mmap(X509_LOOKUP *lu)
+{
+    MMAP_STORE *st, *next;
+
+    for (st = (MMAP_STORE *)lu->method_data; st != NULL; st = next) {
+        next = st->next;
+        mmap_store_free(st);
+    }
+    lu->method_data = NULL;
+}
+
+static int mmap_store_read(MMAP_STORE *st, const char *file)
+{
+#ifdef MMAP_STORE_USE_MMAP
+    struct stat sb;
+    void *m;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &sb) < 0 || sb.st_size < MMAP_STORE_HDR_LEN
+        || (off_t)(size_t)sb.st_size != sb.st_size) {
+        close(fd);
+        return 0;
+    }
+    m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return 0;
+    st->base = m;
+    st->len = (size_t)sb.st_size;
+    st->mapped = 1;
+    return 1;
+#else
+    BIO *in;
+    BUF_MEM *b;
+    int n;
+
+    if ((in = BIO_new_file(file, "rb")) == NULL)
+        return 0;
+    if ((b = BUF_MEM_new()) == NULL) {
+        BIO_free(in);
+        return 0;
+    }
+    for (;;) {
+        if (!BUF_MEM_grow(b, b->length + 8192))
+            goto err;
+        n = BIO_read(in, b->data + b->length - 8192, 8192);
+        if (n < 0)
+            goto err;
+        b->length -= 8192 - n;
+        if (n == 0)
+            break;
+    }
+    BIO_free(in);
+    st->base = (unsigned char *)b->data;
+    st->len = b->length;
+    st->mapped = 0;
+    b->data = NULL;
+    BUF_MEM_free(b);
+    return 1;
+ err:
+    BIO_free(in);
+    BUF_MEM_free(b);
+    return 0;
+#endif
+}
+
+static int mmap_store_load(X509_LOOKUP *lu, const char *file)
+{
+    MMAP_STORE *st;
+    unsigned long data_off;
+
+    if (file == NULL)
+        return 0;
+    st = OPENSSL_malloc(sizeof(*st));
+    if (st == NULL) {
+        X509err(X509_F_MMAP_STORE_LOAD, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    memset(st, 0, sizeof(*st));
+    if ((st->file = BUF_strdup(file)) == NULL) {
+        X509err(X509_F_MMAP_STORE_LOAD, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(st);
+        return 0;
+    }
+    if (!mmap_store_read(st, file)) {
+        X509err(X509_F_MMAP_STORE_LOAD, ERR_R_SYS_LIB);
+        ERR_add_error_data(2, "file=", file);
+        mmap_store_free(st);
+        return 0;
+    }
+
+    if (st->len < MMAP_STORE_HDR_LEN
+        || memcmp(st->base, MMAP_STORE_MAGIC, 8) != 0
+        || mmap_store_get32(st->base + 8) != MMAP_STORE_VERSION)
+        goto bad;
+    st->num = mmap_store_get32(st->base + 12);
+    data_off = mmap_store_get32(st->base + 16);
+    st->data_len = mmap_store_get32(st->base + 20);
+    if (data_off > st->len || st->data_len > st->len - data_off
+        || data_off < MMAP_STORE_HDR_LEN
+        || st->num > (data_off - MMAP_STORE_HDR_LEN) / MMAP_STORE_ENT_LEN)
+        goto bad;
+    st->index = st->base + MMAP_STORE_HDR_LEN;
+    st->data = st->base + data_off;
+
+    st->next = (MMAP_STORE *)lu->method_data;
+    lu->method_data = (char *)st;
+    return 1;
+ bad:
+    X509err(X509_F_MMAP_STORE_LOAD, X509_R_INVALID_STORE_FILE);
+    ERR_add_error_data(2, "file=", file);
+    mmap_store_free(st);
+    return 0;
+}
+
+/*
+ * Map the files of |st| and the stores loaded before it again for |lu|, in
+ * the order they were loaded. The pages themselves are shared.
+ */
+static int mmap_store_copy(X509_LOOKUP *lu, MMAP_STORE *st)
+{
+    if (st == NULL)
+        return 1;
+    if (!mmap_store_copy(lu, st->next))
+        return 0;
+    return mmap_store_load(lu, st->file);
+}
+
+static int mmap_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
+                     char **retp)
+{
+    int ret = 0;
+    X509_LOOKUP *from;
+
+    switch (cmd) {
+    case X509_L_MMAP_LOAD:
+        ret = mmap_store_load(ctx, argp);
+        break;
+    case X509_L_COPY:
+        from = (X509_LOOKUP *)argp;
+        ret = mmap_store_copy(ctx, (MMAP_STORE *)from->method_data);
+        break;
+    }
+    return (ret);
+}
+
+/*
+ * Parse the certificates of one store with subject hash h and add those
+ * matching name to the X509_STORE. Returns the number added or found to be
+ * there already.
+ */
+static int mmap_store_add_subject(X509_LOOKUP *xl, MMAP_STORE *st,
+                                  unsigned long h, X509_NAME *name)
+{
+    const unsigned char *e, *p;
+    unsigned long lo, hi, mid, off, len;
+    X509 *x;
+    int n = 0;
+
+    lo = 0;
+    hi = st->num;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (mmap_store_get32(st->index + mid * MMAP_STORE_ENT_LEN) < h)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < st->num; lo++) {
+        e = st->index + lo * MMAP_STORE_ENT_LEN;
+        if (mmap_store_get32(e) != h)
+            break;
+        off = mmap_store_get32(e + 4);
+        len = mmap_store_get32(e + 8);
+        if (off > st->data_len || len > st->data_len - off
+            || len > LONG_MAX) {
+            X509err(X509_F_MMAP_GET_CERT_BY_SUBJECT,
+                    X509_R_INVALID_STORE_FILE);
+            continue;
+        }
+        p = st->data + off;
+        if ((x = d2i_X509_AUX(NULL, &p, (long)len)) == NULL)
+            continue;
+        if (X509_NAME_cmp(X509_get_subject_name(x), name) == 0) {
+            if (X509_STORE_add_cert(xl->store_ctx, x))
+                n++;
+            else if (ERR_GET_REASON(ERR_peek_last_error())
+                     == X509_R_CERT_ALREADY_IN_HASH_TABLE) {
+                /* Another thread, or another store file, got there first */
+                ERR_get_error();
+                n++;
+            }
+        }
+        X509_free(x);
+    }
+    return n;
+}
+
+static int mmap_get_cert_by_subject(X509_LOOKUP *xl, int type,
+                                    X509_NAME *name, X509_OBJECT *ret)
+{
+    MMAP_STORE *st;
+    X509_OBJECT *tmp;
+    unsigned long h;
+    int n = 0;
+
+    if (name == NULL || type != X509_LU_X509)
+        return 0;
+
+    h = X509_NAME_hash(name);
+    for (st = (MMAP_STORE *)xl->method_data; st != NULL; st = st->next)
+        n += mmap_store_add_subject(xl, st, h, name);
+    if (n == 0)
+        return 0;
+
+    /* we have added it to the cache so now pull it out again */
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+    tmp = X509_OBJECT_retrieve_by_subject(xl->store_ctx->objs, type, name);
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+    if (tmp == NULL)
+        return 0;
+    ret->type = tmp->type;
+    memcpy(&ret->data, &tmp->data, sizeof(ret->data));
+    return 1;
+}
+
+#endif                          /* OPENSSL_NO_STDIO */
+
+typedef struct {
+    unsigned long hash;
+    unsigned long len;
+    int idx;
+} MMAP_STORE_ENT;
+
+static int mmap_store_ent_cmp(const void *a, const void *b)
+{
+    const MMAP_STORE_ENT *ea = a, *eb = b;
+
+    if (ea->hash != eb->hash)
+        return ea->hash < eb->hash ? -1 : 1;
+    return ea->idx - eb->idx;
+}
+
+int X509_mmap_store_write(BIO *out, STACK_OF(X509) *certs)
+{
+    MMAP_STORE_ENT *ents = NULL;
+    unsigned char hdr[MMAP_STORE_HDR_LEN], e[MMAP_STORE_ENT_LEN];
+    unsigned char *buf = NULL, *p;
+    unsigned long off, max = 0;
+    int i, n, len, ret = 0;
+    X509 *x;
+
+    n = sk_X509_num(certs);
+    if (n < 0 || (unsigned long)n > (MMAP_STORE_MAX - MMAP_STORE_HDR_LEN)
+                                    / MMAP_STORE_ENT_LEN) {
+        X509err(X509_F_X509_MMAP_STORE_WRITE, X509_R_STORE_FILE_TOO_LARGE);
+        return 0;
+    }
+    ents = OPENSSL_malloc(((n > 0 ? n : 1) * sizeof(*ents)));
+    if (ents == NULL) {
+        X509err(X509_F_X509_MMAP_STORE_WRITE, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    off = 0;
+    for (i = 0; i < n; i++) {
+        x = sk_X509_value(certs, i);
+        if ((len = i2d_X509_AUX(x, NULL)) <= 0) {
+            X509err(X509_F_X509_MMAP_STORE_WRITE, ERR_R_ASN1_LIB);
+            goto err;
+        }
+        ents[i].hash = X509_NAME_hash(X509_get_subject_name(x));
+        ents[i].len = (unsigned long)len;
+        ents[i].idx = i;
+        if ((unsigned long)len > max)
+            max = (unsigned long)len;
+        if (ents[i].len > MMAP_STORE_MAX - off) {
+            X509err(X509_F_X509_MMAP_STORE_WRITE,
+                    X509_R_STORE_FILE_TOO_LARGE);
+            goto err;
+        }
+        off += ents[i].len;
+    }
+    /* Certificates with the same subject hash also end up adjacent */
+    qsort(ents, n, sizeof(*ents), mmap_store_ent_cmp);
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, MMAP_STORE_MAGIC, 8);
+    mmap_store_put32(hdr + 8, MMAP_STORE_VERSION);
+    mmap_store_put32(hdr + 12, (unsigned long)n);
+    mmap_store_put32(hdr + 16, MMAP_STORE_HDR_LEN
+                     + (unsigned long)n * MMAP_STORE_ENT_LEN);
+    mmap_store_put32(hdr + 20, off);
+    if (BIO_write(out, hdr, sizeof(hdr)) != sizeof(hdr))
+        goto werr;
+
+    off = 0;
+    for (i = 0; i < n; i++) {
+        mmap_store_put32(e, ents[i].hash);
+        mmap_store_put32(e + 4, off);
+        mmap_store_put32(e + 8, ents[i].len);
+        if (BIO_write(out, e, sizeof(e)) != sizeof(e))
+            goto werr;
+        off += ents[i].len;
+    }
+
+    if (n > 0 && (buf = OPENSSL_malloc((int)max)) == NULL) {
+        X509err(X509_F_X509_MMAP_STORE_WRITE, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (i = 0; i < n; i++) {
+        p = buf;
+        len = i2d_X509_AUX(sk_X509_value(certs, ents[i].idx), &p);
+        if (len <= 0 || (unsigned long)len != ents[i].len) {
+            X509err(X509_F_X509_MMAP_STORE_WRITE, ERR_R_ASN1_LIB);
+            goto err;
+        }
+        if (BIO_write(out, buf, len) != len)
+            goto werr;
+    }
+    ret = 1;
+    goto err;
+ werr:
+    X509err(X509_F_X509_MMAP_STORE_WRITE, ERR_R_BIO_LIB);
+ err:
+    if (buf != NULL)
+        OPENSSL_free(buf);
+    OPENSSL_free(ents);
+    return ret;
+}
@@ -59,6 +59,7 @@
 #include <openssl/crypto.h>
 #include <openssl/bio.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
 
@@ -183,6 +184,270 @@ static int test_alt_chains_cert_forgery(void)
     return ret;
 }
 
+static int verify_leaf(X509_STORE *store, X509 *x, STACK_OF(X509) *untrusted,
+                       time_t check_time, int *err)
+{
+    X509_STORE_CTX *sctx;
+    int ret = -1;
+
+    sctx = X509_STORE_CTX_new();
+    if (sctx == NULL)
+        return -1;
+    if (X509_STORE_CTX_init(sctx, store, x, untrusted)) {
+        if (check_time != 0)
+            X509_VERIFY_PARAM_set_time(X509_STORE_CTX_get0_param(sctx),
+                                       check_time);
+        ret = X509_verify_cert(sctx);
+        *err = X509_STORE_CTX_get_error(sctx);
+        /* The chain ends in the trusted self-signed subinterCA */
+        if (ret > 0 && sk_X509_num(X509_STORE_CTX_get_chain(sctx)) != 2)
+            ret = -1;
+    }
+    X509_STORE_CTX_free(sctx);
+    return ret;
+}
+
+static X509 *load_cert(const char *filename)
+{
+    BIO *bio;
+    X509 *x;
+
+    if ((bio = BIO_new_file(filename, "r")) == NULL)
+        return NULL;
+    x = PEM_read_bio_X509(bio, NULL, 0, NULL);
+    BIO_free(bio);
+    return x;
+}
+
+/*
+ * Verify leaf.pem repeatedly with the verification cache enabled: the
+ * second verification must be answered from the cache, while one at a time
+ * after the leaf has expired or once the root is rejected must still fail.
+ */
+static int test_verify_cache(void)
+{
+    int ret = 0;
+    int err;
+    X509 *x = NULL, *bad = NULL, *root;
+    X509_STORE_CTX *sctx = NULL;
+    STACK_OF(X509) *untrusted = NULL;
+    BIO *bio = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    store = X509_STORE_new();
+    if (store == NULL)
+        goto err;
+    if (!X509_STORE_set_verify_cache(store, 4, 300))
+        goto err;
+
+    lookup = X509_STORE_add_lookup(store, X509_LOOKUP_file());
+    if (lookup == NULL)
+        goto err;
+    if (!X509_LOOKUP_load_file(lookup, "certs/roots.pem", X509_FILETYPE_PEM))
+        goto err;
+
+    untrusted = load_certs_from_file("certs/untrusted.pem");
+
+    if ((bio = BIO_new_file("certs/leaf.pem", "r")) == NULL)
+        goto err;
+    if ((x = PEM_read_bio_X509(bio, NULL, 0, NULL)) == NULL)
+        goto err;
+
+    if (verify_leaf(store, x, untrusted, 0, &err) != 1
+        || X509_STORE_get_verify_cache_hits(store) != 0)
+        goto err;
+    if (verify_leaf(store, x, untrusted, 0, &err) != 1
+        || X509_STORE_get_verify_cache_hits(store) != 1)
+        goto err;
+
+    /* August 2035 is after the notAfter date of leaf.pem */
+    if (verify_leaf(store, x, untrusted, 2070000000L, &err) != 0
+        || err != X509_V_ERR_CERT_HAS_EXPIRED
+        || X509_STORE_get_verify_cache_hits(store) != 1)
+        goto err;
+
+    /* Different parameters must not share the result */
+    X509_STORE_set_purpose(store, X509_PURPOSE_SSL_SERVER);
+    if (verify_leaf(store, x, untrusted, 0, &err) != 1
+        || X509_STORE_get_verify_cache_hits(store) != 1)
+        goto err;
+    if (verify_leaf(store, x, untrusted, 0, &err) != 1
+        || X509_STORE_get_verify_cache_hits(store) != 2)
+        goto err;
+
+    /* Adding to the store, as lazy lookups do, keeps the results */
+    if ((bad = load_cert("certs/bad.pem")) == NULL
+        || !X509_STORE_add_cert(store, bad)
+        || verify_leaf(store, x, untrusted, 0, &err) != 1
+        || X509_STORE_get_verify_cache_hits(store) != 3)
+        goto err;
+
+    /* Trust settings are checked again on a hit */
+    if ((sctx = X509_STORE_CTX_new()) == NULL
+        || !X509_STORE_CTX_init(sctx, store, x, untrusted)
+        || X509_verify_cert(sctx) != 1)
+        goto err;
+    root = sk_X509_value(X509_STORE_CTX_get_chain(sctx), 1);
+    if (!X509_add1_reject_object(root,
+                                 OBJ_nid2obj(NID_anyExtendedKeyUsage))
+        || verify_leaf(store, x, untrusted, 0, &err) != 0
+        || err != X509_V_ERR_CERT_REJECTED
+        || X509_STORE_get_verify_cache_hits(store) != 4)
+        goto err;
+
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(sctx);
+    X509_free(bad);
+    X509_free(x);
+    BIO_free(bio);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    if (ret != 1)
+        ERR_print_errors_fp(stderr);
+    return ret;
+}
+
+/*
+ * Verify two separately loaded copies of leaf.pem with the signature cache
+ * enabled: the signature of the second must be taken from the cache.
+ */
+static int test_sig_cache(void)
+{
+    int ret = 0;
+    int i, err, len;
+    unsigned long num, hits, misses;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    X509 *x = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    store = X509_STORE_new();
+    if (store == NULL)
+        goto err;
+    if (!X509_STORE_set_sig_cache(store, 16))
+        goto err;
+
+    lookup = X509_STORE_add_lookup(store, X509_LOOKUP_file());
+    if (lookup == NULL)
+        goto err;
+    if (!X509_LOOKUP_load_file(lookup, "certs/roots.pem", X509_FILETYPE_PEM))
+        goto err;
+
+    for (i = 0; i < 2; i++) {
+        if ((x = load_cert("certs/leaf.pem")) == NULL)
+            goto err;
+        if (verify_leaf(store, x, NULL, 0, &err) != 1)
+            goto err;
+        X509_free(x);
+        x = NULL;
+        X509_STORE_get_sig_cache_stats(store, &num, &hits, &misses);
+        if (num != 1 || hits != (unsigned long)i || misses != 1)
+            goto err;
+    }
+
+    /* A copy with a corrupted signature must not match the cached one */
+    if ((x = load_cert("certs/leaf.pem")) == NULL)
+        goto err;
+    if ((len = i2d_X509(x, &der)) <= 0)
+        goto err;
+    X509_free(x);
+    x = NULL;
+    der[len - 1] ^= 1;
+    p = der;
+    if ((x = d2i_X509(NULL, &p, len)) == NULL)
+        goto err;
+    if (verify_leaf(store, x, NULL, 0, &err) != 0
+        || err != X509_V_ERR_CERT_SIGNATURE_FAILURE)
+        goto err;
+
+    ret = 1;
+ err:
+    if (der != NULL)
+        OPENSSL_free(der);
+    X509_free(x);
+    X509_STORE_free(store);
+    if (ret != 1)
+        ERR_print_errors_fp(stderr);
+    return ret;
+}
+
+/*
+ * Compile roots.pem into a precompiled store and verify leaf.pem through
+ * X509_LOOKUP_mmap(): only the issuer of the leaf may have been parsed.
+ * A copy of the store made by X509_STORE_dup() must have the lookup and
+ * the signature cache too.
+ */
+static int test_mmap_store(void)
+{
+    const char *file = "verify_extra_test.cst";
+    int ret = 0;
+    int err;
+    unsigned long num;
+    X509 *x = NULL;
+    STACK_OF(X509) *roots = NULL;
+    BIO *bio = NULL;
+    X509_STORE *store = NULL, *copy = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    if ((roots = load_certs_from_file("certs/roots.pem")) == NULL
+        || sk_X509_num(roots) != 2)
+        goto err;
+    if ((bio = BIO_new_file(file, "wb")) == NULL)
+        goto err;
+    if (!X509_mmap_store_write(bio, roots))
+        goto err;
+    BIO_free(bio);
+    bio = NULL;
+
+    store = X509_STORE_new();
+    if (store == NULL)
+        goto err;
+    lookup = X509_STORE_add_lookup(store, X509_LOOKUP_mmap());
+    if (lookup == NULL)
+        goto err;
+    /* A PEM file is not a store */
+    if (X509_LOOKUP_load_mmap(lookup, "certs/roots.pem"))
+        goto err;
+    ERR_clear_error();
+    if (!X509_LOOKUP_load_mmap(lookup, file))
+        goto err;
+    if (!X509_STORE_set_sig_cache(store, 16))
+        goto err;
+    if ((copy = X509_STORE_dup(store)) == NULL)
+        goto err;
+
+    if ((x = load_cert("certs/leaf.pem")) == NULL)
+        goto err;
+    if (verify_leaf(copy, x, NULL, 0, &err) != 1
+        || sk_X509_OBJECT_num(copy->objs) != 1
+        || sk_X509_OBJECT_num(store->objs) != 0)
+        goto err;
+    X509_STORE_get_sig_cache_stats(copy, &num, NULL, NULL);
+    if (num != 1)
+        goto err;
+    if (verify_leaf(store, x, NULL, 0, &err) != 1
+        || sk_X509_OBJECT_num(store->objs) != 1)
+        goto err;
+    if (verify_leaf(store, x, NULL, 0, &err) != 1
+        || sk_X509_OBJECT_num(store->objs) != 1)
+        goto err;
+
+    ret = 1;
+ err:
+    X509_free(x);
+    BIO_free(bio);
+    sk_X509_pop_free(roots, X509_free);
+    X509_STORE_free(copy);
+    X509_STORE_free(store);
+    remove(file);
+    if (ret != 1)
+        ERR_print_errors_fp(stderr);
+    return ret;
+}
+
 int main(void)
 {
     CRYPTO_malloc_debug_init();
@@ -197,6 +462,21 @@ int main(void)
         return 1;
     }
 
+    if (!test_verify_cache()) {
+        fprintf(stderr, "Test verify cache failed\n");
+        return 1;
+    }
+
+    if (!test_sig_cache()) {
+        fprintf(stderr, "Test signature cache failed\n");
+        return 1;
+    }
+
+    if (!test_mmap_store()) {
+        fprintf(stderr, "Test precompiled store failed\n");
+        return 1;
+    }
+
     EVP_cleanup();
     CRYPTO_cleanup_all_ex_data();
     ERR_remove_thread_state(NULL);
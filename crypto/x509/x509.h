@@ -185,6 +185,7 @@ struct X509_name_st {
     char *bytes;
 # endif
 /*      unsigned long hash; Keep the hash around for lookups */
+    /* Canonical encoding: -1 length if not yet generated, see i2d_X509_NAME */
     unsigned char *canon_enc;
     int canon_enclen;
 } /* X509_NAME */ ;
@@ -293,6 +294,7 @@ struct x509_st {
     struct ASIdentifiers_st *rfc3779_asid;
 # endif
 # ifndef OPENSSL_NO_SHA
+    /* Only valid after X509_get0_sha1_hash() or X509_check_purpose() */
     unsigned char sha1_hash[SHA_DIGEST_LENGTH];
 # endif
     X509_CERT_AUX *aux;
@@ -858,6 +860,8 @@ int X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev);
 int X509_CRL_get0_by_serial(X509_CRL *crl,
                             X509_REVOKED **ret, ASN1_INTEGER *serial);
 int X509_CRL_get0_by_cert(X509_CRL *crl, X509_REVOKED **ret, X509 *x);
+X509_CRL *d2i_X509_CRL_compact(X509_CRL **a, const unsigned char **pp,
+                               long length);
 
 X509_PKEY *X509_PKEY_new(void);
 void X509_PKEY_free(X509_PKEY *a);
@@ -1246,6 +1250,8 @@ void ERR_load_X509_strings(void);
 # define X509_F_CHECK_POLICY                              145
 # define X509_F_DIR_CTRL                                  102
 # define X509_F_GET_CERT_BY_SUBJECT                       103
+# define X509_F_MMAP_GET_CERT_BY_SUBJECT                  152
+# define X509_F_MMAP_STORE_LOAD                           151
 # define X509_F_NETSCAPE_SPKI_B64_DECODE                  129
 # define X509_F_NETSCAPE_SPKI_B64_ENCODE                  130
 # define X509_F_X509AT_ADD1_ATTR                          135
@@ -1264,6 +1270,7 @@ void ERR_load_X509_strings(void);
 # define X509_F_X509_LOAD_CERT_CRL_FILE                   132
 # define X509_F_X509_LOAD_CERT_FILE                       111
 # define X509_F_X509_LOAD_CRL_FILE                        112
+# define X509_F_X509_MMAP_STORE_WRITE                     153
 # define X509_F_X509_NAME_ADD_ENTRY                       113
 # define X509_F_X509_NAME_ENTRY_CREATE_BY_NID             114
 # define X509_F_X509_NAME_ENTRY_CREATE_BY_TXT             131
@@ -1283,6 +1290,10 @@ void ERR_load_X509_strings(void);
 # define X509_F_X509_STORE_CTX_INIT                       143
 # define X509_F_X509_STORE_CTX_NEW                        142
 # define X509_F_X509_STORE_CTX_PURPOSE_INHERIT            134
+# define X509_F_X509_STORE_DUP                            154
+# define X509_F_X509_STORE_REPLACE_CRL                    150
+# define X509_F_X509_STORE_SET_SIG_CACHE                  149
+# define X509_F_X509_STORE_SET_VERIFY_CACHE               148
 # define X509_F_X509_TO_X509_REQ                          126
 # define X509_F_X509_TRUST_ADD                            133
 # define X509_F_X509_TRUST_SET                            141
@@ -1300,6 +1311,7 @@ void ERR_load_X509_strings(void);
 # define X509_R_IDP_MISMATCH                              128
 # define X509_R_INVALID_DIRECTORY                         113
 # define X509_R_INVALID_FIELD_NAME                        119
+# define X509_R_INVALID_STORE_FILE                        135
 # define X509_R_INVALID_TRUST                             123
 # define X509_R_ISSUER_MISMATCH                           129
 # define X509_R_KEY_TYPE_MISMATCH                         115
@@ -1314,6 +1326,7 @@ void ERR_load_X509_strings(void);
 # define X509_R_PUBLIC_KEY_DECODE_ERROR                   125
 # define X509_R_PUBLIC_KEY_ENCODE_ERROR                   126
 # define X509_R_SHOULD_RETRY                              106
+# define X509_R_STORE_FILE_TOO_LARGE                      136
 # define X509_R_UNABLE_TO_FIND_PARAMETERS_IN_CHAIN        107
 # define X509_R_UNABLE_TO_GET_CERTS_PUBLIC_KEY            108
 # define X509_R_UNKNOWN_KEY_TYPE                          117
@@ -182,11 +182,9 @@ unsigned long X509_subject_name_hash_old(X509 *x)
 int X509_cmp(const X509 *a, const X509 *b)
 {
     int rv;
-    /* ensure hash is valid */
-    X509_check_purpose((X509 *)a, -1, 0);
-    X509_check_purpose((X509 *)b, -1, 0);
 
-    rv = memcmp(a->sha1_hash, b->sha1_hash, SHA_DIGEST_LENGTH);
+    rv = memcmp(X509_get0_sha1_hash((X509 *)a),
+                X509_get0_sha1_hash((X509 *)b), SHA_DIGEST_LENGTH);
     if (rv)
         return rv;
     /* Check for match against stored encoding too */
@@ -205,19 +203,17 @@ int X509_NAME_cmp(const X509_NAME *a, const X509_NAME *b)
 {
     int ret;
 
-    /* Ensure canonical encoding is present and up to date */
+    /*
+     * Ensure canonical encoding is present and up to date. A decoded name
+     * may be canonicalised by another thread, so the pending check is left
+     * to i2d, which makes it under a lock.
+     */
 
-    if (!a->canon_enc || a->modified) {
-        ret = i2d_X509_NAME((X509_NAME *)a, NULL);
-        if (ret < 0)
-            return -2;
-    }
+    if (i2d_X509_NAME((X509_NAME *)a, NULL) < 0)
+        return -2;
 
-    if (!b->canon_enc || b->modified) {
-        ret = i2d_X509_NAME((X509_NAME *)b, NULL);
-        if (ret < 0)
-            return -2;
-    }
+    if (i2d_X509_NAME((X509_NAME *)b, NULL) < 0)
+        return -2;
 
     ret = a->canon_enclen - b->canon_enclen;
 
@@ -76,6 +76,8 @@ static ERR_STRING_DATA X509_str_functs[] = {
     {ERR_FUNC(X509_F_CHECK_POLICY), "CHECK_POLICY"},
     {ERR_FUNC(X509_F_DIR_CTRL), "DIR_CTRL"},
     {ERR_FUNC(X509_F_GET_CERT_BY_SUBJECT), "GET_CERT_BY_SUBJECT"},
+    {ERR_FUNC(X509_F_MMAP_GET_CERT_BY_SUBJECT), "MMAP_GET_CERT_BY_SUBJECT"},
+    {ERR_FUNC(X509_F_MMAP_STORE_LOAD), "MMAP_STORE_LOAD"},
     {ERR_FUNC(X509_F_NETSCAPE_SPKI_B64_DECODE), "NETSCAPE_SPKI_b64_decode"},
     {ERR_FUNC(X509_F_NETSCAPE_SPKI_B64_ENCODE), "NETSCAPE_SPKI_b64_encode"},
     {ERR_FUNC(X509_F_X509AT_ADD1_ATTR), "X509at_add1_attr"},
@@ -100,6 +102,7 @@ static ERR_STRING_DATA X509_str_functs[] = {
     {ERR_FUNC(X509_F_X509_LOAD_CERT_CRL_FILE), "X509_load_cert_crl_file"},
     {ERR_FUNC(X509_F_X509_LOAD_CERT_FILE), "X509_load_cert_file"},
     {ERR_FUNC(X509_F_X509_LOAD_CRL_FILE), "X509_load_crl_file"},
+    {ERR_FUNC(X509_F_X509_MMAP_STORE_WRITE), "X509_mmap_store_write"},
     {ERR_FUNC(X509_F_X509_NAME_ADD_ENTRY), "X509_NAME_add_entry"},
     {ERR_FUNC(X509_F_X509_NAME_ENTRY_CREATE_BY_NID),
      "X509_NAME_ENTRY_create_by_NID"},
@@ -125,6 +128,11 @@ static ERR_STRING_DATA X509_str_functs[] = {
     {ERR_FUNC(X509_F_X509_STORE_CTX_NEW), "X509_STORE_CTX_new"},
     {ERR_FUNC(X509_F_X509_STORE_CTX_PURPOSE_INHERIT),
      "X509_STORE_CTX_purpose_inherit"},
+    {ERR_FUNC(X509_F_X509_STORE_DUP), "X509_STORE_dup"},
+    {ERR_FUNC(X509_F_X509_STORE_REPLACE_CRL), "X509_STORE_replace_crl"},
+    {ERR_FUNC(X509_F_X509_STORE_SET_SIG_CACHE), "X509_STORE_set_sig_cache"},
+    {ERR_FUNC(X509_F_X509_STORE_SET_VERIFY_CACHE),
+     "X509_STORE_set_verify_cache"},
     {ERR_FUNC(X509_F_X509_TO_X509_REQ), "X509_to_X509_REQ"},
     {ERR_FUNC(X509_F_X509_TRUST_ADD), "X509_TRUST_add"},
     {ERR_FUNC(X509_F_X509_TRUST_SET), "X509_TRUST_set"},
@@ -145,6 +153,7 @@ static ERR_STRING_DATA X509_str_reasons[] = {
     {ERR_REASON(X509_R_IDP_MISMATCH), "idp mismatch"},
     {ERR_REASON(X509_R_INVALID_DIRECTORY), "invalid directory"},
     {ERR_REASON(X509_R_INVALID_FIELD_NAME), "invalid field name"},
+    {ERR_REASON(X509_R_INVALID_STORE_FILE), "invalid store file"},
     {ERR_REASON(X509_R_INVALID_TRUST), "invalid trust"},
     {ERR_REASON(X509_R_ISSUER_MISMATCH), "issuer mismatch"},
     {ERR_REASON(X509_R_KEY_TYPE_MISMATCH), "key type mismatch"},
@@ -160,6 +169,7 @@ static ERR_STRING_DATA X509_str_reasons[] = {
     {ERR_REASON(X509_R_PUBLIC_KEY_DECODE_ERROR), "public key decode error"},
     {ERR_REASON(X509_R_PUBLIC_KEY_ENCODE_ERROR), "public key encode error"},
     {ERR_REASON(X509_R_SHOULD_RETRY), "should retry"},
+    {ERR_REASON(X509_R_STORE_FILE_TOO_LARGE), "store file too large"},
     {ERR_REASON(X509_R_UNABLE_TO_FIND_PARAMETERS_IN_CHAIN),
      "unable to find parameters in chain"},
     {ERR_REASON(X509_R_UNABLE_TO_GET_CERTS_PUBLIC_KEY),
@@ -205,6 +205,10 @@ X509_STORE *X509_STORE_new(void)
     ret->lookup_certs = 0;
     ret->lookup_crls = 0;
     ret->cleanup = 0;
+    ret->verify_cache = NULL;
+    ret->verify_cache_hits = 0;
+    ret->sig_cache = NULL;
+    ret->sig_cache_hits = ret->sig_cache_misses = 0;
 
     if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_X509_STORE, ret, &ret->ex_data))
        goto err3;
@@ -268,6 +272,8 @@ void X509_STORE_free(X509_STORE *vfy)
     }
     sk_X509_LOOKUP_free(sk);
     sk_X509_OBJECT_pop_free(vfy->objs, cleanup);
+    X509_STORE_set_verify_cache(vfy, 0, 0);
+    X509_STORE_set_sig_cache(vfy, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
     if (vfy->param)
@@ -421,6 +427,98 @@ int X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x)
     return ret;
 }
 
+/* Do |a| and |b| cover the same certificates? */
+static int crl_same_scope(X509_CRL *a, X509_CRL *b)
+{
+    X509_EXTENSION *ea, *eb;
+    int ia, ib;
+
+    if (X509_CRL_cmp(a, b) != 0
+        || (a->base_crl_number == NULL) != (b->base_crl_number == NULL))
+        return 0;
+    ia = X509_CRL_get_ext_by_NID(a, NID_issuing_distribution_point, -1);
+    ib = X509_CRL_get_ext_by_NID(b, NID_issuing_distribution_point, -1);
+    if (ia < 0 || ib < 0)
+        return ia < 0 && ib < 0;
+    ea = X509_CRL_get_ext(a, ia);
+    eb = X509_CRL_get_ext(b, ib);
+    return ASN1_OCTET_STRING_cmp(X509_EXTENSION_get_data(ea),
+                                 X509_EXTENSION_get_data(eb)) == 0;
+}
+
+/*
+ * Was |a| issued after |b|? The CRL numbers decide if both have one,
+ * otherwise the lastUpdate times.
+ */
+static int crl_is_newer(X509_CRL *a, X509_CRL *b)
+{
+    int day, sec;
+
+    if (a->crl_number != NULL && b->crl_number != NULL)
+        return ASN1_INTEGER_cmp(a->crl_number, b->crl_number) > 0;
+    if (!ASN1_TIME_diff(&day, &sec, X509_CRL_get_lastUpdate(b),
+                        X509_CRL_get_lastUpdate(a)))
+        return 0;
+    return day > 0 || (day == 0 && sec > 0);
+}
+
+/*
+ * Add |x| to the store in place of a CRL with the same issuer, kind (full
+ * or delta) and issuing distribution point, or simply add it if there is
+ * none. |x| must be newer than the CRL it replaces, so that a stale copy
+ * cannot undo a revocation. The swap is made under the store lock, so a
+ * verification sees either the old CRL or the new one; those already
+ * holding the old one keep their reference until they are done with it.
+ */
+int X509_STORE_replace_crl(X509_STORE *ctx, X509_CRL *x)
+{
+    X509_OBJECT *obj, *tmp;
+    X509_CRL *old = NULL;
+    int i, ret = 1;
+
+    if (x == NULL)
+        return 0;
+    obj = (X509_OBJECT *)OPENSSL_malloc(sizeof(X509_OBJECT));
+    if (obj == NULL) {
+        X509err(X509_F_X509_STORE_REPLACE_CRL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    obj->type = X509_LU_CRL;
+    obj->data.crl = x;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+
+    X509_OBJECT_up_ref_count(obj);
+
+    for (i = 0; i < sk_X509_OBJECT_num(ctx->objs); i++) {
+        tmp = sk_X509_OBJECT_value(ctx->objs, i);
+        if (tmp->type == X509_LU_CRL && crl_same_scope(tmp->data.crl, x)) {
+            old = tmp->data.crl;
+            break;
+        }
+    }
+    if (old != NULL && !crl_is_newer(x, old)) {
+        X509_OBJECT_free_contents(obj);
+        OPENSSL_free(obj);
+        X509err(X509_F_X509_STORE_REPLACE_CRL, X509_R_NEWER_CRL_NOT_NEWER);
+        old = NULL;
+        ret = 0;
+    } else if (old != NULL) {
+        tmp->data.crl = x;
+        OPENSSL_free(obj);
+    } else if (!sk_X509_OBJECT_push(ctx->objs, obj)) {
+        X509_OBJECT_free_contents(obj);
+        OPENSSL_free(obj);
+        X509err(X509_F_X509_STORE_REPLACE_CRL, ERR_R_MALLOC_FAILURE);
+        ret = 0;
+    }
+
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+    X509_CRL_free(old);
+    return ret;
+}
+
 void X509_OBJECT_up_ref_count(X509_OBJECT *a)
 {
     switch (a->type) {
@@ -70,6 +70,7 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 #include <openssl/objects.h>
+#include <openssl/sha.h>
 #include "vpm_int.h"
 
 /* CRL score values */
@@ -187,6 +188,374 @@ static X509 *lookup_cert_match(X509_STORE_CTX *ctx, X509 *x)
     return xtmp;
 }
 
+/*
+ * Verification result cache. When enabled with X509_STORE_set_verify_cache()
+ * the chain built by each successful X509_verify_cert() is kept, keyed by a
+ * SHA-256 digest over the encodings of the certificates supplied by the
+ * caller and the parameters that steer chain building. A later verification
+ * with the same key reuses the chain without rebuilding it or checking its
+ * signatures again. Everything else is checked against it as in a full
+ * verification: validity times, extensions and purpose, trust settings,
+ * name constraints, the host/email/IP checks, Suite B, RFC 3779 and, if
+ * enabled, revocation. Anything that fails there falls back to a full
+ * verification, so errors are reported exactly as without the cache.
+ *
+ * Certificates and CRLs added to the store later, as the directory lookups
+ * do on demand, cannot make a chain that was already verified invalid, so
+ * they leave the cache alone. Revocation is always checked again.
+ *
+ * Entries live for at most the configured number of seconds. Lookups only
+ * take the store lock for reading and mark the entry used; eviction gives
+ * used entries a second chance. Verifications with an application callback,
+ * a custom chain builder or policy checking are never cached since their
+ * outcome can depend on more than the key covers.
+ */
+
+typedef struct x509_verify_cache_entry_st X509_VERIFY_CACHE_ENTRY;
+
+struct x509_verify_cache_entry_st {
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    STACK_OF(X509) *chain;
+    int last_untrusted;
+    time_t expires;
+    /* Set on every hit, cleared when the entry is spared eviction */
+    int used;
+    X509_VERIFY_CACHE_ENTRY *prev, *next;
+};
+
+DECLARE_LHASH_OF(X509_VERIFY_CACHE_ENTRY);
+
+typedef struct x509_verify_cache_st {
+    LHASH_OF(X509_VERIFY_CACHE_ENTRY) *entries;
+    /* Most recently added or spared first */
+    X509_VERIFY_CACHE_ENTRY *head, *tail;
+    unsigned long max;
+    long ttl;
+} X509_VERIFY_CACHE;
+
+static unsigned long x509_verify_cache_entry_hash(const X509_VERIFY_CACHE_ENTRY
+                                                  *a)
+{
+    return ((unsigned long)a->key[0]) | ((unsigned long)a->key[1] << 8) |
+        ((unsigned long)a->key[2] << 16) | ((unsigned long)a->key[3] << 24);
+}
+
+static IMPLEMENT_LHASH_HASH_FN(x509_verify_cache_entry,
+                               X509_VERIFY_CACHE_ENTRY)
+
+static int x509_verify_cache_entry_cmp(const X509_VERIFY_CACHE_ENTRY *a,
+                                       const X509_VERIFY_CACHE_ENTRY *b)
+{
+    return memcmp(a->key, b->key, sizeof(a->key));
+}
+
+static IMPLEMENT_LHASH_COMP_FN(x509_verify_cache_entry,
+                               X509_VERIFY_CACHE_ENTRY)
+
+static void verify_cache_unlink(X509_VERIFY_CACHE *c,
+                                X509_VERIFY_CACHE_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        c->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        c->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void verify_cache_link_head(X509_VERIFY_CACHE *c,
+                                   X509_VERIFY_CACHE_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head != NULL)
+        c->head->prev = e;
+    else
+        c->tail = e;
+    c->head = e;
+}
+
+static void verify_cache_remove(X509_VERIFY_CACHE *c,
+                                X509_VERIFY_CACHE_ENTRY *e)
+{
+    verify_cache_unlink(c, e);
+    (void)lh_X509_VERIFY_CACHE_ENTRY_delete(c->entries, e);
+    sk_X509_pop_free(e->chain, X509_free);
+    OPENSSL_free(e);
+}
+
+/*
+ * Evict entries until no more than |num| are left. Unexpired entries used
+ * since they were last considered are moved back to the head instead,
+ * unless the cache is being emptied.
+ */
+static void verify_cache_trim(X509_VERIFY_CACHE *c, unsigned long num)
+{
+    X509_VERIFY_CACHE_ENTRY *e;
+    time_t now = time(NULL);
+
+    while (lh_X509_VERIFY_CACHE_ENTRY_num_items(c->entries) > num) {
+        e = c->tail;
+        if (e->used && e->expires >= now && num > 0) {
+            e->used = 0;
+            verify_cache_unlink(c, e);
+            verify_cache_link_head(c, e);
+            continue;
+        }
+        verify_cache_remove(c, e);
+    }
+}
+
+static void verify_cache_free(X509_VERIFY_CACHE *c)
+{
+    if (c == NULL)
+        return;
+    verify_cache_trim(c, 0);
+    lh_X509_VERIFY_CACHE_ENTRY_free(c->entries);
+    OPENSSL_free(c);
+}
+
+/*
+ * Keep up to |num| successful verification results for |ttl| seconds each,
+ * a |num| of zero disables the cache and discards its contents. A changed
+ * |ttl| applies to results added afterwards.
+ */
+int X509_STORE_set_verify_cache(X509_STORE *ctx, long num, long ttl)
+{
+    X509_VERIFY_CACHE *c = NULL, *old = NULL;
+
+    if (num < 0 || ttl < 0)
+        return 0;
+
+    if (num > 0 && ctx->verify_cache == NULL) {
+        c = OPENSSL_malloc(sizeof(*c));
+        if (c == NULL
+            || (c->entries = lh_X509_VERIFY_CACHE_ENTRY_new()) == NULL) {
+            OPENSSL_free(c);
+            X509err(X509_F_X509_STORE_SET_VERIFY_CACHE,
+                    ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        c->head = c->tail = NULL;
+    }
+
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+    if (num == 0) {
+        old = ctx->verify_cache;
+        ctx->verify_cache = NULL;
+    } else {
+        if (ctx->verify_cache == NULL) {
+            ctx->verify_cache = c;
+            ctx->verify_cache_hits = 0;
+            c = NULL;
+        }
+        ctx->verify_cache->max = num;
+        ctx->verify_cache->ttl = ttl;
+        verify_cache_trim(ctx->verify_cache, num);
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+    verify_cache_free(c);
+    verify_cache_free(old);
+    return 1;
+}
+
+unsigned long X509_STORE_get_verify_cache_hits(X509_STORE *ctx)
+{
+    unsigned long ret = 0;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+    if (ctx->verify_cache != NULL)
+        ret = ctx->verify_cache_hits;
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+    return ret;
+}
+
+static int verify_cache_usable(X509_STORE_CTX *ctx)
+{
+    return ctx->ctx != NULL && ctx->ctx->verify_cache != NULL
+        && ctx->parent == NULL
+        && ctx->verify_cb == null_callback
+        && ctx->verify == internal_verify
+        && ctx->get_issuer == X509_STORE_CTX_get1_issuer
+        && ctx->check_issued == check_issued
+        && ctx->lookup_certs == X509_STORE_get1_certs
+        && !(ctx->param->flags & X509_V_FLAG_POLICY_CHECK);
+}
+
+/*
+ * The key covers everything chain building and the signature checks depend
+ * on: the full encodings of the leaf and the untrusted certificates, in
+ * order, and the flags, purpose, trust and depth. The other checks are run
+ * again on every hit, so their inputs need not be part of it.
+ */
+static int verify_cache_key(X509_STORE_CTX *ctx, unsigned char *key)
+{
+#ifndef OPENSSL_NO_SHA256
+    X509_VERIFY_PARAM *param = ctx->param;
+    EVP_MD_CTX mctx;
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    unsigned long val[5];
+    int i, n, ok;
+
+    n = ctx->untrusted != NULL ? sk_X509_num(ctx->untrusted) : 0;
+    val[0] = param->flags;
+    val[1] = (unsigned long)param->purpose;
+    val[2] = (unsigned long)param->trust;
+    val[3] = (unsigned long)param->depth;
+    val[4] = n;
+
+    EVP_MD_CTX_init(&mctx);
+    ok = EVP_DigestInit_ex(&mctx, EVP_sha256(), NULL)
+        && EVP_DigestUpdate(&mctx, val, sizeof(val))
+        && X509_digest(ctx->cert, EVP_sha256(), md, NULL)
+        && EVP_DigestUpdate(&mctx, md, sizeof(md));
+    for (i = 0; ok && i < n; i++)
+        ok = X509_digest(sk_X509_value(ctx->untrusted, i), EVP_sha256(), md,
+                         NULL)
+            && EVP_DigestUpdate(&mctx, md, sizeof(md));
+    ok = ok && EVP_DigestFinal_ex(&mctx, key, NULL);
+    EVP_MD_CTX_cleanup(&mctx);
+    return ok;
+#else
+    return 0;
+#endif
+}
+
+/* Is |x| valid at the verification time? Errors are not reported. */
+static int verify_cache_check_time(X509_STORE_CTX *ctx, X509 *x)
+{
+    time_t *ptime = NULL;
+
+    if (ctx->param->flags & X509_V_FLAG_USE_CHECK_TIME)
+        ptime = &ctx->param->check_time;
+    return X509_cmp_time(X509_get_notBefore(x), ptime) < 0
+        && X509_cmp_time(X509_get_notAfter(x), ptime) > 0;
+}
+
+/*
+ * Look up a cached chain for |key| and run every check except the signature
+ * verification against it. Returns 1 with ctx->chain set if they all pass,
+ * 0 with |ctx| reset to its initial state otherwise.
+ */
+static int verify_cache_lookup(X509_STORE_CTX *ctx, const unsigned char *key)
+{
+    X509_VERIFY_CACHE *c;
+    X509_VERIFY_CACHE_ENTRY tmp, *e;
+    STACK_OF(X509) *chain = NULL;
+    int i;
+
+    memcpy(tmp.key, key, sizeof(tmp.key));
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+    c = ctx->ctx->verify_cache;
+    if (c != NULL
+        && (e = lh_X509_VERIFY_CACHE_ENTRY_retrieve(c->entries,
+                                                    &tmp)) != NULL
+        && e->expires >= time(NULL)
+        && (chain = X509_chain_up_ref(e->chain)) != NULL) {
+        ctx->last_untrusted = e->last_untrusted;
+        /* Every thread that stores to |used| stores 1 */
+        e->used = 1;
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+    if (chain == NULL)
+        return 0;
+
+    /* Unless it was replaced by a trusted copy, use the caller's leaf */
+    if (ctx->last_untrusted > 0) {
+        X509_free(sk_X509_value(chain, 0));
+        (void)sk_X509_set(chain, 0, ctx->cert);
+        CRYPTO_add(&ctx->cert->references, 1, CRYPTO_LOCK_X509);
+    }
+    ctx->chain = chain;
+
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        if (!verify_cache_check_time(ctx, sk_X509_value(chain, i)))
+            goto miss;
+    }
+    if (check_trust(ctx) != X509_TRUST_TRUSTED
+        || !check_chain_extensions(ctx)
+        || !check_name_constraints(ctx)
+        || !check_id(ctx))
+        goto miss;
+    X509_get_pubkey_parameters(NULL, ctx->chain);
+    if (!ctx->check_revocation(ctx))
+        goto miss;
+    if (X509_chain_check_suiteb(NULL, NULL, ctx->chain,
+                                ctx->param->flags) != X509_V_OK)
+        goto miss;
+#ifndef OPENSSL_NO_RFC3779
+    if (!v3_asid_validate_path(ctx) || !v3_addr_validate_path(ctx))
+        goto miss;
+#endif
+
+    CRYPTO_add(&ctx->ctx->verify_cache_hits, 1, CRYPTO_LOCK_X509_STORE);
+    ctx->error = X509_V_OK;
+    ctx->error_depth = 0;
+    ctx->current_cert = NULL;
+    return 1;
+
+ miss:
+    sk_X509_pop_free(ctx->chain, X509_free);
+    ctx->chain = NULL;
+    ctx->last_untrusted = 0;
+    ctx->error = X509_V_OK;
+    ctx->error_depth = 0;
+    ctx->current_cert = NULL;
+    ctx->current_issuer = NULL;
+    ctx->current_crl = NULL;
+    ctx->current_crl_score = 0;
+    ctx->current_reasons = 0;
+    return 0;
+}
+
+/* Remember the chain of a successful verification under |key| */
+static void verify_cache_add(X509_STORE_CTX *ctx, const unsigned char *key)
+{
+    X509_VERIFY_CACHE *c;
+    X509_VERIFY_CACHE_ENTRY *e, *old = NULL;
+
+    /* Failure to add the entry only costs a full verification next time */
+    e = OPENSSL_malloc(sizeof(*e));
+    if (e == NULL)
+        return;
+    if ((e->chain = X509_chain_up_ref(ctx->chain)) == NULL) {
+        OPENSSL_free(e);
+        return;
+    }
+    memcpy(e->key, key, sizeof(e->key));
+    e->last_untrusted = ctx->last_untrusted;
+    e->used = 0;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+    c = ctx->ctx->verify_cache;
+    /* An expired entry under the same key is replaced */
+    if (c != NULL
+        && (old = lh_X509_VERIFY_CACHE_ENTRY_retrieve(c->entries, e)) != NULL
+        && old->expires < time(NULL)) {
+        verify_cache_remove(c, old);
+        old = NULL;
+    }
+    if (c != NULL && old == NULL) {
+        e->expires = time(NULL) + c->ttl;
+        (void)lh_X509_VERIFY_CACHE_ENTRY_insert(c->entries, e);
+        if (!lh_X509_VERIFY_CACHE_ENTRY_error(c->entries)) {
+            verify_cache_link_head(c, e);
+            verify_cache_trim(c, c->max);
+            e = NULL;
+        }
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+    if (e != NULL) {
+        sk_X509_pop_free(e->chain, X509_free);
+        OPENSSL_free(e);
+    }
+}
+
 int X509_verify_cert(X509_STORE_CTX *ctx)
 {
     X509 *x, *xtmp, *xtmp2, *chain_ss = NULL;
@@ -198,6 +567,8 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
     STACK_OF(X509) *sktmp = NULL;
     int trust = X509_TRUST_UNTRUSTED;
     int err;
+    unsigned char cache_key[SHA256_DIGEST_LENGTH];
+    int use_cache = 0;
 
     if (ctx->cert == NULL) {
         X509err(X509_F_X509_VERIFY_CERT, X509_R_NO_CERT_SET_FOR_US_TO_VERIFY);
@@ -214,6 +585,12 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
         return -1;
     }
 
+    if (verify_cache_usable(ctx) && verify_cache_key(ctx, cache_key)) {
+        if (verify_cache_lookup(ctx, cache_key))
+            return 1;
+        use_cache = 1;
+    }
+
     cb = ctx->verify_cb;
 
     /*
@@ -518,6 +895,8 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
         ok = ctx->check_policy(ctx);
     if (!ok)
         goto err;
+    if (use_cache && !bad_chain)
+        verify_cache_add(ctx, cache_key);
     if (0) {
  err:
         /* Ensure we return an error */
@@ -1730,7 +2109,7 @@ static int check_crl(X509_STORE_CTX *ctx, X509_CRL *crl)
 /* Check certificate against CRL */
 static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x)
 {
-    int ok;
+    int ok, found;
     X509_REVOKED *rev;
     /*
      * The rules changed for this... previously if a CRL contained unhandled
@@ -1749,7 +2128,12 @@ static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x)
      * Look for serial number of certificate in CRL If found make sure reason
      * is not removeFromCRL.
      */
-    if (X509_CRL_get0_by_cert(crl, &rev, x)) {
+    found = X509_CRL_get0_by_cert(crl, &rev, x);
+    if (found < 0) {
+        ctx->error = X509_V_ERR_OUT_OF_MEM;
+        return 0;
+    }
+    if (found) {
         if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
             return 2;
         ctx->error = X509_V_ERR_CERT_REVOKED;
@@ -1864,6 +2248,232 @@ static int check_cert_time(X509_STORE_CTX *ctx, X509 *x)
     return 1;
 }
 
+/*
+ * Signature cache. With X509_STORE_set_sig_cache() the signatures found
+ * good by internal_verify() are remembered in a fixed size table, keyed by
+ * the SHA-256 of the issuer's SubjectPublicKeyInfo and the SHA-256 of the
+ * whole subject certificate, which covers the signed data, the signature
+ * algorithm and the signature itself. A certificate seen again with the
+ * same issuer key then costs two digests and a table lookup instead of a
+ * public key operation. Each key digest picks one slot, a new entry simply
+ * replaces whatever was there. DSA keys are not cached since they may
+ * inherit parameters from further up the chain. Lookups only take the
+ * store lock for reading; the hit and miss counters live in the X509_STORE
+ * and are updated with CRYPTO_add().
+ */
+
+typedef struct {
+    unsigned char key[2 * SHA256_DIGEST_LENGTH];
+    int used;
+} X509_SIG_CACHE_SLOT;
+
+typedef struct x509_sig_cache_st {
+    X509_SIG_CACHE_SLOT *slots;
+    unsigned long num_slots;
+    unsigned long num;
+} X509_SIG_CACHE;
+
+/* Remember up to |num| verified signatures, zero disables the cache */
+int X509_STORE_set_sig_cache(X509_STORE *ctx, long num)
+{
+    X509_SIG_CACHE *c = NULL, *old;
+
+    if (num < 0)
+        return 0;
+
+    if (num > 0) {
+        c = OPENSSL_malloc(sizeof(*c));
+        if (c == NULL
+            || (c->slots = OPENSSL_malloc(num * sizeof(*c->slots))) == NULL) {
+            OPENSSL_free(c);
+            X509err(X509_F_X509_STORE_SET_SIG_CACHE, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        memset(c->slots, 0, num * sizeof(*c->slots));
+        c->num_slots = num;
+        c->num = 0;
+    }
+
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+    old = ctx->sig_cache;
+    ctx->sig_cache = c;
+    ctx->sig_cache_hits = ctx->sig_cache_misses = 0;
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+    if (old != NULL) {
+        OPENSSL_free(old->slots);
+        OPENSSL_free(old);
+    }
+    return 1;
+}
+
+void X509_STORE_get_sig_cache_stats(X509_STORE *ctx, unsigned long *num,
+                                    unsigned long *hits,
+                                    unsigned long *misses)
+{
+    X509_SIG_CACHE *c;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+    c = ctx->sig_cache;
+    if (num != NULL)
+        *num = c != NULL ? c->num : 0;
+    if (hits != NULL)
+        *hits = c != NULL ? ctx->sig_cache_hits : 0;
+    if (misses != NULL)
+        *misses = c != NULL ? ctx->sig_cache_misses : 0;
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+}
+
+/*
+ * Return a new store with the certificates, CRLs, lookup methods, callbacks,
+ * verification parameters and cache sizes of |store|, but none of its cached
+ * results. Lookup methods with state of their own copy it on X509_L_COPY,
+ * the copy fails for those that do not support it.
+ */
+X509_STORE *X509_STORE_dup(X509_STORE *store)
+{
+    X509_STORE *ret;
+    STACK_OF(X509_OBJECT) *objs;
+    X509_OBJECT *obj;
+    X509_LOOKUP *lu, *nlu;
+    unsigned long verify_num = 0, sig_num = 0;
+    long verify_ttl = 0;
+    int i, ok = 1;
+
+    if ((ret = X509_STORE_new()) == NULL)
+        goto merr;
+    ret->cache = store->cache;
+    ret->verify = store->verify;
+    ret->verify_cb = store->verify_cb;
+    ret->get_issuer = store->get_issuer;
+    ret->check_issued = store->check_issued;
+    ret->check_revocation = store->check_revocation;
+    ret->get_crl = store->get_crl;
+    ret->check_crl = store->check_crl;
+    ret->cert_crl = store->cert_crl;
+    ret->lookup_certs = store->lookup_certs;
+    ret->lookup_crls = store->lookup_crls;
+    ret->cleanup = store->cleanup;
+    if (!X509_STORE_set1_param(ret, store->param)
+        || !CRYPTO_dup_ex_data(CRYPTO_EX_INDEX_X509_STORE, &ret->ex_data,
+                               &store->ex_data))
+        goto merr;
+
+    /* Adding takes the store lock, so work from a snapshot */
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+    if (store->verify_cache != NULL) {
+        verify_num = store->verify_cache->max;
+        verify_ttl = store->verify_cache->ttl;
+    }
+    if (store->sig_cache != NULL)
+        sig_num = store->sig_cache->num_slots;
+    objs = sk_X509_OBJECT_dup(store->objs);
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++)
+        X509_OBJECT_up_ref_count(sk_X509_OBJECT_value(objs, i));
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+    if (objs == NULL)
+        goto merr;
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        obj = sk_X509_OBJECT_value(objs, i);
+        if (ok && obj->type == X509_LU_X509)
+            ok = X509_STORE_add_cert(ret, obj->data.x509);
+        else if (ok && obj->type == X509_LU_CRL)
+            ok = X509_STORE_add_crl(ret, obj->data.crl);
+        X509_OBJECT_free_contents(obj);
+    }
+    sk_X509_OBJECT_free(objs);
+    if (!ok)
+        goto err;
+
+    if ((verify_num > 0
+         && !X509_STORE_set_verify_cache(ret, (long)verify_num, verify_ttl))
+        || (sig_num > 0 && !X509_STORE_set_sig_cache(ret, (long)sig_num)))
+        goto err;
+
+    for (i = 0; i < sk_X509_LOOKUP_num(store->get_cert_methods); i++) {
+        lu = sk_X509_LOOKUP_value(store->get_cert_methods, i);
+        if ((nlu = X509_STORE_add_lookup(ret, lu->method)) == NULL)
+            goto merr;
+        if (X509_LOOKUP_ctrl(nlu, X509_L_COPY, (const char *)lu, 0,
+                             NULL) <= 0) {
+            X509err(X509_F_X509_STORE_DUP, X509_R_METHOD_NOT_SUPPORTED);
+            goto err;
+        }
+    }
+    return ret;
+ merr:
+    X509err(X509_F_X509_STORE_DUP, ERR_R_MALLOC_FAILURE);
+ err:
+    X509_STORE_free(ret);
+    return NULL;
+}
+
+static X509_SIG_CACHE_SLOT *sig_cache_slot(X509_SIG_CACHE *c,
+                                           const unsigned char *key)
+{
+    const unsigned char *p = key + SHA256_DIGEST_LENGTH;
+    unsigned long h;
+
+    h = ((unsigned long)(key[0] ^ p[0])) |
+        ((unsigned long)(key[1] ^ p[1]) << 8) |
+        ((unsigned long)(key[2] ^ p[2]) << 16) |
+        ((unsigned long)(key[3] ^ p[3]) << 24);
+    return &c->slots[h % c->num_slots];
+}
+
+/* Verify the signature on |xs| with |pkey|, the key of |xi| */
+static int sig_cache_verify(X509_STORE_CTX *ctx, X509 *xs, X509 *xi,
+                            EVP_PKEY *pkey)
+{
+#ifndef OPENSSL_NO_SHA256
+    unsigned char key[2 * SHA256_DIGEST_LENGTH];
+    unsigned int len;
+    X509_SIG_CACHE *c;
+    X509_SIG_CACHE_SLOT *slot;
+    int ret, hit = -1;
+
+    if (ctx->ctx == NULL || ctx->ctx->sig_cache == NULL
+        || EVP_PKEY_base_id(pkey) == EVP_PKEY_DSA
+        || !ASN1_item_digest(ASN1_ITEM_rptr(X509_PUBKEY), EVP_sha256(),
+                             X509_get_X509_PUBKEY(xi), key, &len)
+        || !X509_digest(xs, EVP_sha256(), key + SHA256_DIGEST_LENGTH, NULL))
+        return X509_verify(xs, pkey);
+
+    CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+    c = ctx->ctx->sig_cache;
+    if (c != NULL) {
+        slot = sig_cache_slot(c, key);
+        hit = slot->used && memcmp(slot->key, key, sizeof(key)) == 0;
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+    if (hit == 1) {
+        CRYPTO_add(&ctx->ctx->sig_cache_hits, 1, CRYPTO_LOCK_X509_STORE);
+        return 1;
+    }
+    if (hit == 0)
+        CRYPTO_add(&ctx->ctx->sig_cache_misses, 1, CRYPTO_LOCK_X509_STORE);
+
+    ret = X509_verify(xs, pkey);
+    if (ret <= 0)
+        return ret;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+    c = ctx->ctx->sig_cache;
+    if (c != NULL) {
+        slot = sig_cache_slot(c, key);
+        if (!slot->used) {
+            slot->used = 1;
+            c->num++;
+        }
+        memcpy(slot->key, key, sizeof(key));
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+    return ret;
+#else
+    return X509_verify(xs, pkey);
+#endif
+}
+
 static int internal_verify(X509_STORE_CTX *ctx)
 {
     int ok = 0, n;
@@ -1915,7 +2525,7 @@ static int internal_verify(X509_STORE_CTX *ctx)
                 ok = (*cb) (0, ctx);
                 if (!ok)
                     goto end;
-            } else if (X509_verify(xs, pkey) <= 0) {
+            } else if (sig_cache_verify(ctx, xs, xi, pkey) <= 0) {
                 ctx->error = X509_V_ERR_CERT_SIGNATURE_FAILURE;
                 ctx->current_cert = xs;
                 ok = (*cb) (0, ctx);
@@ -2172,12 +2782,16 @@ X509_CRL *X509_CRL_diff(X509_CRL *base, X509_CRL *newer,
 
     for (i = 0; i < sk_X509_REVOKED_num(revs); i++) {
         X509_REVOKED *rvn, *rvtmp;
+        int found;
         rvn = sk_X509_REVOKED_value(revs, i);
         /*
          * Add only if not also in base. TODO: need something cleverer here
          * for some more complex CRLs covering multiple CAs.
          */
-        if (!X509_CRL_get0_by_serial(base, &rvtmp, rvn->serialNumber)) {
+        found = X509_CRL_get0_by_serial(base, &rvtmp, rvn->serialNumber);
+        if (found < 0)
+            goto memerr;
+        if (!found) {
             rvtmp = X509_REVOKED_dup(rvn);
             if (!rvtmp)
                 goto memerr;
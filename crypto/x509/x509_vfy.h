@@ -212,6 +212,15 @@ struct x509_store_st {
     int (*cleanup) (X509_STORE_CTX *ctx);
     CRYPTO_EX_DATA ex_data;
     int references;
+    /* Results of earlier verifications, see X509_STORE_set_verify_cache() */
+    struct x509_verify_cache_st *verify_cache;
+    /* Verification cache hits, counted with CRYPTO_add() */
+    int verify_cache_hits;
+    /* Signatures already verified, see X509_STORE_set_sig_cache() */
+    struct x509_sig_cache_st *sig_cache;
+    /* Signature cache statistics, counted with CRYPTO_add() */
+    int sig_cache_hits;
+    int sig_cache_misses;
 } /* X509_STORE */ ;
 
 int X509_STORE_set_depth(X509_STORE *store, int depth);
@@ -305,6 +314,9 @@ void X509_STORE_CTX_set_depth(X509_STORE_CTX *ctx, int depth);
 
 # define X509_L_FILE_LOAD        1
 # define X509_L_ADD_DIR          2
+# define X509_L_MMAP_LOAD        3
+/* Copy the state of the X509_LOOKUP passed as argp, see X509_STORE_dup() */
+# define X509_L_COPY             4
 
 # define X509_LOOKUP_load_file(x,name,type) \
                 X509_LOOKUP_ctrl((x),X509_L_FILE_LOAD,(name),(long)(type),NULL)
@@ -312,6 +324,9 @@ void X509_STORE_CTX_set_depth(X509_STORE_CTX *ctx, int depth);
 # define X509_LOOKUP_add_dir(x,name,type) \
                 X509_LOOKUP_ctrl((x),X509_L_ADD_DIR,(name),(long)(type),NULL)
 
+# define X509_LOOKUP_load_mmap(x,name) \
+                X509_LOOKUP_ctrl((x),X509_L_MMAP_LOAD,(name),0,NULL)
+
 # define         X509_V_OK                                       0
 # define         X509_V_ERR_UNSPECIFIED                          1
 
@@ -467,6 +482,7 @@ void X509_OBJECT_up_ref_count(X509_OBJECT *a);
 void X509_OBJECT_free_contents(X509_OBJECT *a);
 X509_STORE *X509_STORE_new(void);
 void X509_STORE_free(X509_STORE *v);
+X509_STORE *X509_STORE_dup(X509_STORE *store);
 
 STACK_OF(X509) *X509_STORE_get1_certs(X509_STORE_CTX *st, X509_NAME *nm);
 STACK_OF(X509_CRL) *X509_STORE_get1_crls(X509_STORE_CTX *st, X509_NAME *nm);
@@ -474,6 +490,12 @@ int X509_STORE_set_flags(X509_STORE *ctx, unsigned long flags);
 int X509_STORE_set_purpose(X509_STORE *ctx, int purpose);
 int X509_STORE_set_trust(X509_STORE *ctx, int trust);
 int X509_STORE_set1_param(X509_STORE *ctx, X509_VERIFY_PARAM *pm);
+int X509_STORE_set_verify_cache(X509_STORE *ctx, long num, long ttl);
+unsigned long X509_STORE_get_verify_cache_hits(X509_STORE *ctx);
+int X509_STORE_set_sig_cache(X509_STORE *ctx, long num);
+void X509_STORE_get_sig_cache_stats(X509_STORE *ctx, unsigned long *num,
+                                    unsigned long *hits,
+                                    unsigned long *misses);
 
 void X509_STORE_set_verify_cb(X509_STORE *ctx,
                               int (*verify_cb) (int, X509_STORE_CTX *));
@@ -499,9 +521,12 @@ X509_LOOKUP *X509_STORE_add_lookup(X509_STORE *v, X509_LOOKUP_METHOD *m);
 
 X509_LOOKUP_METHOD *X509_LOOKUP_hash_dir(void);
 X509_LOOKUP_METHOD *X509_LOOKUP_file(void);
+X509_LOOKUP_METHOD *X509_LOOKUP_mmap(void);
+int X509_mmap_store_write(BIO *out, STACK_OF(X509) *certs);
 
 int X509_STORE_add_cert(X509_STORE *ctx, X509 *x);
 int X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x);
+int X509_STORE_replace_crl(X509_STORE *ctx, X509_CRL *x);
 
 int X509_STORE_get_by_subject(X509_STORE_CTX *vs, int type, X509_NAME *name,
                               X509_OBJECT *ret);
@@ -63,6 +63,7 @@
 #include <openssl/objects.h>
 #include <openssl/evp.h>
 #include <openssl/x509.h>
+#include "asn1_locl.h"
 
 int X509_CRL_set_version(X509_CRL *x, long version)
 {
@@ -123,6 +124,8 @@ int X509_CRL_sort(X509_CRL *c)
     /*
      * sort the data so it will be written in serial number order
      */
+    if (!x509_crl_uncompact(c))
+        return 0;
     sk_X509_REVOKED_sort(c->crl->revoked);
     for (i = 0; i < sk_X509_REVOKED_num(c->crl->revoked); i++) {
         r = sk_X509_REVOKED_value(c->crl->revoked, i);
@@ -410,10 +410,13 @@ static int nc_match_single(GENERAL_NAME *gen, GENERAL_NAME *base)
 
 static int nc_dn(X509_NAME *nm, X509_NAME *base)
 {
-    /* Ensure canonical encodings are up to date.  */
-    if (nm->modified && i2d_X509_NAME(nm, NULL) < 0)
+    /*
+     * Ensure canonical encodings are up to date. i2d checks for a pending
+     * encoding under a lock.
+     */
+    if (i2d_X509_NAME(nm, NULL) < 0)
         return X509_V_ERR_OUT_OF_MEM;
-    if (base->modified && i2d_X509_NAME(base, NULL) < 0)
+    if (i2d_X509_NAME(base, NULL) < 0)
         return X509_V_ERR_OUT_OF_MEM;
     if (base->canon_enclen > nm->canon_enclen)
         return X509_V_ERR_PERMITTED_VIOLATION;
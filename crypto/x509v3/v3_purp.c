@@ -119,6 +119,31 @@ static int xp_cmp(const X509_PURPOSE *const *a, const X509_PURPOSE *const *b)
     return (*a)->purpose - (*b)->purpose;
 }
 
+#ifndef OPENSSL_NO_SHA
+/*
+ * The SHA1 hash of the certificate is only needed to compare or identify
+ * certificates, so it is computed on first use rather than along with the
+ * extensions.
+ */
+const unsigned char *X509_get0_sha1_hash(X509 *x)
+{
+    int done;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_X509);
+    done = x->ex_flags & EXFLAG_SHA1;
+    CRYPTO_r_unlock(CRYPTO_LOCK_X509);
+    if (!done) {
+        CRYPTO_w_lock(CRYPTO_LOCK_X509);
+        if (!(x->ex_flags & EXFLAG_SHA1)) {
+            X509_digest(x, EVP_sha1(), x->sha1_hash, NULL);
+            x->ex_flags |= EXFLAG_SHA1;
+        }
+        CRYPTO_w_unlock(CRYPTO_LOCK_X509);
+    }
+    return x->sha1_hash;
+}
+#endif
+
 /*
  * As much as I'd like to make X509_check_purpose use a "const" X509* I
  * really can't because it does recalculate hashes and do other non-const
@@ -131,9 +156,16 @@ int X509_check_purpose(X509 *x, int id, int ca)
 
     x509v3_cache_extensions(x);
 
-    /* Return if side-effect only call */
-    if (id == -1)
+    /*
+     * Return if side-effect only call. Callers have long relied on this to
+     * fill in x->sha1_hash, so do it here even though it is otherwise lazy.
+     */
+    if (id == -1) {
+#ifndef OPENSSL_NO_SHA
+        X509_get0_sha1_hash(x);
+#endif
         return 1;
+    }
     idx = X509_PURPOSE_get_by_id(id);
     if (idx == -1)
         return -1;
@@ -404,9 +436,6 @@ static void x509v3_cache_extensions(X509 *x)
         return;
     }
 
-#ifndef OPENSSL_NO_SHA
-    X509_digest(x, EVP_sha1(), x->sha1_hash, NULL);
-#endif
     /* V1 should mean no extensions ... */
     if (!X509_get_version(x))
         x->ex_flags |= EXFLAG_V1;
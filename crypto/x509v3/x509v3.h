@@ -422,6 +422,8 @@ struct ISSUING_DIST_POINT_st {
 # define EXFLAG_FRESHEST         0x1000
 /* Self signed */
 # define EXFLAG_SS               0x2000
+/* sha1_hash is valid */
+# define EXFLAG_SHA1             0x4000
 
 # define KU_DIGITAL_SIGNATURE    0x0080
 # define KU_NON_REPUDIATION      0x0040
@@ -696,6 +698,9 @@ int X509V3_extensions_print(BIO *out, char *title,
 
 int X509_check_ca(X509 *x);
 int X509_check_purpose(X509 *x, int id, int ca);
+# ifndef OPENSSL_NO_SHA
+const unsigned char *X509_get0_sha1_hash(X509 *x);
+# endif
 int X509_supported_extension(X509_EXTENSION *ex);
 int X509_PURPOSE_set(int *p, int purpose);
 int X509_check_issued(X509 *issuer, X509 *subject);
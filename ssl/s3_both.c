@@ -585,7 +585,7 @@ int ssl_verify_alarm_type(long type)
     return (al);
 }
 
-#ifndef OPENSSL_NO_BUF_FREELISTS
+#if !defined(OPENSSL_NO_BUF_FREELISTS) && !defined(SSL3_BUF_CACHE)
 /*-
  * On some platforms, malloc() performance is bad enough that you can't just
  * free() and malloc() buffers all the time, so we need to use freelists from
@@ -650,7 +650,154 @@ static void freelist_insert(SSL_CTX *ctx, int for_read, size_t sz, void *mem)
     if (mem)
         OPENSSL_free(mem);
 }
-#else
+#endif
+
+#ifdef SSL3_BUF_CACHE
+/*
+ * With SSL3_BUF_CACHE, released record buffers are kept instead in small
+ * per-thread caches, or magazines, of up to BUF_CACHE_DEPTH buffers of any
+ * size, so that with SSL_MODE_RELEASE_BUFFERS getting a buffer back costs a
+ * search of a few entries rather than CRYPTO_LOCK_SSL_CTX and malloc().
+ *
+ * A thread finds its magazine by hashing its CRYPTO_THREADID into a table.
+ * Each magazine has a lock word of its own, which in practice only its
+ * thread takes, so threads do not contend. A thread that has no magazine
+ * among the BUF_CACHE_PROBES it may use takes over a free one or the least
+ * recently used one, after freeing what it held: this is how the magazines
+ * of threads that have exited are reclaimed.
+ *
+ * The freelist_max_len of the context a buffer is released from bounds how
+ * many buffers its connections leave in a magazine. The size of the table
+ * bounds the total: at most BUF_CACHE_THREADS * BUF_CACHE_DEPTH buffers, or
+ * some 5MB with the default buffer sizes. Everything is freed when the last
+ * SSL_CTX is.
+ */
+# define BUF_CACHE_THREADS       64
+# define BUF_CACHE_PROBES        4
+# define BUF_CACHE_DEPTH         4
+
+typedef struct {
+    volatile int lock;
+    int owned;
+    CRYPTO_THREADID tid;
+    time_t used;                /* last time a buffer was cached */
+    int num;
+    size_t len[BUF_CACHE_DEPTH];
+    void *buf[BUF_CACHE_DEPTH];
+} __attribute__ ((aligned(64))) BUF_CACHE_MAG;
+
+static BUF_CACHE_MAG buf_cache[BUF_CACHE_THREADS];
+static volatile int buf_cache_ctxs = 0;
+
+static void buf_cache_drain(BUF_CACHE_MAG *m)
+{
+    while (m->num > 0)
+        OPENSSL_free(m->buf[--m->num]);
+}
+
+/*
+ * Return the magazine of the calling thread, locked, or NULL if it has
+ * none and |claim| is zero or the one it would take over is busy.
+ */
+static BUF_CACHE_MAG *buf_cache_lock(int claim)
+{
+    CRYPTO_THREADID tid;
+    BUF_CACHE_MAG *m, *victim = NULL;
+    unsigned long h;
+    int i;
+
+    CRYPTO_THREADID_current(&tid);
+    /* Thread ids are often aligned addresses: mix in the high bits */
+    h = CRYPTO_THREADID_hash(&tid);
+    h = (h ^ (h >> 16)) * 2654435761UL;
+    h ^= h >> 16;
+    for (i = 0; i < BUF_CACHE_PROBES; i++) {
+        m = &buf_cache[(h + i) % BUF_CACHE_THREADS];
+        /* Owner and id are only hints until the lock is held */
+        if (m->owned && !CRYPTO_THREADID_cmp(&m->tid, &tid)
+            && __sync_bool_compare_and_swap(&m->lock, 0, 1)) {
+            if (m->owned && !CRYPTO_THREADID_cmp(&m->tid, &tid))
+                return m;
+            __sync_lock_release(&m->lock);
+        }
+        if (victim == NULL || (victim->owned
+                               && (!m->owned || m->used < victim->used)))
+            victim = m;
+    }
+    if (!claim || !__sync_bool_compare_and_swap(&victim->lock, 0, 1))
+        return NULL;
+    buf_cache_drain(victim);
+    victim->owned = 1;
+    CRYPTO_THREADID_cpy(&victim->tid, &tid);
+    return victim;
+}
+
+static void *freelist_extract(SSL_CTX *ctx, int for_read, int sz)
+{
+    BUF_CACHE_MAG *m;
+    void *result = NULL;
+    int i;
+
+    if ((m = buf_cache_lock(0)) != NULL) {
+        for (i = m->num - 1; i >= 0; i--) {
+            if (m->len[i] == (size_t)sz) {
+                result = m->buf[i];
+                m->num--;
+                m->len[i] = m->len[m->num];
+                m->buf[i] = m->buf[m->num];
+                break;
+            }
+        }
+        __sync_lock_release(&m->lock);
+    }
+    if (!result)
+        result = OPENSSL_malloc(sz);
+    return result;
+}
+
+static void freelist_insert(SSL_CTX *ctx, int for_read, size_t sz, void *mem)
+{
+    BUF_CACHE_MAG *m;
+    unsigned int max = ctx->freelist_max_len;
+
+    if (max > BUF_CACHE_DEPTH)
+        max = BUF_CACHE_DEPTH;
+    if (max > 0 && (m = buf_cache_lock(1)) != NULL) {
+        if (m->num < (int)max) {
+            m->len[m->num] = sz;
+            m->buf[m->num++] = mem;
+            m->used = time(NULL);
+            mem = NULL;
+        }
+        __sync_lock_release(&m->lock);
+    }
+    if (mem)
+        OPENSSL_free(mem);
+}
+
+void ssl3_buf_cache_ctx_new(void)
+{
+    __sync_fetch_and_add(&buf_cache_ctxs, 1);
+}
+
+void ssl3_buf_cache_ctx_free(void)
+{
+    BUF_CACHE_MAG *m;
+    int i;
+
+    if (__sync_sub_and_fetch(&buf_cache_ctxs, 1) > 0)
+        return;
+    for (i = 0; i < BUF_CACHE_THREADS; i++) {
+        m = &buf_cache[i];
+        while (!__sync_bool_compare_and_swap(&m->lock, 0, 1)) ;
+        buf_cache_drain(m);
+        m->owned = 0;
+        __sync_lock_release(&m->lock);
+    }
+}
+#endif
+
+#ifdef OPENSSL_NO_BUF_FREELISTS
 # define freelist_extract(c,fr,sz) OPENSSL_malloc(sz)
 # define freelist_insert(c,fr,sz,m) OPENSSL_free(m)
 #endif
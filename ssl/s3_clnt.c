@@ -625,6 +625,8 @@ int ssl3_connect(SSL *s)
             s->init_num = 0;
             s->renegotiate = 0;
             s->new_session = 0;
+            /* Dynamic record sizing starts again with small records */
+            s->s3->dyn_record_sent = 0;
 
             ssl_update_cache(s, SSL_SESS_CACHE_CLIENT);
             if (s->hit)
@@ -699,7 +701,8 @@ int ssl3_client_hello(SSL *s)
              */
             (!sess->session_id_length && !sess->tlsext_tick) ||
 #endif
-            (sess->not_resumable)) {
+            (sess->not_resumable) ||
+            !ssl_session_resolve_peer(sess, s->session_ctx)) {
             if (!ssl_get_new_session(s, 0))
                 goto err;
         }
@@ -1236,7 +1239,7 @@ int ssl3_get_server_certificate(SSL *s)
         }
 
         q = p;
-        x = d2i_X509(NULL, &q, l);
+        x = ssl_cert_cache_d2i(s->session_ctx, &q, l);
         if (x == NULL) {
             al = SSL_AD_BAD_CERTIFICATE;
             SSLerr(SSL_F_SSL3_GET_SERVER_CERTIFICATE, ERR_R_ASN1_LIB);
@@ -604,7 +604,8 @@ void ssl3_finish_mac(SSL *s, const unsigned char *buf, int len)
     if (s->s3->handshake_buffer
         && !(s->s3->flags & TLS1_FLAGS_KEEP_HANDSHAKE)) {
         BIO_write(s->s3->handshake_buffer, (void *)buf, len);
-    } else {
+    } else if (s->s3->handshake_dgst != NULL) {
+        /* NULL after SSL_compact(), until the next handshake starts */
         int i;
         for (i = 0; i < SSL_MAX_DIGEST; i++) {
             if (s->s3->handshake_dgst[i] != NULL)
@@ -4084,29 +4084,40 @@ int ssl3_put_cipher_by_char(const SSL_CIPHER *c, unsigned char *p)
     return (2);
 }
 
+/*
+ * Set |rank| to the preference order of the ciphers of |sk|, indexed by
+ * position in ssl3_ciphers: 1 for the first cipher of |sk|, 2 for the next
+ * and 0 for ciphers not in |sk|. |rank| has room for ssl3_num_ciphers().
+ */
+void ssl3_rank_ciphers(STACK_OF(SSL_CIPHER) *sk, unsigned short *rank)
+{
+    const SSL_CIPHER *c;
+    int i, r = 0;
+
+    memset(rank, 0, SSL3_NUM_CIPHERS * sizeof(*rank));
+    for (i = 0; i < sk_SSL_CIPHER_num(sk); i++) {
+        c = sk_SSL_CIPHER_value(sk, i);
+        /* Other ciphers, SSLv2 ones, can never be chosen here */
+        if (c < ssl3_ciphers || c >= ssl3_ciphers + SSL3_NUM_CIPHERS
+            || rank[c - ssl3_ciphers] != 0)
+            continue;
+        rank[c - ssl3_ciphers] = ++r;
+    }
+}
+
 SSL_CIPHER *ssl3_choose_cipher(SSL *s, STACK_OF(SSL_CIPHER) *clnt,
                                STACK_OF(SSL_CIPHER) *srvr)
 {
-    SSL_CIPHER *c, *ret = NULL;
-    STACK_OF(SSL_CIPHER) *prio, *allow;
-    int i, ii, ok;
+    SSL_CIPHER *c, *ret = NULL, *safari = NULL;
+    unsigned short rank[SSL3_NUM_CIPHERS];
+    int i, ok, r, srvr_pref, ranked, kl = 0, best = 0, best_safari = 0;
     CERT *cert;
-    unsigned long alg_k, alg_a, mask_k, mask_a, emask_k, emask_a;
+    unsigned long alg_k, alg_a;
+    unsigned long mask_k = 0, mask_a = 0, emask_k = 0, emask_a = 0;
 
     /* Let's see which ciphers we can support */
     cert = s->cert;
 
-#if 0
-    /*
-     * Do not set the compare functions, because this may lead to a
-     * reordering by "id". We want to keep the original ordering. We may pay
-     * a price in performance during sk_SSL_CIPHER_find(), but would have to
-     * pay with the price of sk_SSL_CIPHER_dup().
-     */
-    sk_SSL_CIPHER_set_cmp_func(srvr, ssl_cipher_ptr_id_cmp);
-    sk_SSL_CIPHER_set_cmp_func(clnt, ssl_cipher_ptr_id_cmp);
-#endif
-
 #ifdef CIPHER_DEBUG
     fprintf(stderr, "Server has %d from %p:\n", sk_SSL_CIPHER_num(srvr),
             (void *)srvr);
@@ -4122,43 +4133,59 @@ SSL_CIPHER *ssl3_choose_cipher(SSL *s, STACK_OF(SSL_CIPHER) *clnt,
     }
 #endif
 
-    if (s->options & SSL_OP_CIPHER_SERVER_PREFERENCE || tls1_suiteb(s)) {
-        prio = srvr;
-        allow = clnt;
-    } else {
-        prio = clnt;
-        allow = srvr;
-    }
+    srvr_pref = (s->options & SSL_OP_CIPHER_SERVER_PREFERENCE)
+        || tls1_suiteb(s);
+
+    /*
+     * The server's list is ranked once per SSL_CTX when it is set; only a
+     * list set on the SSL itself is ranked here. The ranks are copied under
+     * the lock they are replaced under, together with the list check.
+     */
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    ranked = srvr == s->ctx->cipher_list && s->ctx->cipher_rank != NULL;
+    if (ranked)
+        memcpy(rank, s->ctx->cipher_rank, sizeof(rank));
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (!ranked)
+        ssl3_rank_ciphers(srvr, rank);
 
     tls1_set_cert_validity(s);
 
-    for (i = 0; i < sk_SSL_CIPHER_num(prio); i++) {
-        c = sk_SSL_CIPHER_value(prio, i);
+    /*
+     * A single pass over the client's ciphers. With client preference the
+     * first usable one the server has is taken; with server preference the
+     * usable one the server ranks highest.
+     */
+    for (i = 0; i < sk_SSL_CIPHER_num(clnt); i++) {
+        c = sk_SSL_CIPHER_value(clnt, i);
+
+        if (c < ssl3_ciphers || c >= ssl3_ciphers + SSL3_NUM_CIPHERS)
+            continue;
+        r = rank[c - ssl3_ciphers];
+        if (r == 0 || (srvr_pref && ret != NULL && r >= best))
+            continue;
 
         /* Skip TLS v1.2 only ciphersuites if not supported */
         if ((c->algorithm_ssl & SSL_TLSV1_2) && !SSL_USE_TLS1_2_CIPHERS(s))
             continue;
 
-        ssl_set_cert_masks(cert, c);
-        mask_k = cert->mask_k;
-        mask_a = cert->mask_a;
-        emask_k = cert->export_mask_k;
-        emask_a = cert->export_mask_a;
+        /* The masks only depend on the cipher through the export key size */
+        if (SSL_C_EXPORT_PKEYLENGTH(c) != kl) {
+            kl = SSL_C_EXPORT_PKEYLENGTH(c);
+            ssl_set_cert_masks(cert, c);
+            mask_k = cert->mask_k;
+            mask_a = cert->mask_a;
+            emask_k = cert->export_mask_k;
+            emask_a = cert->export_mask_a;
 #ifndef OPENSSL_NO_SRP
-        if (s->srp_ctx.srp_Mask & SSL_kSRP) {
-            mask_k |= SSL_kSRP;
-            emask_k |= SSL_kSRP;
-            mask_a |= SSL_aSRP;
-            emask_a |= SSL_aSRP;
-        }
+            if (s->srp_ctx.srp_Mask & SSL_kSRP) {
+                mask_k |= SSL_kSRP;
+                emask_k |= SSL_kSRP;
+                mask_a |= SSL_aSRP;
+                emask_a |= SSL_aSRP;
+            }
 #endif
-
-#ifdef KSSL_DEBUG
-        /*
-         * fprintf(stderr,"ssl3_choose_cipher %d alg= %lx\n",
-         * i,c->algorithms);
-         */
-#endif                          /* KSSL_DEBUG */
+        }
 
         alg_k = c->algorithm_mkey;
         alg_a = c->algorithm_auth;
@@ -4204,21 +4231,23 @@ SSL_CIPHER *ssl3_choose_cipher(SSL *s, STACK_OF(SSL_CIPHER) *clnt,
 
         if (!ok)
             continue;
-        ii = sk_SSL_CIPHER_find(allow, c);
-        if (ii >= 0) {
 #if !defined(OPENSSL_NO_EC) && !defined(OPENSSL_NO_TLSEXT)
-            if ((alg_k & SSL_kEECDH) && (alg_a & SSL_aECDSA)
-                && s->s3->is_probably_safari) {
-                if (!ret)
-                    ret = sk_SSL_CIPHER_value(allow, ii);
-                continue;
+        /* Only fall back to ECDHE-ECDSA for Safari */
+        if ((alg_k & SSL_kEECDH) && (alg_a & SSL_aECDSA)
+            && s->s3->is_probably_safari) {
+            if (safari == NULL || (srvr_pref && r < best_safari)) {
+                safari = c;
+                best_safari = r;
             }
+            continue;
+        }
 #endif
-            ret = sk_SSL_CIPHER_value(allow, ii);
+        ret = c;
+        best = r;
+        if (!srvr_pref || best == 1)
             break;
-        }
     }
-    return (ret);
+    return (ret != NULL ? ret : safari);
 }
 
 int ssl3_get_req_cert_type(SSL *s, unsigned char *p)
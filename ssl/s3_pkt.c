@@ -135,6 +135,10 @@
 static int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                          unsigned int len, int create_empty_fragment);
 static int ssl3_get_record(SSL *s);
+#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+static void ssl3_setup_multi_block_read_buffer(SSL *s);
+static int ssl3_read_multi_block(SSL *s);
+#endif
 
 /*
  * Return values are as per SSL_read()
@@ -296,6 +300,136 @@ int ssl3_read_n(SSL *s, int n, int max, int extend)
  */
 #define MAX_EMPTY_RECORDS 32
 
+#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+# define SSL3_MB_READ_CAPABLE(s) \
+        ((s)->read_ahead && !SSL_IS_DTLS(s) && (s)->expand == NULL && \
+         (s)->enc_read_ctx != NULL && SSL_USE_EXPLICIT_IV(s) && \
+         EVP_CIPHER_flags((s)->enc_read_ctx->cipher) & \
+         EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK)
+
+/*
+ * Multi-block decryption needs several complete records in rbuf at once,
+ * so once it can be used replace regular read buffer with a jumbo one,
+ * much like ssl3_write_bytes does for multi-block encryption. Called only
+ * when rbuf holds no data.
+ */
+static void ssl3_setup_multi_block_read_buffer(SSL *s)
+{
+    SSL3_BUFFER *rb = &s->s3->rbuf;
+    unsigned char *p;
+    size_t len, align = 0;
+
+    if (!SSL3_MB_READ_CAPABLE(s))
+        return;
+
+# if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
+    align = (-SSL3_RT_HEADER_LENGTH) & (SSL3_ALIGN_PAYLOAD - 1);
+# endif
+    len = 4 * (SSL3_RT_HEADER_LENGTH + SSL3_RT_MAX_ENCRYPTED_LENGTH) + align;
+    if (rb->buf != NULL && rb->len >= len)
+        return;
+
+    /* stick to regular buffer if jumbo one can't be had */
+    if ((p = OPENSSL_malloc(len)) == NULL)
+        return;
+    ssl3_release_read_buffer(s);
+    rb->buf = p;
+    rb->len = len;
+    rb->offset = 0;
+    rb->left = 0;
+    s->packet = rb->buf;
+}
+
+/*
+ * Called with the header of an application data record in s->packet. If
+ * read-ahead has already buffered it along with at least three more
+ * complete application data records, and the cipher is capable, decrypt
+ * and verify them all in one go. Records stay in rbuf where they were and
+ * are then picked up one by one by ssl3_get_record.
+ * Returns 0 if the batch failed to verify and 1 otherwise, regardless of
+ * whether anything was done.
+ */
+static int ssl3_read_multi_block(SSL *s)
+{
+    SSL3_BUFFER *rb = &s->s3->rbuf;
+    EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM mb_param;
+    unsigned char aad[13], *p = s->packet;
+    size_t left = rb->left + SSL3_RT_HEADER_LENGTH, total, len, off;
+    size_t orig_len[8];
+    unsigned int n, i;
+    int ret;
+
+    if (!SSL3_MB_READ_CAPABLE(s))
+        return 1;
+
+    /* count complete application data records sitting in rbuf */
+    for (total = 0, n = 0; n < 8; n++) {
+        if (left - total < SSL3_RT_HEADER_LENGTH)
+            break;
+        len = p[total + 3] << 8 | p[total + 4];
+        if (p[total] != SSL3_RT_APPLICATION_DATA
+            || (p[total + 1] << 8 | p[total + 2]) != s->version
+            || len > SSL3_RT_MAX_ENCRYPTED_LENGTH
+            || len > left - total - SSL3_RT_HEADER_LENGTH)
+            break;
+        total += SSL3_RT_HEADER_LENGTH + len;
+    }
+    if (n < 4)
+        return 1;
+
+    memcpy(aad, s->s3->read_sequence, 8);
+    memcpy(aad + 8, p, SSL3_RT_HEADER_LENGTH);
+    mb_param.out = NULL;
+    mb_param.inp = aad;
+    mb_param.len = total;
+    mb_param.interleave = n;
+    if (EVP_CIPHER_CTX_ctrl(s->enc_read_ctx,
+                            EVP_CTRL_TLS1_1_MULTIBLOCK_AAD,
+                            sizeof(mb_param), &mb_param) <= 0)
+        return 1;
+
+    /* the cipher may take fewer records than offered */
+    for (total = 0, i = 0; i < mb_param.interleave; i++) {
+        orig_len[i] = p[total + 3] << 8 | p[total + 4];
+        total += SSL3_RT_HEADER_LENGTH + orig_len[i];
+    }
+
+    mb_param.out = p;
+    mb_param.inp = p;
+    mb_param.len = total;
+    ret = EVP_CIPHER_CTX_ctrl(s->enc_read_ctx,
+                              EVP_CTRL_TLS1_1_MULTIBLOCK_DECRYPT,
+                              sizeof(mb_param), &mb_param);
+    if (ret < 0)
+        return 1;               /* nothing was touched */
+    if (ret == 0)
+        return 0;
+
+    /*
+     * The cipher leaves payload lengths in record headers, put original
+     * lengths back so that records can be consumed as usual.
+     */
+    for (off = 0, i = 0; i < mb_param.interleave; i++) {
+        s->s3->mb_read_len[i] = p[off + 3] << 8 | p[off + 4];
+        p[off + 3] = (unsigned char)(orig_len[i] >> 8);
+        p[off + 4] = (unsigned char)(orig_len[i]);
+        off += SSL3_RT_HEADER_LENGTH + orig_len[i];
+    }
+    s->s3->mb_read_num = mb_param.interleave;
+    s->s3->mb_read_idx = 0;
+
+    /* ssl3_get_record won't call tls1_enc for these, so advance here */
+    for (p = s->s3->read_sequence + 7, i = mb_param.interleave;; p--) {
+        i += *p;
+        *p = (unsigned char)i;
+        if ((i >>= 8) == 0 || p == s->s3->read_sequence)
+            break;
+    }
+
+    return 1;
+}
+#endif
+
 /*-
  * Call this to get a new input record.
  * It will return <= 0 if more data is needed, normally due to an error
@@ -339,6 +473,10 @@ static int ssl3_get_record(SSL *s)
     /* check if we have the header */
     if ((s->rstate != SSL_ST_READ_BODY) ||
         (s->packet_length < SSL3_RT_HEADER_LENGTH)) {
+#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+        if (s->s3->rbuf.left == 0 && s->packet_length == 0)
+            ssl3_setup_multi_block_read_buffer(s);
+#endif
         n = ssl3_read_n(s, SSL3_RT_HEADER_LENGTH, s->s3->rbuf.len, 0);
         if (n <= 0)
             return (n);         /* error or non-blocking */
@@ -396,6 +534,16 @@ static int ssl3_get_record(SSL *s)
             goto f_err;
         }
 
+#if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+        if (s->s3->mb_read_num == 0 && rr->type == SSL3_RT_APPLICATION_DATA
+            && !ssl3_read_multi_block(s)) {
+            al = SSL_AD_BAD_RECORD_MAC;
+            SSLerr(SSL_F_SSL3_GET_RECORD,
+                   SSL_R_DECRYPTION_FAILED_OR_BAD_RECORD_MAC);
+            goto f_err;
+        }
+#endif
+
         /* now s->rstate == SSL_ST_READ_BODY */
     }
 
@@ -443,7 +591,16 @@ static int ssl3_get_record(SSL *s)
     /* decrypt in place in 'rr->input' */
     rr->data = rr->input;
 
-    enc_err = s->method->ssl3_enc->enc(s, 0);
+    if (s->s3->mb_read_num) {
+        /* decrypted and verified by ssl3_read_multi_block already */
+        rr->data += EVP_CIPHER_CTX_iv_length(s->enc_read_ctx);
+        rr->input = rr->data;
+        rr->length = s->s3->mb_read_len[s->s3->mb_read_idx++];
+        if (s->s3->mb_read_idx == s->s3->mb_read_num)
+            s->s3->mb_read_num = s->s3->mb_read_idx = 0;
+        enc_err = 1;
+    } else
+        enc_err = s->method->ssl3_enc->enc(s, 0);
     /*-
      * enc_err is:
      *    0: (in non-constant time) if the record is publically invalid.
@@ -631,6 +788,32 @@ int ssl3_do_compress(SSL *ssl)
     return (1);
 }
 
+/*
+ * Dynamic record sizing, see SSL_set_dynamic_record_sizing(): records stay
+ * small until dyn_record_ramp bytes of application data have been written
+ * since the handshake or since the connection was last idle, so that the
+ * peer can decrypt each of them as soon as one TCP segment arrives.
+ */
+static unsigned int ssl3_send_fragment(SSL *s)
+{
+    if (s->dyn_record_size != 0 && s->dyn_record_size < s->max_send_fragment
+        && s->s3->dyn_record_sent < s->dyn_record_ramp)
+        return s->dyn_record_size;
+    return s->max_send_fragment;
+}
+
+/* Count |num| application data records of |len| bytes */
+static void ssl3_record_written(SSL *s, unsigned int len, unsigned int num)
+{
+    int b = 0;
+
+    while (b < SSL_RECORD_SIZE_BUCKETS - 1 && len > (512U << b))
+        b++;
+    s->ctx->record_count[b] += num;
+    if (s->s3->dyn_record_sent < s->dyn_record_ramp)
+        s->s3->dyn_record_sent += (unsigned long)len * num;
+}
+
 /*
  * Call this to write data in records of type 'type' It will return <= 0 if
  * not all data has been sent or non-blocking IO.
@@ -645,6 +828,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 #endif
     SSL3_BUFFER *wb = &(s->s3->wbuf);
     int i;
+    unsigned long now;
 
     s->rwstate = SSL_NOTHING;
     OPENSSL_assert(s->s3->wnum <= INT_MAX);
@@ -688,6 +872,15 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
         }
         tot += i;               /* this might be last fragment */
     }
+
+    if (type == SSL3_RT_APPLICATION_DATA && s->dyn_record_size != 0
+        && s->dyn_record_idle > 0) {
+        now = (unsigned long)time(NULL);
+        /* An idle connection has to open its congestion window again */
+        if (now - s->s3->dyn_record_last >= (unsigned long)s->dyn_record_idle)
+            s->s3->dyn_record_sent = 0;
+        s->s3->dyn_record_last = now;
+    }
 #if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
     /*
      * Depending on platform multi-block can deliver several *times*
@@ -697,6 +890,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
      */
     if (type == SSL3_RT_APPLICATION_DATA &&
         len >= 4 * (int)(max_send_fragment = s->max_send_fragment) &&
+        ssl3_send_fragment(s) == max_send_fragment &&
         s->compress == NULL && s->msg_callback == NULL &&
         SSL_USE_EXPLICIT_IV(s) &&
         s->enc_write_ctx != NULL &&
@@ -784,6 +978,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
                                     sizeof(mb_param), &mb_param) <= 0)
                 return -1;
 
+            ssl3_record_written(s, max_send_fragment, mb_param.interleave);
             s->s3->write_sequence[7] += mb_param.interleave;
             if (s->s3->write_sequence[7] < mb_param.interleave) {
                 int j = 6;
@@ -826,9 +1021,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 
     n = (len - tot);
     for (;;) {
-        if (n > s->max_send_fragment)
-            nw = s->max_send_fragment;
-        else
+        nw = ssl3_send_fragment(s);
+        if (n < nw)
             nw = n;
 
         i = do_ssl3_write(s, type, &(buf[tot]), nw, 0);
@@ -1068,6 +1262,9 @@ static int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         return wr->length;
     }
 
+    if (type == SSL3_RT_APPLICATION_DATA)
+        ssl3_record_written(s, len, 1);
+
     /* now let's set up wb */
     wb->left = prefix_len + wr->length;
 
@@ -849,6 +849,8 @@ int ssl3_accept(SSL *s)
                                         * HelloRequest */
                 s->renegotiate = 0;
                 s->new_session = 0;
+                /* Dynamic record sizing starts again with small records */
+                s->s3->dyn_record_sent = 0;
 
                 ssl_update_cache(s, SSL_SESS_CACHE_SERVER);
 
@@ -3308,7 +3310,11 @@ int ssl3_get_client_certificate(SSL *s)
         }
 
         q = p;
-        x = d2i_X509(NULL, &p, l);
+        /*
+         * The session cache context, not the one SNI may switch to: that
+         * is where the certificate is looked up on resumption.
+         */
+        x = ssl_cert_cache_d2i(s->session_ctx, &p, l);
         if (x == NULL) {
             SSLerr(SSL_F_SSL3_GET_CLIENT_CERTIFICATE, ERR_R_ASN1_LIB);
             goto err;
@@ -3438,25 +3444,26 @@ int ssl3_send_newsession_ticket(SSL *s)
 
     if (s->state == SSL3_ST_SW_SESSION_TICKET_A) {
         unsigned char *p, *macstart;
-        const unsigned char *const_p;
-        int len, slen_full, slen;
-        SSL_SESSION *sess;
+        int len, slen;
         unsigned int hlen;
         SSL_CTX *tctx = s->initial_ctx;
         unsigned char iv[EVP_MAX_IV_LENGTH];
         unsigned char key_name[16];
 
-        /* get session encoding length */
-        slen_full = i2d_SSL_SESSION(s->session, NULL);
+        /*
+         * get session encoding length: the compact encoding, without the
+         * session ID which is irrelevant for the ticket
+         */
+        slen = ssl_session_to_bin(s->session, NULL, 1);
         /*
          * Some length values are 16 bits, so forget it if session is too
          * long
          */
-        if (slen_full == 0 || slen_full > 0xFF00) {
+        if (slen == 0 || slen > 0xFF00) {
             s->state = SSL_ST_ERR;
             return -1;
         }
-        senc = OPENSSL_malloc(slen_full);
+        senc = OPENSSL_malloc(slen);
         if (!senc) {
             s->state = SSL_ST_ERR;
             return -1;
@@ -3466,29 +3473,8 @@ int ssl3_send_newsession_ticket(SSL *s)
         HMAC_CTX_init(&hctx);
 
         p = senc;
-        if (!i2d_SSL_SESSION(s->session, &p))
-            goto err;
-
-        /*
-         * create a fresh copy (not shared with other threads) to clean up
-         */
-        const_p = senc;
-        sess = d2i_SSL_SESSION(NULL, &const_p, slen_full);
-        if (sess == NULL)
+        if (!ssl_session_to_bin(s->session, &p, 1))
             goto err;
-        sess->session_id_length = 0; /* ID is irrelevant for the ticket */
-
-        slen = i2d_SSL_SESSION(sess, NULL);
-        if (slen == 0 || slen > slen_full) { /* shouldn't ever happen */
-            SSL_SESSION_free(sess);
-            goto err;
-        }
-        p = senc;
-        if (!i2d_SSL_SESSION(sess, &p)) {
-            SSL_SESSION_free(sess);
-            goto err;
-        }
-        SSL_SESSION_free(sess);
 
         /*-
          * Grow buffer if need be: the length calculation is as
@@ -3506,7 +3492,8 @@ int ssl3_send_newsession_ticket(SSL *s)
         p = ssl_handshake_start(s);
         /*
          * Initialize HMAC and cipher contexts. If callback present it does
-         * all the work otherwise use generated values from parent ctx.
+         * all the work otherwise use the key ring or generated values from
+         * parent ctx.
          */
         if (tctx->tlsext_ticket_key_cb) {
             /* if 0 is returned, write en empty ticket */
@@ -3526,7 +3513,7 @@ int ssl3_send_newsession_ticket(SSL *s)
             }
             if (ret < 0)
                 goto err;
-        } else {
+        } else if (tctx->ticket_keys == NULL) {
             if (RAND_bytes(iv, 16) <= 0)
                 goto err;
             if (!EVP_EncryptInit_ex(&ctx, EVP_aes_128_cbc(), NULL,
@@ -3547,30 +3534,37 @@ int ssl3_send_newsession_ticket(SSL *s)
 
         /* Skip ticket length for now */
         p += 2;
-        /* Output key name */
-        macstart = p;
-        memcpy(p, key_name, 16);
-        p += 16;
-        /* output IV */
-        memcpy(p, iv, EVP_CIPHER_CTX_iv_length(&ctx));
-        p += EVP_CIPHER_CTX_iv_length(&ctx);
-        /* Encrypt session data */
-        if (!EVP_EncryptUpdate(&ctx, p, &len, senc, slen))
-            goto err;
-        p += len;
-        if (!EVP_EncryptFinal(&ctx, p, &len))
-            goto err;
-        p += len;
+        if (tctx->tlsext_ticket_key_cb == NULL && tctx->ticket_keys != NULL) {
+            /* Single pass AEAD under the key ring's current key */
+            if (!tls1_ticket_keys_encrypt(tctx, senc, slen, p, &len))
+                goto err;
+            p += len;
+        } else {
+            /* Output key name */
+            macstart = p;
+            memcpy(p, key_name, 16);
+            p += 16;
+            /* output IV */
+            memcpy(p, iv, EVP_CIPHER_CTX_iv_length(&ctx));
+            p += EVP_CIPHER_CTX_iv_length(&ctx);
+            /* Encrypt session data */
+            if (!EVP_EncryptUpdate(&ctx, p, &len, senc, slen))
+                goto err;
+            p += len;
+            if (!EVP_EncryptFinal(&ctx, p, &len))
+                goto err;
+            p += len;
 
-        if (!HMAC_Update(&hctx, macstart, p - macstart))
-            goto err;
-        if (!HMAC_Final(&hctx, p, &hlen))
-            goto err;
+            if (!HMAC_Update(&hctx, macstart, p - macstart))
+                goto err;
+            if (!HMAC_Final(&hctx, p, &hlen))
+                goto err;
+            p += hlen;
+        }
 
         EVP_CIPHER_CTX_cleanup(&ctx);
         HMAC_CTX_cleanup(&hctx);
 
-        p += hlen;
         /* Now write out lengths: p points to end of data written */
         /* Total length */
         len = p - ssl_handshake_start(s);
@@ -571,6 +571,15 @@ struct ssl_session_st {
 #  ifndef OPENSSL_NO_SRP
     char *srp_username;
 #  endif
+    /*
+     * Set if the compact encoding should hold |peer| by reference. A session
+     * decoded from such an encoding has no |peer| until it is looked up in
+     * the certificate cache by the SHA-256 digest and length of its encoding,
+     * kept in |peer_ref| and |peer_ref_len|.
+     */
+    int peer_by_ref;
+    unsigned char peer_ref[32];
+    long peer_ref_len;
 };
 
 # endif
@@ -713,6 +722,14 @@ struct ssl_session_st {
  * draft-ietf-tls-downgrade-scsv-00.
  */
 # define SSL_MODE_SEND_FALLBACK_SCSV 0x00000080L
+/*
+ * Keep only a digest of the peer certificate in the compact encoding of new
+ * sessions, which session tickets use. The certificate is found again in
+ * the SSL_CTX certificate cache (see SSL_CTX_set_cert_cache_size()) when
+ * the session is resumed, and a full handshake is done if it is not there.
+ * Has no effect without a certificate cache.
+ */
+# define SSL_MODE_PEER_CERT_BY_REFERENCE 0x00000100L
 
 /* Cert related flags */
 /*
@@ -887,6 +904,13 @@ int SRP_generate_client_master_secret(SSL *s, unsigned char *master_key);
 
 # define SSL_SESSION_CACHE_MAX_SIZE_DEFAULT      (1024*20)
 
+/*
+ * Application data records are counted in SSL_RECORD_SIZE_BUCKETS buckets
+ * by plaintext length: bucket 0 holds records of up to 512 bytes and each
+ * following one records of up to twice the size of the one before.
+ */
+# define SSL_RECORD_SIZE_BUCKETS                 6
+
 /*
  * This callback type is used inside SSL_CTX, SSL, and in the functions that
  * set them. It is used to override the generation of SSL/TLS session IDs in
@@ -1181,6 +1205,31 @@ struct ssl_ctx_st {
     unsigned char *tlsext_ellipticcurvelist;
 #   endif                       /* OPENSSL_NO_EC */
 #  endif
+
+    /* Parsed peer certificates shared between connections, may be NULL */
+    struct ssl_cert_cache_st *cert_cache;
+    /* Certificate cache hits, counted with CRYPTO_add() */
+    int cert_cache_hits;
+    /* Built-in OCSP stapling, may be NULL */
+    struct ssl_ocsp_stapling_st *ocsp_stapling;
+    /* Built-in session ticket key ring, may be NULL */
+    struct ssl_ticket_keys_st *ticket_keys;
+    /* Session cache shared between processes, may be NULL */
+    struct ssl_shm_cache_st *shm_cache;
+    /* Preference order of cipher_list, see ssl3_rank_ciphers() */
+    unsigned short *cipher_rank;
+    /* Server name to SSL_CTX map, not owned, may be NULL */
+    struct ssl_sni_map_st *sni_map;
+    /* Context this one was derived from, see SSL_CTX_new_from_template() */
+    struct ssl_ctx_st *tmpl;
+    /* Members shared with other contexts, SSL_CTX_SHARED_* in ssl_locl.h */
+    unsigned int shared;
+    /* See SSL_CTX_set_dynamic_record_sizing() */
+    unsigned int dyn_record_size;
+    unsigned long dyn_record_ramp;
+    long dyn_record_idle;
+    /* Application data records written, by SSL_CTX_record_count() bucket */
+    unsigned long record_count[SSL_RECORD_SIZE_BUCKETS];
 };
 
 # endif
@@ -1243,6 +1292,8 @@ void SSL_CTX_sess_set_get_cb(SSL_CTX *ctx,
 SSL_SESSION *(*SSL_CTX_sess_get_get_cb(SSL_CTX *ctx)) (struct ssl_st *ssl,
                                                        unsigned char *Data,
                                                        int len, int *copy);
+/* Keep server sessions in memory shared with processes forked later */
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, long num, long size);
 void SSL_CTX_set_info_callback(SSL_CTX *ctx,
                                void (*cb) (const SSL *ssl, int type,
                                            int val));
@@ -1685,6 +1736,10 @@ struct ssl_st {
     unsigned char *alpn_client_proto_list;
     unsigned alpn_client_proto_list_len;
 #  endif                        /* OPENSSL_NO_TLSEXT */
+    /* See SSL_set_dynamic_record_sizing() */
+    unsigned int dyn_record_size;
+    unsigned long dyn_record_ramp;
+    long dyn_record_idle;
 };
 
 # endif
@@ -1978,6 +2033,11 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 # define SSL_CTRL_CHECK_PROTO_VERSION            119
 # define DTLS_CTRL_SET_LINK_MTU                  120
 # define DTLS_CTRL_GET_LINK_MIN_MTU              121
+# define SSL_CTRL_SET_CERT_CACHE_SIZE            150
+# define SSL_CTRL_GET_CERT_CACHE_SIZE            151
+# define SSL_CTRL_CERT_CACHE_NUMBER              152
+# define SSL_CTRL_CERT_CACHE_HITS                153
+# define SSL_CTRL_RECORD_COUNT                   154
 # define SSL_CERT_SET_FIRST                      1
 # define SSL_CERT_SET_NEXT                       2
 # define SSL_CERT_SET_SERVER                     3
@@ -2129,11 +2189,13 @@ void BIO_ssl_shutdown(BIO *ssl_bio);
 
 int SSL_CTX_set_cipher_list(SSL_CTX *, const char *str);
 SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth);
+SSL_CTX *SSL_CTX_new_from_template(SSL_CTX *tmpl);
 void SSL_CTX_free(SSL_CTX *);
 long SSL_CTX_set_timeout(SSL_CTX *ctx, long t);
 long SSL_CTX_get_timeout(const SSL_CTX *ctx);
 X509_STORE *SSL_CTX_get_cert_store(const SSL_CTX *);
 void SSL_CTX_set_cert_store(SSL_CTX *, X509_STORE *);
+int SSL_CTX_unshare_cert_store(SSL_CTX *ctx);
 int SSL_want(const SSL *s);
 int SSL_clear(SSL *s);
 
@@ -2189,6 +2251,30 @@ int SSL_CTX_use_serverinfo(SSL_CTX *ctx, const unsigned char *serverinfo,
 int SSL_CTX_use_serverinfo_file(SSL_CTX *ctx, const char *file);
 #  endif                        /* NO_STDIO */
 
+#  if !defined(OPENSSL_NO_OCSP) && !defined(OPENSSL_NO_SOCK)
+/* Staple OCSP responses fetched and cached by the library */
+int SSL_CTX_set_ocsp_stapling(SSL_CTX *ctx, const char *url, long refresh);
+int SSL_CTX_update_ocsp_stapling(SSL_CTX *ctx);
+#  endif
+
+/* Seal session tickets with AES-GCM under a rotating ring of keys */
+int SSL_CTX_set_ticket_key_rotation(SSL_CTX *ctx, int num, long interval);
+int SSL_CTX_add_ticket_key(SSL_CTX *ctx, const unsigned char *name,
+                           const unsigned char *key, size_t keylen);
+int SSL_CTX_rotate_ticket_keys(SSL_CTX *ctx);
+
+/* Dispatch server names to SSL_CTXs, optionally loading certificates late */
+typedef struct ssl_sni_map_st SSL_SNI_MAP;
+SSL_SNI_MAP *SSL_SNI_MAP_new(void);
+void SSL_SNI_MAP_free(SSL_SNI_MAP *map);
+int SSL_SNI_MAP_add(SSL_SNI_MAP *map, const char *name, SSL_CTX *ctx);
+#  ifndef OPENSSL_NO_STDIO
+int SSL_SNI_MAP_add_files(SSL_SNI_MAP *map, const char *name, SSL_CTX *ctx,
+                          const char *certfile, const char *keyfile);
+#  endif
+SSL_CTX *SSL_SNI_MAP_lookup(SSL_SNI_MAP *map, const char *name);
+void SSL_CTX_set_sni_map(SSL_CTX *ctx, SSL_SNI_MAP *map);
+
 # endif
 
 # ifndef OPENSSL_NO_STDIO
@@ -2248,6 +2334,10 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
                                 unsigned int id_len);
 SSL_SESSION *d2i_SSL_SESSION(SSL_SESSION **a, const unsigned char **pp,
                              long length);
+/* Compact binary encoding, faster than the ASN.1 one */
+int i2b_SSL_SESSION(SSL_SESSION *in, unsigned char **pp);
+SSL_SESSION *b2i_SSL_SESSION(SSL_SESSION **a, const unsigned char **pp,
+                             long length);
 
 # ifdef HEADER_X509_H
 X509 *SSL_get_peer_certificate(const SSL *s);
@@ -2329,6 +2419,8 @@ char *SSL_get_srp_userinfo(SSL *s);
 
 void SSL_certs_clear(SSL *s);
 void SSL_free(SSL *ssl);
+size_t SSL_get_memory_usage(const SSL *s);
+int SSL_compact(SSL *s);
 int SSL_accept(SSL *ssl);
 int SSL_connect(SSL *ssl);
 int SSL_read(SSL *ssl, void *buf, int num);
@@ -2485,6 +2577,17 @@ int SSL_get_ex_data_X509_STORE_CTX_idx(void);
 # define SSL_CTX_get_session_cache_mode(ctx) \
         SSL_CTX_ctrl(ctx,SSL_CTRL_GET_SESS_CACHE_MODE,0,NULL)
 
+# define SSL_CTX_set_cert_cache_size(ctx,t) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SET_CERT_CACHE_SIZE,t,NULL)
+# define SSL_CTX_get_cert_cache_size(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_GET_CERT_CACHE_SIZE,0,NULL)
+# define SSL_CTX_cert_cache_number(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_CERT_CACHE_NUMBER,0,NULL)
+# define SSL_CTX_cert_cache_hits(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_CERT_CACHE_HITS,0,NULL)
+# define SSL_CTX_record_count(ctx,b) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_RECORD_COUNT,b,NULL)
+
 # define SSL_CTX_get_default_read_ahead(ctx) SSL_CTX_get_read_ahead(ctx)
 # define SSL_CTX_set_default_read_ahead(ctx,m) SSL_CTX_set_read_ahead(ctx,m)
 # define SSL_CTX_get_read_ahead(ctx) \
@@ -2505,6 +2608,12 @@ int SSL_get_ex_data_X509_STORE_CTX_idx(void);
 # define SSL_set_max_send_fragment(ssl,m) \
         SSL_ctrl(ssl,SSL_CTRL_SET_MAX_SEND_FRAGMENT,m,NULL)
 
+/* Send small records first and after idle periods, full size ones later */
+int SSL_CTX_set_dynamic_record_sizing(SSL_CTX *ctx, unsigned int size,
+                                      unsigned long ramp, long idle);
+int SSL_set_dynamic_record_sizing(SSL *s, unsigned int size,
+                                  unsigned long ramp, long idle);
+
      /* NB: the keylength is only applicable when is_export is true */
 # ifndef OPENSSL_NO_RSA
 void SSL_CTX_set_tmp_rsa_callback(SSL_CTX *ctx,
@@ -2592,6 +2701,7 @@ void ERR_load_SSL_strings(void);
 /* Error codes for the SSL functions. */
 
 /* Function codes. */
+# define SSL_F_B2I_SSL_SESSION                            429
 # define SSL_F_CHECK_SUITEB_CIPHER_LIST                   331
 # define SSL_F_CLIENT_CERTIFICATE                         100
 # define SSL_F_CLIENT_FINISHED                            167
@@ -2642,6 +2752,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_F_SERVER_FINISH                              239
 # define SSL_F_SERVER_HELLO                               114
 # define SSL_F_SERVER_VERIFY                              240
+# define SSL_F_SNI_ENTRY_LOAD                             431
 # define SSL_F_SSL23_ACCEPT                               115
 # define SSL_F_SSL23_CLIENT_HELLO                         116
 # define SSL_F_SSL23_CONNECT                              117
@@ -2735,14 +2846,20 @@ void ERR_load_SSL_strings(void);
 # define SSL_F_SSL_CONF_CMD                               334
 # define SSL_F_SSL_CREATE_CIPHER_LIST                     166
 # define SSL_F_SSL_CTRL                                   232
+# define SSL_F_SSL_CTX_ADD_TICKET_KEY                     426
 # define SSL_F_SSL_CTX_CHECK_PRIVATE_KEY                  168
 # define SSL_F_SSL_CTX_MAKE_PROFILES                      309
 # define SSL_F_SSL_CTX_NEW                                169
+# define SSL_F_SSL_CTX_NEW_FROM_TEMPLATE                  434
+# define SSL_F_SSL_CTX_ROTATE_TICKET_KEYS                 427
 # define SSL_F_SSL_CTX_SET_CIPHER_LIST                    269
 # define SSL_F_SSL_CTX_SET_CLIENT_CERT_ENGINE             290
+# define SSL_F_SSL_CTX_SET_OCSP_STAPLING                  425
 # define SSL_F_SSL_CTX_SET_PURPOSE                        226
 # define SSL_F_SSL_CTX_SET_SESSION_ID_CONTEXT             219
+# define SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE           430
 # define SSL_F_SSL_CTX_SET_SSL_VERSION                    170
+# define SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION            428
 # define SSL_F_SSL_CTX_SET_TRUST                          229
 # define SSL_F_SSL_CTX_USE_CERTIFICATE                    171
 # define SSL_F_SSL_CTX_USE_CERTIFICATE_ASN1               172
@@ -2798,6 +2915,8 @@ void ERR_load_SSL_strings(void);
 # define SSL_F_SSL_SET_TRUST                              228
 # define SSL_F_SSL_SET_WFD                                196
 # define SSL_F_SSL_SHUTDOWN                               224
+# define SSL_F_SSL_SNI_MAP_ADD                            432
+# define SSL_F_SSL_SNI_MAP_NEW                            433
 # define SSL_F_SSL_SRP_CTX_INIT                           313
 # define SSL_F_SSL_UNDEFINED_CONST_FUNCTION               243
 # define SSL_F_SSL_UNDEFINED_FUNCTION                     197
@@ -2856,6 +2975,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_BAD_MAC_DECODE                             113
 # define SSL_R_BAD_MAC_LENGTH                             333
 # define SSL_R_BAD_MESSAGE_TYPE                           114
+# define SSL_R_BAD_OCSP_RESPONDER_URL                     411
 # define SSL_R_BAD_PACKET_LENGTH                          115
 # define SSL_R_BAD_PROTOCOL_VERSION_NUMBER                116
 # define SSL_R_BAD_PSK_IDENTITY_HINT_LENGTH               316
@@ -2901,6 +3021,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_CONNECTION_ID_IS_DIFFERENT                 143
 # define SSL_R_CONNECTION_TYPE_NOT_SET                    144
 # define SSL_R_COOKIE_MISMATCH                            308
+# define SSL_R_CTX_USED_AS_TEMPLATE                       418
 # define SSL_R_DATA_BETWEEN_CCS_AND_FINISHED              145
 # define SSL_R_DATA_LENGTH_TOO_LONG                       146
 # define SSL_R_DECRYPTION_FAILED                          147
@@ -2910,6 +3031,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_DIGEST_CHECK_FAILED                        149
 # define SSL_R_DTLS_MESSAGE_TOO_BIG                       334
 # define SSL_R_DUPLICATE_COMPRESSION_ID                   309
+# define SSL_R_DUPLICATE_SERVER_NAME                      415
 # define SSL_R_ECC_CERT_NOT_FOR_KEY_AGREEMENT             317
 # define SSL_R_ECC_CERT_NOT_FOR_SIGNING                   318
 # define SSL_R_ECC_CERT_SHOULD_HAVE_RSA_SIGNATURE         322
@@ -2937,6 +3059,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_INVALID_NULL_CMD_NAME                      385
 # define SSL_R_INVALID_PURPOSE                            278
 # define SSL_R_INVALID_SERVERINFO_DATA                    388
+# define SSL_R_INVALID_SERVER_NAME                        416
 # define SSL_R_INVALID_SRP_USERNAME                       357
 # define SSL_R_INVALID_STATUS_RESPONSE                    328
 # define SSL_R_INVALID_TICKET_KEYS_LENGTH                 325
@@ -2993,6 +3116,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_NO_COMPRESSION_SPECIFIED                   187
 # define SSL_R_NO_GOST_CERTIFICATE_SENT_BY_PEER           330
 # define SSL_R_NO_METHOD_SPECIFIED                        188
+# define SSL_R_NO_OCSP_RESPONDER                          410
 # define SSL_R_NO_PEM_EXTENSIONS                          389
 # define SSL_R_NO_PRIVATEKEY                              189
 # define SSL_R_NO_PRIVATE_KEY_ASSIGNED                    190
@@ -3048,7 +3172,9 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_REUSE_CIPHER_LIST_NOT_ZERO                 218
 # define SSL_R_SCSV_RECEIVED_WHEN_RENEGOTIATING           345
 # define SSL_R_SERVERHELLO_TLSEXT                         275
+# define SSL_R_SESSION_CALLBACKS_ALREADY_SET              417
 # define SSL_R_SESSION_ID_CONTEXT_UNINITIALIZED           277
+# define SSL_R_SHARED_SESSION_CACHE_NOT_SUPPORTED         414
 # define SSL_R_SHORT_READ                                 219
 # define SSL_R_SHUTDOWN_WHILE_IN_INIT                     407
 # define SSL_R_SIGNATURE_ALGORITHMS_ERROR                 360
@@ -3113,6 +3239,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_UNABLE_TO_DECODE_DH_CERTS                  236
 # define SSL_R_UNABLE_TO_DECODE_ECDH_CERTS                313
 # define SSL_R_UNABLE_TO_EXTRACT_PUBLIC_KEY               237
+# define SSL_R_UNABLE_TO_FIND_CERTIFICATE_ISSUER          412
 # define SSL_R_UNABLE_TO_FIND_DH_PARAMETERS               238
 # define SSL_R_UNABLE_TO_FIND_ECDH_PARAMETERS             314
 # define SSL_R_UNABLE_TO_FIND_PUBLIC_KEY_PARAMETERS       239
@@ -3141,6 +3268,7 @@ void ERR_load_SSL_strings(void);
 # define SSL_R_UNSUPPORTED_DIGEST_TYPE                    326
 # define SSL_R_UNSUPPORTED_ELLIPTIC_CURVE                 315
 # define SSL_R_UNSUPPORTED_PROTOCOL                       258
+# define SSL_R_UNSUPPORTED_SESSION_ENCODING               413
 # define SSL_R_UNSUPPORTED_SSL_VERSION                    259
 # define SSL_R_UNSUPPORTED_STATUS_TYPE                    329
 # define SSL_R_USE_SRTP_NOT_NEGOTIATED                    369
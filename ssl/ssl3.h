@@ -628,6 +628,22 @@ typedef struct ssl3_state_st {
     unsigned char *alpn_selected;
     unsigned alpn_selected_len;
 #  endif                        /* OPENSSL_NO_TLSEXT */
+
+    /*
+     * Records in rbuf that were already decrypted and verified by a
+     * multi-block cipher: how many, which one is next and their payload
+     * lengths.
+     */
+    unsigned int mb_read_num;
+    unsigned int mb_read_idx;
+    unsigned int mb_read_len[8];
+
+    /*
+     * Dynamic record sizing: application data bytes written since the
+     * connection started or was last idle, and when it last wrote.
+     */
+    unsigned long dyn_record_sent;
+    unsigned long dyn_record_last;
 } SSL3_STATE;
 
 # endif
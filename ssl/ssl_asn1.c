@@ -145,6 +145,9 @@ int i2d_SSL_SESSION(SSL_SESSION *in, unsigned char **pp)
     if ((in == NULL) || ((in->cipher == NULL) && (in->cipher_id == 0)))
         return (0);
 
+    /* The ASN1_STRING flags below must not be left uninitialised */
+    memset(&a, 0, sizeof(a));
+
     /*
      * Note that I cheat in the following 2 assignments.  I know that if the
      * ASN1_INTEGER passed to ASN1_INTEGER_set is > sizeof(long)+1, the
@@ -710,20 +710,23 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
 {
     X509 *x;
     int i;
-    X509_STORE *verify_store;
+    X509_STORE *verify_store, *ctx_store = NULL;
     X509_STORE_CTX ctx;
 
+    if ((sk == NULL) || (sk_X509_num(sk) == 0))
+        return (0);
+
+    /* The context's store may be replaced meanwhile: hold on to it */
     if (s->cert->verify_store)
         verify_store = s->cert->verify_store;
     else
-        verify_store = s->ctx->cert_store;
-
-    if ((sk == NULL) || (sk_X509_num(sk) == 0))
-        return (0);
+        verify_store = ctx_store = ssl_ctx_get1_cert_store(s->ctx);
 
     x = sk_X509_value(sk, 0);
     if (!X509_STORE_CTX_init(&ctx, verify_store, x, sk)) {
         SSLerr(SSL_F_SSL_VERIFY_CERT_CHAIN, ERR_R_X509_LIB);
+        if (ctx_store != NULL)
+            X509_STORE_free(ctx_store);
         return (0);
     }
     /* Set suite B flags if needed */
@@ -767,6 +770,8 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
 
     s->verify_result = ctx.error;
     X509_STORE_CTX_cleanup(&ctx);
+    if (ctx_store != NULL)
+        X509_STORE_free(ctx_store);
 
     return (i);
 }
@@ -1084,18 +1089,12 @@ int ssl_add_cert_chain(SSL *s, CERT_PKEY *cpk, unsigned long *l)
 
     X509 *x;
     STACK_OF(X509) *extra_certs;
-    X509_STORE *chain_store;
 
     if (cpk)
         x = cpk->x509;
     else
         x = NULL;
 
-    if (s->cert->chain_store)
-        chain_store = s->cert->chain_store;
-    else
-        chain_store = s->ctx->cert_store;
-
     /*
      * If we have a certificate specific chain use it, else use parent ctx.
      */
@@ -1120,23 +1119,31 @@ int ssl_add_cert_chain(SSL *s, CERT_PKEY *cpk, unsigned long *l)
                 return 0;
         } else {
             X509_STORE_CTX xs_ctx;
-
-            if (!X509_STORE_CTX_init(&xs_ctx, chain_store, x, NULL)) {
-                SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, ERR_R_X509_LIB);
-                return (0);
-            }
-            X509_verify_cert(&xs_ctx);
-            /* Don't leave errors in the queue */
-            ERR_clear_error();
-            for (i = 0; i < sk_X509_num(xs_ctx.chain); i++) {
-                x = sk_X509_value(xs_ctx.chain, i);
-
-                if (!ssl_add_cert_to_buf(buf, l, x)) {
-                    X509_STORE_CTX_cleanup(&xs_ctx);
-                    return 0;
+            X509_STORE *chain_store, *ctx_store = NULL;
+            int ok;
+
+            /* The context's store may be replaced meanwhile: hold on to it */
+            if (s->cert->chain_store)
+                chain_store = s->cert->chain_store;
+            else
+                chain_store = ctx_store = ssl_ctx_get1_cert_store(s->ctx);
+
+            ok = X509_STORE_CTX_init(&xs_ctx, chain_store, x, NULL);
+            if (ok) {
+                X509_verify_cert(&xs_ctx);
+                /* Don't leave errors in the queue */
+                ERR_clear_error();
+                for (i = 0; ok && i < sk_X509_num(xs_ctx.chain); i++) {
+                    x = sk_X509_value(xs_ctx.chain, i);
+                    ok = ssl_add_cert_to_buf(buf, l, x);
                 }
-            }
-            X509_STORE_CTX_cleanup(&xs_ctx);
+                X509_STORE_CTX_cleanup(&xs_ctx);
+            } else
+                SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, ERR_R_X509_LIB);
+            if (ctx_store != NULL)
+                X509_STORE_free(ctx_store);
+            if (!ok)
+                return 0;
         }
     }
     for (i = 0; i < sk_X509_num(extra_certs); i++) {
@@ -271,18 +271,74 @@ int SSL_clear(SSL *s)
     return (1);
 }
 
+/*
+ * Rank ctx->cipher_list for ssl3_choose_cipher() each time it is replaced.
+ * Without the ranks the list is ranked for every handshake instead. The
+ * lists and their ranks are swapped in together under the SSL_CTX lock,
+ * under which ssl3_choose_cipher() copies the ranks, so that a handshake
+ * never sees ranks of another list or ones that have been freed.
+ */
+static void ssl_ctx_set_cipher_lists(SSL_CTX *ctx, STACK_OF(SSL_CIPHER) *list,
+                                     STACK_OF(SSL_CIPHER) *by_id)
+{
+    STACK_OF(SSL_CIPHER) *old_list, *old_by_id;
+    unsigned short *rank = NULL, *old_rank;
+    int shared;
+
+    if ((rank = OPENSSL_malloc(ssl3_num_ciphers() * sizeof(*rank))) != NULL)
+        ssl3_rank_ciphers(list, rank);
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    shared = ctx->shared & SSL_CTX_SHARED_CIPHERS;
+    old_list = ctx->cipher_list;
+    old_by_id = ctx->cipher_list_by_id;
+    old_rank = ctx->cipher_rank;
+    ctx->cipher_list = list;
+    ctx->cipher_list_by_id = by_id;
+    ctx->cipher_rank = rank;
+    ctx->shared &= ~SSL_CTX_SHARED_CIPHERS;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    /* Shared lists belong to the template */
+    if (!shared) {
+        if (old_list != NULL)
+            sk_SSL_CIPHER_free(old_list);
+        if (old_by_id != NULL)
+            sk_SSL_CIPHER_free(old_by_id);
+        if (old_rank != NULL)
+            OPENSSL_free(old_rank);
+    }
+}
+
+/*
+ * Build the cipher lists of |ctx| from |str|. A context that still shares
+ * them with its template gets lists of its own, or keeps the shared ones if
+ * that fails.
+ */
+static STACK_OF(SSL_CIPHER) *ssl_ctx_create_cipher_list(SSL_CTX *ctx,
+                                                        const char *str)
+{
+    STACK_OF(SSL_CIPHER) *sk, *list = NULL, *by_id = NULL;
+
+    /* New lists are built, so that the old ones are freed after the swap */
+    sk = ssl_create_cipher_list(ctx->method, &list, &by_id, str, ctx->cert);
+    if (sk == NULL)
+        return NULL;
+    ssl_ctx_set_cipher_lists(ctx, list, by_id);
+    return sk;
+}
+
 /** Used to change an SSL_CTXs default SSL method type */
 int SSL_CTX_set_ssl_version(SSL_CTX *ctx, const SSL_METHOD *meth)
 {
     STACK_OF(SSL_CIPHER) *sk;
 
+    if (ctx->shared & SSL_CTX_SHARED_TEMPLATE) {
+        SSLerr(SSL_F_SSL_CTX_SET_SSL_VERSION, SSL_R_CTX_USED_AS_TEMPLATE);
+        return (0);
+    }
     ctx->method = meth;
 
-    sk = ssl_create_cipher_list(ctx->method, &(ctx->cipher_list),
-                                &(ctx->cipher_list_by_id),
-                                meth->version ==
-                                SSL2_VERSION ? "SSLv2" :
-                                SSL_DEFAULT_CIPHER_LIST, ctx->cert);
+    sk = ssl_ctx_create_cipher_list(ctx, meth->version == SSL2_VERSION ?
+                                     "SSLv2" : SSL_DEFAULT_CIPHER_LIST);
     if ((sk == NULL) || (sk_SSL_CIPHER_num(sk) <= 0)) {
         SSLerr(SSL_F_SSL_CTX_SET_SSL_VERSION,
                SSL_R_SSL_LIBRARY_HAS_NO_CIPHERS);
@@ -358,6 +414,9 @@ SSL *SSL_new(SSL_CTX *ctx)
 #endif
     s->quiet_shutdown = ctx->quiet_shutdown;
     s->max_send_fragment = ctx->max_send_fragment;
+    s->dyn_record_size = ctx->dyn_record_size;
+    s->dyn_record_ramp = ctx->dyn_record_ramp;
+    s->dyn_record_idle = ctx->dyn_record_idle;
 
     CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
     s->ctx = ctx;
@@ -1234,6 +1293,17 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
     case SSL_CTRL_GET_SESS_CACHE_MODE:
         return (ctx->session_cache_mode);
 
+    case SSL_CTRL_SET_CERT_CACHE_SIZE:
+        return ssl_cert_cache_set_size(ctx, larg);
+    case SSL_CTRL_GET_CERT_CACHE_SIZE:
+    case SSL_CTRL_CERT_CACHE_NUMBER:
+    case SSL_CTRL_CERT_CACHE_HITS:
+        return ssl_cert_cache_ctrl(ctx, cmd);
+    case SSL_CTRL_RECORD_COUNT:
+        if (larg < 0 || larg >= SSL_RECORD_SIZE_BUCKETS)
+            return 0;
+        return (long)ctx->record_count[larg];
+
     case SSL_CTRL_SESS_NUMBER:
         return (lh_SSL_SESSION_num_items(ctx->sessions));
     case SSL_CTRL_SESS_CONNECT:
@@ -1295,6 +1365,30 @@ long SSL_CTX_callback_ctrl(SSL_CTX *ctx, int cmd, void (*fp) (void))
     }
 }
 
+int SSL_CTX_set_dynamic_record_sizing(SSL_CTX *ctx, unsigned int size,
+                                      unsigned long ramp, long idle)
+{
+    if ((size != 0 && (size < 512 || size > SSL3_RT_MAX_PLAIN_LENGTH))
+        || idle < 0)
+        return 0;
+    ctx->dyn_record_size = size;
+    ctx->dyn_record_ramp = ramp;
+    ctx->dyn_record_idle = idle;
+    return 1;
+}
+
+int SSL_set_dynamic_record_sizing(SSL *s, unsigned int size,
+                                  unsigned long ramp, long idle)
+{
+    if ((size != 0 && (size < 512 || size > SSL3_RT_MAX_PLAIN_LENGTH))
+        || idle < 0)
+        return 0;
+    s->dyn_record_size = size;
+    s->dyn_record_ramp = ramp;
+    s->dyn_record_idle = idle;
+    return 1;
+}
+
 int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b)
 {
     long l;
@@ -1368,8 +1462,12 @@ int SSL_CTX_set_cipher_list(SSL_CTX *ctx, const char *str)
 {
     STACK_OF(SSL_CIPHER) *sk;
 
-    sk = ssl_create_cipher_list(ctx->method, &ctx->cipher_list,
-                                &ctx->cipher_list_by_id, str, ctx->cert);
+    /* Derived contexts still use the lists of a template */
+    if (ctx->shared & SSL_CTX_SHARED_TEMPLATE) {
+        SSLerr(SSL_F_SSL_CTX_SET_CIPHER_LIST, SSL_R_CTX_USED_AS_TEMPLATE);
+        return 0;
+    }
+    sk = ssl_ctx_create_cipher_list(ctx, str);
     /*
      * ssl_create_cipher_list may return an empty stack if it was unable to
      * find a cipher matching the given rule string (for example if the rule
@@ -1922,6 +2020,9 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
         goto err;
 
     memset(ret, 0, sizeof(SSL_CTX));
+#ifdef SSL3_BUF_CACHE
+    ssl3_buf_cache_ctx_new();
+#endif
 
     ret->method = meth;
 
@@ -1982,11 +2083,8 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     if (ret->cert_store == NULL)
         goto err;
 
-    ssl_create_cipher_list(ret->method,
-                           &ret->cipher_list, &ret->cipher_list_by_id,
-                           meth->version ==
-                           SSL2_VERSION ? "SSLv2" : SSL_DEFAULT_CIPHER_LIST,
-                           ret->cert);
+    ssl_ctx_create_cipher_list(ret, meth->version == SSL2_VERSION ?
+                               "SSLv2" : SSL_DEFAULT_CIPHER_LIST);
     if (ret->cipher_list == NULL || sk_SSL_CIPHER_num(ret->cipher_list) <= 0) {
         SSLerr(SSL_F_SSL_CTX_NEW, SSL_R_LIBRARY_HAS_NO_CIPHERS);
         goto err2;
@@ -2048,6 +2146,8 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
 #endif
 #ifndef OPENSSL_NO_BUF_FREELISTS
     ret->freelist_max_len = SSL_MAX_BUF_FREELIST_LEN_DEFAULT;
+#endif
+#if !defined(OPENSSL_NO_BUF_FREELISTS) && !defined(SSL3_BUF_CACHE)
     ret->rbuf_freelist = OPENSSL_malloc(sizeof(SSL3_BUF_FREELIST));
     if (!ret->rbuf_freelist)
         goto err;
@@ -2102,6 +2202,208 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     return (NULL);
 }
 
+/*
+ * Create a context that uses the cipher lists, certificate store and buffer
+ * freelists of |tmpl| rather than building its own, and starts out with a
+ * copy of its other settings and callbacks. Per tenant contexts made this
+ * way only need memory of their own for what they change afterwards,
+ * typically the certificate and key. A shared member is replaced, never
+ * modified, when it is set on the derived context. The template is kept
+ * alive by the contexts derived from it, and its cipher lists can no longer
+ * be replaced. SSL_CTX_unshare_cert_store() gives either side a certificate
+ * store of its own to change. A shared session cache is not inherited.
+ */
+SSL_CTX *SSL_CTX_new_from_template(SSL_CTX *tmpl)
+{
+    SSL_CTX *ret = NULL;
+
+    if (tmpl == NULL) {
+        SSLerr(SSL_F_SSL_CTX_NEW_FROM_TEMPLATE, ERR_R_PASSED_NULL_PARAMETER);
+        return (NULL);
+    }
+    ret = (SSL_CTX *)OPENSSL_malloc(sizeof(SSL_CTX));
+    if (ret == NULL)
+        goto err;
+
+    memset(ret, 0, sizeof(SSL_CTX));
+#ifdef SSL3_BUF_CACHE
+    ssl3_buf_cache_ctx_new();
+#endif
+
+    ret->references = 1;
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    tmpl->references++;
+    tmpl->shared |= SSL_CTX_SHARED_TEMPLATE | SSL_CTX_SHARED_CERT_STORE;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    ret->tmpl = tmpl;
+    ret->method = tmpl->method;
+
+    ret->cipher_list = tmpl->cipher_list;
+    ret->cipher_list_by_id = tmpl->cipher_list_by_id;
+    ret->cipher_rank = tmpl->cipher_rank;
+    ret->shared |= SSL_CTX_SHARED_CIPHERS;
+    if (tmpl->cert_store != NULL)
+        CRYPTO_add(&tmpl->cert_store->references, 1, CRYPTO_LOCK_X509_STORE);
+    ret->cert_store = tmpl->cert_store;
+    ret->shared |= SSL_CTX_SHARED_CERT_STORE;
+#ifndef OPENSSL_NO_BUF_FREELISTS
+    ret->freelist_max_len = tmpl->freelist_max_len;
+    ret->rbuf_freelist = tmpl->rbuf_freelist;
+    ret->wbuf_freelist = tmpl->wbuf_freelist;
+    ret->shared |= SSL_CTX_SHARED_FREELISTS;
+#endif
+
+    ret->session_cache_mode = tmpl->session_cache_mode;
+    ret->session_cache_size = tmpl->session_cache_size;
+    ret->session_timeout = tmpl->session_timeout;
+    ret->new_session_cb = tmpl->new_session_cb;
+    ret->remove_session_cb = tmpl->remove_session_cb;
+    ret->get_session_cb = tmpl->get_session_cb;
+    ret->generate_session_id = tmpl->generate_session_id;
+    if (tmpl->shm_cache != NULL) {
+        /*
+         * The shared memory cache belongs to the template: fall back to an
+         * internal cache rather than calling its callbacks without it.
+         */
+        ret->session_cache_mode &= ~SSL_SESS_CACHE_NO_INTERNAL;
+        ret->new_session_cb = NULL;
+        ret->get_session_cb = NULL;
+    }
+    if ((ret->sessions = lh_SSL_SESSION_new()) == NULL)
+        goto err;
+
+    ret->app_verify_callback = tmpl->app_verify_callback;
+    ret->app_verify_arg = tmpl->app_verify_arg;
+    ret->default_passwd_callback = tmpl->default_passwd_callback;
+    ret->default_passwd_callback_userdata =
+        tmpl->default_passwd_callback_userdata;
+    ret->client_cert_cb = tmpl->client_cert_cb;
+    ret->app_gen_cookie_cb = tmpl->app_gen_cookie_cb;
+    ret->app_verify_cookie_cb = tmpl->app_verify_cookie_cb;
+    ret->rsa_md5 = tmpl->rsa_md5;
+    ret->md5 = tmpl->md5;
+    ret->sha1 = tmpl->sha1;
+    ret->comp_methods = tmpl->comp_methods;
+    ret->info_callback = tmpl->info_callback;
+    ret->options = tmpl->options;
+    ret->mode = tmpl->mode;
+    ret->max_cert_list = tmpl->max_cert_list;
+    ret->read_ahead = tmpl->read_ahead;
+    ret->msg_callback = tmpl->msg_callback;
+    ret->msg_callback_arg = tmpl->msg_callback_arg;
+    ret->verify_mode = tmpl->verify_mode;
+    ret->sid_ctx_length = tmpl->sid_ctx_length;
+    memcpy(ret->sid_ctx, tmpl->sid_ctx, sizeof(ret->sid_ctx));
+    ret->default_verify_callback = tmpl->default_verify_callback;
+    ret->quiet_shutdown = tmpl->quiet_shutdown;
+    ret->max_send_fragment = tmpl->max_send_fragment;
+    ret->dyn_record_size = tmpl->dyn_record_size;
+    ret->dyn_record_ramp = tmpl->dyn_record_ramp;
+    ret->dyn_record_idle = tmpl->dyn_record_idle;
+
+    if ((ret->cert = ssl_cert_dup(tmpl->cert)) == NULL)
+        goto err;
+    if ((ret->param = X509_VERIFY_PARAM_new()) == NULL
+        || !X509_VERIFY_PARAM_set1(ret->param, tmpl->param))
+        goto err;
+    if ((ret->client_CA = SSL_dup_CA_list(tmpl->client_CA)) == NULL)
+        goto err;
+
+    CRYPTO_new_ex_data(CRYPTO_EX_INDEX_SSL_CTX, ret, &ret->ex_data);
+
+#ifndef OPENSSL_NO_TLSEXT
+    ret->tlsext_servername_callback = tmpl->tlsext_servername_callback;
+    ret->tlsext_servername_arg = tmpl->tlsext_servername_arg;
+    /* Tickets of different tenants are not interchangeable */
+    if ((RAND_bytes(ret->tlsext_tick_key_name, 16) <= 0)
+        || (RAND_bytes(ret->tlsext_tick_hmac_key, 16) <= 0)
+        || (RAND_bytes(ret->tlsext_tick_aes_key, 16) <= 0))
+        ret->options |= SSL_OP_NO_TICKET;
+    ret->tlsext_ticket_key_cb = tmpl->tlsext_ticket_key_cb;
+    ret->tlsext_status_cb = tmpl->tlsext_status_cb;
+    ret->tlsext_status_arg = tmpl->tlsext_status_arg;
+    ret->tlsext_opaque_prf_input_callback =
+        tmpl->tlsext_opaque_prf_input_callback;
+    ret->tlsext_opaque_prf_input_callback_arg =
+        tmpl->tlsext_opaque_prf_input_callback_arg;
+# ifndef OPENSSL_NO_NEXTPROTONEG
+    ret->next_protos_advertised_cb = tmpl->next_protos_advertised_cb;
+    ret->next_protos_advertised_cb_arg = tmpl->next_protos_advertised_cb_arg;
+    ret->next_proto_select_cb = tmpl->next_proto_select_cb;
+    ret->next_proto_select_cb_arg = tmpl->next_proto_select_cb_arg;
+# endif
+    ret->alpn_select_cb = tmpl->alpn_select_cb;
+    ret->alpn_select_cb_arg = tmpl->alpn_select_cb_arg;
+    if (tmpl->alpn_client_proto_list != NULL) {
+        ret->alpn_client_proto_list =
+            BUF_memdup(tmpl->alpn_client_proto_list,
+                       tmpl->alpn_client_proto_list_len);
+        if (ret->alpn_client_proto_list == NULL)
+            goto err;
+        ret->alpn_client_proto_list_len = tmpl->alpn_client_proto_list_len;
+    }
+# ifndef OPENSSL_NO_EC
+    if (tmpl->tlsext_ecpointformatlist != NULL) {
+        ret->tlsext_ecpointformatlist =
+            BUF_memdup(tmpl->tlsext_ecpointformatlist,
+                       tmpl->tlsext_ecpointformatlist_length);
+        if (ret->tlsext_ecpointformatlist == NULL)
+            goto err;
+        ret->tlsext_ecpointformatlist_length =
+            tmpl->tlsext_ecpointformatlist_length;
+    }
+    if (tmpl->tlsext_ellipticcurvelist != NULL) {
+        ret->tlsext_ellipticcurvelist =
+            BUF_memdup(tmpl->tlsext_ellipticcurvelist,
+                       tmpl->tlsext_ellipticcurvelist_length);
+        if (ret->tlsext_ellipticcurvelist == NULL)
+            goto err;
+        ret->tlsext_ellipticcurvelist_length =
+            tmpl->tlsext_ellipticcurvelist_length;
+    }
+# endif
+#endif
+#ifndef OPENSSL_NO_SRTP
+    if (tmpl->srtp_profiles != NULL
+        && (ret->srtp_profiles =
+            sk_SRTP_PROTECTION_PROFILE_dup(tmpl->srtp_profiles)) == NULL)
+        goto err;
+#endif
+#ifndef OPENSSL_NO_PSK
+    if (tmpl->psk_identity_hint != NULL
+        && (ret->psk_identity_hint =
+            BUF_strdup(tmpl->psk_identity_hint)) == NULL)
+        goto err;
+    ret->psk_client_callback = tmpl->psk_client_callback;
+    ret->psk_server_callback = tmpl->psk_server_callback;
+#endif
+#ifndef OPENSSL_NO_SRP
+    SSL_CTX_SRP_CTX_init(ret);
+    ret->srp_ctx.SRP_cb_arg = tmpl->srp_ctx.SRP_cb_arg;
+    ret->srp_ctx.TLS_ext_srp_username_callback =
+        tmpl->srp_ctx.TLS_ext_srp_username_callback;
+    ret->srp_ctx.SRP_verify_param_callback =
+        tmpl->srp_ctx.SRP_verify_param_callback;
+    ret->srp_ctx.SRP_give_srp_client_pwd_callback =
+        tmpl->srp_ctx.SRP_give_srp_client_pwd_callback;
+    ret->srp_ctx.srp_Mask = tmpl->srp_ctx.srp_Mask;
+    ret->srp_ctx.strength = tmpl->srp_ctx.strength;
+#endif
+#ifndef OPENSSL_NO_ENGINE
+    if (tmpl->client_cert_engine != NULL
+        && !SSL_CTX_set_client_cert_engine(ret, tmpl->client_cert_engine))
+        goto err2;
+#endif
+
+    return (ret);
+ err:
+    SSLerr(SSL_F_SSL_CTX_NEW_FROM_TEMPLATE, ERR_R_MALLOC_FAILURE);
+ err2:
+    if (ret != NULL)
+        SSL_CTX_free(ret);
+    return (NULL);
+}
+
 #if 0
 static void SSL_COMP_free(SSL_COMP *comp)
 {
@@ -2109,7 +2411,7 @@ static void SSL_COMP_free(SSL_COMP *comp)
 }
 #endif
 
-#ifndef OPENSSL_NO_BUF_FREELISTS
+#if !defined(OPENSSL_NO_BUF_FREELISTS) && !defined(SSL3_BUF_CACHE)
 static void ssl_buf_freelist_free(SSL3_BUF_FREELIST *list)
 {
     SSL3_BUF_FREELIST_ENTRY *ent, *next;
@@ -2160,13 +2462,26 @@ void SSL_CTX_free(SSL_CTX *a)
 
     if (a->sessions != NULL)
         lh_SSL_SESSION_free(a->sessions);
+    ssl_cert_cache_free(a->cert_cache);
+    ssl_shm_cache_free(a->shm_cache);
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP) \
+    && !defined(OPENSSL_NO_SOCK)
+    ssl_ocsp_stapling_free(a->ocsp_stapling);
+#endif
+#ifndef OPENSSL_NO_TLSEXT
+    ssl_ticket_keys_free(a->ticket_keys);
+#endif
 
     if (a->cert_store != NULL)
         X509_STORE_free(a->cert_store);
-    if (a->cipher_list != NULL)
-        sk_SSL_CIPHER_free(a->cipher_list);
-    if (a->cipher_list_by_id != NULL)
-        sk_SSL_CIPHER_free(a->cipher_list_by_id);
+    if (!(a->shared & SSL_CTX_SHARED_CIPHERS)) {
+        if (a->cipher_list != NULL)
+            sk_SSL_CIPHER_free(a->cipher_list);
+        if (a->cipher_list_by_id != NULL)
+            sk_SSL_CIPHER_free(a->cipher_list_by_id);
+        if (a->cipher_rank != NULL)
+            OPENSSL_free(a->cipher_rank);
+    }
     if (a->cert != NULL)
         ssl_cert_free(a->cert);
     if (a->client_CA != NULL)
@@ -2198,11 +2513,15 @@ void SSL_CTX_free(SSL_CTX *a)
         ENGINE_finish(a->client_cert_engine);
 #endif
 
-#ifndef OPENSSL_NO_BUF_FREELISTS
-    if (a->wbuf_freelist)
-        ssl_buf_freelist_free(a->wbuf_freelist);
-    if (a->rbuf_freelist)
-        ssl_buf_freelist_free(a->rbuf_freelist);
+#ifdef SSL3_BUF_CACHE
+    ssl3_buf_cache_ctx_free();
+#elif !defined(OPENSSL_NO_BUF_FREELISTS)
+    if (!(a->shared & SSL_CTX_SHARED_FREELISTS)) {
+        if (a->wbuf_freelist)
+            ssl_buf_freelist_free(a->wbuf_freelist);
+        if (a->rbuf_freelist)
+            ssl_buf_freelist_free(a->rbuf_freelist);
+    }
 #endif
 #ifndef OPENSSL_NO_TLSEXT
 # ifndef OPENSSL_NO_EC
@@ -2215,6 +2534,10 @@ void SSL_CTX_free(SSL_CTX *a)
         OPENSSL_free(a->alpn_client_proto_list);
 #endif
 
+    /* Drop the template, which owns whatever is still shared with it */
+    if (a->tmpl != NULL)
+        SSL_CTX_free(a->tmpl);
+
     OPENSSL_free(a);
 }
 
@@ -3251,15 +3574,63 @@ SSL_CTX *SSL_set_SSL_CTX(SSL *ssl, SSL_CTX *ctx)
     return (ssl->ctx);
 }
 
+/*
+ * Give a context a certificate store of its own, if it shares one with its
+ * template or with contexts derived from it, so that it can be changed
+ * without affecting them.
+ */
+int SSL_CTX_unshare_cert_store(SSL_CTX *ctx)
+{
+    X509_STORE *old = NULL, *st;
+    int ret = 1;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((ctx->shared & SSL_CTX_SHARED_CERT_STORE) && ctx->cert_store != NULL) {
+        if ((st = X509_STORE_dup(ctx->cert_store)) == NULL) {
+            ret = 0;
+        } else {
+            old = ctx->cert_store;
+            ctx->cert_store = st;
+        }
+    }
+    if (ret)
+        ctx->shared &= ~SSL_CTX_SHARED_CERT_STORE;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    if (old != NULL)
+        X509_STORE_free(old);
+    return ret;
+}
+
+/*
+ * Return a reference to the current certificate store of |ctx|, which stays
+ * valid should the store be replaced while it is in use.
+ */
+X509_STORE *ssl_ctx_get1_cert_store(SSL_CTX *ctx)
+{
+    X509_STORE *st;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    st = ctx->cert_store;
+    if (st != NULL)
+        CRYPTO_add(&st->references, 1, CRYPTO_LOCK_X509_STORE);
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    return st;
+}
+
 #ifndef OPENSSL_NO_STDIO
 int SSL_CTX_set_default_verify_paths(SSL_CTX *ctx)
 {
+    if (!SSL_CTX_unshare_cert_store(ctx))
+        return 0;
     return (X509_STORE_set_default_paths(ctx->cert_store));
 }
 
 int SSL_CTX_load_verify_locations(SSL_CTX *ctx, const char *CAfile,
                                   const char *CApath)
 {
+    if (!SSL_CTX_unshare_cert_store(ctx))
+        return 0;
     return (X509_STORE_load_locations(ctx->cert_store, CAfile, CApath));
 }
 #endif
@@ -3347,9 +3718,16 @@ X509_STORE *SSL_CTX_get_cert_store(const SSL_CTX *ctx)
 
 void SSL_CTX_set_cert_store(SSL_CTX *ctx, X509_STORE *store)
 {
-    if (ctx->cert_store != NULL)
-        X509_STORE_free(ctx->cert_store);
+    X509_STORE *old;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    old = ctx->cert_store;
     ctx->cert_store = store;
+    ctx->shared &= ~SSL_CTX_SHARED_CERT_STORE;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    if (old != NULL)
+        X509_STORE_free(old);
 }
 
 int SSL_want(const SSL *s)
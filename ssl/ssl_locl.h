@@ -841,6 +841,14 @@ typedef struct ssl3_comp_st {
 # endif
 
 # ifndef OPENSSL_NO_BUF_FREELISTS
+/*
+ * With GCC atomic builtins, released record buffers are kept in per-thread
+ * caches, see s3_both.c, rather than in the SSL_CTX freelists below.
+ */
+#  if defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#   define SSL3_BUF_CACHE
+#  endif
 typedef struct ssl3_buf_freelist_st {
     size_t chunklen;
     unsigned int len;
@@ -1073,6 +1081,8 @@ SESS_CERT *ssl_sess_cert_new(void);
 void ssl_sess_cert_free(SESS_CERT *sc);
 int ssl_set_peer_cert_type(SESS_CERT *c, int type);
 int ssl_get_new_session(SSL *s, int session);
+int ssl_session_to_bin(SSL_SESSION *in, unsigned char **pp, int no_id);
+int ssl_session_resolve_peer(SSL_SESSION *ss, SSL_CTX *ctx);
 int ssl_get_prev_session(SSL *s, unsigned char *session, int len,
                          const unsigned char *limit);
 SSL_SESSION *ssl_session_dup(SSL_SESSION *src, int ticket);
@@ -1107,7 +1117,44 @@ int ssl_cert_set_current(CERT *c, long arg);
 X509 *ssl_cert_get0_next_certificate(CERT *c, int first);
 void ssl_cert_set_cert_cb(CERT *c, int (*cb) (SSL *ssl, void *arg),
                           void *arg);
+/*
+ * SSL_CTX members shared with other contexts, see SSL_CTX_new_from_template().
+ * A derived context uses the cipher lists and freelists of its template, and
+ * both copy the certificate store before changing it. The cipher lists of a
+ * context that has been used as a template can no longer be replaced.
+ */
+# define SSL_CTX_SHARED_CIPHERS          0x1
+# define SSL_CTX_SHARED_CERT_STORE       0x2
+# define SSL_CTX_SHARED_FREELISTS        0x4
+# define SSL_CTX_SHARED_TEMPLATE         0x8
+typedef struct ssl_cert_cache_st SSL_CERT_CACHE;
+X509 *ssl_cert_cache_d2i(SSL_CTX *ctx, const unsigned char **pp, long len);
+long ssl_cert_cache_set_size(SSL_CTX *ctx, long size);
+long ssl_cert_cache_ctrl(SSL_CTX *ctx, int cmd);
+void ssl_cert_cache_free(SSL_CERT_CACHE *c);
+X509 *ssl_cert_cache_get(SSL_CTX *ctx, const unsigned char *md, long len);
+typedef struct ssl_shm_cache_st SSL_SHM_CACHE;
+void ssl_shm_cache_remove(SSL_SHM_CACHE *c, SSL_SESSION *sess);
+void ssl_shm_cache_free(SSL_SHM_CACHE *c);
+# if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP) \
+    && !defined(OPENSSL_NO_SOCK)
+typedef struct ssl_ocsp_stapling_st SSL_OCSP_STAPLING;
+int ssl_ocsp_stapling_cb(SSL *s);
+void ssl_ocsp_stapling_free(SSL_OCSP_STAPLING *stp);
+# endif
+# ifndef OPENSSL_NO_TLSEXT
+typedef struct ssl_ticket_keys_st SSL_TICKET_KEYS;
+/* Key name, IV and GCM tag added to the session encoding */
+#  define TLS1_TICKET_KEYS_OVERHEAD       (16 + 12 + 16)
+int tls1_ticket_keys_encrypt(SSL_CTX *ctx, const unsigned char *in,
+                             int inlen, unsigned char *out, int *outlen);
+int tls1_ticket_keys_decrypt(SSL_CTX *ctx, const unsigned char *etick,
+                             int eticklen, unsigned char **psdec, int *pslen);
+void ssl_ticket_keys_free(SSL_TICKET_KEYS *tk);
+int ssl_sni_map_select(SSL *s);
+# endif
 
+X509_STORE *ssl_ctx_get1_cert_store(SSL_CTX *ctx);
 int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk);
 int ssl_add_cert_chain(SSL *s, CERT_PKEY *cpk, unsigned long *l);
 int ssl_build_cert_chain(CERT *c, X509_STORE *chain_store, int flags);
@@ -1191,6 +1238,7 @@ int ssl3_enc(SSL *s, int send_data);
 int n_ssl3_mac(SSL *ssl, unsigned char *md, int send_data);
 void ssl3_free_digest_list(SSL *s);
 unsigned long ssl3_output_cert_chain(SSL *s, CERT_PKEY *cpk);
+void ssl3_rank_ciphers(STACK_OF(SSL_CIPHER) *sk, unsigned short *rank);
 SSL_CIPHER *ssl3_choose_cipher(SSL *ssl, STACK_OF(SSL_CIPHER) *clnt,
                                STACK_OF(SSL_CIPHER) *srvr);
 int ssl3_setup_buffers(SSL *s);
@@ -1198,6 +1246,10 @@ int ssl3_setup_read_buffer(SSL *s);
 int ssl3_setup_write_buffer(SSL *s);
 int ssl3_release_read_buffer(SSL *s);
 int ssl3_release_write_buffer(SSL *s);
+# ifdef SSL3_BUF_CACHE
+void ssl3_buf_cache_ctx_new(void);
+void ssl3_buf_cache_ctx_free(void);
+# endif
 int ssl3_digest_cached_records(SSL *s);
 int ssl3_new(SSL *s);
 void ssl3_free(SSL *s);
@@ -0,0 +1,293 @@
+/* ssl/ssl_mem.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Memory held by connections. SSL_get_memory_usage() adds up the sizes of
+ * the structures and buffers an SSL owns, so that servers with very many
+ * connections can see what each one costs. SSL_compact() drops what an
+ * established connection only needs during a handshake and the record
+ * buffers it is not using; all of it is allocated again when needed.
+ */
+
+#include <stdio.h>
+#include "ssl_locl.h"
+
+static size_t stack_usage(const _STACK *sk)
+{
+    if (sk == NULL)
+        return 0;
+    return sizeof(*sk) + sk->num_alloc * sizeof(*sk->data);
+}
+
+static size_t buf_mem_usage(const BUF_MEM *b)
+{
+    if (b == NULL)
+        return 0;
+    return sizeof(*b) + b->max;
+}
+
+static size_t md_ctx_usage(const EVP_MD_CTX *ctx)
+{
+    size_t n;
+
+    if (ctx == NULL)
+        return 0;
+    n = sizeof(*ctx);
+    if (ctx->digest != NULL && ctx->md_data != NULL)
+        n += ctx->digest->ctx_size;
+    return n;
+}
+
+static size_t cipher_ctx_usage(const EVP_CIPHER_CTX *ctx)
+{
+    size_t n;
+
+    if (ctx == NULL)
+        return 0;
+    n = sizeof(*ctx);
+    if (ctx->cipher != NULL && ctx->cipher_data != NULL)
+        n += ctx->cipher->ctx_size;
+    return n;
+}
+
+static size_t buffer_bio_usage(BIO *b)
+{
+    BIO_F_BUFFER_CTX *ctx;
+
+    if (b == NULL)
+        return 0;
+    ctx = b->ptr;
+    return sizeof(*b) + sizeof(*ctx) + ctx->ibuf_size + ctx->obuf_size;
+}
+
+static size_t mem_bio_usage(BIO *b)
+{
+    if (b == NULL)
+        return 0;
+    return sizeof(*b) + buf_mem_usage(b->ptr);
+}
+
+static size_t bn_usage(const BIGNUM *b)
+{
+    if (b == NULL)
+        return 0;
+    return sizeof(*b) + b->dmax * sizeof(*b->d);
+}
+
+/*
+ * The certificates, keys and stores are only referenced by the CERT of an
+ * SSL, while the temporary DH and ECDH parameters are copies of its own.
+ * EC_KEY is opaque, so only its pointer is counted.
+ */
+static size_t cert_usage(const CERT *c)
+{
+    size_t n = sizeof(*c);
+    int i;
+
+    for (i = 0; i < SSL_PKEY_NUM; i++) {
+        n += stack_usage((const _STACK *)c->pkeys[i].chain);
+#ifndef OPENSSL_NO_TLSEXT
+        if (c->pkeys[i].serverinfo != NULL)
+            n += c->pkeys[i].serverinfo_length;
+#endif
+    }
+#ifndef OPENSSL_NO_DH
+    if (c->dh_tmp != NULL)
+        n += sizeof(*c->dh_tmp) + bn_usage(c->dh_tmp->p)
+            + bn_usage(c->dh_tmp->g) + bn_usage(c->dh_tmp->q)
+            + bn_usage(c->dh_tmp->pub_key) + bn_usage(c->dh_tmp->priv_key);
+#endif
+    if (c->ctypes != NULL)
+        n += c->ctype_num;
+    if (c->peer_sigalgs != NULL)
+        n += c->peer_sigalgslen;
+    if (c->conf_sigalgs != NULL)
+        n += c->conf_sigalgslen;
+    if (c->client_sigalgs != NULL)
+        n += c->client_sigalgslen;
+    if (c->shared_sigalgs != NULL)
+        n += c->shared_sigalgslen * sizeof(*c->shared_sigalgs);
+    if (c->ciphers_raw != NULL)
+        n += c->ciphers_rawlen;
+    n += c->cli_ext.meths_count * sizeof(*c->cli_ext.meths);
+    n += c->srv_ext.meths_count * sizeof(*c->srv_ext.meths);
+    if (c->alpn_proposed != NULL)
+        n += c->alpn_proposed_len;
+    return n;
+}
+
+static size_t ssl3_memory_usage(const SSL *s)
+{
+    const SSL3_STATE *s3 = s->s3;
+    size_t n = sizeof(*s3);
+    int i;
+
+    if (s3->rbuf.buf != NULL)
+        n += s3->rbuf.len;
+    if (s3->wbuf.buf != NULL)
+        n += s3->wbuf.len;
+    n += mem_bio_usage(s3->handshake_buffer);
+    if (s3->handshake_dgst != NULL) {
+        n += SSL_MAX_DIGEST * sizeof(*s3->handshake_dgst);
+        for (i = 0; i < SSL_MAX_DIGEST; i++)
+            n += md_ctx_usage(s3->handshake_dgst[i]);
+    }
+    if (s3->tmp.key_block != NULL)
+        n += s3->tmp.key_block_length;
+    n += stack_usage((const _STACK *)s3->tmp.ca_names);
+#ifndef OPENSSL_NO_TLSEXT
+    if (s3->alpn_selected != NULL)
+        n += s3->alpn_selected_len;
+#endif
+    return n;
+}
+
+size_t SSL_get_memory_usage(const SSL *s)
+{
+    size_t n = sizeof(*s);
+
+#ifndef OPENSSL_NO_SSL2
+    if (s->s2 != NULL)
+        n += sizeof(*s->s2) + 2 * SSL2_MAX_RECORD_LENGTH_2_BYTE_HEADER + 5;
+#endif
+    if (s->s3 != NULL)
+        n += ssl3_memory_usage(s);
+    if (s->d1 != NULL)
+        n += sizeof(*s->d1);
+    n += buf_mem_usage(s->init_buf);
+    n += buffer_bio_usage(s->bbio);
+
+    n += cipher_ctx_usage(s->enc_read_ctx);
+    n += cipher_ctx_usage(s->enc_write_ctx);
+    n += md_ctx_usage(s->read_hash);
+    n += md_ctx_usage(s->write_hash);
+#ifndef OPENSSL_NO_COMP
+    if (s->expand != NULL)
+        n += sizeof(*s->expand);
+    if (s->compress != NULL)
+        n += sizeof(*s->compress);
+#endif
+
+    if (s->cert != NULL)
+        n += cert_usage(s->cert);
+    if (s->param != NULL)
+        n += sizeof(*s->param);
+    n += stack_usage((const _STACK *)s->cipher_list);
+    n += stack_usage((const _STACK *)s->cipher_list_by_id);
+#ifndef OPENSSL_NO_TLSEXT
+    if (s->tlsext_hostname != NULL)
+        n += strlen(s->tlsext_hostname) + 1;
+# ifndef OPENSSL_NO_EC
+    if (s->tlsext_ecpointformatlist != NULL)
+        n += s->tlsext_ecpointformatlist_length;
+    if (s->tlsext_ellipticcurvelist != NULL)
+        n += s->tlsext_ellipticcurvelist_length;
+# endif
+    if (s->tlsext_ocsp_resp != NULL)
+        n += s->tlsext_ocsp_resplen;
+    if (s->alpn_client_proto_list != NULL)
+        n += s->alpn_client_proto_list_len;
+# ifndef OPENSSL_NO_NEXTPROTONEG
+    if (s->next_proto_negotiated != NULL)
+        n += s->next_proto_negotiated_len;
+# endif
+#endif
+    return n;
+}
+
+int SSL_compact(SSL *s)
+{
+    SSL3_STATE *s3 = s->s3;
+
+    if (!SSL_is_init_finished(s) || s->in_handshake)
+        return 0;
+
+    if (s->init_buf != NULL) {
+        BUF_MEM_free(s->init_buf);
+        s->init_buf = NULL;
+    }
+    /* SSLv2 and DTLS keep their state, as with SSL_MODE_RELEASE_BUFFERS */
+    if (s3 == NULL || SSL_IS_DTLS(s))
+        return 1;
+
+    /* The next handshake starts these afresh */
+    ssl3_free_digest_list(s);
+    if (s3->handshake_buffer != NULL) {
+        BIO_free(s3->handshake_buffer);
+        s3->handshake_buffer = NULL;
+    }
+    ssl3_cleanup_key_block(s);
+    if (s3->tmp.ca_names != NULL) {
+        sk_X509_NAME_pop_free(s3->tmp.ca_names, X509_NAME_free);
+        s3->tmp.ca_names = NULL;
+    }
+#ifndef OPENSSL_NO_DH
+    if (s3->tmp.dh != NULL) {
+        DH_free(s3->tmp.dh);
+        s3->tmp.dh = NULL;
+    }
+#endif
+#ifndef OPENSSL_NO_ECDH
+    if (s3->tmp.ecdh != NULL) {
+        EC_KEY_free(s3->tmp.ecdh);
+        s3->tmp.ecdh = NULL;
+    }
+#endif
+
+    /* Unread data, or a record only partly read or written, keeps them */
+    if (s->rstate == SSL_ST_READ_HEADER && s3->rrec.length == 0
+        && s3->rbuf.left == 0)
+        ssl3_release_read_buffer(s);
+    if (s3->wbuf.left == 0)
+        ssl3_release_write_buffer(s);
+    return 1;
+}
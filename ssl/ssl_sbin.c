@@ -0,0 +1,471 @@
+/* ssl/ssl_sbin.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Compact binary session encoding. Unlike the ASN.1 form written by
+ * i2d_SSL_SESSION() this is a fixed layout: the fields every session has
+ * sit at fixed offsets and fixed sizes, so encoding is a single pass of
+ * stores and decoding copies them straight into the SSL_SESSION without
+ * any intermediate allocation. Only the optional variable length fields
+ * follow, each present if its bit is set in the flags byte.
+ *
+ * All integers are big-endian.
+ *
+ *   version          1   SSL_SESSION_BIN_VERSION
+ *   ssl_version      2
+ *   cipher_id        4
+ *   compress_meth    1
+ *   flags            1   SSL_SESSION_BIN_*
+ *   master_key       1 + SSL_MAX_MASTER_KEY_LENGTH    (length, data)
+ *   session_id       1 + SSL_MAX_SSL_SESSION_ID_LENGTH
+ *   sid_ctx          1 + SSL_MAX_SID_CTX_LENGTH
+ *   key_arg          1 + SSL_MAX_KEY_ARG_LENGTH
+ *   time             4
+ *   timeout          4
+ *   verify_result    4
+ *   tick_lifetime    4
+ *
+ * then, in this order and if flagged: the peer certificate (3 byte length
+ * and DER) or a reference to it (SHA-256 digest and 3 byte length of the
+ * DER), and the host name, PSK identity hint, PSK identity, ticket, SRP
+ * user name and Kerberos principal (2 byte length and data each).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+#include <openssl/x509.h>
+#include <openssl/sha.h>
+
+#define SSL_SESSION_BIN_VERSION         0x01
+
+#define SSL_SESSION_BIN_PEER            0x01
+#define SSL_SESSION_BIN_HOSTNAME        0x02
+#define SSL_SESSION_BIN_PSK_HINT        0x04
+#define SSL_SESSION_BIN_PSK_IDENTITY    0x08
+#define SSL_SESSION_BIN_TICKET          0x10
+#define SSL_SESSION_BIN_SRP_USERNAME    0x20
+#define SSL_SESSION_BIN_KRB5_PRINC      0x40
+#define SSL_SESSION_BIN_PEER_REF        0x80
+
+#define SSL_SESSION_BIN_FIXED   (1 + 2 + 4 + 1 + 1 \
+                                 + 1 + SSL_MAX_MASTER_KEY_LENGTH \
+                                 + 1 + SSL_MAX_SSL_SESSION_ID_LENGTH \
+                                 + 1 + SSL_MAX_SID_CTX_LENGTH \
+                                 + 1 + SSL_MAX_KEY_ARG_LENGTH \
+                                 + 4 + 4 + 4 + 4)
+
+/* Copies a length prefixed fixed size field, zero padded */
+static unsigned char *put_fixed(unsigned char *p, const unsigned char *d,
+                                unsigned int len, unsigned int max)
+{
+    *(p++) = (unsigned char)len;
+    memcpy(p, d, len);
+    memset(p + len, 0, max - len);
+    return p + max;
+}
+
+static unsigned char *put_var(unsigned char *p, const void *d, size_t len)
+{
+    s2n(len, p);
+    memcpy(p, d, len);
+    return p + len;
+}
+
+/* Writes the reference to the peer certificate of |in| */
+static unsigned char *put_peer_ref(unsigned char *p, SSL_SESSION *in)
+{
+    unsigned char *der, *q;
+    long len;
+
+    if (in->peer_ref_len != 0) {
+        memcpy(p, in->peer_ref, SHA256_DIGEST_LENGTH);
+        len = in->peer_ref_len;
+    } else {
+        if ((len = i2d_X509(in->peer, NULL)) <= 0
+            || (der = OPENSSL_malloc(len)) == NULL)
+            return NULL;
+        q = der;
+        i2d_X509(in->peer, &q);
+        SHA256(der, len, p);
+        OPENSSL_free(der);
+    }
+    p += SHA256_DIGEST_LENGTH;
+    l2n3(len, p);
+    return p;
+}
+
+/*
+ * Encodes |in| as i2d_SSL_SESSION() does. If |no_id| is set the session ID
+ * is left out, as it is for session tickets.
+ */
+int ssl_session_to_bin(SSL_SESSION *in, unsigned char **pp, int no_id)
+{
+    unsigned char *p;
+    unsigned long id;
+    int len = SSL_SESSION_BIN_FIXED, peer_len = 0, flags = 0;
+    size_t hostname_len = 0, hint_len = 0, identity_len = 0;
+    size_t srp_len = 0, tick_len = 0;
+
+    if (in == NULL || (in->cipher == NULL && in->cipher_id == 0))
+        return 0;
+
+    if (in->peer_by_ref && (in->peer != NULL || in->peer_ref_len != 0)) {
+        flags |= SSL_SESSION_BIN_PEER_REF;
+        len += SHA256_DIGEST_LENGTH + 3;
+    } else if (in->peer != NULL) {
+        if ((peer_len = i2d_X509(in->peer, NULL)) <= 0
+            || peer_len > 0xFFFFFF)
+            return 0;
+        flags |= SSL_SESSION_BIN_PEER;
+        len += 3 + peer_len;
+    }
+#ifndef OPENSSL_NO_TLSEXT
+    if (in->tlsext_hostname != NULL) {
+        hostname_len = strlen(in->tlsext_hostname);
+        flags |= SSL_SESSION_BIN_HOSTNAME;
+        len += 2 + hostname_len;
+    }
+    if (in->tlsext_tick != NULL) {
+        tick_len = in->tlsext_ticklen;
+        flags |= SSL_SESSION_BIN_TICKET;
+        len += 2 + tick_len;
+    }
+#endif
+#ifndef OPENSSL_NO_PSK
+    if (in->psk_identity_hint != NULL) {
+        hint_len = strlen(in->psk_identity_hint);
+        flags |= SSL_SESSION_BIN_PSK_HINT;
+        len += 2 + hint_len;
+    }
+    if (in->psk_identity != NULL) {
+        identity_len = strlen(in->psk_identity);
+        flags |= SSL_SESSION_BIN_PSK_IDENTITY;
+        len += 2 + identity_len;
+    }
+#endif
+#ifndef OPENSSL_NO_SRP
+    if (in->srp_username != NULL) {
+        srp_len = strlen(in->srp_username);
+        flags |= SSL_SESSION_BIN_SRP_USERNAME;
+        len += 2 + srp_len;
+    }
+#endif
+#ifndef OPENSSL_NO_KRB5
+    if (in->krb5_client_princ_len) {
+        flags |= SSL_SESSION_BIN_KRB5_PRINC;
+        len += 2 + in->krb5_client_princ_len;
+    }
+#endif
+    if (hostname_len > 0xFFFF || hint_len > 0xFFFF || identity_len > 0xFFFF
+        || srp_len > 0xFFFF || tick_len > 0xFFFF)
+        return 0;
+
+    if (pp == NULL)
+        return len;
+
+    p = *pp;
+    id = in->cipher != NULL ? in->cipher->id : in->cipher_id;
+    *(p++) = SSL_SESSION_BIN_VERSION;
+    s2n(in->ssl_version, p);
+    l2n(id, p);
+    *(p++) = (unsigned char)in->compress_meth;
+    *(p++) = (unsigned char)flags;
+    p = put_fixed(p, in->master_key, in->master_key_length,
+                  SSL_MAX_MASTER_KEY_LENGTH);
+    p = put_fixed(p, in->session_id, no_id ? 0 : in->session_id_length,
+                  SSL_MAX_SSL_SESSION_ID_LENGTH);
+    p = put_fixed(p, in->sid_ctx, in->sid_ctx_length,
+                  SSL_MAX_SID_CTX_LENGTH);
+    p = put_fixed(p, in->key_arg, in->key_arg_length,
+                  SSL_MAX_KEY_ARG_LENGTH);
+    l2n(in->time, p);
+    l2n(in->timeout, p);
+    l2n(in->verify_result, p);
+#ifndef OPENSSL_NO_TLSEXT
+    l2n(in->tlsext_tick_lifetime_hint, p);
+#else
+    l2n(0, p);
+#endif
+
+    if (flags & SSL_SESSION_BIN_PEER) {
+        l2n3(peer_len, p);
+        i2d_X509(in->peer, &p);
+    } else if (flags & SSL_SESSION_BIN_PEER_REF) {
+        if ((p = put_peer_ref(p, in)) == NULL)
+            return 0;
+    }
+#ifndef OPENSSL_NO_TLSEXT
+    if (flags & SSL_SESSION_BIN_HOSTNAME)
+        p = put_var(p, in->tlsext_hostname, hostname_len);
+#endif
+#ifndef OPENSSL_NO_PSK
+    if (flags & SSL_SESSION_BIN_PSK_HINT)
+        p = put_var(p, in->psk_identity_hint, hint_len);
+    if (flags & SSL_SESSION_BIN_PSK_IDENTITY)
+        p = put_var(p, in->psk_identity, identity_len);
+#endif
+#ifndef OPENSSL_NO_TLSEXT
+    if (flags & SSL_SESSION_BIN_TICKET)
+        p = put_var(p, in->tlsext_tick, tick_len);
+#endif
+#ifndef OPENSSL_NO_SRP
+    if (flags & SSL_SESSION_BIN_SRP_USERNAME)
+        p = put_var(p, in->srp_username, srp_len);
+#endif
+#ifndef OPENSSL_NO_KRB5
+    if (flags & SSL_SESSION_BIN_KRB5_PRINC)
+        p = put_var(p, in->krb5_client_princ, in->krb5_client_princ_len);
+#endif
+    *pp = p;
+    return len;
+}
+
+int i2b_SSL_SESSION(SSL_SESSION *in, unsigned char **pp)
+{
+    return ssl_session_to_bin(in, pp, 0);
+}
+
+/* Reads a length prefixed fixed size field into |d| */
+static int get_fixed(const unsigned char **pp, unsigned char *d,
+                     unsigned int *plen, unsigned int max)
+{
+    const unsigned char *p = *pp;
+
+    if (*p > max)
+        return 0;
+    *plen = *p;
+    memcpy(d, p + 1, *plen);
+    *pp = p + 1 + max;
+    return 1;
+}
+
+/*
+ * Returns the next variable length field of |*pp|, which has |*premain|
+ * bytes left, and its length in |*plen|. Returns NULL if it is truncated.
+ */
+static const unsigned char *get_var(const unsigned char **pp, long *premain,
+                                    size_t *plen)
+{
+    const unsigned char *p = *pp;
+    unsigned int len;
+
+    if (*premain < 2)
+        return NULL;
+    n2s(p, len);
+    if (*premain - 2 < (long)len)
+        return NULL;
+    *plen = len;
+    *pp = p + len;
+    *premain -= 2 + len;
+    return p;
+}
+
+static char *get_string(const unsigned char **pp, long *premain)
+{
+    const unsigned char *d;
+    size_t len;
+
+    if ((d = get_var(pp, premain, &len)) == NULL)
+        return NULL;
+    return BUF_strndup((const char *)d, len);
+}
+
+SSL_SESSION *b2i_SSL_SESSION(SSL_SESSION **a, const unsigned char **pp,
+                             long length)
+{
+    SSL_SESSION *ret;
+    const unsigned char *p = *pp, *d;
+    unsigned long l;
+    unsigned int n;
+    long remain;
+    size_t len;
+    int flags, reason = SSL_R_BAD_LENGTH;
+
+    if (length < SSL_SESSION_BIN_FIXED) {
+        SSLerr(SSL_F_B2I_SSL_SESSION, SSL_R_BAD_LENGTH);
+        return NULL;
+    }
+    if (*p != SSL_SESSION_BIN_VERSION) {
+        SSLerr(SSL_F_B2I_SSL_SESSION, SSL_R_UNSUPPORTED_SESSION_ENCODING);
+        return NULL;
+    }
+    if ((ret = SSL_SESSION_new()) == NULL) {
+        SSLerr(SSL_F_B2I_SSL_SESSION, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+
+    p++;
+    n2s(p, n);
+    ret->ssl_version = n;
+    if ((n >> 8) != SSL2_VERSION_MAJOR && (n >> 8) != SSL3_VERSION_MAJOR
+        && (n >> 8) != DTLS1_VERSION_MAJOR && n != DTLS1_BAD_VER) {
+        reason = SSL_R_UNKNOWN_SSL_VERSION;
+        goto err;
+    }
+    n2l(p, l);
+    ret->cipher_id = l;
+    ret->compress_meth = *(p++);
+    flags = *(p++);
+    if (!get_fixed(&p, ret->master_key, &n, SSL_MAX_MASTER_KEY_LENGTH))
+        goto err;
+    ret->master_key_length = n;
+    if (!get_fixed(&p, ret->session_id, &ret->session_id_length,
+                   SSL_MAX_SSL_SESSION_ID_LENGTH)
+        || !get_fixed(&p, ret->sid_ctx, &ret->sid_ctx_length,
+                      SSL_MAX_SID_CTX_LENGTH))
+        goto err;
+    if (!get_fixed(&p, ret->key_arg, &n, SSL_MAX_KEY_ARG_LENGTH))
+        goto err;
+    ret->key_arg_length = n;
+    n2l(p, l);
+    ret->time = (long)l;
+    n2l(p, l);
+    ret->timeout = (long)l;
+    n2l(p, l);
+    ret->verify_result = (long)l;
+    n2l(p, l);
+#ifndef OPENSSL_NO_TLSEXT
+    ret->tlsext_tick_lifetime_hint = (long)l;
+#endif
+    remain = length - SSL_SESSION_BIN_FIXED;
+
+    if (flags & SSL_SESSION_BIN_PEER) {
+        if (remain < 3)
+            goto err;
+        n2l3(p, l);
+        remain -= 3;
+        if ((unsigned long)remain < l)
+            goto err;
+        d = p;
+        ret->peer = d2i_X509(NULL, &d, l);
+        if (ret->peer == NULL || d != p + l) {
+            reason = ERR_R_NESTED_ASN1_ERROR;
+            goto err;
+        }
+        p += l;
+        remain -= l;
+    } else if (flags & SSL_SESSION_BIN_PEER_REF) {
+        if (remain < SHA256_DIGEST_LENGTH + 3)
+            goto err;
+        memcpy(ret->peer_ref, p, SHA256_DIGEST_LENGTH);
+        p += SHA256_DIGEST_LENGTH;
+        n2l3(p, l);
+        ret->peer_ref_len = l;
+        ret->peer_by_ref = 1;
+        remain -= SHA256_DIGEST_LENGTH + 3;
+    }
+    if (flags & SSL_SESSION_BIN_HOSTNAME) {
+#ifndef OPENSSL_NO_TLSEXT
+        if ((ret->tlsext_hostname = get_string(&p, &remain)) == NULL)
+#else
+        if (get_var(&p, &remain, &len) == NULL)
+#endif
+            goto err;
+    }
+    if (flags & SSL_SESSION_BIN_PSK_HINT) {
+#ifndef OPENSSL_NO_PSK
+        if ((ret->psk_identity_hint = get_string(&p, &remain)) == NULL)
+#else
+        if (get_var(&p, &remain, &len) == NULL)
+#endif
+            goto err;
+    }
+    if (flags & SSL_SESSION_BIN_PSK_IDENTITY) {
+#ifndef OPENSSL_NO_PSK
+        if ((ret->psk_identity = get_string(&p, &remain)) == NULL)
+#else
+        if (get_var(&p, &remain, &len) == NULL)
+#endif
+            goto err;
+    }
+    if (flags & SSL_SESSION_BIN_TICKET) {
+        if ((d = get_var(&p, &remain, &len)) == NULL)
+            goto err;
+#ifndef OPENSSL_NO_TLSEXT
+        if ((ret->tlsext_tick = BUF_memdup(d, len)) == NULL && len != 0)
+            goto err;
+        ret->tlsext_ticklen = len;
+#endif
+    }
+    if (flags & SSL_SESSION_BIN_SRP_USERNAME) {
+#ifndef OPENSSL_NO_SRP
+        if ((ret->srp_username = get_string(&p, &remain)) == NULL)
+#else
+        if (get_var(&p, &remain, &len) == NULL)
+#endif
+            goto err;
+    }
+    if (flags & SSL_SESSION_BIN_KRB5_PRINC) {
+        if ((d = get_var(&p, &remain, &len)) == NULL)
+            goto err;
+#ifndef OPENSSL_NO_KRB5
+        if (len > SSL_MAX_KRB5_PRINCIPAL_LENGTH)
+            goto err;
+        memcpy(ret->krb5_client_princ, d, len);
+        ret->krb5_client_princ_len = len;
+#endif
+    }
+
+    *pp = p;
+    if (a != NULL) {
+        if (*a != NULL)
+            SSL_SESSION_free(*a);
+        *a = ret;
+    }
+    return ret;
+ err:
+    SSLerr(SSL_F_B2I_SSL_SESSION, reason);
+    SSL_SESSION_free(ret);
+    return NULL;
+}
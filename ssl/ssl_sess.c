@@ -419,6 +419,11 @@ int ssl_get_new_session(SSL *s, int session)
     else
         ss->timeout = s->session_ctx->session_timeout;
 
+    /* Without a certificate cache the reference could not be resolved */
+    if ((s->mode & SSL_MODE_PEER_CERT_BY_REFERENCE)
+        && SSL_CTX_get_cert_cache_size(s->session_ctx) > 0)
+        ss->peer_by_ref = 1;
+
     if (s->session != NULL) {
         SSL_SESSION_free(s->session);
         s->session = NULL;
@@ -710,6 +715,9 @@ int ssl_get_prev_session(SSL *s, unsigned char *session_id, int len,
         goto err;
     }
 
+    if (!ssl_session_resolve_peer(ret, s->session_ctx))
+        goto err;               /* treat like cache miss */
+
     s->session_ctx->stats.sess_hit++;
 
     if (s->session != NULL)
@@ -817,6 +825,9 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
 int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
+    /* Not resumable by any process any more */
+    if (ctx->shm_cache != NULL)
+        ssl_shm_cache_remove(ctx->shm_cache, c);
     return remove_session_lock(ctx, c, 1);
 }
 
@@ -999,6 +1010,36 @@ X509 *SSL_SESSION_get0_peer(SSL_SESSION *s)
     return s->peer;
 }
 
+/*
+ * Sets the peer certificate of |ss|, if it holds it by reference, from the
+ * certificate cache of |ctx|, which must be the session_ctx that received
+ * certificates are cached in. Called before a session is resumed. Returns
+ * 0 if the certificate is no longer cached, so that the session must not
+ * be resumed, and 1 otherwise.
+ */
+int ssl_session_resolve_peer(SSL_SESSION *ss, SSL_CTX *ctx)
+{
+    X509 *x;
+    int done;
+
+    /* A cached session may be resolved by several threads at once */
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_SESSION);
+    done = ss->peer != NULL || ss->peer_ref_len == 0;
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_SESSION);
+    if (done)
+        return 1;
+    if ((x = ssl_cert_cache_get(ctx, ss->peer_ref, ss->peer_ref_len)) == NULL)
+        return 0;
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_SESSION);
+    if (ss->peer == NULL) {
+        ss->peer = x;
+        x = NULL;
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_SESSION);
+    X509_free(x);
+    return 1;
+}
+
 int SSL_SESSION_set1_id_context(SSL_SESSION *s, const unsigned char *sid_ctx,
                                 unsigned int sid_ctx_len)
 {
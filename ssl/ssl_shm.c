@@ -0,0 +1,410 @@
+/* ssl/ssl_shm.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Shared memory session cache. SSL_CTX_set_shared_session_cache() maps an
+ * anonymous shared region and installs new and get session callbacks that
+ * keep server sessions there, in their i2b_SSL_SESSION() encoding, in place
+ * of the internal cache. Processes forked after the call all see the same
+ * sessions, so a session can be resumed whichever worker of a preforking
+ * server accepts the connection.
+ *
+ * The region is a hash table of sets of SHM_CACHE_WAYS fixed size slots.
+ * A session ID selects a set, and a session is stored in a free or expired
+ * slot of its set or else replaces the least recently used one. Each set
+ * has its own process-shared robust mutex, so that a lock left behind by a
+ * process that died is recovered, even if its process ID has been reused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#if defined(OPENSSL_SYS_UNIX) && !defined(OPENSSL_NO_POSIX_IO)
+# include <sys/types.h>
+# include <unistd.h>
+# ifdef _POSIX_MAPPED_FILES
+#  include <sys/mman.h>
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#   define MAP_ANONYMOUS MAP_ANON
+#  endif
+#  if defined(MAP_ANONYMOUS) && defined(OPENSSL_THREADS) \
+    && defined(_POSIX_THREAD_PROCESS_SHARED) \
+    && _POSIX_THREAD_PROCESS_SHARED > 0 \
+    && defined(_POSIX_THREAD_ROBUST_PRIO_INHERIT)
+#   include <errno.h>
+#   include <pthread.h>
+#   define SHM_CACHE_USE_MMAP
+#  endif
+# endif
+#endif
+
+#ifdef SHM_CACHE_USE_MMAP
+
+# define SHM_CACHE_WAYS          8
+# define SHM_CACHE_SIZE          1024 /* default encoding size limit */
+# define SHM_CACHE_MAX_SIZE      (64 * 1024)
+# define SHM_CACHE_ALIGN         64 /* keep sets and slots in cache lines */
+
+# define SHM_CACHE_ROUND(n) \
+        (((n) + SHM_CACHE_ALIGN - 1) & ~(size_t)(SHM_CACHE_ALIGN - 1))
+
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned long clock;        /* use counter for LRU */
+} SHM_CACHE_SET;
+
+typedef struct {
+    unsigned long used;         /* set clock at the last use */
+    long expires;
+    unsigned int len;           /* length of the encoding, 0 if free */
+    unsigned int id_len;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    /* the encoding follows */
+} SHM_CACHE_SLOT;
+
+struct ssl_shm_cache_st {
+    unsigned char *base;
+    size_t map_len;
+    size_t nsets;
+    size_t set_len;             /* set header and slots */
+    size_t slot_len;            /* slot header and encoding */
+    size_t size;                /* encoding size limit */
+};
+
+static SHM_CACHE_SET *shm_cache_set(SSL_SHM_CACHE *c, const unsigned char *id,
+                                    unsigned int len)
+{
+    unsigned long h = 2166136261UL;
+    unsigned int i;
+
+    /* Session IDs may come from a generate_session_id callback: hash it all */
+    for (i = 0; i < len; i++)
+        h = ((h ^ id[i]) * 16777619UL) & 0xffffffffUL;
+    return (SHM_CACHE_SET *)(c->base + (h % c->nsets) * c->set_len);
+}
+
+static SHM_CACHE_SLOT *shm_cache_slot(SSL_SHM_CACHE *c, SHM_CACHE_SET *set,
+                                      int i)
+{
+    return (SHM_CACHE_SLOT *)((unsigned char *)set
+                              + SHM_CACHE_ROUND(sizeof(*set))
+                              + i * c->slot_len);
+}
+
+static int shm_cache_lock(SSL_SHM_CACHE *c, SHM_CACHE_SET *set)
+{
+    int i;
+
+    switch (pthread_mutex_lock(&set->lock)) {
+    case 0:
+        return 1;
+    case EOWNERDEAD:
+        /*
+         * The holder may have died half way through writing a slot: drop
+         * whatever the set held.
+         */
+        for (i = 0; i < SHM_CACHE_WAYS; i++)
+            shm_cache_slot(c, set, i)->len = 0;
+        if (pthread_mutex_consistent(&set->lock) != 0) {
+            /* Still ours: don't leave it locked for the next process */
+            pthread_mutex_unlock(&set->lock);
+            return 0;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void shm_cache_unlock(SHM_CACHE_SET *set)
+{
+    pthread_mutex_unlock(&set->lock);
+}
+
+static SHM_CACHE_SLOT *shm_cache_find(SSL_SHM_CACHE *c, SHM_CACHE_SET *set,
+                                      const unsigned char *id,
+                                      unsigned int len)
+{
+    SHM_CACHE_SLOT *sl;
+    int i;
+
+    for (i = 0; i < SHM_CACHE_WAYS; i++) {
+        sl = shm_cache_slot(c, set, i);
+        if (sl->len != 0 && sl->id_len == len && memcmp(sl->id, id, len) == 0)
+            return sl;
+    }
+    return NULL;
+}
+
+static int shm_cache_new_cb(SSL *s, SSL_SESSION *sess)
+{
+    SSL_SHM_CACHE *c = s->session_ctx->shm_cache;
+    SHM_CACHE_SET *set;
+    SHM_CACHE_SLOT *sl, *victim;
+    unsigned char stack[SHM_CACHE_SIZE], *buf, *p;
+    long now;
+    int i, n;
+
+    if (c == NULL || sess->session_id_length == 0)
+        return 0;
+    n = i2b_SSL_SESSION(sess, NULL);
+    if (n <= 0)
+        return 0;
+    if ((size_t)n > c->size) {
+        /* With no internal cache it cannot be resumed: count it */
+        s->session_ctx->stats.sess_cache_full++;
+        return 0;
+    }
+    if ((size_t)n <= sizeof(stack))
+        buf = stack;
+    else if ((buf = OPENSSL_malloc(n)) == NULL)
+        return 0;
+    p = buf;
+    i2b_SSL_SESSION(sess, &p);
+
+    now = (long)time(NULL);
+    set = shm_cache_set(c, sess->session_id, sess->session_id_length);
+    if (!shm_cache_lock(c, set))
+        goto end;
+    victim = shm_cache_find(c, set, sess->session_id,
+                            sess->session_id_length);
+    for (i = 0; victim == NULL && i < SHM_CACHE_WAYS; i++) {
+        sl = shm_cache_slot(c, set, i);
+        if (sl->len == 0 || sl->expires < now)
+            victim = sl;
+    }
+    if (victim == NULL) {
+        victim = shm_cache_slot(c, set, 0);
+        for (i = 1; i < SHM_CACHE_WAYS; i++) {
+            sl = shm_cache_slot(c, set, i);
+            if (sl->used < victim->used)
+                victim = sl;
+        }
+    }
+    victim->id_len = sess->session_id_length;
+    memcpy(victim->id, sess->session_id, sess->session_id_length);
+    victim->expires = sess->time + sess->timeout;
+    victim->used = ++set->clock;
+    memcpy(victim + 1, buf, n);
+    victim->len = n;
+    shm_cache_unlock(set);
+
+ end:
+    if (buf != stack)
+        OPENSSL_free(buf);
+    /* The session itself is not kept */
+    return 0;
+}
+
+static SSL_SESSION *shm_cache_get_cb(SSL *s, unsigned char *id, int len,
+                                     int *copy)
+{
+    SSL_SHM_CACHE *c = s->session_ctx->shm_cache;
+    SHM_CACHE_SET *set;
+    SHM_CACHE_SLOT *sl;
+    SSL_SESSION *ret = NULL;
+    unsigned char stack[SHM_CACHE_SIZE], *buf;
+    const unsigned char *p;
+    unsigned int n = 0;
+
+    *copy = 0;
+    if (c == NULL || len <= 0 || len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return NULL;
+    if (c->size <= sizeof(stack))
+        buf = stack;
+    else if ((buf = OPENSSL_malloc(c->size)) == NULL)
+        return NULL;
+
+    set = shm_cache_set(c, id, len);
+    if (shm_cache_lock(c, set)) {
+        if ((sl = shm_cache_find(c, set, id, len)) != NULL) {
+            if (sl->expires < (long)time(NULL)) {
+                sl->len = 0;
+            } else {
+                n = sl->len;
+                memcpy(buf, sl + 1, n);
+                sl->used = ++set->clock;
+            }
+        }
+        shm_cache_unlock(set);
+    }
+
+    /* Decode outside the lock */
+    if (n != 0) {
+        p = buf;
+        ret = b2i_SSL_SESSION(NULL, &p, n);
+    }
+    if (buf != stack)
+        OPENSSL_free(buf);
+    return ret;
+}
+
+void ssl_shm_cache_remove(SSL_SHM_CACHE *c, SSL_SESSION *sess)
+{
+    SHM_CACHE_SET *set;
+    SHM_CACHE_SLOT *sl;
+
+    if (c == NULL || sess == NULL || sess->session_id_length == 0)
+        return;
+    set = shm_cache_set(c, sess->session_id, sess->session_id_length);
+    if (!shm_cache_lock(c, set))
+        return;
+    if ((sl = shm_cache_find(c, set, sess->session_id,
+                             sess->session_id_length)) != NULL)
+        sl->len = 0;
+    shm_cache_unlock(set);
+}
+
+void ssl_shm_cache_free(SSL_SHM_CACHE *c)
+{
+    if (c == NULL)
+        return;
+    /* The mutexes may still be used by other processes: not destroyed */
+    munmap(c->base, c->map_len);
+    OPENSSL_free(c);
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, long num, long size)
+{
+    SSL_SHM_CACHE *c;
+    SHM_CACHE_SET *set;
+    pthread_mutexattr_t attr;
+    void *base;
+    size_t i;
+    int ok;
+
+    if (size == 0)
+        size = SHM_CACHE_SIZE;
+    if (num < 1 || size < 0 || size > SHM_CACHE_MAX_SIZE) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, SSL_R_BAD_VALUE);
+        return 0;
+    }
+    /* Don't silently replace the application's external cache */
+    if ((ctx->new_session_cb != NULL
+         && ctx->new_session_cb != shm_cache_new_cb)
+        || (ctx->get_session_cb != NULL
+            && ctx->get_session_cb != shm_cache_get_cb)) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+               SSL_R_SESSION_CALLBACKS_ALREADY_SET);
+        return 0;
+    }
+    c = OPENSSL_malloc(sizeof(*c));
+    if (c == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    c->size = size;
+    c->slot_len = SHM_CACHE_ROUND(sizeof(SHM_CACHE_SLOT) + c->size);
+    c->set_len = SHM_CACHE_ROUND(sizeof(SHM_CACHE_SET))
+        + SHM_CACHE_WAYS * c->slot_len;
+    c->nsets = (num + SHM_CACHE_WAYS - 1) / SHM_CACHE_WAYS;
+    if (c->nsets > ((size_t)-1) / c->set_len) {
+        OPENSSL_free(c);
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, SSL_R_BAD_VALUE);
+        return 0;
+    }
+    c->map_len = c->nsets * c->set_len;
+    /* Zero filled, so every slot is empty */
+    base = mmap(NULL, c->map_len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        OPENSSL_free(c);
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+        return 0;
+    }
+    c->base = base;
+
+    ok = pthread_mutexattr_init(&attr) == 0;
+    if (ok) {
+        ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0
+            && pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0;
+        for (i = 0; ok && i < c->nsets; i++) {
+            set = (SHM_CACHE_SET *)(c->base + i * c->set_len);
+            ok = pthread_mutex_init(&set->lock, &attr) == 0;
+        }
+        pthread_mutexattr_destroy(&attr);
+    }
+    if (!ok) {
+        ssl_shm_cache_free(c);
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+        return 0;
+    }
+
+    ssl_shm_cache_free(ctx->shm_cache);
+    ctx->shm_cache = c;
+    ctx->session_cache_mode |= SSL_SESS_CACHE_SERVER
+        | SSL_SESS_CACHE_NO_INTERNAL;
+    ctx->new_session_cb = shm_cache_new_cb;
+    ctx->get_session_cb = shm_cache_get_cb;
+    return 1;
+}
+
+#else                           /* !SHM_CACHE_USE_MMAP */
+
+void ssl_shm_cache_remove(SSL_SHM_CACHE *c, SSL_SESSION *sess)
+{
+}
+
+void ssl_shm_cache_free(SSL_SHM_CACHE *c)
+{
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, long num, long size)
+{
+    SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+           SSL_R_SHARED_SESSION_CACHE_NOT_SUPPORTED);
+    return 0;
+}
+
+#endif
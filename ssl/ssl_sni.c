@@ -0,0 +1,436 @@
+/* ssl/ssl_sni.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Built-in server name dispatch. An SSL_SNI_MAP maps host names, exact or
+ * wildcard ("*.example.com", one label only), to the SSL_CTX serving them.
+ * A map set on the initial SSL_CTX of a connection is consulted when the
+ * ClientHello is processed, before any servername callback, with one hash
+ * lookup for the exact name and at most one more for the wildcard.
+ *
+ * A name can instead come with certificate and key files that are only
+ * read the first time a client asks for it. Many such names can share one
+ * SSL_CTX: the parsed certificate, chain and key are kept in the map and
+ * set on each connection for the name, so that a server with a very large
+ * number of virtual hosts does not parse every certificate at startup.
+ *
+ * Names can be added while the map is in use. Entries are never replaced
+ * or removed until the map is freed, so a connection can use what it
+ * looked up without holding a lock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#ifndef OPENSSL_NO_TLSEXT
+
+# include <openssl/lhash.h>
+# include <openssl/pem.h>
+
+/*
+ * Seconds to wait before reading files again after a failure, doubled up
+ * to the maximum for each further failure
+ */
+# define SNI_LOAD_RETRY          1
+# define SNI_LOAD_RETRY_MAX      256
+
+typedef struct ssl_sni_entry_st SSL_SNI_ENTRY;
+
+struct ssl_sni_entry_st {
+    char *name;                 /* lower case, "*.example.com" if wildcard */
+    SSL_CTX *ctx;
+    /* Files to load on first use, or NULL */
+    char *certfile;
+    char *keyfile;
+    /* What was loaded from them, set once */
+    X509 *x;
+    STACK_OF(X509) *chain;
+    EVP_PKEY *pkey;
+    /* After a failure to load them, when to try again */
+    time_t retry;
+    long retry_wait;
+};
+
+DECLARE_LHASH_OF(SSL_SNI_ENTRY);
+
+struct ssl_sni_map_st {
+    LHASH_OF(SSL_SNI_ENTRY) *entries;
+};
+
+static unsigned long ssl_sni_entry_hash(const SSL_SNI_ENTRY *a)
+{
+    return lh_strhash(a->name);
+}
+
+static IMPLEMENT_LHASH_HASH_FN(ssl_sni_entry, SSL_SNI_ENTRY)
+
+static int ssl_sni_entry_cmp(const SSL_SNI_ENTRY *a, const SSL_SNI_ENTRY *b)
+{
+    return strcmp(a->name, b->name);
+}
+
+static IMPLEMENT_LHASH_COMP_FN(ssl_sni_entry, SSL_SNI_ENTRY)
+
+static void sni_entry_free(SSL_SNI_ENTRY *e)
+{
+    if (e->ctx != NULL)
+        SSL_CTX_free(e->ctx);
+    if (e->name != NULL)
+        OPENSSL_free(e->name);
+    if (e->certfile != NULL)
+        OPENSSL_free(e->certfile);
+    if (e->keyfile != NULL)
+        OPENSSL_free(e->keyfile);
+    if (e->x != NULL)
+        X509_free(e->x);
+    if (e->chain != NULL)
+        sk_X509_pop_free(e->chain, X509_free);
+    if (e->pkey != NULL)
+        EVP_PKEY_free(e->pkey);
+    OPENSSL_free(e);
+}
+
+static void sni_entry_free_doall(SSL_SNI_ENTRY *e)
+{
+    sni_entry_free(e);
+}
+
+static IMPLEMENT_LHASH_DOALL_FN(sni_entry_free, SSL_SNI_ENTRY)
+
+/*
+ * Copy |in| to |out| in lower case, without a trailing dot. Returns 0 if
+ * the result would be empty or longer than a host name can be.
+ */
+static int sni_name_lower(const char *in, char *out)
+{
+    size_t i, len = strlen(in);
+
+    if (len > 0 && in[len - 1] == '.')
+        len--;
+    if (len == 0 || len > TLSEXT_MAXLEN_host_name)
+        return 0;
+    for (i = 0; i < len; i++)
+        out[i] = (in[i] >= 'A' && in[i] <= 'Z') ? in[i] - 'A' + 'a' : in[i];
+    out[len] = '\0';
+    return 1;
+}
+
+/* Called with CRYPTO_LOCK_SSL_CTX held */
+static SSL_SNI_ENTRY *sni_map_find(SSL_SNI_MAP *map, const char *name)
+{
+    char buf[TLSEXT_MAXLEN_host_name + 1], *dot;
+    SSL_SNI_ENTRY tmp, *e;
+
+    if (!sni_name_lower(name, buf))
+        return NULL;
+    tmp.name = buf;
+    if ((e = lh_SSL_SNI_ENTRY_retrieve(map->entries, &tmp)) != NULL)
+        return e;
+    /* "*.example.com" stands in for the first label of the name */
+    if ((dot = strchr(buf, '.')) == NULL || dot == buf)
+        return NULL;
+    tmp.name = dot - 1;
+    tmp.name[0] = '*';
+    return lh_SSL_SNI_ENTRY_retrieve(map->entries, &tmp);
+}
+
+SSL_SNI_MAP *SSL_SNI_MAP_new(void)
+{
+    SSL_SNI_MAP *map;
+
+    map = OPENSSL_malloc(sizeof(*map));
+    if (map == NULL) {
+        SSLerr(SSL_F_SSL_SNI_MAP_NEW, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    map->entries = lh_SSL_SNI_ENTRY_new();
+    if (map->entries == NULL) {
+        OPENSSL_free(map);
+        SSLerr(SSL_F_SSL_SNI_MAP_NEW, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    return map;
+}
+
+void SSL_SNI_MAP_free(SSL_SNI_MAP *map)
+{
+    if (map == NULL)
+        return;
+    lh_SSL_SNI_ENTRY_doall(map->entries, LHASH_DOALL_FN(sni_entry_free));
+    lh_SSL_SNI_ENTRY_free(map->entries);
+    OPENSSL_free(map);
+}
+
+static int sni_map_add(SSL_SNI_MAP *map, const char *name, SSL_CTX *ctx,
+                       const char *certfile, const char *keyfile)
+{
+    char buf[TLSEXT_MAXLEN_host_name + 1];
+    SSL_SNI_ENTRY *e;
+    const char *star;
+    int dup, err = 0;
+
+    /* A wildcard is "*." followed by at least one more label */
+    star = strchr(name, '*');
+    if (!sni_name_lower(name, buf)
+        || (star != NULL && (star != name || name[1] != '.'
+                             || name[2] == '\0' || name[2] == '.'
+                             || strchr(name + 1, '*') != NULL))) {
+        SSLerr(SSL_F_SSL_SNI_MAP_ADD, SSL_R_INVALID_SERVER_NAME);
+        return 0;
+    }
+
+    e = OPENSSL_malloc(sizeof(*e));
+    if (e == NULL)
+        goto merr;
+    memset(e, 0, sizeof(*e));
+    if ((e->name = BUF_strdup(buf)) == NULL
+        || (certfile != NULL && (e->certfile = BUF_strdup(certfile)) == NULL)
+        || (keyfile != NULL && (e->keyfile = BUF_strdup(keyfile)) == NULL))
+        goto merr;
+    CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+    e->ctx = ctx;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    dup = lh_SSL_SNI_ENTRY_retrieve(map->entries, e) != NULL;
+    if (!dup) {
+        (void)lh_SSL_SNI_ENTRY_insert(map->entries, e);
+        err = lh_SSL_SNI_ENTRY_error(map->entries);
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    if (dup || err) {
+        sni_entry_free(e);
+        SSLerr(SSL_F_SSL_SNI_MAP_ADD, dup ? SSL_R_DUPLICATE_SERVER_NAME
+                                          : ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    return 1;
+
+ merr:
+    if (e != NULL)
+        sni_entry_free(e);
+    SSLerr(SSL_F_SSL_SNI_MAP_ADD, ERR_R_MALLOC_FAILURE);
+    return 0;
+}
+
+int SSL_SNI_MAP_add(SSL_SNI_MAP *map, const char *name, SSL_CTX *ctx)
+{
+    return sni_map_add(map, name, ctx, NULL, NULL);
+}
+
+# ifndef OPENSSL_NO_STDIO
+int SSL_SNI_MAP_add_files(SSL_SNI_MAP *map, const char *name, SSL_CTX *ctx,
+                          const char *certfile, const char *keyfile)
+{
+    return sni_map_add(map, name, ctx, certfile,
+                       keyfile != NULL ? keyfile : certfile);
+}
+# endif
+
+SSL_CTX *SSL_SNI_MAP_lookup(SSL_SNI_MAP *map, const char *name)
+{
+    SSL_SNI_ENTRY *e;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    e = sni_map_find(map, name);
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    return e != NULL ? e->ctx : NULL;
+}
+
+void SSL_CTX_set_sni_map(SSL_CTX *ctx, SSL_SNI_MAP *map)
+{
+    ctx->sni_map = map;
+}
+
+# ifndef OPENSSL_NO_STDIO
+/*
+ * Read the certificate, chain and key of |e|, without holding any lock,
+ * and keep them in |e| unless another thread got there first. After a
+ * failure the files are not read again for SNI_LOAD_RETRY seconds, twice
+ * as long after each further failure, so that clients asking for a broken
+ * name don't have them parsed on every connection.
+ */
+static int sni_entry_load(SSL_SNI_ENTRY *e)
+{
+    pem_password_cb *cb = e->ctx->default_passwd_callback;
+    void *u = e->ctx->default_passwd_callback_userdata;
+    STACK_OF(X509) *chain = NULL;
+    EVP_PKEY *pkey = NULL;
+    X509 *x = NULL, *ca;
+    BIO *in = NULL;
+    unsigned long err;
+    int ok = 0;
+
+    if ((in = BIO_new_file(e->certfile, "r")) == NULL
+        || (x = PEM_read_bio_X509_AUX(in, NULL, cb, u)) == NULL) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_PEM_LIB);
+        goto end;
+    }
+    if ((chain = sk_X509_new_null()) == NULL) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_MALLOC_FAILURE);
+        goto end;
+    }
+    while ((ca = PEM_read_bio_X509(in, NULL, cb, u)) != NULL) {
+        if (!sk_X509_push(chain, ca)) {
+            X509_free(ca);
+            SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_MALLOC_FAILURE);
+            goto end;
+        }
+    }
+    /* Running out of certificates is the normal end of the file */
+    err = ERR_peek_last_error();
+    if (ERR_GET_LIB(err) != ERR_LIB_PEM
+        || ERR_GET_REASON(err) != PEM_R_NO_START_LINE) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_PEM_LIB);
+        goto end;
+    }
+    ERR_clear_error();
+
+    if (strcmp(e->keyfile, e->certfile) != 0) {
+        BIO_free(in);
+        if ((in = BIO_new_file(e->keyfile, "r")) == NULL) {
+            SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_SYS_LIB);
+            goto end;
+        }
+    } else if (BIO_reset(in) != 0) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_SYS_LIB);
+        goto end;
+    }
+    if ((pkey = PEM_read_bio_PrivateKey(in, NULL, cb, u)) == NULL) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_PEM_LIB);
+        goto end;
+    }
+    if (!X509_check_private_key(x, pkey)) {
+        SSLerr(SSL_F_SNI_ENTRY_LOAD, ERR_R_X509_LIB);
+        goto end;
+    }
+    ok = 1;
+
+ end:
+    BIO_free(in);
+    if (ok) {
+        CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+        if (e->x == NULL) {
+            e->chain = chain;
+            e->pkey = pkey;
+            e->x = x;
+            x = NULL;
+            chain = NULL;
+            pkey = NULL;
+        }
+        CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    } else {
+        CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+        if (e->retry_wait == 0)
+            e->retry_wait = SNI_LOAD_RETRY;
+        else if (e->retry_wait < SNI_LOAD_RETRY_MAX)
+            e->retry_wait *= 2;
+        e->retry = time(NULL) + e->retry_wait;
+        CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    }
+    X509_free(x);
+    sk_X509_pop_free(chain, X509_free);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+# endif
+
+/*
+ * Switch |s| to the SSL_CTX that its initial SSL_CTX's map has for the
+ * requested name. Returns an SSL_TLSEXT_ERR_* value.
+ */
+int ssl_sni_map_select(SSL *s)
+{
+    SSL_SNI_MAP *map = s->initial_ctx->sni_map;
+    SSL_SNI_ENTRY *e;
+    X509 *x = NULL;
+    time_t retry = 0;
+    const char *name = SSL_get_servername(s, TLSEXT_NAMETYPE_host_name);
+
+    if (name == NULL)
+        return SSL_TLSEXT_ERR_NOACK;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((e = sni_map_find(map, name)) != NULL) {
+        x = e->x;
+        retry = e->retry;
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (e == NULL)
+        return SSL_TLSEXT_ERR_NOACK;
+
+    if (e->certfile != NULL && x == NULL) {
+        /* Failed recently: don't read the files again yet */
+        if (retry != 0 && time(NULL) < retry)
+            return SSL_TLSEXT_ERR_ALERT_FATAL;
+# ifndef OPENSSL_NO_STDIO
+        if (!sni_entry_load(e))
+            return SSL_TLSEXT_ERR_ALERT_FATAL;
+# endif
+        CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+        x = e->x;
+        CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    }
+
+    if (SSL_set_SSL_CTX(s, e->ctx) == NULL)
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    /* Once set, the certificate, chain and key do not change */
+    if (x != NULL && (!SSL_use_certificate(s, x)
+                      || !SSL_use_PrivateKey(s, e->pkey)
+                      || !SSL_set1_chain(s, e->chain)))
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+#endif                          /* !OPENSSL_NO_TLSEXT */
@@ -0,0 +1,345 @@
+/* ssl/ssl_xcache.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+/*
+ * Cache of parsed peer certificates shared by the connections of an
+ * SSL_CTX. Peers commonly present the same few intermediate certificates,
+ * so instead of a full d2i_X509() a repeated certificate costs a SHA-256
+ * over its encoding and a hash table lookup. Entries are matched on the
+ * complete encoding and hold a reference to the X509 handed out to every
+ * connection. Lookups only take the SSL_CTX lock for reading: a hit just
+ * marks its entry as used, and eviction gives used entries a second chance
+ * before dropping them, which approximates least recently used order.
+ *
+ * Sessions that hold their peer certificate by reference record only the
+ * digest and length of its encoding; ssl_cert_cache_get() finds the
+ * certificate again from those, relying on SHA-256 alone.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ssl_locl.h"
+#include <openssl/lhash.h>
+#include <openssl/sha.h>
+
+typedef struct ssl_cert_cache_entry_st SSL_CERT_CACHE_ENTRY;
+
+struct ssl_cert_cache_entry_st {
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    const unsigned char *der;
+    long der_len;
+    X509 *x;
+    /* Set on every hit, cleared when the entry is spared eviction */
+    int used;
+    SSL_CERT_CACHE_ENTRY *prev, *next;
+};
+
+DECLARE_LHASH_OF(SSL_CERT_CACHE_ENTRY);
+
+struct ssl_cert_cache_st {
+    LHASH_OF(SSL_CERT_CACHE_ENTRY) *entries;
+    /* Most recently added or spared first */
+    SSL_CERT_CACHE_ENTRY *head, *tail;
+    unsigned long max;
+};
+
+static unsigned long ssl_cert_cache_entry_hash(const SSL_CERT_CACHE_ENTRY *a)
+{
+    return ((unsigned long)a->md[0]) | ((unsigned long)a->md[1] << 8) |
+        ((unsigned long)a->md[2] << 16) | ((unsigned long)a->md[3] << 24);
+}
+
+static IMPLEMENT_LHASH_HASH_FN(ssl_cert_cache_entry, SSL_CERT_CACHE_ENTRY)
+
+static int ssl_cert_cache_entry_cmp(const SSL_CERT_CACHE_ENTRY *a,
+                                    const SSL_CERT_CACHE_ENTRY *b)
+{
+    if (a->der_len != b->der_len)
+        return a->der_len < b->der_len ? -1 : 1;
+    if (memcmp(a->md, b->md, sizeof(a->md)))
+        return memcmp(a->md, b->md, sizeof(a->md));
+    /* A lookup by reference has no encoding to compare */
+    if (a->der == NULL || b->der == NULL)
+        return 0;
+    return memcmp(a->der, b->der, a->der_len);
+}
+
+static IMPLEMENT_LHASH_COMP_FN(ssl_cert_cache_entry, SSL_CERT_CACHE_ENTRY)
+
+static void cert_cache_entry_free(SSL_CERT_CACHE_ENTRY *e)
+{
+    X509_free(e->x);
+    OPENSSL_free((unsigned char *)e->der);
+    OPENSSL_free(e);
+}
+
+static void cert_cache_unlink(SSL_CERT_CACHE *c, SSL_CERT_CACHE_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        c->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        c->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void cert_cache_link_head(SSL_CERT_CACHE *c, SSL_CERT_CACHE_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head != NULL)
+        c->head->prev = e;
+    else
+        c->tail = e;
+    c->head = e;
+}
+
+/*
+ * Evict entries until no more than |num| are left. Entries used since they
+ * were last considered are moved back to the head instead, unless the cache
+ * is being emptied.
+ */
+static void cert_cache_trim(SSL_CERT_CACHE *c, unsigned long num)
+{
+    SSL_CERT_CACHE_ENTRY *e;
+
+    while (lh_SSL_CERT_CACHE_ENTRY_num_items(c->entries) > num) {
+        e = c->tail;
+        cert_cache_unlink(c, e);
+        if (e->used && num > 0) {
+            e->used = 0;
+            cert_cache_link_head(c, e);
+            continue;
+        }
+        (void)lh_SSL_CERT_CACHE_ENTRY_delete(c->entries, e);
+        cert_cache_entry_free(e);
+    }
+}
+
+void ssl_cert_cache_free(SSL_CERT_CACHE *c)
+{
+    if (c == NULL)
+        return;
+    cert_cache_trim(c, 0);
+    lh_SSL_CERT_CACHE_ENTRY_free(c->entries);
+    OPENSSL_free(c);
+}
+
+/*
+ * Set the maximum number of cached certificates, zero disables the cache.
+ * Returns the previous maximum.
+ */
+long ssl_cert_cache_set_size(SSL_CTX *ctx, long size)
+{
+    SSL_CERT_CACHE *c, *old = NULL;
+    long ret;
+
+    if (size < 0)
+        return -1;
+
+    c = NULL;
+    if (size > 0 && ctx->cert_cache == NULL) {
+        c = OPENSSL_malloc(sizeof(*c));
+        if (c == NULL)
+            return -1;
+        c->entries = lh_SSL_CERT_CACHE_ENTRY_new();
+        if (c->entries == NULL) {
+            OPENSSL_free(c);
+            return -1;
+        }
+        c->head = c->tail = NULL;
+    }
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    ret = ctx->cert_cache != NULL ? (long)ctx->cert_cache->max : 0;
+    if (size == 0) {
+        old = ctx->cert_cache;
+        ctx->cert_cache = NULL;
+    } else {
+        if (ctx->cert_cache == NULL) {
+            ctx->cert_cache = c;
+            ctx->cert_cache_hits = 0;
+            c = NULL;
+        }
+        ctx->cert_cache->max = size;
+        cert_cache_trim(ctx->cert_cache, size);
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    ssl_cert_cache_free(c);
+    ssl_cert_cache_free(old);
+    return ret;
+}
+
+long ssl_cert_cache_ctrl(SSL_CTX *ctx, int cmd)
+{
+    long ret = 0;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    if (ctx->cert_cache != NULL) {
+        switch (cmd) {
+        case SSL_CTRL_GET_CERT_CACHE_SIZE:
+            ret = ctx->cert_cache->max;
+            break;
+        case SSL_CTRL_CERT_CACHE_NUMBER:
+            ret = lh_SSL_CERT_CACHE_ENTRY_num_items(ctx->cert_cache->entries);
+            break;
+        case SSL_CTRL_CERT_CACHE_HITS:
+            ret = ctx->cert_cache_hits;
+            break;
+        }
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    return ret;
+}
+
+/*
+ * Return a new reference to the certificate matching |tmp|, or NULL. Only
+ * the SSL_CTX read lock is taken: the entry is marked as used rather than
+ * moved, and every thread that stores to |used| stores 1.
+ */
+static X509 *cert_cache_hit(SSL_CTX *ctx, SSL_CERT_CACHE_ENTRY *tmp)
+{
+    SSL_CERT_CACHE_ENTRY *e;
+    X509 *x = NULL;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    if (ctx->cert_cache != NULL
+        && (e = lh_SSL_CERT_CACHE_ENTRY_retrieve(ctx->cert_cache->entries,
+                                                 tmp)) != NULL) {
+        e->used = 1;
+        x = e->x;
+        CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509);
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (x != NULL)
+        CRYPTO_add(&ctx->cert_cache_hits, 1, CRYPTO_LOCK_SSL_CTX);
+    return x;
+}
+
+/*
+ * Decode a peer certificate of |len| bytes as d2i_X509() would, returning a
+ * cached X509 if the same encoding was seen before. Only certificates that
+ * take up exactly |len| bytes are cached.
+ */
+X509 *ssl_cert_cache_d2i(SSL_CTX *ctx, const unsigned char **pp, long len)
+{
+    SSL_CERT_CACHE_ENTRY tmp, *e;
+    const unsigned char *p = *pp;
+    unsigned char *der;
+    X509 *x;
+
+    if (ctx->cert_cache == NULL || len <= 0)
+        return d2i_X509(NULL, pp, len);
+
+    SHA256(p, len, tmp.md);
+    tmp.der = p;
+    tmp.der_len = len;
+
+    if ((x = cert_cache_hit(ctx, &tmp)) != NULL) {
+        *pp += len;
+        return x;
+    }
+
+    x = d2i_X509(NULL, pp, len);
+    if (x == NULL || *pp != p + len)
+        return x;
+
+    /* Failure to add the entry only costs a decode next time */
+    e = OPENSSL_malloc(sizeof(*e));
+    der = OPENSSL_malloc(len);
+    if (e == NULL || der == NULL) {
+        OPENSSL_free(e);
+        OPENSSL_free(der);
+        return x;
+    }
+    memcpy(der, p, len);
+    memcpy(e->md, tmp.md, sizeof(e->md));
+    e->der = der;
+    e->der_len = len;
+    e->x = x;
+    e->used = 0;
+    CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509);
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if (ctx->cert_cache != NULL
+        && lh_SSL_CERT_CACHE_ENTRY_retrieve(ctx->cert_cache->entries,
+                                            e) == NULL) {
+        (void)lh_SSL_CERT_CACHE_ENTRY_insert(ctx->cert_cache->entries, e);
+        if (!lh_SSL_CERT_CACHE_ENTRY_error(ctx->cert_cache->entries)) {
+            cert_cache_link_head(ctx->cert_cache, e);
+            cert_cache_trim(ctx->cert_cache, ctx->cert_cache->max);
+            e = NULL;
+        }
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    if (e != NULL)
+        cert_cache_entry_free(e);
+    return x;
+}
+
+/*
+ * Look up a certificate by the SHA-256 digest |md| and length |len| of its
+ * encoding. Returns a new reference to it, or NULL if it is not cached.
+ */
+X509 *ssl_cert_cache_get(SSL_CTX *ctx, const unsigned char *md, long len)
+{
+    SSL_CERT_CACHE_ENTRY tmp;
+
+    memcpy(tmp.md, md, sizeof(tmp.md));
+    tmp.der = NULL;
+    tmp.der_len = len;
+    return cert_cache_hit(ctx, &tmp);
+}
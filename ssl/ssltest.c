@@ -187,6 +187,9 @@
 #ifndef OPENSSL_NO_SRP
 # include <openssl/srp.h>
 #endif
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+# include <openssl/ocsp.h>
+#endif
 #include <openssl/bn.h>
 
 /*
@@ -202,6 +205,9 @@
 #else
 # include OPENSSL_UNISTD
 #endif
+#ifdef OPENSSL_SYS_UNIX
+# include <sys/wait.h>
+#endif
 
 #ifdef OPENSSL_SYS_VMS
 # define TEST_SERVER_CERT "SYS$DISK:[-.APPS]SERVER.PEM"
@@ -379,6 +385,67 @@ static int verify_ticket(SSL* ssl)
     return -1;
 }
 
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+static const char *ocsp_staple_url = NULL;
+static int ocsp_stapled = 0;
+
+/* Client side: note whether a good response was stapled */
+static int ocsp_staple_cb(SSL *s, void *arg)
+{
+    unsigned char *der;
+    const unsigned char *p;
+    OCSP_RESPONSE *resp;
+    OCSP_BASICRESP *bs = NULL;
+    long len;
+
+    len = SSL_get_tlsext_status_ocsp_resp(s, &der);
+    p = der;
+    if (der == NULL || (resp = d2i_OCSP_RESPONSE(NULL, &p, len)) == NULL)
+        return 1;
+    if (OCSP_response_status(resp) == OCSP_RESPONSE_STATUS_SUCCESSFUL
+        && (bs = OCSP_response_get1_basic(resp)) != NULL
+        && OCSP_resp_count(bs) == 1
+        && OCSP_single_get0_status(OCSP_resp_get0(bs, 0), NULL, NULL, NULL,
+                                   NULL) == V_OCSP_CERTSTATUS_GOOD)
+        ocsp_stapled = 1;
+    if (bs != NULL)
+        OCSP_BASICRESP_free(bs);
+    OCSP_RESPONSE_free(resp);
+    return 1;
+}
+
+/*
+ * Have the server fetch a response before the handshakes, which never
+ * contact the responder themselves.
+ */
+static int ocsp_staple_setup(SSL_CTX *s_ctx, SSL_CTX *c_ctx)
+{
+    time_t start = time(NULL);
+# ifndef OPENSSL_SYS_WINDOWS
+    struct timeval tv;
+# endif
+
+    /* Poll every 50ms for up to 10 seconds until the responder is up */
+    if (!SSL_CTX_set_ocsp_stapling(s_ctx, ocsp_staple_url, 1))
+        return 0;
+    while (SSL_CTX_update_ocsp_stapling(s_ctx) == 0) {
+        if (time(NULL) - start > 10) {
+            fprintf(stderr, "no OCSP response from %s\n", ocsp_staple_url);
+            return 0;
+        }
+# ifdef OPENSSL_SYS_WINDOWS
+        Sleep(50);
+# else
+        tv.tv_sec = 0;
+        tv.tv_usec = 50000;
+        select(0, NULL, NULL, NULL, &tv);
+# endif
+    }
+    SSL_CTX_set_tlsext_status_cb(c_ctx, ocsp_staple_cb);
+    return 1;
+}
+#endif
+
 static int verify_server_digest(SSL* ssl)
 {
     int nid = NID_undef;
@@ -393,6 +460,33 @@ static int verify_server_digest(SSL* ssl)
     return -1;
 }
 
+/*
+ * Compact both ends of an established connection, reporting the bytes each
+ * holds while idle.
+ */
+static int compact_idle(SSL *c_ssl, SSL *s_ssl)
+{
+    size_t c_before = SSL_get_memory_usage(c_ssl);
+    size_t s_before = SSL_get_memory_usage(s_ssl);
+    size_t c_after, s_after;
+
+    if (!SSL_compact(c_ssl) || !SSL_compact(s_ssl)) {
+        fprintf(stderr, "connection could not be compacted\n");
+        return -1;
+    }
+    c_after = SSL_get_memory_usage(c_ssl);
+    s_after = SSL_get_memory_usage(s_ssl);
+    BIO_printf(bio_stdout, "idle connection: client %lu -> %lu bytes, "
+               "server %lu -> %lu bytes\n", (unsigned long)c_before,
+               (unsigned long)c_after, (unsigned long)s_before,
+               (unsigned long)s_after);
+    if (c_after >= c_before || s_after >= s_before) {
+        fprintf(stderr, "compacting released nothing\n");
+        return -1;
+    }
+    return 1;
+}
+
 /*-
  * next_protos_parse parses a comma separated list of strings into a string
  * in a format suitable for passing to SSL_CTX_set_next_protos_advertised.
@@ -794,6 +888,7 @@ static int custom_ext_3_srv_add_cb(SSL *s, unsigned int ext_type,
 static char *cipher = NULL;
 static int verbose = 0;
 static int debug = 0;
+static int compact = 0;
 #if 0
 /* Not used yet. */
 # ifdef FIONBIO
@@ -808,6 +903,60 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long bytes, clock_t *s_time,
                  clock_t *c_time);
 int doit(SSL *s_ssl, SSL *c_ssl, long bytes);
 static int do_test_cipherlist(void);
+
+#ifdef OPENSSL_SYS_UNIX
+/*
+ * Do a handshake in a child process and take over its client session, so
+ * that only a cache shared between processes can resume it here.
+ */
+static int doit_forked(SSL *s_ssl, SSL *c_ssl, long bytes, int bio_pair,
+                       clock_t *s_time, clock_t *c_time)
+{
+    unsigned char buf[8192], *q;
+    const unsigned char *p;
+    SSL_SESSION *sess;
+    int fds[2], status, n, len = 0;
+    pid_t pid;
+
+    if (pipe(fds) != 0)
+        return 1;
+    if ((pid = fork()) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        if (bio_pair)
+            n = doit_biopair(s_ssl, c_ssl, bytes, s_time, c_time);
+        else
+            n = doit(s_ssl, c_ssl, bytes);
+        len = i2d_SSL_SESSION(SSL_get_session(c_ssl), NULL);
+        if (n == 0 && len > 0 && len <= (int)sizeof(buf)) {
+            q = buf;
+            i2d_SSL_SESSION(SSL_get_session(c_ssl), &q);
+            n = write(fds[1], buf, len) != len;
+        }
+        _exit(n);
+    }
+    close(fds[1]);
+    while (len < (int)sizeof(buf)
+           && (n = read(fds[0], buf + len, sizeof(buf) - len)) > 0)
+        len += n;
+    close(fds[0]);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+        || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "handshake in child process failed\n");
+        return 1;
+    }
+    p = buf;
+    if ((sess = d2i_SSL_SESSION(NULL, &p, len)) == NULL)
+        return 1;
+    SSL_set_session(c_ssl, sess);
+    SSL_SESSION_free(sess);
+    return 0;
+}
+#endif
 static void sv_usage(void)
 {
     fprintf(stderr, "usage: ssltest [args ...]\n");
@@ -824,6 +973,26 @@ static void sv_usage(void)
     fprintf(stderr, " -v            - more output\n");
     fprintf(stderr, " -d            - debug output\n");
     fprintf(stderr, " -reuse        - use session-id reuse\n");
+    fprintf(stderr,
+            " -cert_cache <val> - cache up to <val> parsed peer certificates\n");
+    fprintf(stderr,
+            " -peer_by_ref  - keep peer certificates of sessions by reference\n");
+    fprintf(stderr,
+            " -release_buffers - release record buffers when they are empty\n");
+    fprintf(stderr,
+            " -read_ahead   - read as many records as are available at once\n");
+    fprintf(stderr,
+            " -compact      - compact connections between handshakes\n");
+    fprintf(stderr,
+            " -dyn_records  - send 1K records until 4K bytes have been sent\n");
+    fprintf(stderr,
+            " -shm_cache <val> - keep <val> server sessions in shared memory\n");
+#ifdef OPENSSL_SYS_UNIX
+    fprintf(stderr,
+            " -fork_first   - do the first handshake in a child process\n");
+#endif
+    fprintf(stderr,
+            " -ctx_template - serve from contexts derived from the configured ones\n");
     fprintf(stderr, " -num <val>    - number of connections to perform\n");
     fprintf(stderr,
             " -bytes <val>  - number of bytes to swap between client/server\n");
@@ -903,12 +1072,16 @@ static void sv_usage(void)
     fprintf(stderr, " -sn_expect1          - expected server 1\n");
     fprintf(stderr, " -sn_expect2          - expected server 2\n");
 #ifndef OPENSSL_NO_TLSEXT
-    fprintf(stderr, " -s_ticket1 <yes|no|broken> - enable/disable session tickets on context 1\n");
+    fprintf(stderr, " -s_ticket1 <yes|no|broken|ring> - enable/disable session tickets on context 1\n");
     fprintf(stderr, " -s_ticket2 <yes|no>        - enable/disable session tickets on context 2\n");
     fprintf(stderr, " -c_ticket <yes|no>         - enable/disable session tickets on the client\n");
     fprintf(stderr, " -ticket_expect <yes|no>    - indicate that the client should (or should not) have a ticket\n");
+#endif
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+    fprintf(stderr, " -ocsp_staple <url>         - staple OCSP responses from this responder\n");
 #endif
     fprintf(stderr, " -sni_in_cert_cb           - have the server handle SNI in the certificate callback\n");
+    fprintf(stderr, " -sni_map                  - have the server handle SNI with a built-in map\n");
     fprintf(stderr, " -client_sigalgs arg       - the signature algorithms to configure on the client\n");
     fprintf(stderr, " -server_digest_expect arg - the expected server signing digest\n");
 }
@@ -1053,7 +1226,13 @@ int main(int argc, char *argv[])
     const SSL_METHOD *meth = NULL;
     SSL *c_ssl, *s_ssl;
     int number = 1, reuse = 0;
-    long bytes = 256L;
+    long bytes = 256L, cert_cache = 0, shm_cache = 0;
+    int peer_by_ref = 0, ctx_template = 0, release_buffers = 0;
+    int dyn_records = 0, read_ahead = 0, fork_first = 0;
+#ifndef OPENSSL_NO_TLSEXT
+    int use_sni_map = 0;
+    SSL_SNI_MAP *sni_map = NULL;
+#endif
 #ifndef OPENSSL_NO_DH
     DH *dh;
     int dhe512 = 0, dhe1024dsa = 0;
@@ -1217,6 +1396,30 @@ int main(int argc, char *argv[])
             number = atoi(*(++argv));
             if (number == 0)
                 number = 1;
+        } else if (strcmp(*argv, "-cert_cache") == 0) {
+            if (--argc < 1)
+                goto bad;
+            cert_cache = atol(*(++argv));
+        } else if (strcmp(*argv, "-peer_by_ref") == 0) {
+            peer_by_ref = 1;
+        } else if (strcmp(*argv, "-release_buffers") == 0) {
+            release_buffers = 1;
+        } else if (strcmp(*argv, "-read_ahead") == 0) {
+            read_ahead = 1;
+        } else if (strcmp(*argv, "-compact") == 0) {
+            compact = 1;
+        } else if (strcmp(*argv, "-dyn_records") == 0) {
+            dyn_records = 1;
+        } else if (strcmp(*argv, "-shm_cache") == 0) {
+            if (--argc < 1)
+                goto bad;
+            shm_cache = atol(*(++argv));
+#ifdef OPENSSL_SYS_UNIX
+        } else if (strcmp(*argv, "-fork_first") == 0) {
+            fork_first = 1;
+#endif
+        } else if (strcmp(*argv, "-ctx_template") == 0) {
+            ctx_template = 1;
         } else if (strcmp(*argv, "-bytes") == 0) {
             if (--argc < 1)
                 goto bad;
@@ -1354,6 +1557,8 @@ int main(int argc, char *argv[])
                 s_ticket1 = 1;
             if (strcmp(*argv, "broken") == 0)
                 s_ticket1 = 2;
+            if (strcmp(*argv, "ring") == 0)
+                s_ticket1 = 3;
         } else if (strcmp(*argv, "-s_ticket2") == 0) {
             if (--argc < 1)
                 goto bad;
@@ -1374,9 +1579,19 @@ int main(int argc, char *argv[])
                 ticket_expect = 1;
             else if (strcmp(*argv, "no") == 0)
                 ticket_expect = 0;
+#endif
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+        } else if (strcmp(*argv, "-ocsp_staple") == 0) {
+            if (--argc < 1)
+                goto bad;
+            ocsp_staple_url = *(++argv);
 #endif
         } else if (strcmp(*argv, "-sni_in_cert_cb") == 0) {
             sni_in_cert_cb = 1;
+#ifndef OPENSSL_NO_TLSEXT
+        } else if (strcmp(*argv, "-sni_map") == 0) {
+            use_sni_map = 1;
+#endif
         } else if (strcmp(*argv, "-client_sigalgs") == 0) {
             if (--argc < 1)
                 goto bad;
@@ -1539,6 +1754,37 @@ int main(int argc, char *argv[])
         goto end;
     }
 
+    if (cert_cache > 0) {
+        SSL_CTX_set_cert_cache_size(c_ctx, cert_cache);
+        SSL_CTX_set_cert_cache_size(s_ctx, cert_cache);
+        SSL_CTX_set_cert_cache_size(s_ctx2, cert_cache);
+    }
+    if (peer_by_ref) {
+        SSL_CTX_set_mode(c_ctx, SSL_MODE_PEER_CERT_BY_REFERENCE);
+        SSL_CTX_set_mode(s_ctx, SSL_MODE_PEER_CERT_BY_REFERENCE);
+        SSL_CTX_set_mode(s_ctx2, SSL_MODE_PEER_CERT_BY_REFERENCE);
+    }
+    if (release_buffers) {
+        SSL_CTX_set_mode(c_ctx, SSL_MODE_RELEASE_BUFFERS);
+        SSL_CTX_set_mode(s_ctx, SSL_MODE_RELEASE_BUFFERS);
+        SSL_CTX_set_mode(s_ctx2, SSL_MODE_RELEASE_BUFFERS);
+    }
+    if (read_ahead) {
+        SSL_CTX_set_read_ahead(c_ctx, 1);
+        SSL_CTX_set_read_ahead(s_ctx, 1);
+        SSL_CTX_set_read_ahead(s_ctx2, 1);
+    }
+    if (dyn_records) {
+        SSL_CTX_set_dynamic_record_sizing(c_ctx, 1024, 4096, 1);
+        SSL_CTX_set_dynamic_record_sizing(s_ctx, 1024, 4096, 1);
+        SSL_CTX_set_dynamic_record_sizing(s_ctx2, 1024, 4096, 1);
+    }
+    if (shm_cache > 0
+        && !SSL_CTX_set_shared_session_cache(s_ctx, shm_cache, 0)) {
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+
     if (cipher != NULL) {
         SSL_CTX_set_cipher_list(c_ctx, cipher);
         SSL_CTX_set_cipher_list(s_ctx, cipher);
@@ -1821,6 +2067,20 @@ int main(int argc, char *argv[])
         OPENSSL_free(alpn);
     }
 
+#ifndef OPENSSL_NO_TLSEXT
+    if (use_sni_map) {
+        /* Context 2 gets the server certificate again, on first use */
+        if ((sni_map = SSL_SNI_MAP_new()) == NULL
+            || (sn_server1 && !SSL_SNI_MAP_add(sni_map, sn_server1, s_ctx))
+            || (sn_server2
+                && !SSL_SNI_MAP_add_files(sni_map, sn_server2, s_ctx2,
+                                          server_cert, server_key))) {
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+        SSL_CTX_set_sni_map(s_ctx, sni_map);
+    } else
+#endif
     if (sn_server1 || sn_server2) {
         if (sni_in_cert_cb)
             SSL_CTX_set_cert_cb(s_ctx, cert_cb, NULL);
@@ -1831,10 +2091,17 @@ int main(int argc, char *argv[])
 #ifndef OPENSSL_NO_TLSEXT
     if (s_ticket1 == 0)
         SSL_CTX_set_options(s_ctx, SSL_OP_NO_TICKET);
-    /* always set the callback */
+    /* always set the callback, unless testing the built-in key ring */
     if (s_ticket1 == 2)
         SSL_CTX_set_tlsext_ticket_key_cb(s_ctx, cb_ticket0);
-    else
+    else if (s_ticket1 == 3) {
+        /* Only the ticket can resume, and only with a ring key */
+        SSL_CTX_set_session_cache_mode(s_ctx, SSL_SESS_CACHE_OFF);
+        if (!SSL_CTX_set_ticket_key_rotation(s_ctx, 2, 0)) {
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+    } else
         SSL_CTX_set_tlsext_ticket_key_cb(s_ctx, cb_ticket1);
 
     if (!s_ticket2)
@@ -1849,11 +2116,60 @@ int main(int argc, char *argv[])
     if (client_sigalgs != NULL)
         SSL_CTX_set1_sigalgs_list(c_ctx, client_sigalgs);
 
+    if (ctx_template) {
+        SSL_CTX *tmp;
+        X509_STORE *tmpl_store = SSL_CTX_get_cert_store(s_ctx);
+
+        /* The contexts configured so far only serve as templates */
+        if ((tmp = SSL_CTX_new_from_template(s_ctx)) == NULL) {
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+        SSL_CTX_free(s_ctx);
+        s_ctx = tmp;
+        if ((tmp = SSL_CTX_new_from_template(s_ctx2)) == NULL) {
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+        /* A template's cipher lists are in use and must stay as they are */
+        if (SSL_CTX_set_cipher_list(s_ctx2, "ALL")) {
+            fprintf(stderr, "Template cipher list changed\n");
+            goto end;
+        }
+        ERR_clear_error();
+        SSL_CTX_free(s_ctx2);
+        s_ctx2 = tmp;
+        /* Verify client certificates with a copy of the shared store */
+        if (SSL_CTX_get_cert_store(s_ctx) != tmpl_store) {
+            fprintf(stderr, "Template certificate store not shared\n");
+            goto end;
+        }
+        if (!SSL_CTX_unshare_cert_store(s_ctx)) {
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+        if (SSL_CTX_get_cert_store(s_ctx) == tmpl_store) {
+            fprintf(stderr, "Certificate store still shared\n");
+            goto end;
+        }
+    }
+
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+    if (ocsp_staple_url != NULL && !ocsp_staple_setup(s_ctx, c_ctx)) {
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+#endif
+
     c_ssl = SSL_new(c_ctx);
     s_ssl = SSL_new(s_ctx);
 
     if (sn_client)
         SSL_set_tlsext_host_name(c_ssl, sn_client);
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+    if (ocsp_staple_url != NULL)
+        SSL_set_tlsext_status_type(c_ssl, TLSEXT_STATUSTYPE_ocsp);
+#endif
 
 #ifndef OPENSSL_NO_KRB5
     if (c_ssl && c_ssl->kssl_ctx) {
@@ -1873,6 +2189,20 @@ int main(int argc, char *argv[])
     for (i = 0; i < number; i++) {
         if (!reuse)
             SSL_set_session(c_ssl, NULL);
+#ifndef OPENSSL_NO_TLSEXT
+        /* The previous ticket must still open with the previous key */
+        if (s_ticket1 == 3 && i > 0)
+            SSL_CTX_rotate_ticket_keys(s_ctx);
+        /* Start on the first context again, as a new SSL object would */
+        if (sn_server2 != NULL && i > 0)
+            SSL_set_SSL_CTX(s_ssl, s_ctx);
+#endif
+#ifdef OPENSSL_SYS_UNIX
+        if (fork_first && i == 0)
+            ret = doit_forked(s_ssl, c_ssl, bytes, bio_pair, &s_time,
+                              &c_time);
+        else
+#endif
         if (bio_pair)
             ret = doit_biopair(s_ssl, c_ssl, bytes, &s_time, &c_time);
         else
@@ -1885,6 +2215,63 @@ int main(int argc, char *argv[])
     if ((number > 1) || (bytes > 1L))
         BIO_printf(bio_stdout, "%d handshakes of %ld bytes done\n", number,
                    bytes);
+#ifndef OPENSSL_NO_TLSEXT
+    if (s_ticket1 == 3 && reuse && number > 1 && ret == 0
+        && !SSL_session_reused(c_ssl)) {
+        fprintf(stderr, "session not resumed from ticket\n");
+        ret = 1;
+    }
+#endif
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP)
+    if (ocsp_staple_url != NULL && ret == 0 && !ocsp_stapled) {
+        fprintf(stderr, "no good OCSP response stapled\n");
+        ret = 1;
+    }
+#endif
+    if (peer_by_ref && reuse && number > 1 && ret == 0) {
+        X509 *peer;
+
+        /* The ticket only has the reference, resolved on resumption */
+        if (!SSL_session_reused(s_ssl) || s_ssl->session->peer_ref_len == 0
+            || (peer = SSL_get_peer_certificate(s_ssl)) == NULL) {
+            fprintf(stderr, "peer certificate not held by reference\n");
+            ret = 1;
+        } else
+            X509_free(peer);
+    }
+    /* The internal cache is off, so only the shared one can resume */
+    if (shm_cache > 0 && reuse && number > 1 && ret == 0
+        && !SSL_session_reused(s_ssl)) {
+        fprintf(stderr, "session not resumed from shared cache\n");
+        ret = 1;
+    }
+    if (cert_cache > 0) {
+        BIO_printf(bio_stdout, "%ld client and %ld server certificate cache "
+                   "hits\n", SSL_CTX_cert_cache_hits(c_ctx),
+                   SSL_CTX_cert_cache_hits(s_ctx));
+        /* Every handshake after the first one resends the same chain */
+        if (number > 1 && !reuse && SSL_CTX_cert_cache_hits(c_ctx) == 0) {
+            fprintf(stderr, "peer certificate cache not used\n");
+            ret = 1;
+        }
+    }
+    if (dyn_records) {
+        BIO_printf(bio_stdout, "client records of up to 512/1K/2K/4K/8K/16K "
+                   "bytes:");
+        for (i = 0; i < SSL_RECORD_SIZE_BUCKETS; i++)
+            BIO_printf(bio_stdout, " %ld", SSL_CTX_record_count(c_ctx, i));
+        BIO_printf(bio_stdout, "\n");
+        /* Each connection starts with four 1K records, then grows */
+        if (ret == 0 && bytes > 4096
+            && (SSL_CTX_record_count(c_ctx, 1) < 4 * number
+                || SSL_CTX_record_count(c_ctx, 2)
+                + SSL_CTX_record_count(c_ctx, 3)
+                + SSL_CTX_record_count(c_ctx, 4)
+                + SSL_CTX_record_count(c_ctx, 5) == 0)) {
+            fprintf(stderr, "records not sized dynamically\n");
+            ret = 1;
+        }
+    }
     if (print_time) {
 #ifdef CLOCKS_PER_SEC
         /*
@@ -1927,6 +2314,9 @@ int main(int argc, char *argv[])
         SSL_CTX_free(s_ctx2);
     if (c_ctx != NULL)
         SSL_CTX_free(c_ctx);
+#ifndef OPENSSL_NO_TLSEXT
+    SSL_SNI_MAP_free(sni_map);
+#endif
 
     if (bio_stdout != NULL)
         BIO_free(bio_stdout);
@@ -2298,6 +2688,12 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
         goto err;
     }
 
+    /* Before the BIOs go, as freeing the SSL BIO sends close_notify */
+    if (compact && compact_idle(c_ssl, s_ssl) < 0) {
+        ret = 1;
+        goto err;
+    }
+
  end:
     ret = 0;
 
@@ -2325,6 +2721,11 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 #define C_DONE  1
 #define S_DONE  2
 
+static int read_ahead_left(SSL *s)
+{
+    return s->s3 != NULL && s->s3->rbuf.left > 0;
+}
+
 int doit(SSL *s_ssl, SSL *c_ssl, long count)
 {
     char *cbuf = NULL, *sbuf = NULL;
@@ -2388,11 +2789,12 @@ int doit(SSL *s_ssl, SSL *c_ssl, long count)
         do_server = 0;
         do_client = 0;
 
-        i = (int)BIO_pending(s_bio);
+        /* Read-ahead may leave whole records in rbuf, not in the BIOs */
+        i = (int)BIO_pending(s_bio) || read_ahead_left(s_ssl);
         if ((i && s_r) || s_w)
             do_server = 1;
 
-        i = (int)BIO_pending(c_bio);
+        i = (int)BIO_pending(c_bio) || read_ahead_left(c_ssl);
         if ((i && c_r) || c_w)
             do_client = 1;
 
@@ -2572,6 +2974,10 @@ int doit(SSL *s_ssl, SSL *c_ssl, long count)
         ret = 1;
         goto err;
     }
+    if (compact && compact_idle(c_ssl, s_ssl) < 0) {
+        ret = 1;
+        goto err;
+    }
     ret = 0;
  err:
     /*
@@ -125,6 +125,9 @@
 const char tls1_version_str[] = "TLSv1" OPENSSL_VERSION_PTEXT;
 
 #ifndef OPENSSL_NO_TLSEXT
+static int tls_ticket_session(unsigned char *sdec, int slen,
+                              const unsigned char *sess_id, int sesslen,
+                              SSL_SESSION **psess, int renew_ticket);
 static int tls_decrypt_ticket(SSL *s, const unsigned char *tick, int ticklen,
                               const unsigned char *sess_id, int sesslen,
                               SSL_SESSION **psess);
@@ -3082,6 +3085,15 @@ static int ssl_check_clienthello_tlsext_early(SSL *s)
      */
 # endif
 
+    /* The built-in name map goes first; a callback can still override it */
+    if (s->initial_ctx != NULL && s->initial_ctx->sni_map != NULL) {
+        ret = ssl_sni_map_select(s);
+        if (ret == SSL_TLSEXT_ERR_ALERT_FATAL) {
+            ssl3_send_alert(s, SSL3_AL_FATAL, SSL_AD_INTERNAL_ERROR);
+            return -1;
+        }
+    }
+
     if (s->ctx != NULL && s->ctx->tlsext_servername_callback != 0)
         ret =
             s->ctx->tlsext_servername_callback(s, &al,
@@ -3225,9 +3237,15 @@ int ssl_check_clienthello_tlsext_late(SSL *s, int *al)
      * If status request then ask callback what to do. Note: this must be
      * called after servername callbacks in case the certificate has changed,
      * and must be called after the cipher has been chosen because this may
-     * influence which certificate is sent
+     * influence which certificate is sent. Without a callback, the built-in
+     * stapling cache is used if set up.
      */
-    if ((s->tlsext_status_type != -1) && s->ctx && s->ctx->tlsext_status_cb) {
+    if ((s->tlsext_status_type != -1) && s->ctx
+        && (s->ctx->tlsext_status_cb
+# if !defined(OPENSSL_NO_OCSP) && !defined(OPENSSL_NO_SOCK)
+            || s->ctx->ocsp_stapling
+# endif
+        )) {
         int ret;
         CERT_PKEY *certpkey;
         certpkey = ssl_get_server_send_pkey(s);
@@ -3238,7 +3256,12 @@ int ssl_check_clienthello_tlsext_late(SSL *s, int *al)
              * et al can pick it up.
              */
             s->cert->key = certpkey;
-            ret = s->ctx->tlsext_status_cb(s, s->ctx->tlsext_status_arg);
+# if !defined(OPENSSL_NO_OCSP) && !defined(OPENSSL_NO_SOCK)
+            if (s->ctx->tlsext_status_cb == NULL)
+                ret = ssl_ocsp_stapling_cb(s);
+            else
+# endif
+                ret = s->ctx->tlsext_status_cb(s, s->ctx->tlsext_status_arg);
             switch (ret) {
                 /* We don't want to send a status request response */
             case SSL_TLSEXT_ERR_NOACK:
@@ -3543,7 +3566,6 @@ static int tls_decrypt_ticket(SSL *s, const unsigned char *etick,
                               int eticklen, const unsigned char *sess_id,
                               int sesslen, SSL_SESSION **psess)
 {
-    SSL_SESSION *sess;
     unsigned char *sdec;
     const unsigned char *p;
     int slen, mlen, renew_ticket = 0;
@@ -3556,6 +3578,27 @@ static int tls_decrypt_ticket(SSL *s, const unsigned char *etick,
     if (eticklen < 16 + EVP_MAX_IV_LENGTH)
         return 2;
 
+    if (tctx->tlsext_ticket_key_cb == NULL && tctx->ticket_keys != NULL) {
+        switch (tls1_ticket_keys_decrypt(tctx, etick, eticklen,
+                                         &sdec, &slen)) {
+        case 0:
+            /*
+             * Not sealed by the ring: it may still be from the context's
+             * own key, used before the ring was set up.
+             */
+            renew_ticket = 1;
+            break;
+        case 1:
+            return 2;
+        case 2:
+            return tls_ticket_session(sdec, slen, sess_id, sesslen, psess, 0);
+        case 3:
+            return tls_ticket_session(sdec, slen, sess_id, sesslen, psess, 1);
+        default:
+            return -1;
+        }
+    }
+
     /* Initialize session ticket encryption and HMAC contexts */
     HMAC_CTX_init(&hctx);
     EVP_CIPHER_CTX_init(&ctx);
@@ -3628,9 +3671,31 @@ static int tls_decrypt_ticket(SSL *s, const unsigned char *etick,
     }
     slen += mlen;
     EVP_CIPHER_CTX_cleanup(&ctx);
-    p = sdec;
+    return tls_ticket_session(sdec, slen, sess_id, sesslen, psess,
+                              renew_ticket);
+err:
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    HMAC_CTX_cleanup(&hctx);
+    return -1;
+}
 
-    sess = d2i_SSL_SESSION(NULL, &p, slen);
+/*
+ * Decodes the session in the decrypted ticket |sdec| of length |slen| and
+ * frees |sdec|. Returns as tls_decrypt_ticket(). Tickets are issued with
+ * the compact session encoding, but ASN.1 ones from earlier versions are
+ * still accepted.
+ */
+static int tls_ticket_session(unsigned char *sdec, int slen,
+                              const unsigned char *sess_id, int sesslen,
+                              SSL_SESSION **psess, int renew_ticket)
+{
+    SSL_SESSION *sess;
+    const unsigned char *p = sdec;
+
+    if (slen > 0 && sdec[0] == (V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED))
+        sess = d2i_SSL_SESSION(NULL, &p, slen);
+    else
+        sess = b2i_SSL_SESSION(NULL, &p, slen);
     slen -= p - sdec;
     OPENSSL_free(sdec);
     if (sess) {
@@ -3659,10 +3724,6 @@ static int tls_decrypt_ticket(SSL *s, const unsigned char *etick,
      * For session parse failure, indicate that we need to send a new ticket.
      */
     return 2;
-err:
-    EVP_CIPHER_CTX_cleanup(&ctx);
-    HMAC_CTX_cleanup(&hctx);
-    return -1;
 }
 
 /* Tables to translate from NIDs to TLS v1.2 ids */
@@ -0,0 +1,494 @@
+/* ssl/t1_ocsp.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Built-in OCSP stapling. SSL_CTX_set_ocsp_stapling() prepares a request
+ * for every certificate of an SSL_CTX; the DER encoded responses are kept
+ * on the SSL_CTX and each handshake with a status request gets a copy of
+ * the one for its certificate. Handshakes never do any I/O for this.
+ * Responses are fetched with the non-blocking OCSP_sendreq_nbio(): each
+ * call to SSL_CTX_update_ocsp_stapling() advances a due fetch by whatever
+ * I/O is possible without waiting, one thread at a time. The responder
+ * address is resolved when stapling is set up, so that a fetch never
+ * blocks on a name lookup. That uses BIO_get_host_ip() because the connect
+ * BIO takes only IPv4 addresses; IPv6-only responders are not supported.
+ *
+ * The configuration is reference counted under CRYPTO_LOCK_SSL_CTX, so
+ * that replacing it does not free it under a running update. Handshakes
+ * only look at it with the lock held.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#if !defined(OPENSSL_NO_TLSEXT) && !defined(OPENSSL_NO_OCSP) \
+    && !defined(OPENSSL_NO_SOCK)
+
+# include <openssl/ocsp.h>
+# include <openssl/x509v3.h>
+
+/* All in seconds */
+# define OCSP_STAPLING_REFRESH   3600 /* default refresh interval */
+# define OCSP_STAPLING_RETRY     60 /* delay after a failed fetch */
+# define OCSP_STAPLING_TIMEOUT   10 /* limit for one fetch */
+# define OCSP_STAPLING_LEEWAY    300 /* clock skew allowed in thisUpdate */
+
+typedef struct {
+    X509 *x;
+    X509 *issuer;
+    OCSP_CERTID *id;
+    char *host;                 /* for the Host header */
+    char *conn;                 /* address:port to connect to */
+    char *path;
+    /* Current response and its nextUpdate time, 0 if none */
+    unsigned char *resp;
+    int resp_len;
+    time_t expires;
+    /* When to fetch next, and the fetch in progress */
+    time_t refresh;
+    BIO *bio;
+    OCSP_REQ_CTX *rctx;
+    time_t started;
+} SSL_OCSP_STAPLE;
+
+struct ssl_ocsp_stapling_st {
+    SSL_OCSP_STAPLE *staples;
+    int num;
+    long refresh;
+    /* Earliest time a fetch needs attention, and whether one is running */
+    time_t due;
+    int busy;
+    int references;
+};
+
+static void staple_cleanup(SSL_OCSP_STAPLE *st)
+{
+    X509_free(st->x);
+    X509_free(st->issuer);
+    if (st->id != NULL)
+        OCSP_CERTID_free(st->id);
+    if (st->host != NULL)
+        OPENSSL_free(st->host);
+    if (st->conn != NULL)
+        OPENSSL_free(st->conn);
+    if (st->path != NULL)
+        OPENSSL_free(st->path);
+    if (st->resp != NULL)
+        OPENSSL_free(st->resp);
+    if (st->rctx != NULL)
+        OCSP_REQ_CTX_free(st->rctx);
+    if (st->bio != NULL)
+        BIO_free_all(st->bio);
+}
+
+void ssl_ocsp_stapling_free(SSL_OCSP_STAPLING *stp)
+{
+    int i;
+
+    if (stp == NULL)
+        return;
+    if (CRYPTO_add(&stp->references, -1, CRYPTO_LOCK_SSL_CTX) > 0)
+        return;
+    for (i = 0; i < stp->num; i++)
+        staple_cleanup(&stp->staples[i]);
+    OPENSSL_free(stp->staples);
+    OPENSSL_free(stp);
+}
+
+static X509 *staple_find_issuer(SSL_CTX *ctx, CERT_PKEY *cpk)
+{
+    STACK_OF(X509) *chain;
+    X509_STORE_CTX sctx;
+    X509 *issuer = NULL;
+    int i;
+
+    chain = cpk->chain != NULL ? cpk->chain : ctx->extra_certs;
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        issuer = sk_X509_value(chain, i);
+        if (X509_check_issued(issuer, cpk->x509) == X509_V_OK) {
+            CRYPTO_add(&issuer->references, 1, CRYPTO_LOCK_X509);
+            return issuer;
+        }
+    }
+    issuer = NULL;
+    if (ctx->cert_store != NULL
+        && X509_STORE_CTX_init(&sctx, ctx->cert_store, cpk->x509, NULL)) {
+        if (X509_STORE_CTX_get1_issuer(&issuer, &sctx, cpk->x509) <= 0)
+            issuer = NULL;
+        X509_STORE_CTX_cleanup(&sctx);
+    }
+    return issuer;
+}
+
+static int staple_setup(SSL_CTX *ctx, SSL_OCSP_STAPLE *st, CERT_PKEY *cpk,
+                        const char *url)
+{
+    STACK_OF(OPENSSL_STRING) *aia = NULL;
+    char *port = NULL;
+    unsigned char ip[4];
+    int use_ssl, len, ret = 0;
+
+    st->x = cpk->x509;
+    CRYPTO_add(&st->x->references, 1, CRYPTO_LOCK_X509);
+    if ((st->issuer = staple_find_issuer(ctx, cpk)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING,
+               SSL_R_UNABLE_TO_FIND_CERTIFICATE_ISSUER);
+        goto err;
+    }
+    if (url == NULL) {
+        aia = X509_get1_ocsp(st->x);
+        if (sk_OPENSSL_STRING_num(aia) > 0)
+            url = sk_OPENSSL_STRING_value(aia, 0);
+    }
+    if (url == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, SSL_R_NO_OCSP_RESPONDER);
+        goto err;
+    }
+    if (!OCSP_parse_url(url, &st->host, &port, &st->path, &use_ssl)
+        || use_ssl) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING,
+               SSL_R_BAD_OCSP_RESPONDER_URL);
+        ERR_add_error_data(2, "url=", url);
+        goto err;
+    }
+    if (BIO_get_host_ip(st->host, ip) <= 0) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, ERR_R_BIO_LIB);
+        ERR_add_error_data(2, "host=", st->host);
+        goto err;
+    }
+    len = (int)strlen(port) + 17;
+    if ((st->conn = OPENSSL_malloc(len)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    BIO_snprintf(st->conn, len, "%d.%d.%d.%d:%s", ip[0], ip[1], ip[2], ip[3],
+                 port);
+    if ((st->id = OCSP_cert_to_id(NULL, st->x, st->issuer)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, ERR_R_X509_LIB);
+        goto err;
+    }
+    ret = 1;
+ err:
+    if (port != NULL)
+        OPENSSL_free(port);
+    X509_email_free(aia);
+    return ret;
+}
+
+int SSL_CTX_set_ocsp_stapling(SSL_CTX *ctx, const char *url, long refresh)
+{
+    SSL_OCSP_STAPLING *stp, *old;
+    int i;
+
+    stp = OPENSSL_malloc(sizeof(*stp));
+    if (stp == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    memset(stp, 0, sizeof(*stp));
+    stp->references = 1;
+    stp->staples = OPENSSL_malloc(SSL_PKEY_NUM * sizeof(*stp->staples));
+    if (stp->staples == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(stp);
+        return 0;
+    }
+    memset(stp->staples, 0, SSL_PKEY_NUM * sizeof(*stp->staples));
+    stp->refresh = refresh > 0 ? refresh : OCSP_STAPLING_REFRESH;
+
+    for (i = 0; i < SSL_PKEY_NUM; i++) {
+        CERT_PKEY *cpk = &ctx->cert->pkeys[i];
+
+        if (cpk->x509 == NULL)
+            continue;
+        /* Counted first so that a partly set up entry is freed too */
+        if (!staple_setup(ctx, &stp->staples[stp->num++], cpk, url))
+            goto err;
+    }
+    if (stp->num == 0) {
+        SSLerr(SSL_F_SSL_CTX_SET_OCSP_STAPLING, SSL_R_NO_CERTIFICATE_ASSIGNED);
+        goto err;
+    }
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    old = ctx->ocsp_stapling;
+    ctx->ocsp_stapling = stp;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    ssl_ocsp_stapling_free(old);
+    return 1;
+ err:
+    ssl_ocsp_stapling_free(stp);
+    return 0;
+}
+
+/*
+ * Advance the fetch for one certificate as far as possible without
+ * blocking. Returns 1 with a new response that has been checked, 0 if the
+ * fetch failed and -1 if it is still in progress.
+ */
+static int staple_fetch(SSL_CTX *ctx, SSL_OCSP_STAPLE *st, time_t now,
+                        unsigned char **pder, int *plen, time_t *pexpires)
+{
+    OCSP_REQUEST *req = NULL;
+    OCSP_CERTID *id;
+    OCSP_RESPONSE *resp = NULL;
+    OCSP_BASICRESP *bs = NULL;
+    ASN1_GENERALIZEDTIME *thisupd, *nextupd;
+    STACK_OF(X509) *issuers = NULL;
+    X509_STORE *store = NULL;
+    unsigned char *p;
+    int rv, status, reason, day, sec, ret = 0;
+
+    /* Failures are retried later: don't leave them to the handshake */
+    ERR_set_mark();
+    if (st->rctx == NULL) {
+        if ((st->bio = BIO_new_connect(st->conn)) == NULL)
+            goto end;
+        BIO_set_nbio(st->bio, 1);
+        st->rctx = OCSP_sendreq_new(st->bio, st->path, NULL, -1);
+        req = OCSP_REQUEST_new();
+        if (st->rctx == NULL || req == NULL
+            || (id = OCSP_CERTID_dup(st->id)) == NULL
+            || !OCSP_request_add0_id(req, id)
+            || !OCSP_REQ_CTX_add1_header(st->rctx, "Host", st->host)
+            || !OCSP_REQ_CTX_set1_req(st->rctx, req))
+            goto end;
+        /* The request has been written to the context */
+        OCSP_REQUEST_free(req);
+        req = NULL;
+        st->started = now;
+    }
+
+    rv = OCSP_sendreq_nbio(&resp, st->rctx);
+    if (rv == -1) {
+        if (now - st->started < OCSP_STAPLING_TIMEOUT) {
+            ERR_pop_to_mark();
+            return -1;
+        }
+        goto end;
+    }
+    if (rv != 1)
+        goto end;
+
+    if (OCSP_response_status(resp) != OCSP_RESPONSE_STATUS_SUCCESSFUL
+        || (bs = OCSP_response_get1_basic(resp)) == NULL)
+        goto end;
+    /* Signed by the issuer itself, or by a responder verified from it */
+    store = ssl_ctx_get1_cert_store(ctx);
+    if ((issuers = sk_X509_new_null()) == NULL
+        || !sk_X509_push(issuers, st->issuer)
+        || OCSP_basic_verify(bs, issuers, store, OCSP_TRUSTOTHER) <= 0)
+        goto end;
+    if (!OCSP_resp_find_status(bs, st->id, &status, &reason, NULL,
+                               &thisupd, &nextupd)
+        || !OCSP_check_validity(thisupd, nextupd, OCSP_STAPLING_LEEWAY, -1))
+        goto end;
+    *pexpires = 0;
+    if (nextupd != NULL) {
+        if (!ASN1_TIME_diff(&day, &sec, NULL, nextupd))
+            goto end;
+        *pexpires = now + (time_t)day * 24 * 60 * 60 + sec;
+    }
+
+    if ((*plen = i2d_OCSP_RESPONSE(resp, NULL)) <= 0
+        || (*pder = OPENSSL_malloc(*plen)) == NULL)
+        goto end;
+    p = *pder;
+    i2d_OCSP_RESPONSE(resp, &p);
+    ret = 1;
+ end:
+    if (req != NULL)
+        OCSP_REQUEST_free(req);
+    if (resp != NULL)
+        OCSP_RESPONSE_free(resp);
+    if (bs != NULL)
+        OCSP_BASICRESP_free(bs);
+    sk_X509_free(issuers);
+    if (store != NULL)
+        X509_STORE_free(store);
+    if (st->rctx != NULL) {
+        OCSP_REQ_CTX_free(st->rctx);
+        st->rctx = NULL;
+    }
+    if (st->bio != NULL) {
+        BIO_free_all(st->bio);
+        st->bio = NULL;
+    }
+    ERR_pop_to_mark();
+    return ret;
+}
+
+static void stapling_update(SSL_CTX *ctx, SSL_OCSP_STAPLING *stp, time_t now)
+{
+    SSL_OCSP_STAPLE *st;
+    unsigned char *der = NULL;
+    time_t expires = 0, next, due;
+    int i, rv, len = 0, claimed = 0;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    rv = !stp->busy && now >= stp->due;
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (!rv)
+        return;
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if (!stp->busy && now >= stp->due)
+        stp->busy = claimed = 1;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (!claimed)
+        return;
+
+    for (i = 0; i < stp->num; i++) {
+        st = &stp->staples[i];
+        if (st->rctx == NULL && now < st->refresh)
+            continue;
+        rv = staple_fetch(ctx, st, now, &der, &len, &expires);
+        if (rv < 0)
+            continue;
+        if (rv == 0) {
+            st->refresh = now + (stp->refresh < OCSP_STAPLING_RETRY ?
+                                 stp->refresh : OCSP_STAPLING_RETRY);
+            continue;
+        }
+        /* Refresh half way to nextUpdate if that comes first */
+        next = stp->refresh;
+        if (expires != 0 && (expires - now) / 2 < next)
+            next = (expires - now) / 2;
+        if (next < OCSP_STAPLING_TIMEOUT)
+            next = OCSP_STAPLING_TIMEOUT;
+        CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+        if (st->resp != NULL)
+            OPENSSL_free(st->resp);
+        st->resp = der;
+        st->resp_len = len;
+        st->expires = expires;
+        CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+        st->refresh = now + next;
+    }
+
+    due = 0;
+    for (i = 0; i < stp->num; i++) {
+        st = &stp->staples[i];
+        next = st->rctx != NULL ? now : st->refresh;
+        if (i == 0 || next < due)
+            due = next;
+    }
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    stp->due = due;
+    stp->busy = 0;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+}
+
+int SSL_CTX_update_ocsp_stapling(SSL_CTX *ctx)
+{
+    SSL_OCSP_STAPLING *stp;
+    time_t now = time(NULL);
+    int i, n = 0;
+
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((stp = ctx->ocsp_stapling) != NULL)
+        stp->references++;
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (stp == NULL)
+        return 0;
+    stapling_update(ctx, stp, now);
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    for (i = 0; i < stp->num; i++) {
+        if (stp->staples[i].resp != NULL
+            && (stp->staples[i].expires == 0
+                || now < stp->staples[i].expires))
+            n++;
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    ssl_ocsp_stapling_free(stp);
+    return n;
+}
+
+/*
+ * Status callback used when the application has not set one: staple a copy
+ * of the current response for the certificate being sent, if there is one.
+ */
+int ssl_ocsp_stapling_cb(SSL *s)
+{
+    SSL_OCSP_STAPLING *stp;
+    SSL_OCSP_STAPLE *st;
+    X509 *x = s->cert->key->x509;
+    unsigned char *resp = NULL;
+    time_t now = time(NULL);
+    int i, len = 0;
+
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    stp = s->ctx->ocsp_stapling;
+    for (i = 0; stp != NULL && i < stp->num; i++) {
+        st = &stp->staples[i];
+        if (st->x != x && X509_cmp(st->x, x) != 0)
+            continue;
+        if (st->resp != NULL && (st->expires == 0 || now < st->expires)
+            && (resp = OPENSSL_malloc(st->resp_len)) != NULL) {
+            memcpy(resp, st->resp, st->resp_len);
+            len = st->resp_len;
+        }
+        break;
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+
+    if (resp == NULL)
+        return SSL_TLSEXT_ERR_NOACK;
+    if (s->tlsext_ocsp_resp != NULL)
+        OPENSSL_free(s->tlsext_ocsp_resp);
+    s->tlsext_ocsp_resp = resp;
+    s->tlsext_ocsp_resplen = len;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+#endif
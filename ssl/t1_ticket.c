@@ -0,0 +1,393 @@
+/* ssl/t1_ticket.c */
+/* ====================================================================
+ * Copyright (c) 2024 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+
+/*
+ * Session ticket key ring. Tickets are sealed with AES-GCM under the newest
+ * key of the ring and opened with whichever key their name selects, so a
+ * ticket stays valid for as long as its key remains on the ring. Each key
+ * is kept as an EVP_CIPHER_CTX with its key schedule and GHASH tables
+ * already set up: a ticket only copies that context and sets a fresh IV,
+ * and is then encrypted and authenticated in a single pass.
+ *
+ * Ticket format: key name (16) | IV (12) | ciphertext | tag (16), where the
+ * key name and IV are authenticated as additional data.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#ifndef OPENSSL_NO_TLSEXT
+
+# include <openssl/evp.h>
+# include <openssl/rand.h>
+
+# define TICKET_KEYS_MAX         16
+# define TICKET_KEYS_DEFAULT     3
+# define TICKET_NAME_LEN         16
+# define TICKET_IV_LEN           12
+# define TICKET_TAG_LEN          16
+
+typedef struct {
+    unsigned char name[TICKET_NAME_LEN];
+    /* Set up with the key once, only ever copied afterwards */
+    EVP_CIPHER_CTX ctx;
+    time_t created;
+} SSL_TICKET_KEY;
+
+struct ssl_ticket_keys_st {
+    /* keys[0] seals new tickets, all of them open tickets */
+    SSL_TICKET_KEY *keys[TICKET_KEYS_MAX];
+    int num;
+    int max;
+    /* Seconds between automatic rotations, 0 if rotation is manual */
+    long interval;
+};
+
+static void ticket_key_free(SSL_TICKET_KEY *k)
+{
+    if (k == NULL)
+        return;
+    EVP_CIPHER_CTX_cleanup(&k->ctx);
+    OPENSSL_cleanse(k->name, sizeof(k->name));
+    OPENSSL_free(k);
+}
+
+static SSL_TICKET_KEY *ticket_key_new(const unsigned char *name,
+                                      const unsigned char *key,
+                                      size_t keylen)
+{
+    SSL_TICKET_KEY *k;
+    const EVP_CIPHER *cipher;
+
+    cipher = keylen == 32 ? EVP_aes_256_gcm() : EVP_aes_128_gcm();
+    if ((k = OPENSSL_malloc(sizeof(*k))) == NULL)
+        return NULL;
+    EVP_CIPHER_CTX_init(&k->ctx);
+    if (!EVP_EncryptInit_ex(&k->ctx, cipher, NULL, key, NULL)) {
+        ticket_key_free(k);
+        return NULL;
+    }
+    memcpy(k->name, name, TICKET_NAME_LEN);
+    k->created = time(NULL);
+    return k;
+}
+
+static SSL_TICKET_KEY *ticket_key_random(void)
+{
+    unsigned char buf[TICKET_NAME_LEN + 16];
+    SSL_TICKET_KEY *k = NULL;
+
+    if (RAND_bytes(buf, sizeof(buf)) > 0)
+        k = ticket_key_new(buf, buf + TICKET_NAME_LEN, 16);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    return k;
+}
+
+/* Make |k| the sealing key, dropping the oldest key if the ring is full */
+static void ticket_keys_push(SSL_TICKET_KEYS *tk, SSL_TICKET_KEY *k)
+{
+    if (tk->num == tk->max)
+        ticket_key_free(tk->keys[--tk->num]);
+    memmove(&tk->keys[1], &tk->keys[0], tk->num * sizeof(tk->keys[0]));
+    tk->keys[0] = k;
+    tk->num++;
+}
+
+/*
+ * Returns the key ring of |ctx|, creating it with a random key if needed.
+ * Called with CRYPTO_LOCK_SSL_CTX write locked.
+ */
+static SSL_TICKET_KEYS *ticket_keys_get(SSL_CTX *ctx)
+{
+    SSL_TICKET_KEYS *tk;
+
+    if (ctx->ticket_keys != NULL)
+        return ctx->ticket_keys;
+    if ((tk = OPENSSL_malloc(sizeof(*tk))) == NULL)
+        return NULL;
+    memset(tk, 0, sizeof(*tk));
+    tk->max = TICKET_KEYS_DEFAULT;
+    if ((tk->keys[0] = ticket_key_random()) == NULL) {
+        OPENSSL_free(tk);
+        return NULL;
+    }
+    tk->num = 1;
+    ctx->ticket_keys = tk;
+    return tk;
+}
+
+void ssl_ticket_keys_free(SSL_TICKET_KEYS *tk)
+{
+    int i;
+
+    if (tk == NULL)
+        return;
+    for (i = 0; i < tk->num; i++)
+        ticket_key_free(tk->keys[i]);
+    OPENSSL_free(tk);
+}
+
+int SSL_CTX_set_ticket_key_rotation(SSL_CTX *ctx, int num, long interval)
+{
+    SSL_TICKET_KEYS *tk;
+
+    if (num < 1 || num > TICKET_KEYS_MAX || interval < 0) {
+        SSLerr(SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION, SSL_R_BAD_VALUE);
+        return 0;
+    }
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((tk = ticket_keys_get(ctx)) != NULL) {
+        while (tk->num > num)
+            ticket_key_free(tk->keys[--tk->num]);
+        tk->max = num;
+        tk->interval = interval;
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (tk == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_TICKET_KEY_ROTATION, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    return 1;
+}
+
+int SSL_CTX_add_ticket_key(SSL_CTX *ctx, const unsigned char *name,
+                           const unsigned char *key, size_t keylen)
+{
+    SSL_TICKET_KEYS *tk;
+    SSL_TICKET_KEY *k;
+
+    if (keylen != 16 && keylen != 32) {
+        SSLerr(SSL_F_SSL_CTX_ADD_TICKET_KEY,
+               SSL_R_INVALID_TICKET_KEYS_LENGTH);
+        return 0;
+    }
+    if ((k = ticket_key_new(name, key, keylen)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_ADD_TICKET_KEY, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((tk = ticket_keys_get(ctx)) != NULL)
+        ticket_keys_push(tk, k);
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (tk == NULL) {
+        ticket_key_free(k);
+        SSLerr(SSL_F_SSL_CTX_ADD_TICKET_KEY, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    return 1;
+}
+
+int SSL_CTX_rotate_ticket_keys(SSL_CTX *ctx)
+{
+    SSL_TICKET_KEYS *tk;
+    SSL_TICKET_KEY *k;
+
+    if ((k = ticket_key_random()) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_ROTATE_TICKET_KEYS, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if ((tk = ticket_keys_get(ctx)) != NULL)
+        ticket_keys_push(tk, k);
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (tk == NULL) {
+        ticket_key_free(k);
+        SSLerr(SSL_F_SSL_CTX_ROTATE_TICKET_KEYS, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    return 1;
+}
+
+/* Rotates the keys of |tk| if the sealing key has served its interval */
+static void ticket_keys_check_rotation(SSL_TICKET_KEYS *tk)
+{
+    SSL_TICKET_KEY *k;
+    time_t now;
+    int due;
+
+    if (tk->interval == 0)
+        return;
+    now = time(NULL);
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    due = now - tk->keys[0]->created >= tk->interval;
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (!due)
+        return;
+
+    /* On failure the current key just stays in use a little longer */
+    if ((k = ticket_key_random()) == NULL)
+        return;
+    CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+    if (now - tk->keys[0]->created >= tk->interval) {
+        ticket_keys_push(tk, k);
+        k = NULL;
+    }
+    CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+    ticket_key_free(k);
+}
+
+/*
+ * Seals |inlen| bytes of session encoding into a ticket at |out|, which
+ * needs room for inlen + TLS1_TICKET_KEYS_OVERHEAD bytes. Returns 1 and
+ * sets |*outlen| on success, 0 on error.
+ */
+int tls1_ticket_keys_encrypt(SSL_CTX *ctx, const unsigned char *in,
+                             int inlen, unsigned char *out, int *outlen)
+{
+    SSL_TICKET_KEYS *tk = ctx->ticket_keys;
+    EVP_CIPHER_CTX c;
+    unsigned char *p = out;
+    int len, ok;
+
+    ticket_keys_check_rotation(tk);
+
+    EVP_CIPHER_CTX_init(&c);
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    memcpy(p, tk->keys[0]->name, TICKET_NAME_LEN);
+    ok = EVP_CIPHER_CTX_copy(&c, &tk->keys[0]->ctx);
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    p += TICKET_NAME_LEN;
+
+    if (!ok
+        || RAND_bytes(p, TICKET_IV_LEN) <= 0
+        || !EVP_EncryptInit_ex(&c, NULL, NULL, NULL, p)
+        || !EVP_EncryptUpdate(&c, NULL, &len, out,
+                              TICKET_NAME_LEN + TICKET_IV_LEN))
+        goto err;
+    p += TICKET_IV_LEN;
+    if (!EVP_EncryptUpdate(&c, p, &len, in, inlen))
+        goto err;
+    p += len;
+    if (!EVP_EncryptFinal_ex(&c, p, &len))
+        goto err;
+    p += len;
+    if (!EVP_CIPHER_CTX_ctrl(&c, EVP_CTRL_GCM_GET_TAG, TICKET_TAG_LEN, p))
+        goto err;
+    p += TICKET_TAG_LEN;
+    EVP_CIPHER_CTX_cleanup(&c);
+    *outlen = p - out;
+    return 1;
+ err:
+    EVP_CIPHER_CTX_cleanup(&c);
+    return 0;
+}
+
+/*-
+ * Opens the ticket |etick| if it was sealed with a key of the ring. On
+ * success |*psdec| is set to a newly allocated buffer holding |*pslen|
+ * bytes of session encoding.
+ *
+ * Returns:
+ *   -1: fatal error.
+ *    0: the ticket's key name is not on the ring.
+ *    1: the ticket couldn't be decrypted, or its key couldn't be used.
+ *    2: the ticket was decrypted.
+ *    3: same as 2, but the key is no longer the sealing key.
+ */
+int tls1_ticket_keys_decrypt(SSL_CTX *ctx, const unsigned char *etick,
+                             int eticklen, unsigned char **psdec, int *pslen)
+{
+    SSL_TICKET_KEYS *tk = ctx->ticket_keys;
+    EVP_CIPHER_CTX c;
+    unsigned char *sdec;
+    const unsigned char *iv = etick + TICKET_NAME_LEN;
+    int i, len, slen, found = 0, current = 0, ok = 0;
+
+    EVP_CIPHER_CTX_init(&c);
+    CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+    for (i = 0; i < tk->num; i++) {
+        if (memcmp(etick, tk->keys[i]->name, TICKET_NAME_LEN) == 0) {
+            found = 1;
+            current = i == 0;
+            ok = EVP_CIPHER_CTX_copy(&c, &tk->keys[i]->ctx);
+            break;
+        }
+    }
+    CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+    if (!found)
+        return 0;
+    if (!ok) {
+        /* Fall back to a full handshake */
+        EVP_CIPHER_CTX_cleanup(&c);
+        return 1;
+    }
+
+    slen = eticklen - (TICKET_NAME_LEN + TICKET_IV_LEN + TICKET_TAG_LEN);
+    if (slen <= 0) {
+        EVP_CIPHER_CTX_cleanup(&c);
+        return 1;
+    }
+    if ((sdec = OPENSSL_malloc(slen)) == NULL) {
+        EVP_CIPHER_CTX_cleanup(&c);
+        return -1;
+    }
+    if (!EVP_DecryptInit_ex(&c, NULL, NULL, NULL, iv)
+        || !EVP_DecryptUpdate(&c, NULL, &len, etick,
+                              TICKET_NAME_LEN + TICKET_IV_LEN)
+        || !EVP_CIPHER_CTX_ctrl(&c, EVP_CTRL_GCM_SET_TAG, TICKET_TAG_LEN,
+                                (unsigned char *)etick + eticklen
+                                - TICKET_TAG_LEN)
+        || !EVP_DecryptUpdate(&c, sdec, &len, iv + TICKET_IV_LEN, slen)
+        || EVP_DecryptFinal_ex(&c, sdec + len, &slen) <= 0) {
+        EVP_CIPHER_CTX_cleanup(&c);
+        OPENSSL_free(sdec);
+        return 1;
+    }
+    EVP_CIPHER_CTX_cleanup(&c);
+    *psdec = sdec;
+    *pslen = len + slen;
+    return current ? 2 : 3;
+}
+
+#endif                          /* OPENSSL_NO_TLSEXT */
@@ -10,6 +10,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <openssl/asn1t.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <openssl/ec.h>
+#include <openssl/err.h>
 
 typedef struct {
     ASN1_STRING *invalidDirString;
@@ -56,10 +60,454 @@ static int test_invalid_template(void)
     return 0;
 }
 
+/* Self-signed P-256 certificate with CA extensions */
+static unsigned char t_cert[] = {
+    0x30, 0x82, 0x01, 0xb4, 0x30, 0x82, 0x01, 0x59, 0xa0, 0x03, 0x02, 0x01,
+    0x02, 0x02, 0x01, 0x01, 0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce,
+    0x3d, 0x04, 0x03, 0x02, 0x30, 0x3a, 0x31, 0x0b, 0x30, 0x09, 0x06, 0x03,
+    0x55, 0x04, 0x06, 0x13, 0x02, 0x55, 0x4b, 0x31, 0x16, 0x30, 0x14, 0x06,
+    0x03, 0x55, 0x04, 0x0a, 0x0c, 0x0d, 0x4f, 0x70, 0x65, 0x6e, 0x53, 0x53,
+    0x4c, 0x20, 0x47, 0x72, 0x6f, 0x75, 0x70, 0x31, 0x13, 0x30, 0x11, 0x06,
+    0x03, 0x55, 0x04, 0x03, 0x0c, 0x0a, 0x61, 0x72, 0x65, 0x6e, 0x61, 0x20,
+    0x74, 0x65, 0x73, 0x74, 0x30, 0x1e, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30,
+    0x31, 0x38, 0x32, 0x30, 0x35, 0x35, 0x32, 0x39, 0x5a, 0x17, 0x0d, 0x33,
+    0x36, 0x31, 0x30, 0x31, 0x35, 0x32, 0x30, 0x35, 0x35, 0x32, 0x39, 0x5a,
+    0x30, 0x3a, 0x31, 0x0b, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13,
+    0x02, 0x55, 0x4b, 0x31, 0x16, 0x30, 0x14, 0x06, 0x03, 0x55, 0x04, 0x0a,
+    0x0c, 0x0d, 0x4f, 0x70, 0x65, 0x6e, 0x53, 0x53, 0x4c, 0x20, 0x47, 0x72,
+    0x6f, 0x75, 0x70, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x03,
+    0x0c, 0x0a, 0x61, 0x72, 0x65, 0x6e, 0x61, 0x20, 0x74, 0x65, 0x73, 0x74,
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02,
+    0x01, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03,
+    0x42, 0x00, 0x04, 0x5e, 0xc9, 0xdb, 0x12, 0x75, 0xe9, 0x38, 0x12, 0xd7,
+    0x09, 0x66, 0xc1, 0xc2, 0x2b, 0x1c, 0x5b, 0x4a, 0x83, 0x64, 0x30, 0x75,
+    0x03, 0xa3, 0xb2, 0xdd, 0x3b, 0x06, 0x3d, 0xba, 0x4f, 0xfb, 0xf2, 0xce,
+    0x75, 0xf5, 0xb5, 0x35, 0xd0, 0xd0, 0xf8, 0x73, 0x5c, 0x72, 0xf1, 0x1e,
+    0x0a, 0x1f, 0x9a, 0x99, 0x94, 0x08, 0x89, 0x38, 0x11, 0xe1, 0xd9, 0x32,
+    0x13, 0x7e, 0x01, 0x8c, 0x9b, 0x77, 0x41, 0xa3, 0x50, 0x30, 0x4e, 0x30,
+    0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04, 0x14, 0xb7, 0x98,
+    0xf4, 0xf7, 0xea, 0x1f, 0xf4, 0x64, 0x42, 0xf9, 0xe2, 0xa2, 0x89, 0xd7,
+    0x3d, 0xd0, 0x0e, 0xef, 0x7b, 0xec, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d,
+    0x23, 0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0xb7, 0x98, 0xf4, 0xf7, 0xea,
+    0x1f, 0xf4, 0x64, 0x42, 0xf9, 0xe2, 0xa2, 0x89, 0xd7, 0x3d, 0xd0, 0x0e,
+    0xef, 0x7b, 0xec, 0x30, 0x0c, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x04, 0x05,
+    0x30, 0x03, 0x01, 0x01, 0xff, 0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48,
+    0xce, 0x3d, 0x04, 0x03, 0x02, 0x03, 0x49, 0x00, 0x30, 0x46, 0x02, 0x21,
+    0x00, 0xbc, 0x3c, 0x9d, 0x2d, 0x33, 0x13, 0x33, 0x1d, 0xd4, 0x3a, 0x86,
+    0x5d, 0x80, 0xec, 0x17, 0xdf, 0xf8, 0x77, 0x3e, 0x7b, 0x55, 0x97, 0xa8,
+    0x0f, 0xbc, 0x91, 0x1e, 0x6e, 0x8f, 0xe6, 0x51, 0xf3, 0x02, 0x21, 0x00,
+    0xe4, 0xe3, 0xfc, 0xf8, 0x35, 0xb4, 0x94, 0x1b, 0xd9, 0xf2, 0x99, 0x1c,
+    0x74, 0x8d, 0x82, 0x66, 0x57, 0x92, 0xcc, 0xda, 0x9f, 0xb7, 0x5c, 0xa7,
+    0xab, 0x35, 0x48, 0xa4, 0x53, 0x2d, 0xd3, 0xa0,
+};
+
+static int test_borrow_decode(void)
+{
+    unsigned char copy[sizeof(t_cert)];
+    const unsigned char *p = t_cert;
+    unsigned char *der = NULL;
+    ASN1_INTEGER *serial;
+    ASN1_BIT_STRING *key;
+    X509_EXTENSION *ext;
+    EVP_PKEY *pkey = NULL;
+    X509 *x;
+    int len, ret = 0;
+
+    memcpy(copy, t_cert, sizeof(t_cert));
+    x = (X509 *)ASN1_item_d2i_borrow(NULL, &p, sizeof(t_cert),
+                                     ASN1_ITEM_rptr(X509));
+    if (x == NULL || p != t_cert + sizeof(t_cert)) {
+        printf("FAILED: borrowing decode of certificate\n");
+        goto err;
+    }
+
+    serial = X509_get_serialNumber(x);
+    key = x->cert_info->key->public_key;
+    ext = X509_get_ext(x, 0);
+#define IN_CERT(s) ((s)->data >= t_cert \
+                    && (s)->data + (s)->length <= t_cert + sizeof(t_cert) \
+                    && ((s)->flags & ASN1_STRING_FLAG_BORROWED))
+    if (!IN_CERT(serial) || !IN_CERT(key) || ext == NULL
+        || !IN_CERT(ext->value) || !IN_CERT(x->signature)) {
+        printf("FAILED: borrowed fields do not point into input\n");
+        goto err;
+    }
+
+    len = i2d_X509(x, &der);
+    if (len != sizeof(t_cert) || memcmp(der, t_cert, len) != 0) {
+        printf("FAILED: borrowed certificate does not re-encode\n");
+        goto err;
+    }
+    if ((pkey = X509_get_pubkey(x)) == NULL || X509_verify(x, pkey) != 1
+        || X509_check_ca(x) != 1) {
+        printf("FAILED: borrowed certificate not usable\n");
+        goto err;
+    }
+
+    /* Modifying a borrowed field must leave the input alone */
+    if (!ASN1_INTEGER_set(serial, 12345) || ASN1_INTEGER_get(serial) != 12345
+        || !ASN1_BIT_STRING_set_bit(x->signature, 0, 0)
+        || !ASN1_OCTET_STRING_set(ext->value, (unsigned char *)"x", 1)
+        || (serial->flags & ASN1_STRING_FLAG_BORROWED)
+        || memcmp(copy, t_cert, sizeof(t_cert)) != 0) {
+        printf("FAILED: modifying borrowed certificate\n");
+        goto err;
+    }
+    ret = 1;
+ err:
+    OPENSSL_free(der);
+    EVP_PKEY_free(pkey);
+    X509_free(x);
+    return ret;
+}
+
+#ifndef OPENSSL_NO_EC
+static int leaks;
+
+static void *count_leak(unsigned long order, const char *file, int line,
+                        int num_bytes, void *addr)
+{
+    leaks++;
+    return NULL;
+}
+
+/*
+ * Re-signing a borrowed certificate replaces the borrowed signature; it
+ * must neither free the input buffer nor leak the new signature.
+ */
+static int test_borrow_resign(void)
+{
+    unsigned char copy[sizeof(t_cert)];
+    const unsigned char *p = t_cert;
+    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    EVP_PKEY *pkey = EVP_PKEY_new();
+    X509 *x = NULL;
+    int ret = 0;
+
+    if (ec == NULL || pkey == NULL || !EC_KEY_generate_key(ec)
+        || !EVP_PKEY_set1_EC_KEY(pkey, ec)) {
+        printf("FAILED: generating signing key\n");
+        goto err;
+    }
+    memcpy(copy, t_cert, sizeof(t_cert));
+
+    CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_ON);
+    x = (X509 *)ASN1_item_d2i_borrow(NULL, &p, sizeof(t_cert),
+                                     ASN1_ITEM_rptr(X509));
+    if (x == NULL || !(x->signature->flags & ASN1_STRING_FLAG_BORROWED)
+        || !X509_sign(x, pkey, EVP_sha256())
+        || (x->signature->flags & ASN1_STRING_FLAG_BORROWED)
+        || X509_verify(x, pkey) != 1
+        || memcmp(copy, t_cert, sizeof(t_cert)) != 0) {
+        printf("FAILED: re-signing borrowed certificate\n");
+        goto err;
+    }
+    /* The key picks up signing state lazily, so it goes too */
+    X509_free(x);
+    EVP_PKEY_free(pkey);
+    EC_KEY_free(ec);
+    x = NULL;
+    pkey = NULL;
+    ec = NULL;
+    CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_OFF);
+
+    leaks = 0;
+    CRYPTO_mem_leaks_cb(count_leak);
+    if (leaks != 0) {
+        printf("FAILED: re-signing borrowed certificate leaked\n");
+        goto err;
+    }
+    ret = 1;
+ err:
+    CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_OFF);
+    X509_free(x);
+    EC_KEY_free(ec);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+#endif
+
+static int test_lazy_cache(void)
+{
+    const unsigned char *p = t_cert;
+    X509 *x, *y = NULL;
+    int ret = 0;
+
+    x = d2i_X509(NULL, &p, sizeof(t_cert));
+    if (x == NULL || (x->ex_flags & (EXFLAG_SET | EXFLAG_SHA1))
+        || x->cert_info->subject->canon_enclen != -1) {
+        printf("FAILED: certificate caches filled in on decode\n");
+        goto err;
+    }
+    if (X509_NAME_cmp(X509_get_subject_name(x), X509_get_issuer_name(x))
+        || x->cert_info->subject->canon_enclen <= 0
+        || (y = X509_dup(x)) == NULL || X509_cmp(x, y) != 0
+        || !(x->ex_flags & EXFLAG_SHA1) || (x->ex_flags & EXFLAG_SET)) {
+        printf("FAILED: certificate caches filled in on use\n");
+        goto err;
+    }
+    X509_free(y);
+    y = X509_dup(x);
+    if (y == NULL || X509_check_purpose(y, -1, 0) != 1
+        || !(y->ex_flags & EXFLAG_SHA1)
+        || memcmp(y->sha1_hash, x->sha1_hash, SHA_DIGEST_LENGTH) != 0) {
+        printf("FAILED: X509_check_purpose(x, -1, 0) did not set hash\n");
+        goto err;
+    }
+    ret = 1;
+ err:
+    X509_free(x);
+    X509_free(y);
+    return ret;
+}
+
+#ifndef OPENSSL_NO_EC
+/*
+ * Build a CRL revoking every third serial number from 3 to 297, one of them
+ * negative, with reason codes on every other entry. If |critical| is set
+ * one reason code is marked critical.
+ */
+static X509_CRL *make_crl(EVP_PKEY *pkey, int critical)
+{
+    X509_CRL *crl = X509_CRL_new();
+    X509_NAME *name = X509_NAME_new();
+    ASN1_TIME *t = X509_gmtime_adj(NULL, 0);
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    ASN1_ENUMERATED *reason = ASN1_ENUMERATED_new();
+    X509_REVOKED *rev;
+    long i;
+    int ok;
+
+    ok = crl != NULL && name != NULL && t != NULL && serial != NULL
+        && reason != NULL && X509_CRL_set_version(crl, 1)
+        && X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                      (unsigned char *)"Test CA", -1, -1, 0)
+        && X509_CRL_set_issuer_name(crl, name)
+        && X509_CRL_set_lastUpdate(crl, t);
+    for (i = 3; ok && i < 300; i += 3) {
+        ok = (rev = X509_REVOKED_new()) != NULL;
+        if (!ok)
+            break;
+        ok = ASN1_INTEGER_set(serial, i == 150 ? -i : i)
+            && X509_REVOKED_set_serialNumber(rev, serial)
+            && X509_REVOKED_set_revocationDate(rev, t);
+        if (ok && i % 2 == 0) {
+            ok = ASN1_ENUMERATED_set(reason, i == 6
+                                     ? CRL_REASON_REMOVE_FROM_CRL
+                                     : CRL_REASON_KEY_COMPROMISE)
+                && X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason, reason,
+                                             critical && i == 96, 0);
+        }
+        if (!ok || !X509_CRL_add0_revoked(crl, rev)) {
+            X509_REVOKED_free(rev);
+            ok = 0;
+        }
+    }
+    ok = ok && X509_CRL_sort(crl) && X509_CRL_sign(crl, pkey, EVP_sha256());
+    X509_NAME_free(name);
+    ASN1_TIME_free(t);
+    ASN1_INTEGER_free(serial);
+    ASN1_ENUMERATED_free(reason);
+    if (!ok) {
+        X509_CRL_free(crl);
+        return NULL;
+    }
+    return crl;
+}
+
+static int check_compact_crl(EVP_PKEY *pkey, int critical)
+{
+    X509_CRL *crl, *full = NULL, *compact = NULL, *resigned = NULL;
+    X509_REVOKED *r1, *r2;
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    X509_STORE *store = X509_STORE_new();
+    X509_OBJECT *obj;
+    ASN1_TIME *t = NULL;
+    unsigned char *der = NULL, *der2 = NULL, *der3 = NULL;
+    const unsigned char *p;
+    int len, i, k1, k2, ret = 0;
+
+    if ((crl = make_crl(pkey, critical)) == NULL || serial == NULL
+        || store == NULL || (len = i2d_X509_CRL(crl, &der)) <= 0) {
+        printf("FAILED: creating CRL\n");
+        goto err;
+    }
+    p = der;
+    full = d2i_X509_CRL(NULL, &p, len);
+    p = der;
+    compact = d2i_X509_CRL_compact(NULL, &p, len);
+    if (full == NULL || compact == NULL || p != der + len
+        || X509_CRL_get_REVOKED(compact) != NULL
+        || (full->flags & EXFLAG_CRITICAL) != (compact->flags & EXFLAG_CRITICAL)
+        || (compact->flags & EXFLAG_INVALID)) {
+        printf("FAILED: compact CRL decode\n");
+        goto err;
+    }
+    if (i2d_X509_CRL(compact, &der2) != len || memcmp(der, der2, len) != 0
+        || X509_CRL_verify(compact, pkey) != 1) {
+        printf("FAILED: compact CRL does not re-encode\n");
+        goto err;
+    }
+
+    for (i = -160; i < 310; i++) {
+        r1 = r2 = NULL;
+        if (!ASN1_INTEGER_set(serial, i))
+            goto err;
+        k1 = X509_CRL_get0_by_serial(full, &r1, serial);
+        k2 = X509_CRL_get0_by_serial(compact, &r2, serial);
+        if (k1 != k2 || (k1 && (r2 == NULL || r1->reason != r2->reason
+                                || ASN1_INTEGER_cmp(r1->serialNumber,
+                                                    r2->serialNumber)))) {
+            printf("FAILED: compact CRL lookup of serial %d\n", i);
+            goto err;
+        }
+    }
+
+    /* A CRL that is not newer does not replace the one in the store */
+    if (!X509_STORE_add_crl(store, full)
+        || X509_STORE_replace_crl(store, compact)) {
+        printf("FAILED: replaced CRL with one that is not newer\n");
+        goto err;
+    }
+    ERR_clear_error();
+
+    /* Re-signing a compact CRL must keep its entries */
+    if ((t = X509_gmtime_adj(NULL, 60)) == NULL
+        || !X509_CRL_set_lastUpdate(compact, t)
+        || !X509_CRL_sign(compact, pkey, EVP_sha256())
+        || (len = i2d_X509_CRL(compact, &der3)) <= 0) {
+        printf("FAILED: re-signing compact CRL\n");
+        goto err;
+    }
+    p = der3;
+    resigned = d2i_X509_CRL(NULL, &p, len);
+    if (resigned == NULL
+        || sk_X509_REVOKED_num(X509_CRL_get_REVOKED(resigned)) != 99
+        || X509_CRL_get0_by_serial(compact, &r2, serial) != 0
+        || !ASN1_INTEGER_set(serial, -150)
+        || X509_CRL_get0_by_serial(compact, &r2, serial) != 1) {
+        printf("FAILED: re-signed compact CRL lost its entries\n");
+        goto err;
+    }
+
+    /* The newer CRL takes the place of the full one */
+    if (!X509_STORE_replace_crl(store, compact)
+        || sk_X509_OBJECT_num(store->objs) != 1
+        || (obj = sk_X509_OBJECT_value(store->objs, 0))->data.crl != compact) {
+        printf("FAILED: replacing CRL in store\n");
+        goto err;
+    }
+    ret = 1;
+ err:
+    OPENSSL_free(der);
+    OPENSSL_free(der2);
+    OPENSSL_free(der3);
+    ASN1_TIME_free(t);
+    X509_CRL_free(resigned);
+    ASN1_INTEGER_free(serial);
+    X509_STORE_free(store);
+    X509_CRL_free(crl);
+    X509_CRL_free(full);
+    X509_CRL_free(compact);
+    return ret;
+}
+
+/* A CRL entry with two reason codes makes the CRL invalid */
+static int check_duplicate_reason(EVP_PKEY *pkey)
+{
+    X509_CRL *crl, *full = NULL, *compact = NULL;
+    X509_REVOKED *rev = X509_REVOKED_new();
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    ASN1_ENUMERATED *reason = ASN1_ENUMERATED_new();
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int len, ret = 0;
+
+    if ((crl = make_crl(pkey, 0)) == NULL || rev == NULL || serial == NULL
+        || reason == NULL || !ASN1_INTEGER_set(serial, 1000)
+        || !X509_REVOKED_set_serialNumber(rev, serial)
+        || !X509_REVOKED_set_revocationDate(rev, X509_CRL_get_lastUpdate(crl))
+        || !ASN1_ENUMERATED_set(reason, CRL_REASON_KEY_COMPROMISE)
+        || !X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason, reason, 0,
+                                      X509V3_ADD_APPEND)
+        || !X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason, reason, 0,
+                                      X509V3_ADD_APPEND)
+        || !X509_CRL_add0_revoked(crl, rev)) {
+        printf("FAILED: creating CRL with duplicate reason\n");
+        X509_REVOKED_free(rev);
+        goto err;
+    }
+    if (!X509_CRL_sort(crl) || !X509_CRL_sign(crl, pkey, EVP_sha256())
+        || (len = i2d_X509_CRL(crl, &der)) <= 0) {
+        printf("FAILED: creating CRL with duplicate reason\n");
+        goto err;
+    }
+    p = der;
+    full = d2i_X509_CRL(NULL, &p, len);
+    p = der;
+    compact = d2i_X509_CRL_compact(NULL, &p, len);
+    if (full == NULL || compact == NULL
+        || X509_CRL_get_REVOKED(compact) != NULL
+        || !(full->flags & EXFLAG_INVALID)
+        || !(compact->flags & EXFLAG_INVALID)) {
+        printf("FAILED: duplicate reason not flagged\n");
+        goto err;
+    }
+    ret = 1;
+ err:
+    OPENSSL_free(der);
+    ASN1_INTEGER_free(serial);
+    ASN1_ENUMERATED_free(reason);
+    X509_CRL_free(crl);
+    X509_CRL_free(full);
+    X509_CRL_free(compact);
+    return ret;
+}
+
+static int test_compact_crl(void)
+{
+    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    EVP_PKEY *pkey = EVP_PKEY_new();
+    int ret = 0;
+
+    if (ec == NULL || pkey == NULL || !EC_KEY_generate_key(ec)
+        || !EVP_PKEY_set1_EC_KEY(pkey, ec)) {
+        printf("FAILED: generating CRL key\n");
+        goto err;
+    }
+    ret = check_compact_crl(pkey, 0) && check_compact_crl(pkey, 1)
+        && check_duplicate_reason(pkey);
+ err:
+    EC_KEY_free(ec);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+#endif
+
 int main(void)
 {
+    CRYPTO_malloc_debug_init();
+
     if (!test_invalid_template())
         return 1;
 
+    OpenSSL_add_all_digests();
+
+    if (!test_borrow_decode())
+        return 1;
+
+    if (!test_lazy_cache())
+        return 1;
+
+#ifndef OPENSSL_NO_EC
+    if (!test_borrow_resign())
+        return 1;
+#endif
+
+#ifndef OPENSSL_NO_EC
+    if (!test_compact_crl())
+        return 1;
+#endif
+
     return 0;
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2017-2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Tests that the compact i2b_SSL_SESSION() encoding keeps everything the
+ * ASN.1 i2d_SSL_SESSION() one does. A session is round-tripped through
+ * both after each optional field is set, and the results must re-encode
+ * identically.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/err.h>
+
+static unsigned char *encode(SSL_SESSION *s, int bin, int *plen)
+{
+    unsigned char *der, *p;
+    int len;
+
+    len = bin ? i2b_SSL_SESSION(s, NULL) : i2d_SSL_SESSION(s, NULL);
+    if (len <= 0 || (der = OPENSSL_malloc(len)) == NULL)
+        return NULL;
+    p = der;
+    if ((bin ? i2b_SSL_SESSION(s, &p) : i2d_SSL_SESSION(s, &p)) != len
+        || p != der + len) {
+        OPENSSL_free(der);
+        return NULL;
+    }
+    *plen = len;
+    return der;
+}
+
+static SSL_SESSION *decode(const unsigned char *der, int len, int bin)
+{
+    const unsigned char *p = der;
+    SSL_SESSION *s;
+
+    s = bin ? b2i_SSL_SESSION(NULL, &p, len) : d2i_SSL_SESSION(NULL, &p, len);
+    if (s != NULL && p != der + len) {
+        SSL_SESSION_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int roundtrip(SSL_SESSION *s, const char *what)
+{
+    unsigned char *der = NULL, *bin = NULL, *bder = NULL, *bbin = NULL;
+    unsigned char *dder = NULL;
+    int der_len, bin_len, bder_len, bbin_len, dder_len, ret = 0;
+    SSL_SESSION *d = NULL, *b = NULL;
+
+    if ((der = encode(s, 0, &der_len)) == NULL
+        || (bin = encode(s, 1, &bin_len)) == NULL
+        || (d = decode(der, der_len, 0)) == NULL
+        || (b = decode(bin, bin_len, 1)) == NULL
+        || (dder = encode(d, 0, &dder_len)) == NULL
+        || (bder = encode(b, 0, &bder_len)) == NULL
+        || (bbin = encode(b, 1, &bbin_len)) == NULL) {
+        printf("FAILED: %s: encoding or decoding failed\n", what);
+        ERR_print_errors_fp(stdout);
+        goto err;
+    }
+    if (dder_len != der_len || memcmp(dder, der, der_len) != 0) {
+        printf("FAILED: %s: d2i/i2d does not round-trip\n", what);
+        goto err;
+    }
+    if (bder_len != dder_len || memcmp(bder, dder, dder_len) != 0) {
+        printf("FAILED: %s: b2i result differs from d2i result\n", what);
+        goto err;
+    }
+    if (bbin_len != bin_len || memcmp(bbin, bin, bin_len) != 0) {
+        printf("FAILED: %s: b2i/i2b does not round-trip\n", what);
+        goto err;
+    }
+    ret = 1;
+ err:
+    OPENSSL_free(der);
+    OPENSSL_free(bin);
+    OPENSSL_free(dder);
+    OPENSSL_free(bder);
+    OPENSSL_free(bbin);
+    SSL_SESSION_free(d);
+    SSL_SESSION_free(b);
+    return ret;
+}
+
+static X509 *read_cert(const char *file)
+{
+    BIO *in = BIO_new_file(file, "r");
+    X509 *x = NULL;
+
+    if (in != NULL)
+        x = PEM_read_bio_X509(in, NULL, NULL, NULL);
+    BIO_free(in);
+    return x;
+}
+
+int main(int argc, char *argv[])
+{
+    static unsigned char tick[300];
+    SSL_SESSION *s = NULL;
+    int ret = 1;
+
+    if (argc != 2) {
+        printf("Usage: ssl_session_test certfile\n");
+        return 1;
+    }
+
+    SSL_library_init();
+    SSL_load_error_strings();
+
+    if ((s = SSL_SESSION_new()) == NULL)
+        goto end;
+    s->ssl_version = TLS1_2_VERSION;
+    s->cipher_id = 0x0300002F;  /* AES128-SHA */
+    s->master_key_length = SSL_MAX_MASTER_KEY_LENGTH;
+    memset(s->master_key, 0x11, s->master_key_length);
+    s->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+    memset(s->session_id, 0x22, s->session_id_length);
+    s->sid_ctx_length = 5;
+    memcpy(s->sid_ctx, "ctx01", 5);
+    s->time = 1600000000;
+    s->timeout = 7200;
+    s->verify_result = X509_V_OK;
+    if (!roundtrip(s, "minimal session"))
+        goto end;
+
+    if ((s->peer = read_cert(argv[1])) == NULL) {
+        printf("FAILED: reading %s\n", argv[1]);
+        goto end;
+    }
+    if (!roundtrip(s, "peer certificate"))
+        goto end;
+
+#ifndef OPENSSL_NO_TLSEXT
+    if ((s->tlsext_hostname = BUF_strdup("www.example.com")) == NULL
+        || !roundtrip(s, "host name"))
+        goto end;
+    memset(tick, 0x33, sizeof(tick));
+    if ((s->tlsext_tick = BUF_memdup(tick, sizeof(tick))) == NULL)
+        goto end;
+    s->tlsext_ticklen = sizeof(tick);
+    s->tlsext_tick_lifetime_hint = 300;
+    if (!roundtrip(s, "ticket"))
+        goto end;
+#endif
+#ifndef OPENSSL_NO_PSK
+    if ((s->psk_identity_hint = BUF_strdup("hint")) == NULL
+        || !roundtrip(s, "PSK identity hint"))
+        goto end;
+    if ((s->psk_identity = BUF_strdup("Client_identity")) == NULL
+        || !roundtrip(s, "PSK identity"))
+        goto end;
+#endif
+#ifndef OPENSSL_NO_SRP
+    if ((s->srp_username = BUF_strdup("user")) == NULL
+        || !roundtrip(s, "SRP user name"))
+        goto end;
+#endif
+#ifndef OPENSSL_NO_KRB5
+    s->krb5_client_princ_len = 16;
+    memcpy(s->krb5_client_princ, "user@EXAMPLE.COM", 16);
+    if (!roundtrip(s, "Kerberos principal"))
+        goto end;
+#endif
+
+    ret = 0;
+ end:
+    if (ret == 0)
+        printf("PASS\n");
+    SSL_SESSION_free(s);
+    ERR_free_strings();
+    ERR_remove_thread_state(NULL);
+    EVP_cleanup();
+    CRYPTO_cleanup_all_ex_data();
+    return ret;
+}